@@ -18,6 +18,7 @@ namespace cbor_diff {
 	std::vector<char> cbor_encode(const cbor::CborObject& value);
 	cbor::CborObjectP cbor_decode(const std::vector<char>& input_bytes);
 
+	// copies the tree node by node, the copy shares no node with object
 	cbor::CborObjectP cbor_deep_clone(cbor::CborObject* object);
 
 	bool is_scalar_cbor_value_type(const cbor::CborObjectType& cbor_value_type);
@@ -65,12 +66,28 @@ namespace cbor_diff {
 
 		// Ѿɰ汾json,ʹdiffõ°汾
 		// @throws CborDiffException
+		// the result shares the subtrees the diff doesn't change with old_val, old_val itself is not changed.
+		// new values and added items are shared with the diff, and keep the arena of a decoded diff alive (see CborArena)
 		cbor::CborObjectP patch(const cbor::CborObjectP old_val, const DiffResultP diff_info);
 
+		// same result as value = patch(value, diff_info), but changes only the nodes on the paths the diff touches.
+		// a node that another tree shares is copied before it is changed, so only value sees the change.
+		// the copy is of the whole node (a map or array with all its items, which stay shared), so patching a top level
+		// map another tree still shares costs a copy of all its entries (about 35 ms for 100000 entries), and the
+		// saving over patch only holds for the nodes below it, or once value owns the top level map
+		// if it throws, value may be partly patched
+		// @throws CborDiffException
+		void patch_inplace(cbor::CborObjectP& value, const DiffResultP diff_info);
+
 		cbor::CborObjectP rollback_by_string(const std::string& new_hex, DiffResultP diff_info);
 
 		// °汾ʹdiffعɰ汾
 		// @throws CborDiffException
+		// the result shares the subtrees the diff doesn't change with new_val, new_val itself is not changed
 		cbor::CborObjectP rollback(const cbor::CborObjectP new_val, DiffResultP diff_info);
+
+		// same result as value = rollback(value, diff_info), changing value in place like patch_inplace
+		// @throws CborDiffException
+		void rollback_inplace(cbor::CborObjectP& value, DiffResultP diff_info);
 	};
 }
\ No newline at end of file
@@ -1,8 +1,30 @@
 #pragma once
+#include <cstddef>
 
 namespace cbor_diff {
 
 	void test_cbor_json();
 	void test_cbor_diff();
 
+	// encodes, decodes and deep clones a map of entries_count records (about 180 bytes of cbor each), sizes its
+	// encoding, streams it through the decoder and decodes it to a contract storage value with and without the
+	// CborObject tree, and prints the average time of each over rounds runs
+	void bench_cbor_documents(size_t entries_count = 100000, size_t rounds = 5);
+
+	// applies diffs_count small diffs (a changed amount, some added and deleted records) to a map of entries_count
+	// records with patch_inplace, rolls them back with rollback_inplace, and prints their time next to patch and
+	// to the deep clone each diff used to cost
+	void bench_cbor_diff_patch(size_t entries_count = 100000, size_t diffs_count = 1000);
+
+	// the as_* accessors and CborDiff reject objects of the wrong type with exceptions, returns true if they all do
+	bool test_cbor_type_checks();
+
+	// encoded_size of each object type matches its encoding, and storage values decoded straight from cbor bytes
+	// match the ones decoded through the CborObject tree, returns true if they all do
+	bool test_cbor_encoding();
+
+	// patch and rollback (and their in place versions) of a map leave their input and the diff unchanged, undo each
+	// other, and reject a diff of the other container type, returns true if they all do
+	bool test_cbor_patch_rollback();
+
 }
\ No newline at end of file
@@ -9,6 +9,7 @@
 #include <map>
 #include <memory>
 #include <algorithm>
+#include <atomic>
 #include <cborcpp/exceptions.h>
 
 namespace cbor {
@@ -55,28 +56,108 @@ namespace cbor {
 	typedef fc::static_variant<CborBoolValue, CborIntValue, CborExtraIntValue, CborDoubleValue, CborTagValue, CborStringValue, CborBytesValue,
 		CborArrayValue, CborMapValue> CborObjectValue;
 #else
-	typedef struct _CborObjectValue { // union if allow copy constrctor in union
+	// only the member selected by CborObject::type is alive, CborObject constructs, copies and destroys it
+	union CborObjectValue {
 		CborBoolValue bool_val;
 		CborIntValue int_val;
 		CborExtraIntValue extra_int_val;
 		CborDoubleValue float64_val;
 		CborTagValue tag_or_special_val;
-		CborStringValue string_val;
+		CborStringValue string_val; // COT_STRING and COT_ERROR
 		CborBytesValue bytes_val;
 		CborArrayValue array_val;
 		CborMapValue map_val;
-	} CborObjectValue;
+
+		CborObjectValue() : int_val(0) {}
+		~CborObjectValue() {}
+	};
 #endif
 
+	// bump allocator for the nodes of one document. nodes are never freed one by one, the arena counts the live
+	// allocations and releases its chunks together when the last of them is deallocated.
+	// so any node still alive keeps the memory of its whole document: a small subtree kept from a big decoded
+	// value, or a node of a decoded diff that CborDiff::patch puts into a long-lived tree, pins all the chunks.
+	// copy such nodes out with cbor_diff::cbor_deep_clone when the rest of the document is dropped
+	class CborArena {
+	private:
+		struct Chunk {
+			Chunk* next;
+			size_t size;
+		};
+		std::atomic<size_t> _refs;
+		Chunk* _chunks;
+		char* _pos;
+		char* _end;
+		size_t _next_chunk_size;
+
+		CborArena();
+		~CborArena();
+	public:
+		static CborArena* create();
+
+		// only the thread that owns the arena allocates from it, any thread can release
+		void* allocate(size_t size);
+		inline void release() {
+			if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				delete this;
+		}
+	};
+
+	template <typename T>
+	struct CborArenaAllocator {
+		typedef T value_type;
+		CborArena* arena;
+
+		explicit CborArenaAllocator(CborArena* arena_) : arena(arena_) {}
+		template <typename U>
+		CborArenaAllocator(const CborArenaAllocator<U>& other) : arena(other.arena) {}
+
+		T* allocate(size_t n) {
+			return static_cast<T*>(arena->allocate(n * sizeof(T)));
+		}
+		void deallocate(T*, size_t) {
+			arena->release();
+		}
+	};
+	template <typename T, typename U>
+	inline bool operator==(const CborArenaAllocator<T>& a, const CborArenaAllocator<U>& b) {
+		return a.arena == b.arena;
+	}
+	template <typename T, typename U>
+	inline bool operator!=(const CborArenaAllocator<T>& a, const CborArenaAllocator<U>& b) {
+		return a.arena != b.arena;
+	}
+
+	// while a scope is alive, the CborObject factories called on its thread allocate the nodes from one arena,
+	// so a decoded document is a few big allocations instead of one allocation per node
+	class CborArenaScope {
+	private:
+		CborArena* _arena;
+		CborArena* _outer_arena;
+	public:
+		CborArenaScope();
+		~CborArenaScope();
+		CborArenaScope(const CborArenaScope&) = delete;
+		CborArenaScope& operator=(const CborArenaScope&) = delete;
+	};
+
 	struct CborObject {
 		CborObjectType type;
-		CborObjectValue value;
-		uint32_t array_or_map_size = 0;
 		bool is_positive_extra = false;
+		uint32_t array_or_map_size = 0;
+		CborObjectValue value;
 
 		CborObject();
+		explicit CborObject(CborObjectType type_);
 		CborObject(const CborObject& other);
+		CborObject& operator=(const CborObject& other);
+#if defined(CBOR_OBJECT_USE_VARIANT)
 		~CborObject() {}
+#else
+		~CborObject() {
+			destroy_value();
+		}
+#endif
 
 #if defined(CBOR_OBJECT_USE_VARIANT)
 		template <typename T>
@@ -127,7 +208,13 @@ namespace cbor {
 		inline CborObjectType object_type() const {
 			return type;
 		}
+		// the as_* accessors throw CborException when the object is not of the type they read
+		inline void check_type(bool is_expected_type, const char* accessor) const {
+			if (!is_expected_type)
+				throw_wrong_type(accessor);
+		}
 		inline const CborBoolValue as_bool() const {
+			check_type(is_bool(), "as_bool");
 #if defined(CBOR_OBJECT_USE_VARIANT)
 			return as<CborBoolValue>();
 #else
@@ -135,6 +222,7 @@ namespace cbor {
 #endif
 		}
 		inline const CborIntValue as_int() const {
+			check_type(is_int(), "as_int");
 #if defined(CBOR_OBJECT_USE_VARIANT)
 			return as<CborIntValue>();
 #else
@@ -142,6 +230,7 @@ namespace cbor {
 #endif
 		}
 		inline const CborExtraIntValue as_extra_int() const {
+			check_type(is_extra_int(), "as_extra_int");
 #if defined(CBOR_OBJECT_USE_VARIANT)
 			return as<CborExtraIntValue>();
 #else
@@ -151,6 +240,7 @@ namespace cbor {
 		CborIntValue force_as_int() const;
 
 		inline const CborTagValue as_tag() const {
+			check_type(is_tag(), "as_tag");
 #if defined(CBOR_OBJECT_USE_VARIANT)
 			return as<CborTagValue>();
 #else
@@ -158,13 +248,16 @@ namespace cbor {
 #endif
 		}
 		inline const CborExtraIntValue as_extra_tag() const {
+			check_type(COT_EXTRA_TAG == type, "as_extra_tag");
 #if defined(CBOR_OBJECT_USE_VARIANT)
 			return as<CborExtraIntValue>();
 #else
 			return value.extra_int_val;
 #endif
 		}
+		// no special values are decoded into objects, tag_or_special_val is only alive in tags
 		inline const CborSpecialValue& as_special() const {
+			check_type(is_tag(), "as_special");
 #if defined(CBOR_OBJECT_USE_VARIANT)
 			return as<CborSpecialValue>();
 #else
@@ -172,6 +265,7 @@ namespace cbor {
 #endif
 		}
 		inline const CborBytesValue& as_bytes() const {
+			check_type(is_bytes(), "as_bytes");
 #if defined(CBOR_OBJECT_USE_VARIANT)
 			return as<CborBytesValue>();
 #else
@@ -179,6 +273,7 @@ namespace cbor {
 #endif
 		}
 		inline const CborArrayValue& as_array() const {
+			check_type(is_array(), "as_array");
 #if defined(CBOR_OBJECT_USE_VARIANT)
 			return as<CborArrayValue>();
 #else
@@ -186,13 +281,32 @@ namespace cbor {
 #endif
 		}
 		inline const CborMapValue& as_map() const {
+			check_type(is_map(), "as_map");
 #if defined(CBOR_OBJECT_USE_VARIANT)
 			return as<CborMapValue>();
 #else
 			return value.map_val;
+#endif
+		}
+		// the items of an array or map node to change in place. only for a node no other tree shares
+		inline CborArrayValue& as_mutable_array() {
+			check_type(is_array(), "as_mutable_array");
+#if defined(CBOR_OBJECT_USE_VARIANT)
+			return value.get<CborArrayValue>();
+#else
+			return value.array_val;
+#endif
+		}
+		inline CborMapValue& as_mutable_map() {
+			check_type(is_map(), "as_mutable_map");
+#if defined(CBOR_OBJECT_USE_VARIANT)
+			return value.get<CborMapValue>();
+#else
+			return value.map_val;
 #endif
 		}
 		inline const CborStringValue& as_string() const {
+			check_type(is_string() || COT_ERROR == type, "as_string");
 #if defined(CBOR_OBJECT_USE_VARIANT)
 			return as<CborStringValue>();
 #else
@@ -200,6 +314,7 @@ namespace cbor {
 #endif
 		}
 		inline const CborDoubleValue as_float64() const {
+			check_type(is_float(), "as_float64");
 #if defined(CBOR_OBJECT_USE_VARIANT)
 			return as<CborDoubleValue>();
 #else
@@ -229,5 +344,14 @@ namespace cbor {
 		static CborObjectP from_extra_integer(uint64_t value, bool sign);
 		static CborObjectP from_extra_tag(uint64_t value);
 		// static CborObjectP from_extra_special(uint64_t value);
+
+	private:
+		[[noreturn]] void throw_wrong_type(const char* accessor) const;
+		// a node of this type, from the arena of the current CborArenaScope if there is one
+		static CborObjectP make_object(CborObjectType type);
+#if !defined(CBOR_OBJECT_USE_VARIANT)
+		void init_value(const CborObject* other);
+		void destroy_value();
+#endif
 	};
 }
@@ -19,6 +19,7 @@
 
 #include "cborcpp/input.h"
 #include "cborcpp/cbor_object.h"
+#include "cborcpp/listener.h"
 
 namespace cbor {
     typedef enum {
@@ -40,7 +41,6 @@ namespace cbor {
 
     class decoder {
     private:
-        // listener *_listener;
         input *_in;
         decoder_state _state;
         int _currentLength;
@@ -48,6 +48,11 @@ namespace cbor {
         decoder(input &in);
         ~decoder();
 		CborObjectP run();
-        //void set_listener(listener &listener_instance);
+		// streams the values of the input to the listener instead of building a tree. unlike run() it doesn't check
+		// that the input holds exactly one complete value, the listener sees the values as they come
+		void run(listener &listener_instance);
+    private:
+		template <typename Listener>
+		void decode(Listener &listener_instance);
     };
 }
@@ -20,11 +20,17 @@
 #include "cborcpp/cbor_object.h"
 #include <string>
 #include <cstdint>
+#include <cstddef>
 
 namespace cbor {
+    // writes are collected in a small buffer and handed to the output in bulk at the end of each write_* call
     class encoder {
     private:
+        static const size_t buffer_capacity = 4096;
+
         output *_out;
+        unsigned char _buffer[buffer_capacity];
+        size_t _buffered;
     public:
         encoder(output &out);
 
@@ -46,7 +52,7 @@ namespace cbor {
 
         void write_string(const char *data, unsigned int size);
 
-        void write_string(const std::string str);
+        void write_string(const std::string& str);
 
         void write_array(int size);
 
@@ -64,7 +70,20 @@ namespace cbor {
 
 		void write_cbor_object(const CborObject* value);
 
+		// number of bytes write_cbor_object(value) writes, computed from the object without encoding it
+		static size_t encoded_size(const CborObject* value);
+
     private:
+        void put_byte(unsigned char value);
+
+        void put_bytes(const unsigned char *data, size_t size);
+
+        void flush();
+
+		void encode_cbor_object(const CborObject* value);
+
+		static std::string float64_string(CborDoubleValue value);
+
         void write_type_value(int major_type, uint32_t value);
 
         void write_type_value(int major_type, uint64_t value);
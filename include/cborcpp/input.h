@@ -39,6 +39,9 @@ namespace cbor {
 
         void get_bytes(void *to, int count);
 
+        // the next count bytes in place, valid as long as the input data
+        const char *get_bytes_view(int count);
+
 		void skip_bytes(int count);
     };
 }
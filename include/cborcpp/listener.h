@@ -0,0 +1,56 @@
+/*
+   Copyright 2014-2015 Stanislav Ovsyannikov
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+	   Unless required by applicable law or agreed to in writing, software
+	   distributed under the License is distributed on an "AS IS" BASIS,
+	   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+	   See the License for the specific language governing permissions and
+	   limitations under the License.
+*/
+
+
+#pragma once
+
+#include "cborcpp/cbor_object.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace cbor {
+    // receives the values of a document in order as decoder::run(listener&) reads them, without building a CborObject tree.
+    // on_array and on_map give the declared items count and their items follow as events of their own, a map as key, value, key, value...
+    // the data of on_bytes and on_string points into the input buffer and is only valid as long as that buffer
+    class listener {
+    public:
+        virtual ~listener() {}
+
+        virtual void on_integer(CborIntValue value) = 0;
+
+        virtual void on_extra_integer(CborExtraIntValue value, bool is_positive) = 0;
+
+        virtual void on_float64(CborDoubleValue value) = 0;
+
+        virtual void on_bytes(const char *data, size_t size) = 0;
+
+        virtual void on_string(const char *data, size_t size) = 0;
+
+        virtual void on_array(uint32_t size) = 0;
+
+        virtual void on_map(uint32_t size) = 0;
+
+        virtual void on_tag(CborTagValue tag) = 0;
+
+        virtual void on_extra_tag(CborExtraIntValue tag) = 0;
+
+        virtual void on_bool(bool value) = 0;
+
+        virtual void on_null() = 0;
+
+        virtual void on_undefined() = 0;
+    };
+}
@@ -2,7 +2,9 @@
 #ifndef json_reader_h
 #define json_reader_h
 
-#include <stack>
+#include <deque>
+#include <utility>
+#include <vector>
 #include <uvm/lprefix.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -59,46 +61,51 @@ public:
 
 typedef std::deque<ErrorInfo> Errors;
 
+// json decoder of json.loads. it reads the document in place and pushes the lua values on the stack while
+// parsing, without an intermediate tree
 class Json_Reader {
 private:
 	typedef char Char;
 	lua_State *L_;
-	std::string source_;
-	typedef std::stack<UvmStorageValue> Nodes;
-	Nodes nodes_;
-	
-	//JSONCPP_STRING document_;
 	Location begin_;
 	Location end_;
 	Location current_;
-	//Location lastValueEnd_;
-	//UvmStorageValue* lastValue_;
-	//JSONCPP_STRING commentsBefore_;
-	//Features features_;
-	//bool collectComments_;
-	bool readValue();
+	// stack index of the table holding the member values of the objects being read
+	int members_values_index_;
+	int members_values_count_;
+	// names of the members of the objects being read and their index in the member values table.
+	// the members of an object are set in name order once it is read, as the old storage value tree did
+	std::vector<std::pair<std::string, int> > members_;
+	// last string token read: its decoded bytes, in the source when it has no escape or in decoded_
+	const Char* string_;
+	size_t string_size_;
+	std::string decoded_;
+	// error found when decoding the last string token, reported only if the token is terminated
+	const char* string_error_;
+
+	bool readValue(int depth);
 	bool readToken(Token& token);
 	void skipSpaces();
 	Char getNextChar();
 	bool readString();
-	UvmStorageValue* currentValue();
-	bool decodeString(Token& token, bool is_skip_quote, std::string& decoded);
 	bool addError(const std::string& message,
 		Token& token,
 		Location extra);
-	bool readObject(Token& token);
+	bool readObject(Token& token, int depth);
 	bool readKeyToken(Token& token);
-	bool readArray(Token& token);
+	bool readArray(Token& token, int depth);
 	bool readNumber(bool checkInf);
-	bool decodeNumber(Token& token,UvmStorageValue* number);
-	bool decodeDouble(Token& token, UvmStorageValue* doubleval);
-	bool decodeInteger(Token& token, UvmStorageValue* intVal);
+	bool decodeNumber(Token& token);
+	bool decodeDouble(Token& token);
+	bool decodeInteger(Token& token);
 	bool match(Location pattern, int patternLength);
 
 public:
 	ErrorInfo error;
 	//Errors errors_;
-	bool parse(lua_State *L, std::string& str, UvmStorageValue* root);
+	// parse the json of size bytes at str and push its value on the stack of L.
+	// returns false, with the stack unchanged, if it is not valid json
+	bool parse(lua_State *L, const char* str, size_t size);
 
 	static bool vm_disable_json_loads_negative;
 };
@@ -54,6 +54,7 @@ LUAI_FUNC void luaF_initupvals(lua_State *L, uvm_types::GcLClosure *cl);
 LUAI_FUNC UpVal *luaF_findupval(lua_State *L, StkId level);
 LUAI_FUNC void luaF_close(lua_State *L, StkId level);
 LUAI_FUNC void luaF_freeproto(lua_State *L, uvm_types::GcProto *f);
+LUAI_FUNC void luaF_buildgasblocks(uvm_types::GcProto *f);
 LUAI_FUNC const char *luaF_getlocalname(const uvm_types::GcProto *func, int local_number,
     int pc);
 
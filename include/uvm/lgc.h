@@ -109,10 +109,14 @@
 ** GC cycle on every opportunity)
 */
 #define luaC_condGC(L,pre,pos) \
-    	{  }
+	{ if ((L)->gc_state->gc_debt() > 0) { pre; luaC_step(L); pos; } }
 
-/* more often than not, 'pre'/'pos' are empty */
-#define luaC_checkGC(L)		luaC_condGC(L,,)
+/*
+** C API, parser and stack growth sites may hold objects not anchored
+** anywhere yet, so automatic steps only run at the VM safe points
+** ('checkGC' in lvm.cpp)
+*/
+#define luaC_checkGC(L)		{  }
 
 
 #define luaC_barrier(L,p,v) (  \
@@ -0,0 +1,88 @@
+/*
+** Jump table of the interpreter loop, used when the compiler
+** supports computed goto ('UVM_USE_JUMPTABLE' in lvm.cpp).
+** Included inside 'ExecuteContext::executeOps'. Entries are in the
+** order of 'OpCode' (lopcodes.h), the unused codes just go on to
+** the next instruction, as the switch does.
+*/
+
+#undef vmdispatch
+#undef vmcase
+#undef vmbreak
+
+#define vmdispatch(x)	goto *disptab[x];
+
+#define vmcase(l)	L_##l:
+
+#define vmbreak		goto l_opdone
+
+static_assert(UNUM_OPCODES == 57, "update the jump table in ljumptab.h");
+
+static const void *const disptab[1 << SIZE_OP] = {
+
+&&L_UOP_MOVE,
+&&L_UOP_LOADK,
+&&L_UOP_LOADKX,
+&&L_UOP_LOADBOOL,
+&&L_UOP_LOADNIL,
+&&L_UOP_GETUPVAL,
+&&L_UOP_GETTABUP,
+&&L_UOP_GETTABLE,
+&&L_UOP_SETTABUP,
+&&L_UOP_SETUPVAL,
+&&L_UOP_SETTABLE,
+&&L_UOP_NEWTABLE,
+&&L_UOP_SELF,
+&&L_UOP_ADD,
+&&L_UOP_SUB,
+&&L_UOP_MUL,
+&&L_UOP_MOD,
+&&L_UOP_POW,
+&&L_UOP_DIV,
+&&L_UOP_IDIV,
+&&L_UOP_BAND,
+&&L_UOP_BOR,
+&&L_UOP_BXOR,
+&&L_UOP_SHL,
+&&L_UOP_SHR,
+&&L_UOP_UNM,
+&&L_UOP_BNOT,
+&&L_UOP_NOT,
+&&L_UOP_LEN,
+&&L_UOP_CONCAT,
+&&L_UOP_JMP,
+&&L_UOP_EQ,
+&&L_UOP_LT,
+&&L_UOP_LE,
+&&L_UOP_TEST,
+&&L_UOP_TESTSET,
+&&L_UOP_CALL,
+&&L_UOP_TAILCALL,
+&&L_UOP_RETURN,
+&&L_UOP_FORLOOP,
+&&L_UOP_FORPREP,
+&&L_UOP_TFORCALL,
+&&L_UOP_TFORLOOP,
+&&L_UOP_SETLIST,
+&&L_UOP_CLOSURE,
+&&L_UOP_VARARG,
+&&L_UOP_EXTRAARG,
+&&L_UOP_PUSH,
+&&L_UOP_POP,
+&&L_UOP_GETTOP,
+&&L_UOP_CMP,
+&&L_UOP_CMP_EQ,
+&&L_UOP_CMP_NE,
+&&L_UOP_CMP_GT,
+&&L_UOP_CMP_LT,
+&&L_UOP_CCALL,
+&&L_UOP_CSTATICCALL,
+&&L_UOP_DUMMY_COUNT,
+&&l_opdone,
+&&l_opdone,
+&&l_opdone,
+&&l_opdone,
+&&l_opdone,
+&&l_opdone
+
+};
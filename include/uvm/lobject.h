@@ -11,6 +11,7 @@
 
 #include <stdarg.h>
 #include <map>
+#include <deque>
 #include <algorithm>
 #include <unordered_map>
 
@@ -288,14 +289,14 @@ namespace uvm_types {
 ** (Access to 'extra' ensures that value is really a 'TString'.)
 */
 #define getstr(ts)  \
-  ((char*)((ts)->value.data()))
+  ((ts)->data())
 
 
 /* get the actual string (array of bytes) from a Lua value */
 #define svalue(o)       getstr(tsvalue(o))
 
 /* get string length from 'TString *s' */
-#define tsslen(s)	((s)->tt == LUA_TSHRSTR ? (s)->value.size() : (s)->value.size())
+#define tsslen(s)	((s)->len)
 
 /* get string length from 'TValue *o' */
 #define vslen(o)	tsslen(tsvalue(o))
@@ -396,24 +397,38 @@ unsigned int luaS_hash(const char *str, size_t l, unsigned int seed);
 
 // vmgc object types
 namespace uvm_types {
+	// the bytes of the string follow the object in the same gc buffer, ended by a '\0'.
+	// short strings (LUA_TSHRSTR) are interned in the lua_State's string table
 	struct GcString : vmgc::GcObject
 	{
 		const static vmgc::gc_type type = LUA_TLNGSTR;
+		const static bool trivial_members = true;
 		int tt_ = LUA_TLNGSTR;
-		std::string value;
-		lu_byte extra = 0;
+		lu_byte extra = 0; // reserved word index + 1 of short strings
+		mutable bool hashed = false; // long strings get their hash on first use
+		mutable unsigned int hashv = 0;
+		size_t len = 0;
+		GcString* hnext = nullptr; // next string in the same bucket of the string table
 
 		inline GcString() : tt_(LUA_TLNGSTR){ }
 
 		virtual ~GcString() {}
 
+		inline char* data() { return reinterpret_cast<char*>(this + 1); }
+		inline const char* data() const { return reinterpret_cast<const char*>(this + 1); }
+
 		inline unsigned int hash() const {
-			return luaS_hash(value.data(), value.size(), 1);
+			if (!hashed) {
+				hashv = luaS_hash(data(), len, 1);
+				hashed = true;
+			}
+			return hashv;
 		}
 	};
 	struct GcUserdata : vmgc::GcObject
 	{
 		const static vmgc::gc_type type = LUA_TUSERDATA;
+		const static bool trivial_members = true;
 		int tt_ = LUA_TUSERDATA;
 		void* gc_value = nullptr; // user value managed in vmgc
 		uvm_types::GcTable *metatable;
@@ -469,13 +484,25 @@ namespace uvm_types {
 	public:
 		bool operator()(const TValue& x, const TValue& y) const;
 	};
+	struct GcTableNode
+	{
+		TValue key;
+		TValue value;
+		unsigned int hash; // hash of the key's table key chars
+	};
 	struct GcTable : vmgc::GcObject
 	{
 		typedef TValue GcTableItemType;
 		const static vmgc::gc_type type = LUA_TTABLE;
 		int tt_ = LUA_TTABLE;
-		std::map<TValue, GcTableItemType, table_sort_comparator> entries; // must use map, not unordered_map
-		std::unordered_map<std::string, TValue> keys;
+		// hash part in insertion order. keys are never removed, a removed key keeps a nil value.
+		// deque keeps the value pointers returned by luaH_set valid when new keys are added
+		std::deque<GcTableNode> nodes;
+		std::vector<uint32_t> slots; // open addressing index of nodes, node index + 1, 0 if empty
+		std::vector<uint32_t> sorted; // node indexes in table_sort_comparator order, must iterate in this order
+		std::vector<uint32_t> sorted_pos; // node index => position in sorted
+		size_t sorted_count = 0; // nodes already in sorted, the later ones are merged on next iteration
+		size_t next_cursor = 0; // position in sorted of the key last returned by luaH_next
 		std::vector<GcTableItemType> array;
 		GcTable* metatable;
 		lu_byte flags; // flag to mask meta methods
@@ -500,6 +527,7 @@ namespace uvm_types {
 		std::vector<int> lineinfos;  /* map from opcodes to source lines (debug information) */
 		std::vector<LocVar> locvars;  /* information about local variables (debug information) */
 		std::vector<Upvaldesc> upvalues;  /* upvalue information */
+		std::vector<int> gasblocks;  /* gas of the run of instructions starting at each pc (see 'luaF_buildgasblocks') */
 		struct GcLClosure *cache;  /* last-created closure with this prototype */
 		GcString  *source;  /* used for debug information */
 
@@ -62,6 +62,14 @@ struct lua_longjmp;  /* defined in ldo.c */
 #define KGC_EMERGENCY	1	/* gc was forced by an allocation failure */
 
 
+/* table of the interned short strings, chained by 'hnext' */
+typedef struct stringtable {
+	uvm_types::GcString **hash;
+	int nuse;  /* number of elements */
+	int size;
+} stringtable;
+
+
 /*
 ** Information about a call.
 ** When a thread yields, 'func' is adjusted to pretend that the
@@ -88,7 +96,7 @@ typedef struct CallInfo {
     } u;
     ptrdiff_t extra;
     short nresults;  /* expected number of results from this function */
-    lu_byte callstatus;
+    unsigned short callstatus;
 } CallInfo;
 
 
@@ -104,6 +112,8 @@ of luaV_execute */
 #define CIST_TAIL	(1<<5)	/* call was tail called */
 #define CIST_HOOKYIELD	(1<<6)	/* last hook called yielded */
 #define CIST_LEQ	(1<<7)  /* using __lt for __le */
+#define CIST_CCALL	(1<<8)	/* C function is calling Lua through lua_call/lua_pcall */
+#define CIST_PARSER	(1<<9)	/* call is loading a chunk (lua_load) */
 
 #define isLua(ci)	((ci)->callstatus & CIST_LUA)
 
@@ -134,6 +144,7 @@ inline UvmStatePreProcessorFunction make_lua_state_preprocessor(std::list<void*>
 // typedef void(*LuaStatePreProcessor)(lua_State *L, void *ptr);
 
 struct lua_State;
+struct UvmStateContext;
 
 namespace uvm_types {
 	struct GcString;
@@ -197,7 +208,7 @@ struct lua_State : vmgc::GcObject {
 	void *ud;         /* auxiliary data to 'frealloc' */
 	TValue l_registry;
 	unsigned int seed;  /* randomized seed for hashes */
-	//stringtable strt;  /* hash table for strings */
+	stringtable strt;  /* hash table for strings */
 
 	const lua_Number *version;  /* pointer to version number */
 	uvm_types::GcString *memerrmsg;  /* memory-error message */
@@ -221,6 +232,7 @@ struct lua_State : vmgc::GcObject {
 	uint32_t ci_depth;
     
 	int cbor_diff_state; // 0: not_set, 1: true, 2: false
+	UvmStateContext *state_context; // values shared in this state, see uvm::lua::lib::get_lua_state_value
 
 	inline lua_State() :tt_(LUA_TTHREAD) {}
 	virtual ~lua_State() {}
@@ -22,8 +22,7 @@
 /*
 ** test whether a string is a reserved word
 */
-//#define isreserved(s)	((s)->tt == LUA_TSHRSTR && (s)->extra > 0)
-#define isreserved(s)	((s)->tt == LUA_TLNGSTR && (s)->extra > 0)
+#define isreserved(s)	((s)->tt == LUA_TSHRSTR && (s)->extra > 0)
 
 
 /*
@@ -35,6 +34,7 @@
 LUAI_FUNC unsigned int luaS_hash(const char *str, size_t l, unsigned int seed);
 LUAI_FUNC unsigned int luaS_hashlongstr(uvm_types::GcString *ts);
 LUAI_FUNC int luaS_eqlngstr(uvm_types::GcString *a, uvm_types::GcString *b);
+LUAI_FUNC void luaS_resize(lua_State *L, int newsize);
 LUAI_FUNC void luaS_clearcache(lua_State *L);
 LUAI_FUNC void luaS_init(lua_State *L);
 LUAI_FUNC void luaS_remove(lua_State *L, uvm_types::GcString *ts);
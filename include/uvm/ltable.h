@@ -48,6 +48,7 @@ LUAI_FUNC void luaH_free(lua_State *L, uvm_types::GcTable *t);
 LUAI_FUNC int luaH_next(lua_State *L, uvm_types::GcTable *t, StkId key);
 LUAI_FUNC int luaH_getn(uvm_types::GcTable *t);
 LUAI_FUNC void luaH_setisonlyread(lua_State *L, uvm_types::GcTable *t, bool isOnlyRead);
+LUAI_FUNC void luaH_rehashnodes(uvm_types::GcTable *t, size_t nslots);
 
 #if defined(LUA_DEBUG)
 LUAI_FUNC Node *luaH_mainposition(const Table *t, const TValue *key);
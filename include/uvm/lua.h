@@ -148,6 +148,8 @@ extern const char lua_ident[];
 */
 LUA_API lua_State *(lua_newstate)(lua_Alloc f, void *ud);
 LUA_API void       (lua_close)(lua_State *L);
+/* keep the gc heaps of closed states for new states of the current thread */
+LUA_API void       (lua_setgcarena)(int enable);
 
 LUA_API lua_CFunction(lua_atpanic) (lua_State *L, lua_CFunction panicf);
 
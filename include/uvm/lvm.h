@@ -112,6 +112,8 @@ namespace uvm {
 			// execute to next ci called, return whether has next ci to execute
 			bool executeToNextCi(lua_State* L);
 			bool executeToNextOp(lua_State* L);
+			// run instructions until the frame changes or the state needs the caller, or only one when single_step
+			bool executeOps(lua_State* L, bool single_step);
 			void enter_newframe(lua_State* L);
 			void prepare_newframe(lua_State* L);
 
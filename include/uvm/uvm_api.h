@@ -14,11 +14,13 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <deque>
 #include <set>
 #include <map>
 #include <unordered_map>
 #include <memory>
 #include <iostream>
+#include <iterator>
 
 #include <uvm/lua.h>
 #include <jsondiff/jsondiff.h>
@@ -70,6 +72,12 @@
 
 #define CHECK_CONTRACT_CODE_EVERY_TIME 0
 
+// max count of contract bytecodes whose decoded prototypes are kept in the process-wide cache
+#define CONTRACT_PROTO_CACHE_MAX_COUNT 256
+
+// UvmStateScope copies a process-wide initialized prototype state instead of opening all libs in each new state
+#define USE_LUA_STATE_PROTOTYPE 1
+
 // ，register_object_in_pool
 enum UvmOutsideObjectTypes
 {
@@ -434,9 +442,117 @@ typedef struct UvmStorageChangeItem
 
 
 
-typedef std::list<UvmStorageChangeItem> UvmStorageChangeList;
+/**
+ * storage change items in the order they were made, with an index from
+ * (contract_id, key, fast_map_key, is_fast_map) to the items of each storage,
+ * so finding the last change of a storage doesn't scan the whole history
+ */
+class UvmStorageChangeList
+{
+public:
+	typedef std::list<UvmStorageChangeItem> items_type;
+	typedef items_type::iterator iterator;
+	typedef items_type::const_iterator const_iterator;
+	typedef items_type::reverse_iterator reverse_iterator;
+	typedef std::deque<iterator> storage_items_type;
+
+	iterator begin() { return _items.begin(); }
+	iterator end() { return _items.end(); }
+	const_iterator begin() const { return _items.begin(); }
+	const_iterator end() const { return _items.end(); }
+	reverse_iterator rbegin() { return _items.rbegin(); }
+	reverse_iterator rend() { return _items.rend(); }
+	size_t size() const { return _items.size(); }
+	bool empty() const { return _items.empty(); }
+
+	void push_back(const UvmStorageChangeItem &item)
+	{
+		_items.push_back(item);
+		auto it = std::prev(_items.end());
+		_index[StorageKey(it->contract_id, it->key, it->fast_map_key, it->is_fast_map)].push_back(it);
+	}
+
+	void pop_back()
+	{
+		auto it = std::prev(_items.end());
+		unindex(it, false);
+		_items.pop_back();
+	}
+
+	void pop_front()
+	{
+		unindex(_items.begin(), true);
+		_items.pop_front();
+	}
+
+	void clear()
+	{
+		_index.clear();
+		_items.clear();
+	}
+
+	// items of the storage in the order they were made, nullptr if it has no items
+	const storage_items_type *find(const std::string &contract_id, const std::string &key, const std::string &fast_map_key, bool is_fast_map) const
+	{
+		auto found = _index.find(StorageKey(contract_id, key, fast_map_key, is_fast_map));
+		return found == _index.end() ? nullptr : &found->second;
+	}
+
+	// the last item of the storage, nullptr if it has no items
+	UvmStorageChangeItem *find_last(const std::string &contract_id, const std::string &key, const std::string &fast_map_key, bool is_fast_map) const
+	{
+		auto items = find(contract_id, key, fast_map_key, is_fast_map);
+		return items ? &*items->back() : nullptr;
+	}
+
+private:
+	struct StorageKey
+	{
+		std::string contract_id;
+		std::string key;
+		std::string fast_map_key;
+		bool is_fast_map;
+
+		StorageKey(const std::string &contract_id_, const std::string &key_, const std::string &fast_map_key_, bool is_fast_map_)
+			: contract_id(contract_id_), key(key_), fast_map_key(fast_map_key_), is_fast_map(is_fast_map_) {}
+
+		bool operator==(const StorageKey &other) const
+		{
+			return is_fast_map == other.is_fast_map && key == other.key && fast_map_key == other.fast_map_key && contract_id == other.contract_id;
+		}
+	};
+
+	struct StorageKeyHash
+	{
+		size_t operator()(const StorageKey &k) const
+		{
+			std::hash<std::string> h;
+			size_t seed = h(k.contract_id);
+			seed ^= h(k.key) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+			seed ^= h(k.fast_map_key) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+			return seed ^ (size_t)k.is_fast_map;
+		}
+	};
+
+	// 'it' is the first or the last item of its storage, as it is the first or the last of the list
+	void unindex(iterator it, bool first)
+	{
+		auto found = _index.find(StorageKey(it->contract_id, it->key, it->fast_map_key, it->is_fast_map));
+		if (found == _index.end())
+			return;
+		if (first)
+			found->second.pop_front();
+		else
+			found->second.pop_back();
+		if (found->second.empty())
+			_index.erase(found);
+	}
+
+	items_type _items;
+	std::unordered_map<StorageKey, storage_items_type, StorageKeyHash> _index;
+};
 
-typedef std::list<UvmStorageChangeItem> UvmStorageTableReadList;
+typedef UvmStorageChangeList UvmStorageTableReadList;
 
 struct UvmStorageValue lua_type_to_storage_value_type(lua_State *L, int index);
 
@@ -448,7 +564,12 @@ UvmStorageValue json_to_uvm_storage_value(lua_State *L, jsondiff::JsonValue json
 jsondiff::JsonValue uvm_storage_value_to_json(UvmStorageValue value);
 
 UvmStorageValue cbor_to_uvm_storage_value(lua_State *L, cbor::CborObject* cbor_value);
+// decodes the cbor bytes straight into the storage value, without building the CborObject tree first
+UvmStorageValue cbor_to_uvm_storage_value(lua_State *L, const char *cbor_data, size_t cbor_size);
 cbor::CborObjectP uvm_storage_value_to_cbor(UvmStorageValue value);
+// diff of two storage tables of scalars built from their items, the same as CborDiff::diff of their cbor values.
+// nullptr if the tables can't be diffed this way
+cbor_diff::DiffResultP diff_storage_tables_by_items(const UvmStorageValue& before, const UvmStorageValue& after);
 
 typedef std::unordered_map<std::string, UvmStorageChangeItem> ContractChangesMap;
 
@@ -657,7 +778,40 @@ namespace uvm {
           };
 
 
-          extern IUvmChainApi *global_uvm_chain_api;
+          /**
+          * the chain api used by uvm. a thread-local api set by set_thread_api (or UvmChainApiThreadScope)
+          * takes precedence over the process-wide api, so each thread can run its own vms against its own chain
+          */
+          class UvmChainApiHolder
+          {
+          private:
+            IUvmChainApi *_process_api = nullptr;
+            static thread_local IUvmChainApi *_thread_api;
+          public:
+            inline IUvmChainApi *get() const { return _thread_api ? _thread_api : _process_api; }
+            inline IUvmChainApi *operator->() const { return get(); }
+            inline explicit operator bool() const { return get() != nullptr; }
+            inline bool operator==(std::nullptr_t) const { return get() == nullptr; }
+            inline bool operator!=(std::nullptr_t) const { return get() != nullptr; }
+            // set the process-wide api
+            inline UvmChainApiHolder &operator=(IUvmChainApi *api) { _process_api = api; return *this; }
+            inline IUvmChainApi *process_api() const { return _process_api; }
+            // set the api of the current thread, nullptr to fall back to the process-wide api
+            inline void set_thread_api(IUvmChainApi *api) { _thread_api = api; }
+            inline IUvmChainApi *thread_api() const { return _thread_api; }
+          };
+
+          extern UvmChainApiHolder global_uvm_chain_api;
+
+          // use api as the chain api of the current thread in this scope
+          class UvmChainApiThreadScope
+          {
+          private:
+            IUvmChainApi *_old_api;
+          public:
+            inline UvmChainApiThreadScope(IUvmChainApi *api) : _old_api(global_uvm_chain_api.thread_api()) { global_uvm_chain_api.set_thread_api(api); }
+            inline ~UvmChainApiThreadScope() { global_uvm_chain_api.set_thread_api(_old_api); }
+          };
 
         }
     }
@@ -66,6 +66,22 @@ typedef struct _UvmStateValueNode {
     UvmStateValue value;
 } UvmStateValueNode;
 
+/**
+* values shared in one lua_State (L->state_context).
+* the keys read by lvm and the storage api on every call are plain fields,
+* other keys (extensions) are kept in 'values' and found by name
+*/
+struct UvmStateContext {
+	int64_t instructions_limit = 0;
+	int64_t *instructions_executed_count = nullptr;
+	int64_t *stop_in_lvm = nullptr;
+	int64_t in_sandbox = 0;
+	UvmStorageChangeList *storage_changelist = nullptr;
+	UvmStorageTableReadList *storage_read_tables = nullptr;
+	bool has_exception = false; // exception mark of the chain api
+	std::unordered_map<std::string, UvmStateValueNode> values;
+};
+
 
 namespace uvm
 {
@@ -305,6 +321,19 @@ namespace uvm
 
             lua_State *create_lua_state(bool use_contract = true, bool allow_change_global = false);
 
+            /**
+             * same as create_lua_state, but copies the registry of a fully initialized prototype state
+             * (built once for each use_contract/allow_change_global pair) instead of opening all libs again.
+             * falls back to create_lua_state when the prototype holds values which can't be copied
+             */
+            lua_State *create_lua_state_from_prototype(bool use_contract = true, bool allow_change_global = false);
+
+            /**
+             * close the prototype states built by create_lua_state_from_prototype.
+             * must not run while states are being created from them, the next create builds them again
+             */
+            void close_lua_state_prototypes();
+
             bool commit_storage_changes(lua_State *L);
 
             void close_lua_state(lua_State *L);
@@ -323,6 +352,9 @@ namespace uvm
 
             int get_lua_state_instructions_executed_count(lua_State *L);
 
+            // counters of the collector of the lua_State
+            vmgc::GcStats get_lua_state_gc_stats(lua_State *L);
+
             void enter_lua_sandbox(lua_State *L);
 
             void exit_lua_sandbox(lua_State *L);
@@ -421,6 +453,20 @@ namespace uvm
              */
             uvm_types::GcLClosure *luaU_undump_from_stream(lua_State *L, UvmModuleByteStreamP stream, const char *name);
 
+            /**
+             * contract prototypes decoded from bytecode are kept in a process-wide cache keyed by the sha256 of the bytecode.
+             * load_contract_proto_from_cache pushes a new main closure of the cached prototypes on the stack
+             * (like luaL_loadbufferx does), or returns nullptr when the bytecode is not in the cache
+             */
+            uvm_types::GcLClosure *load_contract_proto_from_cache(lua_State *L, UvmModuleByteStreamP stream);
+
+            /**
+             * save the prototypes of a main closure loaded from the stream's bytecode into the cache
+             */
+            void put_contract_proto_to_cache(UvmModuleByteStreamP stream, uvm_types::GcLClosure *closure);
+
+            void clear_contract_proto_cache();
+
             /**
              * secure apis
              */
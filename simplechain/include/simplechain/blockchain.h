@@ -10,10 +10,13 @@
 #include <simplechain/storage.h>
 #include <simplechain/asset.h>
 #include <simplechain/debugger.h>
+#include <simplechain/db.h>
 #include <memory>
 #include <vector>
 #include <map>
 #include <list>
+#include <set>
+#include <functional>
 #include <algorithm>
 #include <uvm/lobject.h>
 
@@ -21,7 +24,6 @@ namespace simplechain {
 	typedef int64_t balance_t; //int64
 
 	class blockchain {
-		// TODO: local db and rollback
 	private:
 		std::vector<asset> assets;
 		std::vector<block> blocks;
@@ -32,16 +34,32 @@ namespace simplechain {
 		std::map<std::string, std::map<std::string, StorageDataType> > contract_storages;
 		std::vector<transaction> tx_mempool;
 
+		// lookup indexes of the state above, kept up to date by the functions changing it
+		std::vector<std::string> block_hashes; // block number => hash of the sealed block
+		std::map<std::string, uint64_t> block_numbers; // block hash => block number
+		std::map<std::string, std::pair<uint64_t, size_t> > tx_locations; // tx hash => block number and position in the block
+		std::map<std::string, std::set<std::string> > contract_addresses; // contract name (may be empty) => addresses of the contracts with it
+		std::map<std::string, std::set<asset_id_t> > asset_ids; // asset symbol => ids of the assets with it
+
 		std::map<std::string, std::list<uint32_t> > breakpoints;
 
 		std::shared_ptr<generic_evaluator> last_evaluator_when_debugger;
+
+		size_t block_execution_threads;
+		// keys of the chain state written while generating a block, to validate speculative results
+		std::set<std::string>* block_state_writes = nullptr;
+
+		// persistent copy of the chain state, see open_state_db
+		std::unique_ptr<state_db> db;
+		// values before the changes not committed to the db yet, by state key
+		std::map<std::string, state_db_write> uncommitted_state_undo;
 	public:
 		blockchain();
 		// @throws exception
 		std::shared_ptr<evaluate_result> evaluate_transaction(std::shared_ptr<transaction> tx);
 		void clear_debugger_info();
 		void apply_transaction(std::shared_ptr<transaction> tx);
-		block latest_block() const;
+		const block& latest_block() const;
 		uint64_t head_block_number() const;
 		std::string head_block_hash() const;
 		std::shared_ptr<transaction> get_trx_by_hash(const std::string& tx_hash) const;
@@ -55,8 +73,13 @@ namespace simplechain {
 		bool contains_contract_by_address(const std::string& contract_address) const;
 		bool contains_contract_by_name(const std::string& name) const;
 		void store_contract(const std::string& addr, const contract_object& contract_obj);
-		StorageDataType get_storage(const std::string& contract_address, const std::string& key) const;
-		std::map<std::string, StorageDataType> get_contract_storages(const std::string& contract_address) const;
+		// a missing storage reads as the shared cbor null storage
+		const StorageDataType& get_storage(const std::string& contract_address, const std::string& key) const;
+		const std::map<std::string, StorageDataType>& get_contract_storages(const std::string& contract_address) const;
+		// visit at most limit storages of the contract whose names sort after start_after, in name order.
+		// returns true when more storages follow the last visited one
+		bool visit_contract_storages(const std::string& contract_address, const std::string& start_after, size_t limit,
+			const std::function<void(const std::string&, const StorageDataType&)>& visitor) const;
 		void set_storage(const std::string& contract_address, const std::string& key, const StorageDataType& value);
 		void add_asset(const asset& new_asset);
 		std::shared_ptr<asset> get_asset(asset_id_t asset_id);
@@ -98,6 +121,20 @@ namespace simplechain {
 		void accept_transaction_to_mempool(const transaction& tx);
 		std::vector<transaction> get_tx_mempool() const;
 		void generate_block();
+		// threads used to execute the transactions of a new block speculatively.
+		// 1 (the default) applies them one by one, the parallel execution is opt-in
+		void set_block_execution_threads(size_t threads_count);
+		size_t get_block_execution_threads() const;
+
+		// keep the chain state in the state db in dir, replacing the current state by the one stored there if any.
+		// each new block is committed to the db with the changes made since the previous block
+		// @throws exception
+		void open_state_db(const std::string& dir);
+		void close_state_db();
+		// drop the last blocks_count blocks (and the changes not committed yet) and restore the state before them.
+		// needs an open state db, the txs of the dropped blocks are not put back into the mempool
+		// @throws exception
+		void rollback_blocks(size_t blocks_count);
 
 		fc::variant get_state() const;
 		std::string get_state_json() const;
@@ -126,5 +163,18 @@ namespace simplechain {
 	private:
 		// @throws exception
 		std::shared_ptr<generic_evaluator> get_operation_evaluator(transaction* tx, const operation& op);
+		void record_state_write(const char* kind, const std::string& key1, const std::string& key2 = "");
+		// encoded value of a state key as stored in the state db, false if the key has no value
+		bool read_state_value(const std::string& key, std::string& value) const;
+		void apply_state_write(const state_db_write& write);
+		std::vector<std::string> persisted_state_keys() const;
+		void commit_state_db();
+		void index_block(size_t block_number);
+		void unindex_block(size_t block_number);
+		void put_contract(const std::string& addr, const contract_object& contract_obj);
+		void erase_contract(const std::string& addr);
+		void put_asset(const asset& item);
+		void unindex_asset(asset_id_t asset_id);
+		void truncate_assets(size_t assets_count);
 	};
 }
@@ -0,0 +1,10 @@
+#pragma once
+#include <simplechain/simplechain.h>
+#include <string>
+
+namespace simplechain {
+	// builds a chain of blocks_count blocks with one mint tx each, plus named contracts and assets, prints the
+	// latency of the tx, block, contract and asset lookups behind the RPCs and returns true if they all find
+	// the expected items
+	bool test_chain_lookups(size_t blocks_count = 100000);
+}
@@ -53,6 +53,8 @@ namespace simplechain {
 		RpcResultType invoke_contract(blockchain* chain, HttpServer* server, const RpcRequestParams& params);
 		RpcResultType invoke_contract_offline(blockchain* chain, HttpServer* server, const RpcRequestParams& params);
 		RpcResultType generate_block(blockchain* chain, HttpServer* server, const RpcRequestParams& params);
+		// rollback_blocks(count: int), needs the chain started with --data-dir
+		RpcResultType rollback_blocks(blockchain* chain, HttpServer* server, const RpcRequestParams& params);
 		RpcResultType get_block_by_height(blockchain* chain, HttpServer* server, const RpcRequestParams& params);
 		RpcResultType get_tx(blockchain* chain, HttpServer* server, const RpcRequestParams& params);
 		RpcResultType get_tx_receipt(blockchain* chain, HttpServer* server, const RpcRequestParams& params);
@@ -64,6 +66,10 @@ namespace simplechain {
 		RpcResultType get_contract_info(blockchain* chain, HttpServer* server, const RpcRequestParams& params);
 		RpcResultType get_account_balances(blockchain* chain, HttpServer* server, const RpcRequestParams& params);
 		RpcResultType get_contract_storages(blockchain* chain, HttpServer* server, const RpcRequestParams& params);
+		// get_contract_storages_page(contract_address: string, start_after: string, limit: int)
+		// limit must be at least 1, at most SIMPLECHAIN_MAX_STORAGES_PAGE_SIZE storages are returned per page
+		// returns {storages, next}, pass next as start_after to get the next page, next is null at the last page
+		RpcResultType get_contract_storages_page(blockchain* chain, HttpServer* server, const RpcRequestParams& params);
 		RpcResultType get_storage(blockchain* chain, HttpServer* server, const RpcRequestParams& params);
 
 		//add debug rpc
@@ -19,3 +19,6 @@
 
 #define SIMPLECHAIN_CONTRACT_ADDRESS_PREFIX "CON"
 #define SIMPLECHAIN_ADDRESS_PREFIX "SPL"
+
+// most storages returned by one get_contract_storages_page call
+#define SIMPLECHAIN_MAX_STORAGES_PAGE_SIZE 1000
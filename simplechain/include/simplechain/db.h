@@ -1 +1,84 @@
 #pragma once
+#include <simplechain/config.h>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace simplechain {
+
+	// a key set (or erased) by a block, or the value the key had before the block when used as undo
+	struct state_db_write {
+		std::string key;
+		bool erased = false;
+		std::string value;
+	};
+
+	// embedded store of the chain state.
+	// each commit appends one checksummed record to state.log with the new values of the keys changed by a block
+	// and their values before it, so a record torn by a crash is dropped when reopening and the last blocks can be
+	// rolled back. the live keys are indexed in memory by the log position of their value, and the index is
+	// checkpointed to state.index so reopening only replays the records appended after the checkpoint.
+	// not thread safe
+	class state_db {
+	public:
+		state_db();
+		~state_db();
+
+		// @throws exception
+		void open(const std::string& dir);
+		void close();
+		bool is_open() const;
+		// no block committed yet
+		bool empty() const;
+		// number of the last committed block
+		uint64_t head_block_number() const;
+		// committed blocks that can still be rolled back
+		size_t rollbackable_blocks() const;
+		size_t keys_count() const;
+
+		// append the changes of block_number atomically, undo holds the previous value of each written key
+		// @throws exception
+		void commit_block(uint64_t block_number, const std::vector<state_db_write>& writes, const std::vector<state_db_write>& undo);
+		// undo the last blocks_count committed blocks, returns the writes that restore the state before them
+		// @throws exception
+		std::vector<state_db_write> rollback_blocks(size_t blocks_count);
+
+		bool get(const std::string& key, std::string& value) const;
+		// visit all the live keys in log order, so the log is read sequentially
+		// @throws exception
+		void visit(const std::function<void(const std::string& key, const std::string& value)>& visitor) const;
+
+		// write the index to state.index, done every checkpoint_interval commits and when closing
+		void checkpoint();
+		void set_checkpoint_interval(size_t commits_count);
+
+	private:
+		struct value_location {
+			uint64_t offset = 0;
+			uint32_t size = 0;
+		};
+		struct block_record {
+			uint64_t block_number = 0;
+			uint64_t offset = 0; // offset of the commit record in the log
+		};
+
+		// returns false if there is no usable checkpoint
+		bool load_index(uint64_t& indexed_log_size);
+		void replay_log(uint64_t from_offset);
+		// parse the record at offset, returns its size or 0 if it is incomplete or corrupted
+		uint64_t read_record(uint64_t offset, std::string& payload) const;
+		void index_record(uint64_t offset, const std::string& payload);
+		void append_record(const std::string& payload);
+		void read_at(uint64_t offset, size_t size, std::string& out) const;
+
+		std::string _dir;
+		FILE* _log = nullptr;
+		uint64_t _log_size = 0;
+		std::map<std::string, value_location> _index;
+		std::vector<block_record> _blocks;
+		size_t _checkpoint_interval = 1000;
+		size_t _commits_since_checkpoint = 0;
+	};
+}
@@ -28,8 +28,8 @@ namespace simplechain {
 		virtual void set_current_tx(transaction* tx);
 		virtual transaction* get_current_tx() const;
 
-		StorageDataType get_storage(const std::string& contract_address, const std::string& key) const;
-		std::map<std::string, StorageDataType> get_contract_storages(const std::string& contract_addr) const;
+		const StorageDataType& get_storage(const std::string& contract_address, const std::string& key) const;
+		const std::map<std::string, StorageDataType>& get_contract_storages(const std::string& contract_addr) const;
 		void emit_event(const std::string& contract_address, const std::string& event_name, const std::string& event_arg);
 		void store_contract(const std::string& contract_address,
 			const contract_object& contract_obj);
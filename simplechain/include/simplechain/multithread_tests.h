@@ -0,0 +1,13 @@
+#pragma once
+#include <simplechain/simplechain.h>
+#include <string>
+
+namespace simplechain {
+	// runs the token contract on threads_count threads, each thread with its own blockchain,
+	// and checks the results against a serial run. return true if all results are the same
+	bool test_token_contract_multithread(const std::string& token_gpc_filepath, size_t threads_count = 8, size_t transfers_count = 100);
+
+	// applies blocks of independent and of contended token transfers serially and with speculative parallel execution,
+	// prints the throughput of both and returns true if the blocks have the same receipts and state
+	bool test_parallel_block_execution(const std::string& token_gpc_filepath, size_t transfers_count = 2000);
+}
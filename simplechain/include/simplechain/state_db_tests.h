@@ -0,0 +1,14 @@
+#pragma once
+#include <simplechain/simplechain.h>
+#include <string>
+
+namespace simplechain {
+	// runs token transfers on a blockchain kept in a state db, then checks that reopening it (with and without
+	// the index checkpoint and after a torn log record) and rolling back a block give the same state as the
+	// chain had at that block. return true if all states match
+	bool test_state_db(const std::string& token_gpc_filepath);
+
+	// commits blocks of keys_per_block new contract storages up to keys_count storages and prints the commit
+	// throughput, the time to reopen the state db and the time to load a blockchain from it
+	void bench_state_db(size_t keys_count = 1000000, size_t keys_per_block = 10000);
+}
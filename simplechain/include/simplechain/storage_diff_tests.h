@@ -0,0 +1,9 @@
+#pragma once
+#include <cstddef>
+
+namespace simplechain {
+	// diffs pairs_count random pairs of storage tables and arrays of scalars with diff_storage_tables_by_items
+	// and with CborDiff::diff on their cbor values, returns true if every item diff is byte-identical to the
+	// full diff
+	bool test_storage_diff_by_items(size_t pairs_count = 200000);
+}
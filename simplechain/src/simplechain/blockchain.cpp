@@ -5,6 +5,9 @@
 #include <simplechain/uvm_contract_engine.h>
 #include <iostream>
 #include <list>
+#include <mutex>
+#include <thread>
+#include <atomic>
 #include <fc/io/json.hpp>
 #include <uvm/lvm.h>
 #include <fc/log/logger.hpp>
@@ -14,20 +17,110 @@
 #include <cbor_diff/cbor_diff.h>
 
 namespace simplechain {
+	// contract_object as kept in the state db, with the api arg types of its code that Code does not reflect
+	struct stored_contract_object {
+		uint64_t registered_block = 0;
+		uvm::blockchain::Code code;
+		std::map<std::string, std::vector<int32_t> > api_arg_types;
+		std::string owner_address;
+		fc::time_point_sec create_time;
+		std::string contract_address;
+		std::string contract_name;
+		std::string contract_desc;
+		int32_t type_of_contract = 0;
+		std::string native_contract_key;
+		std::vector<std::string> derived;
+		std::string inherit_from;
+	};
+
+	// transaction_receipt as kept in the state db. the reflection of transaction_receipt leaves out
+	// exec_succeed and is part of its serialized format, so it is not reused here
+	struct stored_contract_event {
+		std::string contract_address;
+		std::string event_name;
+		std::string event_arg;
+		std::string caller_addr;
+		uint64_t block_num = 0;
+	};
+
+	struct stored_tx_receipt {
+		std::string tx_id;
+		std::vector<stored_contract_event> events;
+		bool exec_succeed = false;
+	};
+}
+
+FC_REFLECT(simplechain::stored_contract_object, (registered_block)(code)(api_arg_types)(owner_address)(create_time)(contract_address)
+	(contract_name)(contract_desc)(type_of_contract)(native_contract_key)(derived)(inherit_from))
+FC_REFLECT(simplechain::stored_contract_event, (contract_address)(event_name)(event_arg)(caller_addr)(block_num))
+FC_REFLECT(simplechain::stored_tx_receipt, (tx_id)(events)(exec_succeed))
+
+namespace simplechain {
+	static std::string state_key(const char* kind, const std::string& key1, const std::string& key2) {
+		std::string key(kind);
+		key.push_back('\n');
+		key += key1;
+		key.push_back('\n');
+		key += key2;
+		return key;
+	}
+
+	// keys of the chain state read by the speculative evaluation running on this thread, see generate_block
+	static thread_local std::set<std::string>* speculative_state_reads = nullptr;
+
+	static void record_state_read(const char* kind, const std::string& key1, const std::string& key2 = "") {
+		if (speculative_state_reads)
+			speculative_state_reads->insert(state_key(kind, key1, key2));
+	}
+
+	static void split_state_key(const std::string& key, std::string& kind, std::string& key1, std::string& key2) {
+		auto pos1 = key.find('\n');
+		auto pos2 = key.find('\n', pos1 + 1);
+		FC_ASSERT(pos1 != std::string::npos && pos2 != std::string::npos, "invalid state key");
+		kind = key.substr(0, pos1);
+		key1 = key.substr(pos1 + 1, pos2 - pos1 - 1);
+		key2 = key.substr(pos2 + 1);
+	}
+
+	// kinds of state kept in the state db, each item keyed by its state_key
+	static bool is_persisted_state(const char* kind) {
+		static const std::set<std::string> persisted_kinds = { "balance", "pubkey", "contract", "storage", "asset", "receipt", "block" };
+		return persisted_kinds.find(kind) != persisted_kinds.end();
+	}
+
+	void blockchain::record_state_write(const char* kind, const std::string& key1, const std::string& key2) {
+		if (block_state_writes)
+			block_state_writes->insert(state_key(kind, key1, key2));
+		if (db && is_persisted_state(kind)) {
+			auto key = state_key(kind, key1, key2);
+			if (uncommitted_state_undo.find(key) == uncommitted_state_undo.end()) {
+				auto& undo = uncommitted_state_undo[key];
+				undo.key = key;
+				undo.erased = !read_state_value(key, undo.value);
+			}
+		}
+	}
+
 	blockchain::blockchain() {
-		uvm::lua::api::global_uvm_chain_api = new simplechain::SimpleChainUvmChainApi();
+		// the chain api finds its chain through the lua_State, so all blockchains (and threads) share one instance
+		static std::once_flag chain_api_inited;
+		std::call_once(chain_api_inited, []() {
+			uvm::lua::api::global_uvm_chain_api = new simplechain::SimpleChainUvmChainApi();
+		});
+		block_execution_threads = 1;
 
 		asset core_asset;
 		core_asset.asset_id = 0;
 		core_asset.precision = SIMPLECHAIN_CORE_ASSET_PRECISION;
 		core_asset.symbol = SIMPLECHAIN_CORE_ASSET_SYMBOL;
-		assets.push_back(core_asset);
+		put_asset(core_asset);
 
 		block genesis_block;
 		genesis_block.prev_block_hash = "";
 		genesis_block.block_number = 0;
 		genesis_block.block_time = fc::time_point(fc::microseconds(1536033055382L));
 		blocks.push_back(genesis_block);
+		index_block(0);
 	}
 
 	std::shared_ptr<evaluate_result> blockchain::evaluate_transaction(std::shared_ptr<transaction> tx) {
@@ -67,7 +160,7 @@ namespace simplechain {
 		}
 	}
 
-	block blockchain::latest_block() const {
+	const block& blockchain::latest_block() const {
 		assert( ! blocks.empty() );
 		return blocks[blocks.size() - 1];
 	}
@@ -77,17 +170,16 @@ namespace simplechain {
 	}
 
 	std::string blockchain::head_block_hash() const {
-		return latest_block().block_hash();
+		assert(!block_hashes.empty());
+		return block_hashes[block_hashes.size() - 1];
 	}
 
 	std::shared_ptr<transaction> blockchain::get_trx_by_hash(const std::string& tx_hash) const {
-		for (const auto& block : blocks) {
-			for (const auto& tx : block.txs) {
-				if (tx.tx_hash() == tx_hash)
-					return std::make_shared<transaction>(tx);
-			}
+		auto it = tx_locations.find(tx_hash);
+		if (it == tx_locations.end()) {
+			return nullptr;
 		}
-		return nullptr;
+		return std::make_shared<transaction>(blocks[it->second.first].txs[it->second.second]);
 	}
 
 	std::shared_ptr<block> blockchain::get_block_by_number(uint64_t num) const {
@@ -97,15 +189,14 @@ namespace simplechain {
 		return std::make_shared<block>(blocks[num]);
 	}
 	std::shared_ptr<block> blockchain::get_block_by_hash(const std::string& to_find_block_hash) const {
-		for (const auto& blk : blocks) {
-			const auto& block_hash = blk.block_hash();
-			if (block_hash == to_find_block_hash) {
-				return std::make_shared<block>(blk);
-			}
+		auto it = block_numbers.find(to_find_block_hash);
+		if (it == block_numbers.end()) {
+			return nullptr;
 		}
-		return nullptr;
+		return get_block_by_number(it->second);
 	}
 	balance_t blockchain::get_account_asset_balance(const std::string& account_address, asset_id_t asset_id) const {
+		record_state_read("balance", account_address, std::to_string(asset_id));
 		auto balances_iter = account_balances.find(account_address);
 		if (balances_iter == account_balances.end()) {
 			return 0;
@@ -119,6 +210,7 @@ namespace simplechain {
 	}
 
 	std::map<asset_id_t, balance_t> blockchain::get_account_balances(const std::string& account_address) const {
+		record_state_read("balances", account_address);
 		auto balances_iter = account_balances.find(account_address);
 		std::map<asset_id_t, balance_t> balances;
 		if (balances_iter != account_balances.end()) {
@@ -128,6 +220,9 @@ namespace simplechain {
 	}
 
 	void blockchain::update_account_asset_balance(const std::string& account_address, asset_id_t asset_id, int64_t balance_change) {
+		record_state_write("balance", account_address, std::to_string(asset_id));
+		record_state_write("balances", account_address);
+		record_state_write("accounts", "");
 		auto balances_iter = account_balances.find(account_address);
 		std::map<asset_id_t, balance_t> balances;
 		if (balances_iter != account_balances.end()) {
@@ -146,45 +241,40 @@ namespace simplechain {
 		account_balances[account_address] = balances;
 	}
 	std::shared_ptr<contract_object> blockchain::get_contract_by_address(const std::string& addr) const {
-		for (const auto& it : contracts) {
-			if (it.first == addr) {
-				return std::make_shared<contract_object>(it.second);
-			}
+		record_state_read("contract", addr);
+		auto it = contracts.find(addr);
+		if (it == contracts.end()) {
+			return nullptr;
 		}
-		return nullptr;
+		return std::make_shared<contract_object>(it->second);
 	}
 	std::shared_ptr<contract_object> blockchain::get_contract_by_name(const std::string& name) const {
-		for (const auto& it : contracts) {
-			if (it.second.contract_name == name) {
-				return std::make_shared<contract_object>(it.second);
-			}
+		record_state_read("contract_name", name);
+		auto it = contract_addresses.find(name);
+		if (it == contract_addresses.end()) {
+			return nullptr;
 		}
-		return nullptr;
+		// the contract with the smallest address, the first one a scan of contracts finds
+		return std::make_shared<contract_object>(contracts.at(*it->second.begin()));
 	}
 
 	bool blockchain::contains_contract_by_address(const std::string& contract_address) const {
-		for (const auto& it : contracts) {
-			if (it.first == contract_address) {
-				return true;
-			}
-		}
-		return false;
+		record_state_read("contract", contract_address);
+		return contracts.find(contract_address) != contracts.end();
 	}
 	bool blockchain::contains_contract_by_name(const std::string& name) const {
-		for (const auto& it : contracts) {
-			if (it.second.contract_name == name) {
-				return true;
-			}
-		}
-		return false;
+		record_state_read("contract_name", name);
+		return contract_addresses.find(name) != contract_addresses.end();
 	}
 
 
 	void blockchain::register_account(const std::string& addr, const std::string& pub_key_hex) {
+		record_state_write("pubkey", addr);
 		address_pubkeys[addr] = pub_key_hex;
 	}
 
 	std::string blockchain::get_address_pubkey_hex(const std::string& addr) const {
+		record_state_read("pubkey", addr);
 		auto it = address_pubkeys.find(addr);
 		if (it == address_pubkeys.end())
 			return "";
@@ -192,83 +282,105 @@ namespace simplechain {
 	}
 
 	void blockchain::store_contract(const std::string& addr, const contract_object& contract_obj) {
-		contracts[addr] = contract_obj;
+		if (block_state_writes) {
+			auto old = contracts.find(addr);
+			if (old != contracts.end())
+				record_state_write("contract_name", old->second.contract_name);
+			record_state_write("contract_name", contract_obj.contract_name);
+			record_state_write("contracts", "");
+		}
+		record_state_write("contract", addr);
+		put_contract(addr, contract_obj);
 	}
 
-	StorageDataType blockchain::get_storage(const std::string& contract_address, const std::string& key) const {
-		auto it1 = contract_storages.find(contract_address);
-		if (it1 == contract_storages.end()) {
-			auto cbor_null = cbor::CborObject::create_null();
-			const auto& cbor_null_bytes = cbor_diff::cbor_encode(cbor_null);
+	static const StorageDataType& null_storage_data() {
+		static const StorageDataType null_storage = [] {
 			StorageDataType storage;
-			storage.storage_data = cbor_null_bytes;
+			storage.storage_data = cbor_diff::cbor_encode(cbor::CborObject::create_null());
 			return storage;
-			// std::string null_jsonstr("null");
-			// return StorageDataType(null_jsonstr);
+		}();
+		return null_storage;
+	}
+
+	const StorageDataType& blockchain::get_storage(const std::string& contract_address, const std::string& key) const {
+		record_state_read("storage", contract_address, key);
+		auto it1 = contract_storages.find(contract_address);
+		if (it1 == contract_storages.end()) {
+			return null_storage_data();
 		}
 		auto it2 = it1->second.find(key);
 		if (it2 == it1->second.end()) {
-			auto cbor_null = cbor::CborObject::create_null();
-			const auto& cbor_null_bytes = cbor_diff::cbor_encode(cbor_null);
-			StorageDataType storage;
-			storage.storage_data = cbor_null_bytes;
-			return storage;
-			// std::string null_jsonstr("null");
-			// return StorageDataType(null_jsonstr);
+			return null_storage_data();
 		}
 		return it2->second;
 	}
 
-	std::map<std::string, StorageDataType> blockchain::get_contract_storages(const std::string& contract_address) const {
+	const std::map<std::string, StorageDataType>& blockchain::get_contract_storages(const std::string& contract_address) const {
+		static const std::map<std::string, StorageDataType> empty_storages;
+		record_state_read("storages", contract_address);
 		auto it1 = contract_storages.find(contract_address);
-		std::map<std::string, StorageDataType> storages;
-		if (it1 != contract_storages.end()) {
-			storages = it1->second;
+		if (it1 == contract_storages.end()) {
+			return empty_storages;
 		}
-		return storages;
+		return it1->second;
 	}
 
-	void blockchain::set_storage(const std::string& contract_address, const std::string& key, const StorageDataType& value) {
+	bool blockchain::visit_contract_storages(const std::string& contract_address, const std::string& start_after, size_t limit,
+		const std::function<void(const std::string&, const StorageDataType&)>& visitor) const {
+		record_state_read("storages", contract_address);
 		auto it1 = contract_storages.find(contract_address);
-		std::map<std::string, StorageDataType> storages;
-		if (it1 != contract_storages.end()) {
-			storages = it1->second;
+		if (it1 == contract_storages.end()) {
+			return false;
+		}
+		const auto& storages = it1->second;
+		auto it2 = start_after.empty() ? storages.begin() : storages.upper_bound(start_after);
+		for (size_t i = 0; i < limit && it2 != storages.end(); ++i, ++it2) {
+			visitor(it2->first, it2->second);
 		}
-		storages[key] = value;
-		contract_storages[contract_address] = storages;
+		return it2 != storages.end();
+	}
+
+	void blockchain::set_storage(const std::string& contract_address, const std::string& key, const StorageDataType& value) {
+		record_state_write("storage", contract_address, key);
+		record_state_write("storages", contract_address);
+		contract_storages[contract_address][key] = value;
 	}
 
 	void blockchain::add_asset(const asset& new_asset) {
+		record_state_write("assets", "");
+		record_state_write("asset", std::to_string(assets.size()));
 		asset item(new_asset);
 		item.asset_id = (asset_id_t)(assets.size());
-		assets.push_back(item);
+		put_asset(item);
 	}
 	std::shared_ptr<asset> blockchain::get_asset(asset_id_t asset_id) {
-		for (const auto& item : assets) {
-			if (item.asset_id == asset_id) {
-				return std::make_shared<asset>(item);
-			}
+		record_state_read("assets", "");
+		if (asset_id >= assets.size()) {
+			return nullptr;
 		}
-		return nullptr;
+		return std::make_shared<asset>(assets[asset_id]);
 	}
 	std::shared_ptr<asset> blockchain::get_asset_by_symbol(const std::string& symbol) {
-		for (const auto& item : assets) {
-			if (item.symbol == symbol) {
-				return std::make_shared<asset>(item);
-			}
+		record_state_read("assets", "");
+		auto it = asset_ids.find(symbol);
+		if (it == asset_ids.end()) {
+			return nullptr;
 		}
-		return nullptr;
+		return std::make_shared<asset>(assets[*it->second.begin()]);
 	}
 
 	std::vector<asset> blockchain::get_assets() const {
+		record_state_read("assets", "");
 		return assets;
 	}
 
 	void blockchain::set_tx_receipt(const std::string& tx_id, const transaction_receipt& tx_receipt) {
+		record_state_write("receipt", tx_id);
 		tx_receipts[tx_id] = tx_receipt;
 	}
 
 	std::shared_ptr<transaction_receipt> blockchain::get_tx_receipt(const std::string& tx_id) {
+		record_state_read("receipt", tx_id);
 		auto it = tx_receipts.find(tx_id);
 		if (it == tx_receipts.end()) {
 			return nullptr;
@@ -361,29 +473,527 @@ namespace simplechain {
 		return tx_mempool;
 	}
 
+	// result of evaluating a transaction against the chain state at the start of the block
+	struct speculative_tx_result {
+		std::shared_ptr<contract_invoke_result> result; // nullptr if the tx must be applied one by one
+		std::set<std::string> state_reads;
+
+		// still valid if nothing it read was written by the txs committed before it
+		bool valid_after(const std::set<std::string>& state_writes) const {
+			if (!result)
+				return false;
+			for (const auto& key : state_reads) {
+				if (state_writes.find(key) != state_writes.end())
+					return false;
+			}
+			return true;
+		}
+	};
+
+	static bool is_contract_operation(const operation& op) {
+		auto type = op.which();
+		return type == operation::tag<contract_create_operation>::value
+			|| type == operation::tag<contract_invoke_operation>::value
+			|| type == operation::tag<native_contract_create_operation>::value;
+	}
+
 	void blockchain::generate_block() {
+		// evaluate single contract operation txs on block_execution_threads threads against the current state,
+		// then commit in mempool order. a tx whose reads were written by an earlier tx of the block is applied again,
+		// so the block state and receipts are the same as applying the txs one by one
+		std::vector<speculative_tx_result> speculations;
+		bool has_breakpoints = !breakpoints.empty() || get_last_contract_engine_for_debugger();
+		if (block_execution_threads > 1 && tx_mempool.size() > 1 && !has_breakpoints) {
+			speculations.resize(tx_mempool.size());
+			std::atomic<size_t> next_tx(0);
+			auto speculate = [this, &speculations, &next_tx]() {
+				for (size_t i = next_tx++; i < tx_mempool.size(); i = next_tx++) {
+					auto& tx = tx_mempool[i];
+					if (tx.operations.size() != 1 || !is_contract_operation(tx.operations[0]))
+						continue;
+					auto& speculation = speculations[i];
+					speculative_state_reads = &speculation.state_reads;
+					try {
+						auto evaluator_instance = get_operation_evaluator(&tx, tx.operations[0]);
+						speculation.result = std::static_pointer_cast<contract_invoke_result>(evaluator_instance->evaluate(tx.operations[0]));
+					}
+					catch (...) {
+						speculation.result = nullptr;
+					}
+					speculative_state_reads = nullptr;
+				}
+			};
+			std::vector<std::thread> threads;
+			auto threads_count = std::min(block_execution_threads, tx_mempool.size());
+			for (size_t i = 0; i < threads_count; i++) {
+				threads.emplace_back(speculate);
+			}
+			for (auto& t : threads) {
+				t.join();
+			}
+		}
+
 		std::vector<transaction> valid_txs;
-		auto it = tx_mempool.begin();
-		while (it != tx_mempool.end()) {
+		std::vector<transaction> failed_txs;
+		std::set<std::string> state_writes;
+		block_state_writes = speculations.empty() ? nullptr : &state_writes;
+		for (size_t i = 0; i < tx_mempool.size(); i++) {
+			const auto& tx = tx_mempool[i];
 			try {
-				apply_transaction(std::make_shared<transaction>(*it));
-				valid_txs.push_back(*it);
-				it = tx_mempool.erase(it);
+				if (i < speculations.size() && speculations[i].valid_after(state_writes)) {
+					speculations[i].result->apply_pendings(this, tx.tx_hash());
+				}
+				else {
+					apply_transaction(std::make_shared<transaction>(tx));
+				}
+				valid_txs.push_back(tx);
 			}
 			catch (const std::exception& e) {
 				std::cout << "error of applying tx when generating block: " << e.what() << std::endl;
-				it++;
+				failed_txs.push_back(tx);
 			}
 		}
+		block_state_writes = nullptr;
+		tx_mempool = failed_txs;
+
 		block blk;
 		blk.txs = valid_txs;
 		blk.block_time = fc::time_point_sec(fc::time_point::now());
 		blk.block_number = blocks.size();
-		blk.prev_block_hash = latest_block().block_hash();
+		blk.prev_block_hash = head_block_hash();
+		record_state_write("block", std::to_string(blk.block_number));
 		blocks.push_back(blk);
+		index_block(blk.block_number);
+		if (db)
+			commit_state_db();
 		ilog("block #${block_num} generated", ("block_num", blk.block_number));
 	}
 
+	void blockchain::set_block_execution_threads(size_t threads_count) {
+		block_execution_threads = std::max<size_t>(threads_count, 1);
+	}
+
+	size_t blockchain::get_block_execution_threads() const {
+		return block_execution_threads;
+	}
+
+	void blockchain::index_block(size_t block_number) {
+		const auto& blk = blocks[block_number];
+		if (block_hashes.size() <= block_number)
+			block_hashes.resize(block_number + 1);
+		block_hashes[block_number] = blk.block_hash();
+		block_numbers[block_hashes[block_number]] = block_number;
+		for (size_t i = 0; i < blk.txs.size(); i++) {
+			// a tx included again later is still found in its first block
+			auto location = std::make_pair(uint64_t(block_number), i);
+			auto it = tx_locations.find(blk.txs[i].tx_hash());
+			if (it == tx_locations.end())
+				tx_locations[blk.txs[i].tx_hash()] = location;
+			else if (it->second.first > block_number)
+				it->second = location;
+		}
+	}
+
+	void blockchain::unindex_block(size_t block_number) {
+		if (block_number >= block_hashes.size() || block_hashes[block_number].empty())
+			return;
+		block_numbers.erase(block_hashes[block_number]);
+		for (const auto& tx : blocks[block_number].txs) {
+			auto it = tx_locations.find(tx.tx_hash());
+			if (it != tx_locations.end() && it->second.first == block_number)
+				tx_locations.erase(it);
+		}
+		block_hashes[block_number].clear();
+		while (!block_hashes.empty() && block_hashes.back().empty())
+			block_hashes.pop_back();
+	}
+
+	void blockchain::put_contract(const std::string& addr, const contract_object& contract_obj) {
+		erase_contract(addr);
+		contracts[addr] = contract_obj;
+		contract_addresses[contract_obj.contract_name].insert(addr);
+	}
+
+	void blockchain::erase_contract(const std::string& addr) {
+		auto it = contracts.find(addr);
+		if (it == contracts.end())
+			return;
+		auto name_it = contract_addresses.find(it->second.contract_name);
+		if (name_it != contract_addresses.end()) {
+			name_it->second.erase(addr);
+			if (name_it->second.empty())
+				contract_addresses.erase(name_it);
+		}
+		contracts.erase(it);
+	}
+
+	void blockchain::put_asset(const asset& item) {
+		if (item.asset_id < assets.size())
+			unindex_asset(item.asset_id);
+		else
+			assets.resize(item.asset_id + 1);
+		assets[item.asset_id] = item;
+		// the first asset with a symbol is the one found by it
+		asset_ids[item.symbol].insert(item.asset_id);
+	}
+
+	void blockchain::unindex_asset(asset_id_t asset_id) {
+		auto it = asset_ids.find(assets[asset_id].symbol);
+		if (it == asset_ids.end())
+			return;
+		it->second.erase(asset_id);
+		if (it->second.empty())
+			asset_ids.erase(it);
+	}
+
+	void blockchain::truncate_assets(size_t assets_count) {
+		for (auto i = assets_count; i < assets.size(); i++) {
+			unindex_asset(asset_id_t(i));
+		}
+		if (assets_count < assets.size())
+			assets.resize(assets_count);
+	}
+
+	template <typename T>
+	static std::string pack_state_value(const T& obj) {
+		auto data = fc::raw::pack(obj);
+		return std::string(data.begin(), data.end());
+	}
+
+	template <typename T>
+	static T unpack_state_value(const std::string& value) {
+		std::vector<char> data(value.begin(), value.end());
+		return fc::raw::unpack<T>(data);
+	}
+
+	static std::string pack_contract(const contract_object& obj) {
+		stored_contract_object stored;
+		stored.registered_block = obj.registered_block;
+		stored.code = obj.code;
+		for (const auto& p : obj.code.api_arg_types) {
+			auto& arg_types = stored.api_arg_types[p.first];
+			for (auto arg_type : p.second) {
+				arg_types.push_back(int32_t(arg_type));
+			}
+		}
+		stored.owner_address = obj.owner_address;
+		stored.create_time = obj.create_time;
+		stored.contract_address = obj.contract_address;
+		stored.contract_name = obj.contract_name;
+		stored.contract_desc = obj.contract_desc;
+		stored.type_of_contract = int32_t(obj.type_of_contract);
+		stored.native_contract_key = obj.native_contract_key;
+		stored.derived = obj.derived;
+		stored.inherit_from = obj.inherit_from;
+		return pack_state_value(stored);
+	}
+
+	static contract_object unpack_contract(const std::string& value) {
+		auto stored = unpack_state_value<stored_contract_object>(value);
+		contract_object obj;
+		obj.registered_block = stored.registered_block;
+		obj.code = stored.code;
+		for (const auto& p : stored.api_arg_types) {
+			auto& arg_types = obj.code.api_arg_types[p.first];
+			for (auto arg_type : p.second) {
+				arg_types.push_back(UvmTypeInfoEnum(arg_type));
+			}
+		}
+		obj.owner_address = stored.owner_address;
+		obj.create_time = stored.create_time;
+		obj.contract_address = stored.contract_address;
+		obj.contract_name = stored.contract_name;
+		obj.contract_desc = stored.contract_desc;
+		obj.type_of_contract = contract_type(stored.type_of_contract);
+		obj.native_contract_key = stored.native_contract_key;
+		obj.derived = stored.derived;
+		obj.inherit_from = stored.inherit_from;
+		return obj;
+	}
+
+	static std::string pack_tx_receipt(const transaction_receipt& receipt) {
+		stored_tx_receipt stored;
+		stored.tx_id = receipt.tx_id;
+		for (const auto& event : receipt.events) {
+			stored_contract_event stored_event;
+			stored_event.contract_address = event.contract_address;
+			stored_event.event_name = event.event_name;
+			stored_event.event_arg = event.event_arg;
+			stored_event.caller_addr = event.caller_addr;
+			stored_event.block_num = event.block_num;
+			stored.events.push_back(stored_event);
+		}
+		stored.exec_succeed = receipt.exec_succeed;
+		return pack_state_value(stored);
+	}
+
+	static transaction_receipt unpack_tx_receipt(const std::string& value) {
+		auto stored = unpack_state_value<stored_tx_receipt>(value);
+		transaction_receipt receipt;
+		receipt.tx_id = stored.tx_id;
+		for (const auto& stored_event : stored.events) {
+			contract_event_notify_info event;
+			event.contract_address = stored_event.contract_address;
+			event.event_name = stored_event.event_name;
+			event.event_arg = stored_event.event_arg;
+			event.caller_addr = stored_event.caller_addr;
+			event.block_num = stored_event.block_num;
+			receipt.events.push_back(event);
+		}
+		receipt.exec_succeed = stored.exec_succeed;
+		return receipt;
+	}
+
+	bool blockchain::read_state_value(const std::string& key, std::string& value) const {
+		std::string kind, key1, key2;
+		split_state_key(key, kind, key1, key2);
+		if (kind == "balance") {
+			auto it1 = account_balances.find(key1);
+			if (it1 == account_balances.end())
+				return false;
+			auto it2 = it1->second.find(asset_id_t(std::stoul(key2)));
+			if (it2 == it1->second.end())
+				return false;
+			value = std::to_string(it2->second);
+			return true;
+		}
+		else if (kind == "pubkey") {
+			auto it = address_pubkeys.find(key1);
+			if (it == address_pubkeys.end())
+				return false;
+			value = it->second;
+			return true;
+		}
+		else if (kind == "contract") {
+			auto it = contracts.find(key1);
+			if (it == contracts.end())
+				return false;
+			value = pack_contract(it->second);
+			return true;
+		}
+		else if (kind == "storage") {
+			auto it1 = contract_storages.find(key1);
+			if (it1 == contract_storages.end())
+				return false;
+			auto it2 = it1->second.find(key2);
+			if (it2 == it1->second.end())
+				return false;
+			value.assign(it2->second.storage_data.begin(), it2->second.storage_data.end());
+			return true;
+		}
+		else if (kind == "asset") {
+			auto asset_id = size_t(std::stoul(key1));
+			if (asset_id >= assets.size())
+				return false;
+			value = pack_state_value(assets[asset_id]);
+			return true;
+		}
+		else if (kind == "receipt") {
+			auto it = tx_receipts.find(key1);
+			if (it == tx_receipts.end())
+				return false;
+			value = pack_tx_receipt(it->second);
+			return true;
+		}
+		else if (kind == "block") {
+			auto block_number = size_t(std::stoull(key1));
+			if (block_number >= blocks.size())
+				return false;
+			value = pack_state_value(blocks[block_number]);
+			return true;
+		}
+		FC_THROW("unknown state kind ${kind}", ("kind", kind));
+	}
+
+	void blockchain::apply_state_write(const state_db_write& write) {
+		std::string kind, key1, key2;
+		split_state_key(write.key, kind, key1, key2);
+		if (kind == "balance") {
+			auto asset_id = asset_id_t(std::stoul(key2));
+			if (write.erased) {
+				auto it = account_balances.find(key1);
+				if (it != account_balances.end()) {
+					it->second.erase(asset_id);
+					if (it->second.empty())
+						account_balances.erase(it);
+				}
+			}
+			else {
+				account_balances[key1][asset_id] = balance_t(std::stoll(write.value));
+			}
+		}
+		else if (kind == "pubkey") {
+			if (write.erased)
+				address_pubkeys.erase(key1);
+			else
+				address_pubkeys[key1] = write.value;
+		}
+		else if (kind == "contract") {
+			if (write.erased)
+				erase_contract(key1);
+			else
+				put_contract(key1, unpack_contract(write.value));
+		}
+		else if (kind == "storage") {
+			if (write.erased) {
+				auto it = contract_storages.find(key1);
+				if (it != contract_storages.end()) {
+					it->second.erase(key2);
+					if (it->second.empty())
+						contract_storages.erase(it);
+				}
+			}
+			else {
+				auto& storage = contract_storages[key1][key2];
+				storage.storage_data.assign(write.value.begin(), write.value.end());
+			}
+		}
+		else if (kind == "asset") {
+			// assets are only appended, so erasing one drops it and the ones after it
+			auto asset_id = size_t(std::stoul(key1));
+			if (write.erased) {
+				truncate_assets(asset_id);
+			}
+			else {
+				auto item = unpack_state_value<asset>(write.value);
+				item.asset_id = asset_id_t(asset_id);
+				put_asset(item);
+			}
+		}
+		else if (kind == "receipt") {
+			if (write.erased)
+				tx_receipts.erase(key1);
+			else
+				tx_receipts[key1] = unpack_tx_receipt(write.value);
+		}
+		else if (kind == "block") {
+			auto block_number = size_t(std::stoull(key1));
+			if (write.erased) {
+				for (auto i = block_number; i < blocks.size(); i++) {
+					unindex_block(i);
+				}
+				if (block_number < blocks.size())
+					blocks.resize(block_number);
+			}
+			else {
+				if (block_number >= blocks.size())
+					blocks.resize(block_number + 1);
+				unindex_block(block_number);
+				blocks[block_number] = unpack_state_value<block>(write.value);
+				index_block(block_number);
+			}
+		}
+		else {
+			FC_THROW("unknown state kind ${kind}", ("kind", kind));
+		}
+	}
+
+	std::vector<std::string> blockchain::persisted_state_keys() const {
+		std::vector<std::string> keys;
+		for (const auto& p : account_balances) {
+			for (const auto& balance : p.second) {
+				keys.push_back(state_key("balance", p.first, std::to_string(balance.first)));
+			}
+		}
+		for (const auto& p : address_pubkeys) {
+			keys.push_back(state_key("pubkey", p.first, ""));
+		}
+		for (const auto& p : contracts) {
+			keys.push_back(state_key("contract", p.first, ""));
+		}
+		for (const auto& p : contract_storages) {
+			for (const auto& storage : p.second) {
+				keys.push_back(state_key("storage", p.first, storage.first));
+			}
+		}
+		for (size_t i = 0; i < assets.size(); i++) {
+			keys.push_back(state_key("asset", std::to_string(i), ""));
+		}
+		for (const auto& p : tx_receipts) {
+			keys.push_back(state_key("receipt", p.first, ""));
+		}
+		for (size_t i = 0; i < blocks.size(); i++) {
+			keys.push_back(state_key("block", std::to_string(i), ""));
+		}
+		return keys;
+	}
+
+	void blockchain::commit_state_db() {
+		std::vector<state_db_write> writes;
+		std::vector<state_db_write> undo;
+		for (const auto& p : uncommitted_state_undo) {
+			state_db_write write;
+			write.key = p.first;
+			write.erased = !read_state_value(p.first, write.value);
+			writes.push_back(write);
+			undo.push_back(p.second);
+		}
+		db->commit_block(blocks.size() - 1, writes, undo);
+		uncommitted_state_undo.clear();
+	}
+
+	void blockchain::open_state_db(const std::string& dir) {
+		FC_ASSERT(!db, "state db already open");
+		std::unique_ptr<state_db> new_db(new state_db());
+		new_db->open(dir);
+		if (new_db->empty()) {
+			// a new db starts with the whole current state
+			std::vector<state_db_write> writes;
+			for (const auto& key : persisted_state_keys()) {
+				state_db_write write;
+				write.key = key;
+				read_state_value(key, write.value);
+				writes.push_back(write);
+			}
+			new_db->commit_block(blocks.size() - 1, writes, std::vector<state_db_write>());
+		}
+		else {
+			assets.clear();
+			blocks.clear();
+			tx_receipts.clear();
+			address_pubkeys.clear();
+			account_balances.clear();
+			contracts.clear();
+			contract_storages.clear();
+			block_hashes.clear();
+			block_numbers.clear();
+			tx_locations.clear();
+			contract_addresses.clear();
+			asset_ids.clear();
+			new_db->visit([this](const std::string& key, const std::string& value) {
+				state_db_write write;
+				write.key = key;
+				write.value = value;
+				apply_state_write(write);
+			});
+			FC_ASSERT(!blocks.empty() && blocks.size() == new_db->head_block_number() + 1,
+				"blocks in state db ${dir} are not consistent", ("dir", dir));
+		}
+		uncommitted_state_undo.clear();
+		db = std::move(new_db);
+	}
+
+	void blockchain::close_state_db() {
+		if (db) {
+			db->close();
+			db.reset();
+		}
+		uncommitted_state_undo.clear();
+	}
+
+	void blockchain::rollback_blocks(size_t blocks_count) {
+		FC_ASSERT(db, "rolling back blocks needs an open state db");
+		for (const auto& p : uncommitted_state_undo) {
+			apply_state_write(p.second);
+		}
+		uncommitted_state_undo.clear();
+		for (const auto& write : db->rollback_blocks(blocks_count)) {
+			apply_state_write(write);
+		}
+		clear_debugger_info();
+		ilog("rolled back to block #${block_num}", ("block_num", blocks.size() - 1));
+	}
+
 	fc::variant blockchain::get_state() const {
 		fc::mutable_variant_object chainstate_json;
 		fc::variant assets_obj;
@@ -403,6 +1013,7 @@ namespace simplechain {
 	}
 
 	std::vector<contract_object> blockchain::get_contracts() const {
+		record_state_read("contracts", "");
 		std::vector<contract_object> result;
 		for (const auto& p : contracts) {
 			result.push_back(p.second);
@@ -411,6 +1022,7 @@ namespace simplechain {
 	}
 
 	std::vector<std::string> blockchain::get_account_addresses() const {
+		record_state_read("accounts", "");
 		std::vector<std::string> result;
 		for (const auto& p : account_balances) {
 			result.push_back(p.first);
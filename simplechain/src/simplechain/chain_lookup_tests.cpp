@@ -0,0 +1,131 @@
+#include <simplechain/chain_lookup_tests.h>
+#include <simplechain/chain_rpc.h>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace simplechain {
+	using namespace std;
+
+	// average microseconds of lookups_count calls of lookup(i)
+	template <typename Lookup>
+	static double lookup_latency_us(size_t lookups_count, const Lookup& lookup) {
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < lookups_count; i++) {
+			lookup(i);
+		}
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / lookups_count;
+	}
+
+	// what the lookups returned before they were indexed: the first contract with the name in address order
+	static std::string scan_contract_by_name(blockchain& chain, const std::string& name) {
+		for (const auto& contract : chain.get_contracts()) {
+			if (contract.contract_name == name)
+				return contract.contract_address;
+		}
+		return "";
+	}
+
+	static bool same_contract_lookup(blockchain& chain, const std::string& name) {
+		auto expected = scan_contract_by_name(chain, name);
+		auto contract = chain.get_contract_by_name(name);
+		return chain.contains_contract_by_name(name) == !expected.empty()
+			&& (contract ? contract->contract_address : std::string()) == expected;
+	}
+
+	bool test_chain_lookups(size_t blocks_count) {
+		cout << "start test_chain_lookups" << endl;
+		try {
+			blockchain chain;
+			std::vector<std::string> tx_hashes;
+			std::vector<std::string> block_hashes;
+			auto op_time = fc::time_point_sec(1536033055);
+			for (size_t i = 0; i < blocks_count; i++) {
+				transaction tx;
+				auto op = operations_helper::mint(std::string(SIMPLECHAIN_ADDRESS_PREFIX) + "user" + std::to_string(i), 0, 100);
+				op.op_time = op_time;
+				tx.operations.push_back(op);
+				tx.tx_time = op_time;
+				tx_hashes.push_back(tx.tx_hash());
+				chain.accept_transaction_to_mempool(tx);
+				chain.generate_block();
+				block_hashes.push_back(chain.head_block_hash());
+			}
+			const size_t contracts_count = 1000;
+			for (size_t i = 0; i < contracts_count; i++) {
+				contract_object contract;
+				contract.contract_address = std::string(SIMPLECHAIN_CONTRACT_ADDRESS_PREFIX) + "lookup" + std::to_string(i);
+				contract.contract_name = "contract" + std::to_string(i);
+				chain.store_contract(contract.contract_address, contract);
+			}
+			const size_t assets_count = 100;
+			for (size_t i = 0; i < assets_count; i++) {
+				asset item;
+				item.symbol = "ASSET" + std::to_string(i);
+				item.precision = 5;
+				chain.add_asset(item);
+			}
+
+			bool ok = true;
+			const size_t lookups_count = 10000;
+			auto get_tx_us = lookup_latency_us(lookups_count, [&](size_t i) {
+				rpc::RpcRequestParams params;
+				params.push_back(fc::variant(tx_hashes[(i * 7919) % blocks_count]));
+				ok = ok && !rpc::get_tx(&chain, nullptr, params).is_null();
+			});
+			auto get_block_us = lookup_latency_us(lookups_count, [&](size_t i) {
+				auto block_number = (i * 7919) % blocks_count;
+				auto blk = chain.get_block_by_hash(block_hashes[block_number]);
+				ok = ok && blk && blk->block_number == block_number + 1;
+			});
+			auto get_contract_us = lookup_latency_us(lookups_count, [&](size_t i) {
+				auto contract = chain.get_contract_by_name("contract" + std::to_string(i % contracts_count));
+				ok = ok && contract && contract->contract_address == std::string(SIMPLECHAIN_CONTRACT_ADDRESS_PREFIX) + "lookup" + std::to_string(i % contracts_count);
+			});
+			auto get_asset_us = lookup_latency_us(lookups_count, [&](size_t i) {
+				auto item = chain.get_asset_by_symbol("ASSET" + std::to_string(i % assets_count));
+				ok = ok && item && item->asset_id == i % assets_count + 1;
+			});
+			ok = ok && !chain.get_trx_by_hash("missing") && !chain.get_block_by_hash("missing") && !chain.get_contract_by_name("missing");
+
+			// unnamed and duplicated names find the same contract as a scan, also after a contract is renamed
+			const std::vector<std::string> names = { "", "contract5", "missing" };
+			auto check_contract_lookups = [&]() {
+				for (const auto& name : names) {
+					ok = ok && same_contract_lookup(chain, name);
+				}
+			};
+			check_contract_lookups();
+			for (const auto& p : std::vector<std::pair<std::string, std::string> >{ { "unnamed_b", "" }, { "unnamed_a", "" }, { "5dup", "contract5" }, { "0dup", "contract5" } }) {
+				contract_object contract;
+				contract.contract_address = std::string(SIMPLECHAIN_CONTRACT_ADDRESS_PREFIX) + "lookup" + p.first;
+				contract.contract_name = p.second;
+				chain.store_contract(contract.contract_address, contract);
+				check_contract_lookups();
+			}
+			for (const auto& addr : { "0dup", "unnamed_a" }) {
+				auto contract = chain.get_contract_by_address(std::string(SIMPLECHAIN_CONTRACT_ADDRESS_PREFIX) + "lookup" + addr);
+				contract->contract_name = contract->contract_name.empty() ? "contract5" : "";
+				chain.store_contract(contract->contract_address, *contract);
+				check_contract_lookups();
+			}
+			ok = ok && chain.get_contract_by_name("")->contract_address == std::string(SIMPLECHAIN_CONTRACT_ADDRESS_PREFIX) + "lookup0dup";
+			asset duplicated;
+			duplicated.symbol = "ASSET3";
+			chain.add_asset(duplicated);
+			ok = ok && chain.get_asset_by_symbol("ASSET3")->asset_id == 4;
+			cout << blocks_count << " blocks: get_tx rpc " << get_tx_us << " us, get_block_by_hash " << get_block_us
+				<< " us, get_contract_by_name " << get_contract_us << " us, get_asset_by_symbol " << get_asset_us << " us" << endl;
+			cout << "test_chain_lookups " << (ok ? "passed" : "failed") << endl;
+			return ok;
+		}
+		catch (const fc::exception& e) {
+			cout << "error " << e.to_detail_string() << endl;
+		}
+		catch (const std::exception& e) {
+			cout << "error " << e.what() << endl;
+		}
+		cout << "test_chain_lookups failed" << endl;
+		return false;
+	}
+}
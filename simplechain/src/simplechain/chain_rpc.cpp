@@ -261,6 +261,20 @@ namespace simplechain {
 			return block_ids;
 		}
 
+		RpcResultType rollback_blocks(blockchain* chain, HttpServer* server, const RpcRequestParams& params) {
+			auto count = params.at(0).as_int64();
+			if (count <= 0) {
+				throw uvm::core::UvmException("need rollback at least 1 block");
+			}
+			try {
+				chain->rollback_blocks(size_t(count));
+			}
+			catch (const fc::exception& e) {
+				throw uvm::core::UvmException(e.to_string());
+			}
+			return chain->head_block_hash();
+		}
+
 		RpcResultType get_block_by_height(blockchain* chain, HttpServer* server, const RpcRequestParams& params) {
 			const auto& block_height = params.at(0).as_uint64();
 			auto block = chain->get_block_by_number(block_height);
@@ -361,13 +375,32 @@ namespace simplechain {
 			}
 			return storages_json;
 		}
+		RpcResultType get_contract_storages_page(blockchain* chain, HttpServer* server, const RpcRequestParams& params) {
+			const auto& addr = params.at(0).as_string();
+			const auto& start_after = params.at(1).as_string();
+			auto limit = params.at(2).as_uint64();
+			if (limit == 0) {
+				throw uvm::core::UvmException("need at least 1 storage per page");
+			}
+			limit = std::min<uint64_t>(limit, SIMPLECHAIN_MAX_STORAGES_PAGE_SIZE);
+			fc::mutable_variant_object storages_json;
+			std::string last_name;
+			auto has_more = chain->visit_contract_storages(addr, start_after, limit, [&](const std::string& name, const StorageDataType& storage) {
+				auto storage_value = cbor_diff::cbor_decode(storage.storage_data);
+				storages_json[name] = storage_value->to_json();
+				last_name = name;
+			});
+			fc::mutable_variant_object res;
+			res["storages"] = storages_json;
+			res["next"] = has_more ? fc::variant(last_name) : fc::variant();
+			return res;
+		}
 		RpcResultType get_storage(blockchain* chain, HttpServer* server, const RpcRequestParams& params) {
 			const auto& addr = params.at(0).as_string();
 			const auto& storage_name = params.at(1).as_string();
 			const auto& storage = chain->get_storage(addr, storage_name);
-			auto storage_value = cbor_diff::cbor_decode(storage.storage_data);
 			auto scope = std::make_shared < uvm::lua::lib::UvmStateScope>();
-			auto uvm_storage_data = cbor_to_uvm_storage_value(scope->L(), storage_value.get());
+			auto uvm_storage_data = cbor_to_uvm_storage_value(scope->L(), storage.storage_data.data(), storage.storage_data.size());
 			auto storage_json = simplechain::uvm_storage_value_to_json(uvm_storage_data);
 			auto res = storage_json;
 			return res;
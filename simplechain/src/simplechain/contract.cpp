@@ -196,7 +196,7 @@ namespace simplechain {
 			size_t changes_size = 0;
 			auto nested_changes_cbor = cbor::CborObject::create_map(nested_changes);
 			const auto& changes_parsed_to_array = uvm::util::nested_cbor_object_to_array(nested_changes_cbor.get());
-			changes_size = cbor_diff::cbor_encode(changes_parsed_to_array).size();
+			changes_size = cbor::encoder::encoded_size(changes_parsed_to_array.get());
 			// printf("changes size: %d bytes\n", changes_size);
 			storage_gas += changes_size * 10; // 1 byte storage cost 10 gas
 
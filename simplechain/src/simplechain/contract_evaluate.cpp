@@ -13,7 +13,8 @@
 namespace simplechain {
 	using namespace std;
 
-	static std::shared_ptr<ContractEngine> last_contract_engine_for_debugger;
+	// per thread, so chains evaluating on different threads don't share the debugger engine
+	static thread_local std::shared_ptr<ContractEngine> last_contract_engine_for_debugger;
 
 	std::shared_ptr<ContractEngine> get_last_contract_engine_for_debugger() {
 		return last_contract_engine_for_debugger;
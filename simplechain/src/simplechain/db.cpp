@@ -0,0 +1,441 @@
+#include <simplechain/db.h>
+#include <fc/exception/exception.hpp>
+#include <algorithm>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace simplechain {
+
+	static const uint32_t state_log_magic = 0x53434442; // "SCDB"
+	static const uint32_t state_index_magic = 0x53434958; // "SCIX"
+	static const size_t record_header_size = 16; // magic, payload size, payload checksum
+	static const uint8_t commit_record_type = 1;
+	static const uint8_t rollback_record_type = 2;
+
+	// FNV-1a, enough to detect a torn or partially synced record
+	static uint64_t checksum(const char* data, size_t size) {
+		uint64_t hash = 14695981039346656037ULL;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= uint8_t(data[i]);
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	static void put_u8(std::string& out, uint8_t value) {
+		out.push_back(char(value));
+	}
+	static void put_u32(std::string& out, uint32_t value) {
+		for (int i = 0; i < 4; i++)
+			out.push_back(char((value >> (8 * i)) & 0xff));
+	}
+	static void put_u64(std::string& out, uint64_t value) {
+		for (int i = 0; i < 8; i++)
+			out.push_back(char((value >> (8 * i)) & 0xff));
+	}
+	static void put_bytes(std::string& out, const std::string& value) {
+		put_u32(out, uint32_t(value.size()));
+		out += value;
+	}
+	static void put_writes(std::string& out, const std::vector<state_db_write>& writes) {
+		put_u32(out, uint32_t(writes.size()));
+		for (const auto& write : writes) {
+			put_u8(out, write.erased ? 1 : 0);
+			put_bytes(out, write.key);
+			put_bytes(out, write.erased ? std::string() : write.value);
+		}
+	}
+
+	// little endian reader over a record payload or the index file, ok is false after reading past the end
+	struct bytes_reader {
+		const std::string& data;
+		size_t pos = 0;
+		bool ok = true;
+
+		explicit bytes_reader(const std::string& data_) : data(data_) {}
+
+		bool has(size_t size) {
+			ok = ok && data.size() - pos >= size;
+			return ok;
+		}
+		uint8_t u8() {
+			return has(1) ? uint8_t(data[pos++]) : 0;
+		}
+		uint32_t u32() {
+			uint32_t value = 0;
+			if (has(4)) {
+				for (int i = 0; i < 4; i++)
+					value |= uint32_t(uint8_t(data[pos++])) << (8 * i);
+			}
+			return value;
+		}
+		uint64_t u64() {
+			uint64_t value = 0;
+			if (has(8)) {
+				for (int i = 0; i < 8; i++)
+					value |= uint64_t(uint8_t(data[pos++])) << (8 * i);
+			}
+			return value;
+		}
+		std::string bytes() {
+			auto size = u32();
+			if (!has(size))
+				return std::string();
+			std::string value(data, pos, size);
+			pos += size;
+			return value;
+		}
+	};
+
+	// value_positions gets the payload position of each written value
+	static bool read_writes(bytes_reader& reader, std::vector<state_db_write>& writes, std::vector<size_t>* value_positions) {
+		auto count = reader.u32();
+		for (uint32_t i = 0; i < count && reader.ok; i++) {
+			state_db_write write;
+			write.erased = reader.u8() != 0;
+			write.key = reader.bytes();
+			if (value_positions)
+				value_positions->push_back(reader.pos + 4);
+			write.value = reader.bytes();
+			writes.push_back(write);
+		}
+		return reader.ok;
+	}
+
+	static void sync_file(FILE* file) {
+		fflush(file);
+#ifdef _WIN32
+		_commit(_fileno(file));
+#else
+		fsync(fileno(file));
+#endif
+	}
+
+	static int seek_file(FILE* file, uint64_t offset) {
+#ifdef _WIN32
+		return _fseeki64(file, int64_t(offset), SEEK_SET);
+#else
+		return fseeko(file, off_t(offset), SEEK_SET);
+#endif
+	}
+
+	static std::string log_path(const std::string& dir) {
+		return (fc::path(dir) / "state.log").string();
+	}
+
+	static std::string index_path(const std::string& dir) {
+		return (fc::path(dir) / "state.index").string();
+	}
+
+	state_db::state_db() {}
+
+	state_db::~state_db() {
+		try {
+			close();
+		}
+		catch (...) {
+		}
+	}
+
+	void state_db::open(const std::string& dir) {
+		FC_ASSERT(!_log, "state db already open");
+		fc::create_directories(fc::path(dir));
+		_dir = dir;
+		auto path = log_path(dir);
+		_log = fopen(path.c_str(), "a+b");
+		FC_ASSERT(_log, "can't open state log ${path}", ("path", path));
+		_log_size = fc::file_size(fc::path(path));
+		uint64_t indexed_log_size = 0;
+		if (!load_index(indexed_log_size)) {
+			_index.clear();
+			_blocks.clear();
+			indexed_log_size = 0;
+		}
+		replay_log(indexed_log_size);
+	}
+
+	void state_db::close() {
+		if (!_log)
+			return;
+		checkpoint();
+		fclose(_log);
+		_log = nullptr;
+		_log_size = 0;
+		_index.clear();
+		_blocks.clear();
+	}
+
+	bool state_db::is_open() const {
+		return _log != nullptr;
+	}
+
+	bool state_db::empty() const {
+		return _blocks.empty();
+	}
+
+	uint64_t state_db::head_block_number() const {
+		FC_ASSERT(!_blocks.empty(), "no block in state db");
+		return _blocks.back().block_number;
+	}
+
+	size_t state_db::rollbackable_blocks() const {
+		return _blocks.empty() ? 0 : _blocks.size() - 1;
+	}
+
+	size_t state_db::keys_count() const {
+		return _index.size();
+	}
+
+	bool state_db::load_index(uint64_t& indexed_log_size) {
+		auto path = index_path(_dir);
+		if (!fc::exists(fc::path(path)))
+			return false;
+		auto file = fopen(path.c_str(), "rb");
+		if (!file)
+			return false;
+		std::string data(size_t(fc::file_size(fc::path(path))), '\0');
+		auto read_size = data.empty() ? 0 : fread(&data[0], 1, data.size(), file);
+		fclose(file);
+		if (read_size != data.size())
+			return false;
+
+		bytes_reader header(data);
+		auto magic = header.u32();
+		auto payload_size = header.u64();
+		auto payload_checksum = header.u64();
+		if (!header.ok || magic != state_index_magic || data.size() - header.pos != payload_size
+			|| checksum(data.data() + header.pos, size_t(payload_size)) != payload_checksum)
+			return false;
+
+		bytes_reader reader(data);
+		reader.pos = header.pos;
+		indexed_log_size = reader.u64();
+		if (indexed_log_size > _log_size)
+			return false;
+		auto keys_count = reader.u32();
+		for (uint32_t i = 0; i < keys_count && reader.ok; i++) {
+			auto key = reader.bytes();
+			value_location location;
+			location.offset = reader.u64();
+			location.size = reader.u32();
+			_index.emplace_hint(_index.end(), std::move(key), location);
+		}
+		auto blocks_count = reader.u32();
+		for (uint32_t i = 0; i < blocks_count && reader.ok; i++) {
+			block_record blk;
+			blk.block_number = reader.u64();
+			blk.offset = reader.u64();
+			_blocks.push_back(blk);
+		}
+		return reader.ok;
+	}
+
+	void state_db::checkpoint() {
+		if (!_log)
+			return;
+		std::string payload;
+		put_u64(payload, _log_size);
+		put_u32(payload, uint32_t(_index.size()));
+		for (const auto& p : _index) {
+			put_bytes(payload, p.first);
+			put_u64(payload, p.second.offset);
+			put_u32(payload, p.second.size);
+		}
+		put_u32(payload, uint32_t(_blocks.size()));
+		for (const auto& blk : _blocks) {
+			put_u64(payload, blk.block_number);
+			put_u64(payload, blk.offset);
+		}
+		std::string data;
+		put_u32(data, state_index_magic);
+		put_u64(data, payload.size());
+		put_u64(data, checksum(payload.data(), payload.size()));
+		data += payload;
+
+		// write aside and rename, so a crash leaves either the old or the new checkpoint
+		auto path = index_path(_dir);
+		auto tmp_path = path + ".tmp";
+		auto file = fopen(tmp_path.c_str(), "wb");
+		FC_ASSERT(file, "can't write state index ${path}", ("path", tmp_path));
+		auto written = fwrite(data.data(), 1, data.size(), file);
+		sync_file(file);
+		fclose(file);
+		FC_ASSERT(written == data.size(), "can't write state index ${path}", ("path", tmp_path));
+		fc::rename(fc::path(tmp_path), fc::path(path));
+		_commits_since_checkpoint = 0;
+	}
+
+	void state_db::set_checkpoint_interval(size_t commits_count) {
+		_checkpoint_interval = std::max<size_t>(commits_count, 1);
+	}
+
+	void state_db::read_at(uint64_t offset, size_t size, std::string& out) const {
+		out.resize(size);
+		if (size == 0)
+			return;
+		FC_ASSERT(seek_file(_log, offset) == 0 && fread(&out[0], 1, size, _log) == size,
+			"can't read state log at ${offset}", ("offset", offset));
+	}
+
+	uint64_t state_db::read_record(uint64_t offset, std::string& payload) const {
+		if (_log_size - offset < record_header_size)
+			return 0;
+		std::string header_data;
+		read_at(offset, record_header_size, header_data);
+		bytes_reader header(header_data);
+		auto magic = header.u32();
+		auto payload_size = header.u32();
+		auto payload_checksum = header.u64();
+		if (magic != state_log_magic || _log_size - offset - record_header_size < payload_size)
+			return 0;
+		read_at(offset + record_header_size, payload_size, payload);
+		if (checksum(payload.data(), payload.size()) != payload_checksum)
+			return 0;
+		return record_header_size + payload_size;
+	}
+
+	void state_db::index_record(uint64_t offset, const std::string& payload) {
+		bytes_reader reader(payload);
+		auto type = reader.u8();
+		auto block_number = reader.u64();
+		std::vector<state_db_write> writes;
+		std::vector<size_t> value_positions;
+		FC_ASSERT(read_writes(reader, writes, &value_positions), "invalid state log record at ${offset}", ("offset", offset));
+		for (size_t i = 0; i < writes.size(); i++) {
+			const auto& write = writes[i];
+			if (write.erased) {
+				_index.erase(write.key);
+				continue;
+			}
+			value_location location;
+			location.offset = offset + record_header_size + value_positions[i];
+			location.size = uint32_t(write.value.size());
+			_index[write.key] = location;
+		}
+		if (type == commit_record_type) {
+			block_record blk;
+			blk.block_number = block_number;
+			blk.offset = offset;
+			_blocks.push_back(blk);
+		}
+		else {
+			while (!_blocks.empty() && _blocks.back().block_number > block_number)
+				_blocks.pop_back();
+		}
+	}
+
+	void state_db::replay_log(uint64_t from_offset) {
+		auto offset = from_offset;
+		std::string payload;
+		while (offset < _log_size) {
+			auto record_size = read_record(offset, payload);
+			if (record_size == 0)
+				break;
+			index_record(offset, payload);
+			offset += record_size;
+		}
+		if (offset < _log_size) {
+			// drop the record torn by a crash, it was never acknowledged
+			auto path = log_path(_dir);
+			fclose(_log);
+			fc::resize_file(fc::path(path), size_t(offset));
+			_log = fopen(path.c_str(), "a+b");
+			FC_ASSERT(_log, "can't open state log ${path}", ("path", path));
+			_log_size = offset;
+		}
+	}
+
+	void state_db::append_record(const std::string& payload) {
+		FC_ASSERT(_log, "state db not open");
+		std::string record;
+		put_u32(record, state_log_magic);
+		put_u32(record, uint32_t(payload.size()));
+		put_u64(record, checksum(payload.data(), payload.size()));
+		record += payload;
+		// the log is opened for append, but a read must not be directly followed by a write
+		seek_file(_log, _log_size);
+		auto written = fwrite(record.data(), 1, record.size(), _log);
+		sync_file(_log);
+		if (written != record.size()) {
+			// the torn record is dropped when reopening
+			fclose(_log);
+			_log = nullptr;
+			FC_THROW("can't append to state log in ${dir}, reopen the state db", ("dir", _dir));
+		}
+		index_record(_log_size, payload);
+		_log_size += record.size();
+	}
+
+	void state_db::commit_block(uint64_t block_number, const std::vector<state_db_write>& writes, const std::vector<state_db_write>& undo) {
+		FC_ASSERT(empty() || block_number > head_block_number(), "block ${num} already committed", ("num", block_number));
+		std::string payload;
+		put_u8(payload, commit_record_type);
+		put_u64(payload, block_number);
+		put_writes(payload, writes);
+		put_writes(payload, undo);
+		append_record(payload);
+		if (++_commits_since_checkpoint >= _checkpoint_interval)
+			checkpoint();
+	}
+
+	std::vector<state_db_write> state_db::rollback_blocks(size_t blocks_count) {
+		FC_ASSERT(blocks_count <= rollbackable_blocks(), "only ${count} blocks can be rolled back", ("count", rollbackable_blocks()));
+		std::vector<state_db_write> restore_writes;
+		if (blocks_count == 0)
+			return restore_writes;
+		// from the head block down, so the value before the oldest rolled back block wins
+		std::map<std::string, state_db_write> restore;
+		for (size_t i = 0; i < blocks_count; i++) {
+			const auto& blk = _blocks[_blocks.size() - 1 - i];
+			std::string payload;
+			FC_ASSERT(read_record(blk.offset, payload) > 0, "state log record of block ${num} corrupted", ("num", blk.block_number));
+			bytes_reader reader(payload);
+			reader.u8();
+			reader.u64();
+			std::vector<state_db_write> writes;
+			std::vector<state_db_write> undo;
+			FC_ASSERT(read_writes(reader, writes, nullptr) && read_writes(reader, undo, nullptr),
+				"state log record of block ${num} corrupted", ("num", blk.block_number));
+			for (auto& write : undo) {
+				restore[write.key] = std::move(write);
+			}
+		}
+		for (auto& p : restore) {
+			restore_writes.push_back(std::move(p.second));
+		}
+		std::string payload;
+		put_u8(payload, rollback_record_type);
+		put_u64(payload, _blocks[_blocks.size() - 1 - blocks_count].block_number);
+		put_writes(payload, restore_writes);
+		put_writes(payload, std::vector<state_db_write>());
+		append_record(payload);
+		return restore_writes;
+	}
+
+	bool state_db::get(const std::string& key, std::string& value) const {
+		auto it = _index.find(key);
+		if (it == _index.end())
+			return false;
+		read_at(it->second.offset, it->second.size, value);
+		return true;
+	}
+
+	void state_db::visit(const std::function<void(const std::string& key, const std::string& value)>& visitor) const {
+		std::vector<std::pair<value_location, const std::string*> > locations;
+		locations.reserve(_index.size());
+		for (const auto& p : _index) {
+			locations.push_back(std::make_pair(p.second, &p.first));
+		}
+		std::sort(locations.begin(), locations.end(), [](const std::pair<value_location, const std::string*>& a, const std::pair<value_location, const std::string*>& b) {
+			return a.first.offset < b.first.offset;
+		});
+		std::string value;
+		for (const auto& p : locations) {
+			read_at(p.first.offset, p.first.size, value);
+			visitor(*p.second, value);
+		}
+	}
+}
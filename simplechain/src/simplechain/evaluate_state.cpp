@@ -16,7 +16,7 @@ namespace simplechain {
 	transaction* evaluate_state::get_current_tx() const {
 		return current_tx;
 	}
-	StorageDataType evaluate_state::get_storage(const std::string& contract_address, const std::string& key) const {
+	const StorageDataType& evaluate_state::get_storage(const std::string& contract_address, const std::string& key) const {
 		// TODO: read from parent evaluate_state first
 		auto it1 = invoke_contract_result.storage_changes.find(contract_address);
 		if (it1 != invoke_contract_result.storage_changes.end()) {
@@ -30,7 +30,7 @@ namespace simplechain {
 		return chain->get_storage(contract_address, key);
 	}
 
-	std::map<std::string, StorageDataType> evaluate_state::get_contract_storages(const std::string& contract_addr) const {
+	const std::map<std::string, StorageDataType>& evaluate_state::get_contract_storages(const std::string& contract_addr) const {
 		return chain->get_contract_storages(contract_addr);
 	}
 
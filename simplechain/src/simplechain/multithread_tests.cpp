@@ -0,0 +1,285 @@
+#include <simplechain/multithread_tests.h>
+#include <fc/io/json.hpp>
+#include <fc/crypto/sha256.hpp>
+#include <fc/crypto/hex.hpp>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace simplechain {
+	using namespace std;
+
+	struct token_contract_run_result {
+		bool ok = false;
+		std::string error;
+		balance_t caller_balance = 0;
+		uint64_t head_block_number = 0;
+		std::map<std::string, StorageDataType> storages;
+	};
+
+	// deploy the token contract on a new blockchain, init it and make transfers_count transfers.
+	// op and tx times are fixed so every run produces the same contract address and storages
+	static token_contract_run_result run_token_contract(const std::string& token_gpc_filepath, size_t transfers_count) {
+		token_contract_run_result result;
+		try {
+			auto chain = std::make_shared<simplechain::blockchain>();
+			std::string caller_addr = std::string(SIMPLECHAIN_ADDRESS_PREFIX) + "caller1";
+			std::string caller2_addr = std::string(SIMPLECHAIN_ADDRESS_PREFIX) + "caller2";
+			auto op_time = fc::time_point_sec(1536033055);
+
+			auto tx1 = std::make_shared<transaction>();
+			auto mint_op = operations_helper::mint(caller_addr, 0, 10000000);
+			mint_op.op_time = op_time;
+			tx1->operations.push_back(mint_op);
+			tx1->tx_time = op_time;
+			chain->accept_transaction_to_mempool(*tx1);
+
+			auto tx2 = std::make_shared<transaction>();
+			auto create_op = operations_helper::create_contract_from_file(caller_addr, token_gpc_filepath);
+			create_op.op_time = op_time;
+			tx2->operations.push_back(create_op);
+			tx2->tx_time = op_time;
+			auto contract_addr = create_op.calculate_contract_id();
+			chain->accept_transaction_to_mempool(*tx2);
+			chain->generate_block();
+
+			auto tx3 = std::make_shared<transaction>();
+			fc::variants init_args;
+			fc::variant init_arg;
+			fc::to_variant(std::string("test,TEST,100000000,10"), init_arg);
+			init_args.push_back(init_arg);
+			auto init_op = operations_helper::invoke_contract(caller_addr, contract_addr, "init_token", init_args);
+			init_op.op_time = op_time;
+			tx3->operations.push_back(init_op);
+			tx3->tx_time = op_time;
+			chain->accept_transaction_to_mempool(*tx3);
+			chain->generate_block();
+
+			for (size_t i = 0; i < transfers_count; i++) {
+				auto tx = std::make_shared<transaction>();
+				fc::variants args;
+				fc::variant arg;
+				fc::to_variant(caller2_addr + "," + std::to_string(i + 1), arg);
+				args.push_back(arg);
+				auto op = operations_helper::invoke_contract(caller_addr, contract_addr, "transfer", args);
+				op.op_time = op_time;
+				tx->operations.push_back(op);
+				tx->tx_time = op_time;
+				chain->accept_transaction_to_mempool(*tx);
+			}
+			chain->generate_block();
+
+			FC_ASSERT(chain->get_contract_by_address(contract_addr), "token contract not created");
+			FC_ASSERT(chain->get_tx_mempool().empty(), "some txs failed");
+			result.caller_balance = chain->get_account_asset_balance(caller_addr, 0);
+			result.head_block_number = chain->head_block_number();
+			result.storages = chain->get_contract_storages(contract_addr);
+			result.ok = true;
+		}
+		catch (const fc::exception& e) {
+			result.error = e.to_detail_string();
+		}
+		catch (const std::exception& e) {
+			result.error = e.what();
+		}
+		return result;
+	}
+
+	static bool same_token_contract_run_result(const token_contract_run_result& a, const token_contract_run_result& b) {
+		if (!a.ok || !b.ok)
+			return false;
+		if (a.caller_balance != b.caller_balance || a.head_block_number != b.head_block_number)
+			return false;
+		if (a.storages.size() != b.storages.size())
+			return false;
+		for (auto it1 = a.storages.begin(), it2 = b.storages.begin(); it1 != a.storages.end(); ++it1, ++it2) {
+			if (it1->first != it2->first || it1->second.storage_data != it2->second.storage_data)
+				return false;
+		}
+		return true;
+	}
+
+	bool test_token_contract_multithread(const std::string& token_gpc_filepath, size_t threads_count, size_t transfers_count) {
+		cout << "start test_token_contract_multithread" << endl;
+		auto expected = run_token_contract(token_gpc_filepath, transfers_count);
+		if (!expected.ok) {
+			cout << "serial run error " << expected.error << endl;
+			return false;
+		}
+		cout << "serial run done, " << expected.storages.size() << " storages" << endl;
+
+		std::vector<token_contract_run_result> results(threads_count);
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < threads_count; i++) {
+			threads.emplace_back([&results, i, &token_gpc_filepath, transfers_count]() {
+				results[i] = run_token_contract(token_gpc_filepath, transfers_count);
+			});
+		}
+		for (auto& t : threads) {
+			t.join();
+		}
+
+		bool all_same = true;
+		for (size_t i = 0; i < threads_count; i++) {
+			if (!results[i].ok) {
+				cout << "thread " << i << " error " << results[i].error << endl;
+				all_same = false;
+			}
+			else if (!same_token_contract_run_result(results[i], expected)) {
+				cout << "thread " << i << " result differs from the serial run" << endl;
+				all_same = false;
+			}
+		}
+		cout << "test_token_contract_multithread " << (all_same ? "passed" : "failed") << " on " << threads_count << " threads" << endl;
+		return all_same;
+	}
+
+	static transaction make_token_transfer_tx(const std::string& from_addr, const std::string& contract_addr,
+		const std::string& to_addr, size_t amount, fc::time_point_sec op_time, int32_t tx_nonce) {
+		transaction tx;
+		tx.tx_nonce = tx_nonce;
+		fc::variants args;
+		fc::variant arg;
+		fc::to_variant(to_addr + "," + std::to_string(amount), arg);
+		args.push_back(arg);
+		auto op = operations_helper::invoke_contract(from_addr, contract_addr, "transfer", args);
+		op.op_time = op_time;
+		tx.operations.push_back(op);
+		tx.tx_time = op_time;
+		return tx;
+	}
+
+	// receipts json of the txs of the head block
+	static std::string head_block_receipts_json(blockchain& chain) {
+		std::string receipts;
+		auto blk = chain.get_block_by_number(chain.head_block_number() - 1);
+		for (const auto& tx : blk->txs) {
+			auto receipt = chain.get_tx_receipt(tx.tx_hash());
+			receipts += receipt ? fc::json::to_string(receipt->to_json()) : std::string("null");
+			receipts += "\n";
+		}
+		return receipts;
+	}
+
+	// sha256 of the balances, contract storages, block txs and receipts of the chain.
+	// block times (and so block hashes) are left out, they differ between two runs
+	static std::string state_root(blockchain& chain) {
+		std::string state;
+		for (const auto& addr : chain.get_account_addresses()) {
+			for (const auto& p : chain.get_account_balances(addr)) {
+				state += addr + "\n" + std::to_string(p.first) + "\n" + std::to_string(p.second) + "\n";
+			}
+		}
+		for (const auto& contract : chain.get_contracts()) {
+			for (const auto& p : chain.get_contract_storages(contract.contract_address)) {
+				state += contract.contract_address + "\n" + p.first + "\n"
+					+ fc::to_hex(p.second.storage_data) + "\n";
+			}
+		}
+		for (uint64_t i = 0; i < chain.head_block_number(); i++) {
+			auto blk = chain.get_block_by_number(i);
+			for (const auto& tx : blk->txs) {
+				auto receipt = chain.get_tx_receipt(tx.tx_hash());
+				state += tx.tx_hash() + "\n" + (receipt ? fc::json::to_string(receipt->to_json()) : std::string("null")) + "\n";
+			}
+		}
+		return fc::sha256::hash(state).str();
+	}
+
+	struct token_block_bench_result {
+		std::vector<std::string> blocks_receipts;
+		std::string state_root;
+		double independent_seconds = 0;
+		double contended_seconds = 0;
+	};
+
+	// one block of transfers_count transfers between distinct users and one block of transfers_count transfers from the same user
+	static token_block_bench_result run_token_blocks(const std::string& token_gpc_filepath, size_t transfers_count, size_t threads_count) {
+		token_block_bench_result result;
+		blockchain chain;
+		chain.set_block_execution_threads(threads_count);
+		std::string caller_addr = std::string(SIMPLECHAIN_ADDRESS_PREFIX) + "caller1";
+		auto op_time = fc::time_point_sec(1536033055);
+		// tx nonces are taken from a process wide counter by default, fix them so both runs have the same tx hashes
+		int32_t tx_nonce = 0;
+
+		transaction tx1;
+		tx1.tx_nonce = tx_nonce++;
+		auto mint_op = operations_helper::mint(caller_addr, 0, 10000000);
+		mint_op.op_time = op_time;
+		tx1.operations.push_back(mint_op);
+		tx1.tx_time = op_time;
+		chain.accept_transaction_to_mempool(tx1);
+		transaction tx2;
+		tx2.tx_nonce = tx_nonce++;
+		auto create_op = operations_helper::create_contract_from_file(caller_addr, token_gpc_filepath);
+		create_op.op_time = op_time;
+		tx2.operations.push_back(create_op);
+		tx2.tx_time = op_time;
+		auto contract_addr = create_op.calculate_contract_id();
+		chain.accept_transaction_to_mempool(tx2);
+		chain.generate_block();
+
+		transaction tx3;
+		tx3.tx_nonce = tx_nonce++;
+		fc::variants init_args;
+		fc::variant init_arg;
+		fc::to_variant(std::string("test,TEST,100000000000,10"), init_arg);
+		init_args.push_back(init_arg);
+		auto init_op = operations_helper::invoke_contract(caller_addr, contract_addr, "init_token", init_args);
+		init_op.op_time = op_time;
+		tx3.operations.push_back(init_op);
+		tx3.tx_time = op_time;
+		chain.accept_transaction_to_mempool(tx3);
+		chain.generate_block();
+
+		auto user_addr = [](const char* name, size_t i) { return std::string(SIMPLECHAIN_ADDRESS_PREFIX) + name + std::to_string(i); };
+		for (size_t i = 0; i < transfers_count; i++) {
+			chain.accept_transaction_to_mempool(make_token_transfer_tx(caller_addr, contract_addr, user_addr("user", i), 100000, op_time, tx_nonce++));
+		}
+		chain.generate_block();
+		result.blocks_receipts.push_back(head_block_receipts_json(chain));
+
+		for (size_t i = 0; i < transfers_count; i++) {
+			chain.accept_transaction_to_mempool(make_token_transfer_tx(user_addr("user", i), contract_addr, user_addr("receiver", i), i + 1, op_time, tx_nonce++));
+		}
+		auto start = std::chrono::steady_clock::now();
+		chain.generate_block();
+		result.independent_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		result.blocks_receipts.push_back(head_block_receipts_json(chain));
+
+		for (size_t i = 0; i < transfers_count; i++) {
+			chain.accept_transaction_to_mempool(make_token_transfer_tx(caller_addr, contract_addr, user_addr("receiver", i), i + 1, op_time, tx_nonce++));
+		}
+		start = std::chrono::steady_clock::now();
+		chain.generate_block();
+		result.contended_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		result.blocks_receipts.push_back(head_block_receipts_json(chain));
+
+		FC_ASSERT(chain.get_tx_mempool().empty(), "some txs failed");
+		result.state_root = state_root(chain);
+		return result;
+	}
+
+	bool test_parallel_block_execution(const std::string& token_gpc_filepath, size_t transfers_count) {
+		try {
+			cout << "start test_parallel_block_execution" << endl;
+			auto threads_count = std::max<size_t>(std::thread::hardware_concurrency(), 2);
+			auto serial = run_token_blocks(token_gpc_filepath, transfers_count, 1);
+			auto parallel = run_token_blocks(token_gpc_filepath, transfers_count, threads_count);
+			bool same = serial.blocks_receipts == parallel.blocks_receipts && serial.state_root == parallel.state_root;
+			cout << "state root: serial " << serial.state_root << ", " << threads_count << " threads " << parallel.state_root << endl;
+			cout << transfers_count << " independent token transfers: serial " << transfers_count / serial.independent_seconds
+				<< " tx/s, " << threads_count << " threads " << transfers_count / parallel.independent_seconds << " tx/s" << endl;
+			cout << transfers_count << " contended token transfers: serial " << transfers_count / serial.contended_seconds
+				<< " tx/s, " << threads_count << " threads " << transfers_count / parallel.contended_seconds << " tx/s" << endl;
+			cout << "test_parallel_block_execution " << (same ? "passed" : "failed, parallel block differs from the serial block") << endl;
+			return same;
+		}
+		catch (const std::exception& e) {
+			cout << "error " << e.what() << endl;
+			return false;
+		}
+	}
+}
@@ -24,6 +24,7 @@ namespace simplechain {
 	{ "invoke_contract_offline", &invoke_contract_offline },
 	{ "exit", &exit_chain },
 	{ "generate_block", &generate_block },
+	{ "rollback_blocks", &rollback_blocks },
 	{ "get_block_by_height", &get_block_by_height },
 	{ "get_tx", &get_tx },
 	{ "get_tx_receipt", &get_tx_receipt },
@@ -34,6 +35,7 @@ namespace simplechain {
 	{ "get_contract_info", &get_contract_info },
 	{ "get_account_balances", &get_account_balances },
 	{ "get_contract_storages", &get_contract_storages },
+	{ "get_contract_storages_page", &get_contract_storages_page },
 	{ "get_storage", &get_storage },
 	{ "add_asset", &add_asset },
     { "generate_key", &generate_key },
@@ -6,6 +6,10 @@
 #include <cbor_diff/cbor_diff.h>
 #include <cbor_diff/cbor_diff_tests.h>
 #include <simplechain/native_contract_tests.h>
+#include <simplechain/multithread_tests.h>
+#include <simplechain/state_db_tests.h>
+#include <simplechain/chain_lookup_tests.h>
+#include <simplechain/storage_diff_tests.h>
 
 using namespace simplechain;
 #ifndef RUN_BOOST_TESTS
@@ -15,8 +19,64 @@ int main(int argc, char** argv) {
 	// cbor_diff::test_cbor_diff();
 	// cbor_diff::test_cbor_json();
 	// test_token_native_contract();
+	if (argc >= 3 && std::string(argv[1]) == "test_multithread") {
+		// simplechain_runner test_multithread <token.gpc path> [threads count]
+		size_t threads_count = argc > 3 ? size_t(std::atoi(argv[3])) : 8;
+		return test_token_contract_multithread(argv[2], threads_count) ? 0 : 1;
+	}
+	if (argc >= 3 && std::string(argv[1]) == "test_parallel_block") {
+		// simplechain_runner test_parallel_block <token.gpc path> [transfers count]
+		size_t transfers_count = argc > 3 ? size_t(std::atoi(argv[3])) : 2000;
+		return test_parallel_block_execution(argv[2], transfers_count) ? 0 : 1;
+	}
+	if (argc >= 3 && std::string(argv[1]) == "test_state_db") {
+		// simplechain_runner test_state_db <token.gpc path>
+		return test_state_db(argv[2]) ? 0 : 1;
+	}
+	if (argc >= 2 && std::string(argv[1]) == "bench_state_db") {
+		// simplechain_runner bench_state_db [storages count] [storages per block]
+		size_t keys_count = argc > 2 ? size_t(std::atol(argv[2])) : 1000000;
+		size_t keys_per_block = argc > 3 ? size_t(std::atol(argv[3])) : 10000;
+		bench_state_db(keys_count, keys_per_block);
+		return 0;
+	}
+	if (argc >= 2 && std::string(argv[1]) == "bench_cbor") {
+		// simplechain_runner bench_cbor [entries count] [rounds]
+		size_t entries_count = argc > 2 ? size_t(std::atol(argv[2])) : 100000;
+		size_t rounds = argc > 3 ? size_t(std::atol(argv[3])) : 5;
+		// the lua states the storage values are decoded in are closed through the chain api a blockchain sets
+		simplechain::blockchain chain;
+		cbor_diff::bench_cbor_documents(entries_count, rounds);
+		return 0;
+	}
+	if (argc >= 2 && std::string(argv[1]) == "bench_cbor_patch") {
+		// simplechain_runner bench_cbor_patch [entries count] [diffs count]
+		size_t entries_count = argc > 2 ? size_t(std::atol(argv[2])) : 100000;
+		size_t diffs_count = argc > 3 ? size_t(std::atol(argv[3])) : 1000;
+		cbor_diff::bench_cbor_diff_patch(entries_count, diffs_count);
+		return 0;
+	}
+	if (argc >= 2 && std::string(argv[1]) == "test_cbor") {
+		// simplechain_runner test_cbor
+		simplechain::blockchain chain;
+		return (cbor_diff::test_cbor_type_checks() & cbor_diff::test_cbor_encoding() & cbor_diff::test_cbor_patch_rollback()) ? 0 : 1;
+	}
+	if (argc >= 2 && std::string(argv[1]) == "test_storage_diff") {
+		// simplechain_runner test_storage_diff [pairs count]
+		size_t pairs_count = argc > 2 ? size_t(std::atol(argv[2])) : 200000;
+		return test_storage_diff_by_items(pairs_count) ? 0 : 1;
+	}
+	if (argc >= 2 && std::string(argv[1]) == "test_chain_lookups") {
+		// simplechain_runner test_chain_lookups [blocks count]
+		size_t blocks_count = argc > 2 ? size_t(std::atol(argv[2])) : 100000;
+		return test_chain_lookups(blocks_count) ? 0 : 1;
+	}
 	try {
 		auto chain = std::make_shared<simplechain::blockchain>();
+		if (argc >= 3 && std::string(argv[1]) == "--data-dir") {
+			// simplechain_runner --data-dir <dir>: keep the chain state in dir across restarts
+			chain->open_state_db(argv[2]);
+		}
 
 		if (argc == 2) {
 			// TODO: remove this demo code
@@ -36,14 +36,23 @@
 namespace simplechain {
 	using namespace uvm::lua::api;
 
-			static int has_error = 0;
+			// exception mark is kept per lua_State, so vms on other threads are not affected
+			static bool has_error(lua_State *L)
+			{
+				return L->state_context->has_exception;
+			}
+
+			static void set_has_error(lua_State *L, bool value)
+			{
+				L->state_context->has_exception = value;
+			}
 
 			/**
 			* whether exception happen in L
 			*/
 			bool SimpleChainUvmChainApi::has_exception(lua_State *L)
 			{
-				return has_error ? true : false;
+				return has_error(L);
 			}
 
 			/**
@@ -51,7 +60,7 @@ namespace simplechain {
 			*/
 			void SimpleChainUvmChainApi::clear_exceptions(lua_State *L)
 			{
-				has_error = 0;
+				set_has_error(L, false);
 			}
 
 			/**
@@ -63,9 +72,9 @@ namespace simplechain {
 			*/
 			void SimpleChainUvmChainApi::throw_exception(lua_State *L, int code, const char *error_format, ...)
 			{
-				if (has_error)
+				if (has_error(L))
 					return;
-				has_error = 1;
+				set_has_error(L, true);
 				char *msg = (char*)lua_malloc(L, LUA_EXCEPTION_MULTILINE_STRNG_MAX_LENGTH);
 				if (msg) {
 					memset(msg, 0x0, LUA_EXCEPTION_MULTILINE_STRNG_MAX_LENGTH);
@@ -367,10 +376,6 @@ namespace simplechain {
 				return nullptr;
             }
 
-            // storage,mapkey contract_id + "$" + storage_name
-            // TODO: lua_closepost_callback，
-            static std::map<lua_State *, std::shared_ptr<std::map<std::string, UvmStorageValue>>> _demo_chain_storage_buffer;
-
 			UvmStorageValue SimpleChainUvmChainApi::get_storage_value_from_uvm(lua_State *L, const char *contract_name, const std::string& name,
 				const std::string& fast_map_key, bool is_fast_map)
 			{
@@ -499,7 +504,7 @@ namespace simplechain {
 						key = name + "." + fast_map_key;
 					}
 					
-					auto storage_data = evaluator->get_storage(contract_id, key);
+					const auto& storage_data = evaluator->get_storage(contract_id, key);
 					return StorageDataType::create_lua_storage_from_storage_data(L, storage_data);
 				}
 				catch (...) {
@@ -573,7 +578,7 @@ namespace simplechain {
 					if (use_cbor_diff_flag) {
 						auto nested_changes_cbor = cbor::CborObject::create_map(nested_changes);
 						const auto& changes_parsed_to_array = nested_cbor_object_to_array(nested_changes_cbor.get());
-						changes_size = cbor_diff::cbor_encode(changes_parsed_to_array).size();
+						changes_size = cbor::encoder::encoded_size(changes_parsed_to_array.get());
 					}
 					/*else {
 						const auto& changes_parsed_to_array = nested_json_object_to_array(json_nested_changes);
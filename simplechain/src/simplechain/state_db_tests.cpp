@@ -0,0 +1,204 @@
+#include <simplechain/state_db_tests.h>
+#include <fc/io/json.hpp>
+#include <fc/crypto/hex.hpp>
+#include <cbor_diff/cbor_diff.h>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+namespace simplechain {
+	using namespace std;
+
+	static void accept_token_transfer(blockchain& chain, const std::string& from_addr, const std::string& contract_addr,
+		const std::string& to_addr, size_t amount, fc::time_point_sec op_time) {
+		transaction tx;
+		fc::variants args;
+		fc::variant arg;
+		fc::to_variant(to_addr + "," + std::to_string(amount), arg);
+		args.push_back(arg);
+		auto op = operations_helper::invoke_contract(from_addr, contract_addr, "transfer", args);
+		op.op_time = op_time;
+		tx.operations.push_back(op);
+		tx.tx_time = op_time;
+		chain.accept_transaction_to_mempool(tx);
+	}
+
+	// what the tests compare: the chain state json, the blocks and their receipts, the token contract and its storages
+	static std::string chain_state_snapshot(blockchain& chain, const std::string& contract_addr) {
+		std::string snapshot = chain.get_state_json();
+		for (uint64_t i = 0; i < chain.head_block_number(); i++) {
+			auto blk = chain.get_block_by_number(i);
+			snapshot += "\n" + blk->block_hash();
+			for (const auto& tx : blk->txs) {
+				auto receipt = chain.get_tx_receipt(tx.tx_hash());
+				snapshot += "\n" + (receipt ? fc::json::to_string(receipt->to_json()) : std::string("null"));
+			}
+		}
+		auto contract = chain.get_contract_by_address(contract_addr);
+		snapshot += "\n" + (contract ? contract->contract_address + " " + contract->code.code_hash : std::string("no contract"));
+		for (const auto& p : chain.get_contract_storages(contract_addr)) {
+			snapshot += "\n" + p.first + "=" + fc::to_hex(p.second.storage_data.data(), uint32_t(p.second.storage_data.size()));
+		}
+		return snapshot;
+	}
+
+	bool test_state_db(const std::string& token_gpc_filepath) {
+		cout << "start test_state_db" << endl;
+		auto dir = fc::temp_directory_path() / fc::unique_path();
+		bool ok = true;
+		auto check = [&ok](bool same, const char* what) {
+			if (!same) {
+				cout << what << " differs" << endl;
+				ok = false;
+			}
+		};
+		try {
+			std::string caller_addr = std::string(SIMPLECHAIN_ADDRESS_PREFIX) + "caller1";
+			std::string receiver_addr = std::string(SIMPLECHAIN_ADDRESS_PREFIX) + "receiver";
+			auto op_time = fc::time_point_sec(1536033055);
+			std::string contract_addr;
+			std::string before_last_block;
+			std::string at_last_block;
+			{
+				blockchain chain;
+				chain.open_state_db(dir.string());
+				transaction tx1;
+				auto mint_op = operations_helper::mint(caller_addr, 0, 10000000);
+				mint_op.op_time = op_time;
+				tx1.operations.push_back(mint_op);
+				tx1.tx_time = op_time;
+				chain.accept_transaction_to_mempool(tx1);
+				transaction tx2;
+				auto create_op = operations_helper::create_contract_from_file(caller_addr, token_gpc_filepath);
+				create_op.op_time = op_time;
+				tx2.operations.push_back(create_op);
+				tx2.tx_time = op_time;
+				contract_addr = create_op.calculate_contract_id();
+				chain.accept_transaction_to_mempool(tx2);
+				chain.generate_block();
+
+				transaction tx3;
+				fc::variants init_args;
+				fc::variant init_arg;
+				fc::to_variant(std::string("test,TEST,100000000,10"), init_arg);
+				init_args.push_back(init_arg);
+				auto init_op = operations_helper::invoke_contract(caller_addr, contract_addr, "init_token", init_args);
+				init_op.op_time = op_time;
+				tx3.operations.push_back(init_op);
+				tx3.tx_time = op_time;
+				chain.accept_transaction_to_mempool(tx3);
+				chain.generate_block();
+
+				for (size_t i = 0; i < 10; i++) {
+					accept_token_transfer(chain, caller_addr, contract_addr, receiver_addr + std::to_string(i), i + 1, op_time);
+				}
+				chain.generate_block();
+				before_last_block = chain_state_snapshot(chain, contract_addr);
+				for (size_t i = 0; i < 10; i++) {
+					accept_token_transfer(chain, caller_addr, contract_addr, receiver_addr + std::to_string(i), i + 100, op_time);
+				}
+				chain.generate_block();
+				FC_ASSERT(chain.get_tx_mempool().empty(), "some txs failed");
+				// the receipts kept in the db carry events and exec_succeed, which the snapshots compare
+				auto last_block = chain.get_block_by_number(chain.head_block_number() - 1);
+				auto receipt = chain.get_tx_receipt(last_block->txs[0].tx_hash());
+				FC_ASSERT(receipt && receipt->exec_succeed && !receipt->events.empty(), "token transfer receipt without events");
+				at_last_block = chain_state_snapshot(chain, contract_addr);
+			}
+			{
+				blockchain chain;
+				chain.open_state_db(dir.string());
+				check(chain_state_snapshot(chain, contract_addr) == at_last_block, "state reopened from the index checkpoint");
+			}
+			fc::remove(dir / "state.index");
+			{
+				blockchain chain;
+				chain.open_state_db(dir.string());
+				check(chain_state_snapshot(chain, contract_addr) == at_last_block, "state replayed from the whole log");
+			}
+			{
+				// the start of a record that a crash cut short
+				auto log = fopen((dir / "state.log").string().c_str(), "ab");
+				FC_ASSERT(log, "can't open the state log");
+				const char torn_record[] = "BDCS\x40\x00\x00\x00torn";
+				fwrite(torn_record, 1, sizeof(torn_record) - 1, log);
+				fclose(log);
+			}
+			{
+				blockchain chain;
+				chain.open_state_db(dir.string());
+				check(chain_state_snapshot(chain, contract_addr) == at_last_block, "state with a torn log record");
+				chain.rollback_blocks(1);
+				check(chain_state_snapshot(chain, contract_addr) == before_last_block, "state rolled back one block");
+				accept_token_transfer(chain, caller_addr, contract_addr, receiver_addr, 1000, op_time);
+				chain.generate_block();
+				check(chain.get_tx_mempool().empty(), "transfer after the rollback");
+				at_last_block = chain_state_snapshot(chain, contract_addr);
+			}
+			{
+				blockchain chain;
+				chain.open_state_db(dir.string());
+				check(chain_state_snapshot(chain, contract_addr) == at_last_block, "state reopened after the rollback");
+			}
+		}
+		catch (const fc::exception& e) {
+			cout << "error " << e.to_detail_string() << endl;
+			ok = false;
+		}
+		catch (const std::exception& e) {
+			cout << "error " << e.what() << endl;
+			ok = false;
+		}
+		fc::remove_all(dir);
+		cout << "test_state_db " << (ok ? "passed" : "failed") << endl;
+		return ok;
+	}
+
+	void bench_state_db(size_t keys_count, size_t keys_per_block) {
+		auto dir = fc::temp_directory_path() / fc::unique_path();
+		try {
+			std::string contract_addr = std::string(SIMPLECHAIN_CONTRACT_ADDRESS_PREFIX) + "bench";
+			size_t blocks_count = (keys_count + keys_per_block - 1) / keys_per_block;
+			double commit_seconds = 0;
+			{
+				blockchain chain;
+				chain.open_state_db(dir.string());
+				size_t key_index = 0;
+				for (size_t i = 0; i < blocks_count; i++) {
+					auto start = std::chrono::steady_clock::now();
+					for (size_t j = 0; j < keys_per_block && key_index < keys_count; j++, key_index++) {
+						StorageDataType value;
+						value.storage_data = cbor_diff::cbor_encode(cbor::CborObject::from_int(key_index));
+						chain.set_storage(contract_addr, "key" + std::to_string(key_index), value);
+					}
+					chain.generate_block();
+					commit_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				}
+			}
+			cout << blocks_count << " blocks of " << keys_per_block << " new storages: " << commit_seconds * 1000 / blocks_count
+				<< " ms per block, " << keys_count / commit_seconds << " keys/s" << endl;
+
+			auto start = std::chrono::steady_clock::now();
+			{
+				state_db db;
+				db.open(dir.string());
+				cout << "reopen state db of " << db.keys_count() << " keys: "
+					<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << endl;
+			}
+			start = std::chrono::steady_clock::now();
+			{
+				blockchain chain;
+				chain.open_state_db(dir.string());
+				cout << "load blockchain of " << chain.get_contract_storages(contract_addr).size() << " storages from the state db: "
+					<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << endl;
+			}
+		}
+		catch (const fc::exception& e) {
+			cout << "error " << e.to_detail_string() << endl;
+		}
+		catch (const std::exception& e) {
+			cout << "error " << e.what() << endl;
+		}
+		fc::remove_all(dir);
+	}
+}
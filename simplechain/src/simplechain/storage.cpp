@@ -236,11 +236,9 @@ namespace simplechain {
 	UvmStorageValue StorageDataType::create_lua_storage_from_storage_data(lua_State *L, const StorageDataType& storage)
 	{
 		const auto& storage_data = storage.storage_data;
-		auto cbor_value = cbor_decode(storage_data);
-		// printf("storage value: %s\n", cbor_value->str().c_str());
 		// auto json_value = json_from_str(storage_str);
 		// auto value = json_to_uvm_storage_value(L, json_value);
-		const auto& value = cbor_to_uvm_storage_value(L, cbor_value.get());
+		const auto& value = cbor_to_uvm_storage_value(L, storage_data.data(), storage_data.size());
 		return value;
 	}
 
@@ -0,0 +1,127 @@
+#include <simplechain/storage_diff_tests.h>
+#include <uvm/uvm_api.h>
+#include <cbor_diff/cbor_diff.h>
+#include <iostream>
+#include <iterator>
+#include <random>
+
+namespace simplechain {
+	using namespace std;
+	using uvm::blockchain::StorageValueTypes;
+
+	static char diff_test_strings[][4] = { "a", "b", "", "xyz" };
+
+	static UvmStorageValue random_scalar_storage_value(std::mt19937& rng) {
+		UvmStorageValue value;
+		switch (rng() % 6) {
+		case 0:
+			value.type = StorageValueTypes::storage_value_int;
+			value.value.int_value = lua_Integer(rng() % 5) - 2;
+			break;
+		case 1: {
+			const double numbers[] = { 0.5, 1e-20, 2e-20, -0.0, 0.0, 3.25 };
+			value.type = StorageValueTypes::storage_value_number;
+			value.value.number_value = numbers[rng() % 6];
+			break;
+		}
+		case 2:
+			value.type = StorageValueTypes::storage_value_bool;
+			value.value.bool_value = rng() % 2 != 0;
+			break;
+		case 3:
+		case 4:
+			value.type = StorageValueTypes::storage_value_string;
+			value.value.string_value = diff_test_strings[rng() % 4];
+			break;
+		default:
+			value.type = StorageValueTypes::storage_value_int;
+			value.value.int_value = lua_Integer(rng());
+		}
+		return value;
+	}
+
+	// table keys include names colliding with the diff keys of other items
+	static std::string random_storage_key(std::mt19937& rng, bool is_array, size_t index) {
+		if (is_array)
+			return std::to_string(index + 1);
+		const char* keys[] = { "a", "b", "c", "a__deleted", "b__added", "k1", "k10", "k2", "x" };
+		return keys[rng() % 9];
+	}
+
+	static UvmStorageValue random_storage_table(std::mt19937& rng, bool is_array) {
+		UvmStorageValue value;
+		value.type = is_array ? StorageValueTypes::storage_value_unknown_array : StorageValueTypes::storage_value_unknown_table;
+		value.value.table_value = new UvmTableMap();
+		size_t count = rng() % 8;
+		for (size_t i = 0; i < count; i++) {
+			(*value.value.table_value)[random_storage_key(rng, is_array, i)] = random_scalar_storage_value(rng);
+		}
+		return value;
+	}
+
+	// removes, adds or changes a few items, and sometimes turns a table into an array or the reverse
+	static UvmStorageValue mutate_storage_table(std::mt19937& rng, const UvmStorageValue& table, bool is_array) {
+		UvmStorageValue value = table;
+		value.value.table_value = new UvmTableMap(*table.value.table_value);
+		if (rng() % 10 == 0) {
+			value.type = is_array ? StorageValueTypes::storage_value_unknown_table : StorageValueTypes::storage_value_unknown_array;
+		}
+		auto& items = *value.value.table_value;
+		size_t changes_count = rng() % 4;
+		for (size_t i = 0; i < changes_count; i++) {
+			auto op = rng() % 3;
+			if (op == 0 && !items.empty()) {
+				auto it = items.begin();
+				std::advance(it, rng() % items.size());
+				items.erase(it);
+			}
+			else if (op == 1) {
+				items[random_storage_key(rng, is_array, items.size() + rng() % 2)] = random_scalar_storage_value(rng);
+			}
+			else if (!items.empty()) {
+				auto it = items.begin();
+				std::advance(it, rng() % items.size());
+				it->second = random_scalar_storage_value(rng);
+			}
+		}
+		return value;
+	}
+
+	bool test_storage_diff_by_items(size_t pairs_count) {
+		cout << "start test_storage_diff_by_items" << endl;
+		std::mt19937 rng(42);
+		size_t items_diff_count = 0;
+		size_t mismatches_count = 0;
+		try {
+			for (size_t i = 0; i < pairs_count; i++) {
+				bool is_array = rng() % 2 != 0;
+				auto before = random_storage_table(rng, is_array);
+				auto after = mutate_storage_table(rng, before, is_array);
+				cbor_diff::CborDiff differ;
+				auto full_diff = differ.diff(uvm_storage_value_to_cbor(before), uvm_storage_value_to_cbor(after));
+				auto items_diff = diff_storage_tables_by_items(before, after);
+				if (items_diff) {
+					items_diff_count++;
+					bool same = full_diff->is_undefined() == items_diff->is_undefined()
+						&& (full_diff->is_undefined() || cbor_diff::cbor_encode(full_diff->value()) == cbor_diff::cbor_encode(items_diff->value()));
+					if (!same) {
+						mismatches_count++;
+						if (mismatches_count <= 5)
+							cout << "diff mismatch: " << full_diff->str() << " | " << items_diff->str() << endl;
+					}
+				}
+				delete before.value.table_value;
+				delete after.value.table_value;
+			}
+		}
+		catch (const std::exception& e) {
+			cout << "test_storage_diff_by_items error: " << e.what() << endl;
+			return false;
+		}
+		cout << "pairs: " << pairs_count << ", diffed by items: " << items_diff_count << ", mismatches: " << mismatches_count << endl;
+		// most pairs must take the item diff path, or the test checks nothing
+		bool ok = mismatches_count == 0 && items_diff_count * 2 > pairs_count;
+		cout << "test_storage_diff_by_items " << (ok ? "passed" : "failed") << endl;
+		return ok;
+	}
+}
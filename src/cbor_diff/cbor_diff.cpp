@@ -3,6 +3,7 @@
 #include <uvm/uvm_lutil.h>
 #include <fc/crypto/hex.hpp>
 #include <boost/algorithm/hex.hpp>
+#include <set>
 
 namespace cbor_diff {
 
@@ -68,15 +69,58 @@ namespace cbor_diff {
 	}
 
 	cbor::CborObjectP cbor_decode(const std::vector<char>& input_bytes) {
-		std::vector<char> source(input_bytes);
-		cbor::input input(source.data(), source.size());
+		// the decoder only reads its input
+		cbor::input input(const_cast<char*>(input_bytes.data()), input_bytes.size());
 		cbor::decoder decoder(input);
 		auto result_cbor = decoder.run();
 		return result_cbor;
 	}
 
+	static cbor::CborObjectP clone_cbor_object(const cbor::CborObject* object) {
+		if (object->is_array()) {
+			const auto& items = object->as_array();
+			auto result = cbor::CborObject::create_array(items.size());
+			auto& result_items = result->as_mutable_array();
+			result_items.reserve(items.size());
+			for (const auto& item : items)
+				result_items.push_back(clone_cbor_object(item.get()));
+			return result;
+		}
+		else if (object->is_map()) {
+			const auto& items = object->as_map();
+			auto result = cbor::CborObject::create_map(items.size());
+			auto& result_items = result->as_mutable_map();
+			for (const auto& p : items)
+				result_items.emplace_hint(result_items.end(), p.first, clone_cbor_object(p.second.get()));
+			return result;
+		}
+		auto result = cbor::CborObject::create_null();
+		*result = *object;
+		return result;
+	}
+
 	cbor::CborObjectP cbor_deep_clone(cbor::CborObject* object) {
-		return cbor_decode(cbor_encode(*object));
+		// the clone's nodes come from one arena like a decoded document's
+		cbor::CborArenaScope arena_scope;
+		return clone_cbor_object(object);
+	}
+
+	// a node that is about to change in place. if another tree shares it, node is replaced by a copy first,
+	// the copy still shares its items
+	static cbor::CborObject* writable_node(cbor::CborObjectP& node) {
+		if (node.use_count() > 1)
+			node = std::make_shared<cbor::CborObject>(*node);
+		return node.get();
+	}
+
+	// "~" items of an array diff read the item of the old version, so the items must be kept while they change
+	static bool array_diff_has_modify_op(const cbor::CborArrayValue& diff_json_array) {
+		for (const auto& diff_item : diff_json_array) {
+			if (diff_item->is_array() && diff_item->as_array().size() == 3 && diff_item->as_array()[0]->is_string()
+				&& diff_item->as_array()[0]->as_string() == "~")
+				return true;
+		}
+		return false;
 	}
 
 	DiffResult::DiffResult()
@@ -175,7 +219,7 @@ namespace cbor_diff {
 					continue;
 				}
 				auto diff_item = diff_obj_array[i]->as_array();
-				if (diff_item.size() != 3)
+				if (diff_item.size() != 3 || !diff_item[0]->is_string())
 				{
 					ss << indents << "\t " << diff_obj_array[i]->str() << std::endl;
 					continue;
@@ -400,11 +444,16 @@ namespace cbor_diff {
 	// Ѿɰ汾json,ʹdiffõ°汾
 	// @throws CborDiffException
 	cbor::CborObjectP CborDiff::patch(const cbor::CborObjectP old_val, const DiffResultP diff_info) {
-		auto old_json_type = old_val->object_type();
+		auto result = old_val;
+		patch_inplace(result, diff_info);
+		return result;
+	}
+
+	void CborDiff::patch_inplace(cbor::CborObjectP& value, const DiffResultP diff_info) {
+		auto old_json_type = value->object_type();
 		const auto& diff_json = diff_info->value();
-		auto result = cbor_deep_clone(old_val.get());
 		if (diff_info->is_undefined() || diff_json.is_null())
-			return result;
+			return;
 
 
 		if (is_scalar_cbor_value_type(old_json_type) || is_scalar_cbor_value_diff_format(diff_json))
@@ -412,24 +461,26 @@ namespace cbor_diff {
 			if (!diff_json.is_map())
 				throw CborDiffException("wrong format of diffjson of scalar json value");
 			const auto& diff_map = diff_json.as_map();
-			result = diff_map.at(CBORDIFF_KEY_NEW_VALUE);
+			value = diff_map.at(CBORDIFF_KEY_NEW_VALUE);
 		}
 		else if (old_json_type == cbor::COT_MAP)
 		{
-			const auto& old_json_str = cbor_encode(old_val);
-			const auto& diff_json_str = cbor_encode(diff_json);
-			const auto& old_json_obj = old_val->as_map();
+			if (!diff_json.is_map())
+				throw CborDiffException("wrong format of diffjson of this old version json");
 			const auto& diff_json_obj = diff_json.as_map();
-			auto result_obj = result->as_map();
+			auto result = writable_node(value);
+			auto& result_obj = result->as_mutable_map();
+			// keys the old version didn't have and a <key>__added item put in, <key>__deleted only deletes keys of the old version
+			std::set<std::string> added_keys;
 			for (auto i = diff_json_obj.begin(); i != diff_json_obj.end(); i++)
 			{
-				auto key = i->first;
-				auto diff_item = i->second;
+				const auto& key = i->first;
+				const auto& diff_item = i->second;
 				// key <key>__deleted  <key>__addedɾӣ޸keyֵ
 				if (utils::string_ends_with(key, CBORDIFF_KEY_DELETED_POSTFIX) && key.size() > strlen(CBORDIFF_KEY_DELETED_POSTFIX))
 				{
 					auto old_key = utils::string_without_ext(key, CBORDIFF_KEY_DELETED_POSTFIX);
-					if (old_json_obj.find(old_key) != old_json_obj.end())
+					if (result_obj.find(old_key) != result_obj.end() && added_keys.find(old_key) == added_keys.end())
 					{
 						// ɾԲ
 						result_obj.erase(old_key);
@@ -440,24 +491,35 @@ namespace cbor_diff {
 				{
 					auto old_key = utils::string_without_ext(key, CBORDIFF_KEY_ADDED_POSTFIX);
 					// Բ
-					result_obj[old_key] = diff_item;
+					auto found = result_obj.find(old_key);
+					if (found == result_obj.end())
+					{
+						added_keys.insert(old_key);
+						result_obj.emplace(old_key, diff_item);
+					}
+					else
+						found->second = diff_item;
 					continue;
 				}
 				// ޸keyֵ
-				if (old_json_obj.find(key) == old_json_obj.end())
+				// (the items that add or delete a key sort after it, so the map still has the keys of the old version here)
+				auto found = result_obj.find(key);
+				if (found == result_obj.end())
 					throw CborDiffException("wrong format of diffjson of this old version json");
-				auto sub_item_new = patch(old_json_obj.at(key), std::make_shared<DiffResult>(*diff_item));
-				result_obj[key] = sub_item_new;
+				patch_inplace(found->second, std::make_shared<DiffResult>(*diff_item));
 			}
-			return cbor::CborObject::create_map(result_obj);
+			result->array_or_map_size = static_cast<uint32_t>(result_obj.size());
 		}
 		else if (old_json_type == cbor::COT_ARRAY)
 		{
-			const auto& old_json_str = cbor_encode(old_val);
-			const auto& diff_json_str = cbor_encode(diff_json);
-			const auto& old_json_array = old_val->as_array();
+			if (!diff_json.is_array())
+				throw CborDiffException("diffjson format error for array diff");
 			const auto& diff_json_array = diff_json.as_array();
-			auto result_array = result->as_array();
+			auto result = writable_node(value);
+			auto& result_array = result->as_mutable_array();
+			cbor::CborArrayValue old_json_array;
+			if (array_diff_has_modify_op(diff_json_array))
+				old_json_array = result_array;
 			for (size_t i = 0; i < diff_json_array.size(); i++)
 			{
 				if (!diff_json_array[i]->is_array())
@@ -465,9 +527,11 @@ namespace cbor_diff {
 				const auto& diff_item = diff_json_array[i]->as_array();
 				if (diff_item.size() != 3)
 					throw CborDiffException("diffjson format error for array diff");
-				auto op_item = diff_item[0]->as_string();
+				if (!diff_item[0]->is_string())
+					throw CborDiffException(std::string("not supported diff array op now: ") + diff_item[0]->str());
+				const auto& op_item = diff_item[0]->as_string();
 				auto pos = diff_item[1]->force_as_int();
-				auto inner_diff_json = diff_item[2];
+				const auto& inner_diff_json = diff_item[2];
 				// FIXME һarrayж仯ʱ diffԭʼindexӦҳ pos => old_jsonֵͬpos
 				if (op_item == std::string("+"))
 				{
@@ -482,21 +546,19 @@ namespace cbor_diff {
 				else if (op_item == std::string("~"))
 				{
 					// ޸Ԫ
-					auto sub_item_new = patch(old_json_array[i], std::make_shared<DiffResult>(*inner_diff_json));
-					result_array[pos] = sub_item_new;
+					result_array[pos] = patch(old_json_array[i], std::make_shared<DiffResult>(*inner_diff_json));
 				}
 				else
 				{
 					throw CborDiffException(std::string("not supported diff array op now: ") + op_item);
 				}
 			}
-			return cbor::CborObject::create_array(result_array);
+			result->array_or_map_size = static_cast<uint32_t>(result_array.size());
 		}
 		else
 		{
-			throw CborDiffException(std::string("not supported json value type to merge patch ") + old_val->str());
+			throw CborDiffException(std::string("not supported json value type to merge patch ") + value->str());
 		}
-		return result;
 	}
 
 	cbor::CborObjectP CborDiff::rollback_by_string(const std::string& new_hex, DiffResultP diff_info) {
@@ -506,11 +568,16 @@ namespace cbor_diff {
 	// °汾ʹdiffعɰ汾
 	// @throws CborDiffException
 	cbor::CborObjectP CborDiff::rollback(const cbor::CborObjectP new_val, DiffResultP diff_info) {
-		auto new_json_type = new_val->object_type();
-		auto diff_json = diff_info->value();
-		auto result = cbor_deep_clone(new_val.get());
+		auto result = new_val;
+		rollback_inplace(result, diff_info);
+		return result;
+	}
+
+	void CborDiff::rollback_inplace(cbor::CborObjectP& value, DiffResultP diff_info) {
+		auto new_json_type = value->object_type();
+		const auto& diff_json = diff_info->value();
 		if (diff_info->is_undefined() || diff_json.is_null())
-			return result;
+			return;
 
 
 		if (is_scalar_cbor_value_type(new_json_type) || is_scalar_cbor_value_diff_format(diff_json))
@@ -518,24 +585,26 @@ namespace cbor_diff {
 			if (!diff_json.is_map())
 				throw CborDiffException("wrong format of diffjson of scalar json value");
 			const auto& diff_map = diff_json.as_map();
-			result = diff_map.at(CBORDIFF_KEY_OLD_VALUE);
+			value = diff_map.at(CBORDIFF_KEY_OLD_VALUE);
 		}
 		else if (new_json_type == cbor::COT_MAP)
 		{
-			const auto& new_json_str = cbor_encode(new_val);
-			const auto& diff_json_str = cbor_encode(diff_json);
-			const auto& new_json_obj = new_val->as_map();
+			if (!diff_json.is_map())
+				throw CborDiffException("wrong format of diffjson of this old version json");
 			const auto& diff_json_obj = diff_json.as_map();
-			cbor::CborMapValue result_obj = result->as_map();
+			auto result = writable_node(value);
+			auto& result_obj = result->as_mutable_map();
 			for (auto i = diff_json_obj.begin(); i != diff_json_obj.end(); i++)
 			{
-				auto key = i->first;
-				auto diff_item = i->second;
+				const auto& key = i->first;
+				const auto& diff_item = i->second;
 				// key <key>__deleted  <key>__addedɾӣ޸keyֵ
+				// (the items of a key sort as <key>, <key>__added, <key>__deleted, so the map still has the keys of
+				// the new version when an item checks them)
 				if (utils::string_ends_with(key, CBORDIFF_KEY_ADDED_POSTFIX) && key.size() > strlen(CBORDIFF_KEY_ADDED_POSTFIX))
 				{
 					auto origin_key = utils::string_without_ext(key, CBORDIFF_KEY_ADDED_POSTFIX);
-					if (new_json_obj.find(origin_key) != new_json_obj.end())
+					if (result_obj.find(origin_key) != result_obj.end())
 					{
 						// ԲҪع
 						result_obj.erase(origin_key);
@@ -550,30 +619,35 @@ namespace cbor_diff {
 					continue;
 				}
 				// ޸keyֵ
-				if (new_json_obj.find(key) == new_json_obj.end())
+				auto found = result_obj.find(key);
+				if (found == result_obj.end())
 					throw CborDiffException("wrong format of diffjson of this old version json");
-				auto sub_item_new = rollback(new_json_obj.at(key), std::make_shared<DiffResult>(*diff_item));
-				result_obj[key] = sub_item_new;
+				rollback_inplace(found->second, std::make_shared<DiffResult>(*diff_item));
 			}
-			return cbor::CborObject::create_map(result_obj);
+			result->array_or_map_size = static_cast<uint32_t>(result_obj.size());
 		}
 		else if (new_json_type == cbor::COT_ARRAY)
 		{
-			const auto& new_json_str = cbor_encode(new_val);
-			const auto& diff_json_str = cbor_encode(diff_json);
-			const auto& new_json_array = new_val->as_array();
+			if (!diff_json.is_array())
+				throw CborDiffException("diffjson format error for array diff");
 			const auto& diff_json_array = diff_json.as_array();
-			cbor::CborArrayValue result_array = result->as_array();
+			auto result = writable_node(value);
+			auto& result_array = result->as_mutable_array();
+			cbor::CborArrayValue new_json_array;
+			if (array_diff_has_modify_op(diff_json_array))
+				new_json_array = result_array;
 			for (size_t i = 0; i < diff_json_array.size(); i++)
 			{
 				if (!diff_json_array[i]->is_array())
 					throw CborDiffException("diffjson format error for array diff");
-				auto diff_item = diff_json_array[i]->as_array();
+				const auto& diff_item = diff_json_array[i]->as_array();
 				if (diff_item.size() != 3)
 					throw CborDiffException("diffjson format error for array diff");
-				auto op_item = diff_item[0]->as_string();
+				if (!diff_item[0]->is_string())
+					throw CborDiffException(std::string("not supported diff array op now: ") + diff_item[0]->str());
+				const auto& op_item = diff_item[0]->as_string();
 				auto pos = diff_item[1]->force_as_int(); // posoldpos FIXME ¾ɶposһһ
-				auto inner_diff_json = diff_item[2];
+				const auto& inner_diff_json = diff_item[2];
 				// FIXME һarrayж仯ʱ diffԭʼindexӦҳ pos => old_jsonֵͬpos
 				if (op_item == std::string("-"))
 				{
@@ -588,21 +662,19 @@ namespace cbor_diff {
 				else if (op_item == std::string("~"))
 				{
 					// ޸Ԫ
-					auto sub_item_new = rollback(new_json_array[i], std::make_shared<DiffResult>(*inner_diff_json));
-					result_array[pos] = sub_item_new;
+					result_array[pos] = rollback(new_json_array[i], std::make_shared<DiffResult>(*inner_diff_json));
 				}
 				else
 				{
 					throw CborDiffException(std::string("not supported diff array op now: ") + op_item);
 				}
 			}
-			return cbor::CborObject::create_array(result_array);
+			result->array_or_map_size = static_cast<uint32_t>(result_array.size());
 		}
 		else
 		{
-			throw CborDiffException(std::string("not supported json value type to rollback diff from ") + cbor_to_hex(new_val));
+			throw CborDiffException(std::string("not supported json value type to rollback diff from ") + cbor_to_hex(value));
 		}
-		return result;
 	}
 
 }
\ No newline at end of file
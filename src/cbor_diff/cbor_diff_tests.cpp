@@ -5,6 +5,9 @@
 #include <uvm/uvm_storage.h>
 #include <uvm/uvm_lib.h>
 #include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <map>
 #include <fc/io/json.hpp>
 
 namespace cbor_diff {
@@ -203,4 +206,412 @@ namespace cbor_diff {
 			std::cout << "d1: " << d1->str() << " e1: " << e1->str() << " f1: " << f1->str() << " g1: " << g1->str() << " h1: " << h1->str() << std::endl;
 		}
 	}
+
+	// a contract storage like table: records of ints, short and long strings, a small array and a byte string
+	// (left out of documents for contract storages, which have no bytes type)
+	static CborObjectP make_bench_cbor_document(size_t entries_count, bool with_bytes = true) {
+		CborMapValue entries;
+		for (size_t i = 0; i < entries_count; i++) {
+			CborMapValue record;
+			record["id"] = CborObject::from_int(i);
+			record["owner"] = CborObject::from_string("SPLaddress" + std::to_string(i * 7919));
+			record["amount"] = CborObject::from_int(int64_t(i) * 100000007);
+			record["supply"] = CborObject::from_extra_integer((uint64_t(1) << 40) | i, true);
+			record["active"] = CborObject::from_bool(i % 2 == 0);
+			record["memo"] = CborObject::from_string("a memo longer than the short string buffer of the node " + std::to_string(i));
+			record["tags"] = CborObject::create_array({ CborObject::from_string("a"), CborObject::from_int(i), CborObject::create_null() });
+			if (with_bytes)
+				record["raw"] = CborObject::from_bytes(std::vector<char>(12, char(i)));
+			entries["key" + std::to_string(i)] = CborObject::create_map(record);
+		}
+		return CborObject::create_map(entries);
+	}
+
+	// counts the values of a document streamed through the decoder
+	class bench_cbor_counter : public cbor::listener {
+	public:
+		size_t values_count = 0;
+		size_t strings_size = 0;
+
+		void on_integer(CborIntValue value) override { values_count++; }
+		void on_extra_integer(CborExtraIntValue value, bool is_positive) override { values_count++; }
+		void on_float64(CborDoubleValue value) override { values_count++; }
+		void on_bytes(const char *data, size_t size) override { values_count++; strings_size += size; }
+		void on_string(const char *data, size_t size) override { values_count++; strings_size += size; }
+		void on_array(uint32_t size) override { values_count++; }
+		void on_map(uint32_t size) override { values_count++; }
+		void on_tag(CborTagValue tag) override { values_count++; }
+		void on_extra_tag(CborExtraIntValue tag) override { values_count++; }
+		void on_bool(bool value) override { values_count++; }
+		void on_null() override { values_count++; }
+		void on_undefined() override { values_count++; }
+	};
+
+	void bench_cbor_documents(size_t entries_count, size_t rounds) {
+		typedef std::chrono::steady_clock clock;
+		auto ms_per_round = [rounds](clock::time_point start) {
+			return std::chrono::duration<double, std::milli>(clock::now() - start).count() / rounds;
+		};
+		auto document = make_bench_cbor_document(entries_count);
+		auto encoded = cbor_encode(document);
+		if (cbor_encode(cbor_decode(encoded)) != encoded) {
+			cout << "bench_cbor_documents: decoded document differs" << endl;
+			return;
+		}
+		cout << entries_count << " entries, " << encoded.size() << " bytes of cbor, " << sizeof(CborObject) << " bytes per node" << endl;
+
+		auto start = clock::now();
+		for (size_t i = 0; i < rounds; i++) {
+			cbor_encode(document);
+		}
+		cout << "encode: " << ms_per_round(start) << " ms" << endl;
+
+		start = clock::now();
+		for (size_t i = 0; i < rounds; i++) {
+			cbor_decode(encoded);
+		}
+		cout << "decode and free: " << ms_per_round(start) << " ms" << endl;
+
+		start = clock::now();
+		for (size_t i = 0; i < rounds; i++) {
+			cbor_deep_clone(document.get());
+		}
+		cout << "deep clone and free: " << ms_per_round(start) << " ms" << endl;
+
+		start = clock::now();
+		for (size_t i = 0; i < rounds; i++) {
+			encoder::encoded_size(document.get());
+		}
+		cout << "encoded size: " << ms_per_round(start) << " ms" << endl;
+
+		start = clock::now();
+		for (size_t i = 0; i < rounds; i++) {
+			input in(encoded.data(), encoded.size());
+			decoder dec(in);
+			bench_cbor_counter counter;
+			dec.run(counter);
+		}
+		cout << "stream through decoder: " << ms_per_round(start) << " ms" << endl;
+
+		// contract storage values, from the decoded document and straight from the cbor bytes
+		auto storage_encoded = cbor_encode(make_bench_cbor_document(entries_count, false));
+		lua_State *L = uvm::lua::lib::create_lua_state();
+		auto from_document = cbor_to_uvm_storage_value(L, cbor_decode(storage_encoded).get());
+		auto from_bytes = cbor_to_uvm_storage_value(L, storage_encoded.data(), storage_encoded.size());
+		if (from_document.type != from_bytes.type
+			|| cbor_encode(uvm_storage_value_to_cbor(from_document)) != cbor_encode(uvm_storage_value_to_cbor(from_bytes))) {
+			cout << "bench_cbor_documents: storage values differ" << endl;
+		}
+		start = clock::now();
+		for (size_t i = 0; i < rounds; i++) {
+			cbor_to_uvm_storage_value(L, cbor_decode(storage_encoded).get());
+		}
+		cout << "decode to storage value through CborObject: " << ms_per_round(start) << " ms" << endl;
+		start = clock::now();
+		for (size_t i = 0; i < rounds; i++) {
+			cbor_to_uvm_storage_value(L, storage_encoded.data(), storage_encoded.size());
+		}
+		cout << "decode to storage value: " << ms_per_round(start) << " ms" << endl;
+		uvm::lua::lib::close_lua_state(L);
+	}
+
+	void bench_cbor_diff_patch(size_t entries_count, size_t diffs_count) {
+		typedef std::chrono::steady_clock clock;
+		auto ms_since = [](clock::time_point start) {
+			return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+		};
+		// the records of the first half get their amounts changed, the second half has the records to delete
+		size_t changed_count = entries_count / 2;
+		if (changed_count < diffs_count) {
+			cout << "bench_cbor_diff_patch: needs at least 2 entries per diff" << endl;
+			return;
+		}
+		auto document = make_bench_cbor_document(entries_count);
+		auto encoded = cbor_encode(document);
+		const auto& records = document->as_map();
+		std::vector<DiffResultP> diffs;
+		std::map<size_t, int64_t> amounts;
+		for (size_t i = 0; i < diffs_count; i++) {
+			size_t changed_index = (i * 7919) % changed_count;
+			auto amount = amounts.find(changed_index);
+			if (amount == amounts.end())
+				amount = amounts.emplace(changed_index, int64_t(changed_index) * 100000007).first;
+			CborMapValue diff;
+			diff["key" + std::to_string(changed_index)] = CborObject::create_map({
+				{ "amount", CborObject::create_map({
+					{ CBORDIFF_KEY_OLD_VALUE, CborObject::from_int(amount->second) },
+					{ CBORDIFF_KEY_NEW_VALUE, CborObject::from_int(amount->second + 1) } }) } });
+			amount->second++;
+			if (i % 10 == 0) {
+				diff["new" + std::to_string(i) + CBORDIFF_KEY_ADDED_POSTFIX] = CborObject::create_map({
+					{ "id", CborObject::from_int(entries_count + i) },
+					{ "owner", CborObject::from_string("SPLnewaddress" + std::to_string(i)) } });
+			}
+			else if (i % 10 == 5) {
+				auto deleted_key = "key" + std::to_string(changed_count + i);
+				diff[deleted_key + CBORDIFF_KEY_DELETED_POSTFIX] = records.at(deleted_key);
+			}
+			diffs.push_back(std::make_shared<DiffResult>(*CborObject::create_map(diff)));
+		}
+		cout << entries_count << " entries, " << encoded.size() << " bytes of cbor, " << diffs_count << " diffs" << endl;
+		CborDiff differ;
+
+		// what every patch and rollback paid for its deep clone before
+		size_t clone_rounds = 3;
+		auto start = clock::now();
+		for (size_t i = 0; i < clone_rounds; i++) {
+			cbor_decode(cbor_encode(document));
+		}
+		auto encode_decode_ms = ms_since(start) / clone_rounds;
+		cout << "clone by encode and decode: " << encode_decode_ms << " ms, " << encode_decode_ms * diffs_count << " ms for all diffs" << endl;
+		start = clock::now();
+		for (size_t i = 0; i < clone_rounds; i++) {
+			cbor_deep_clone(document.get());
+		}
+		cout << "deep clone: " << ms_since(start) / clone_rounds << " ms" << endl;
+
+		// patch keeps its input, so it copies the top map of the document
+		size_t patch_count = std::min<size_t>(diffs_count, 10);
+		auto patched = document;
+		start = clock::now();
+		for (size_t i = 0; i < patch_count; i++) {
+			patched = differ.patch(patched, diffs[i]);
+		}
+		auto patch_ms = ms_since(start) / patch_count;
+		cout << "patch: " << patch_ms << " ms per diff" << endl;
+		if (cbor_encode(document) != encoded) {
+			cout << "bench_cbor_diff_patch: patch changed its input" << endl;
+			return;
+		}
+
+		auto value = cbor_deep_clone(document.get());
+		start = clock::now();
+		for (const auto& diff : diffs) {
+			differ.patch_inplace(value, diff);
+		}
+		auto patch_inplace_ms = ms_since(start);
+		cout << "patch_inplace: " << patch_inplace_ms << " ms for all diffs, " << patch_inplace_ms * 1000 / diffs_count << " us per diff" << endl;
+		if (value->as_map().size() != entries_count + (diffs_count + 9) / 10 - (diffs_count + 4) / 10) {
+			cout << "bench_cbor_diff_patch: wrong count of records after patch_inplace" << endl;
+			return;
+		}
+		start = clock::now();
+		for (auto diff = diffs.rbegin(); diff != diffs.rend(); diff++) {
+			differ.rollback_inplace(value, *diff);
+		}
+		auto rollback_inplace_ms = ms_since(start);
+		cout << "rollback_inplace: " << rollback_inplace_ms << " ms for all diffs, " << rollback_inplace_ms * 1000 / diffs_count << " us per diff" << endl;
+		if (cbor_encode(value) != encoded) {
+			cout << "bench_cbor_diff_patch: rolled back document differs" << endl;
+		}
+	}
+	// true if f throws an exception of type E
+	template <typename E, typename F>
+	static bool throws(const F& f) {
+		try {
+			f();
+		}
+		catch (const E&) {
+			return true;
+		}
+		catch (...) {
+			return false;
+		}
+		return false;
+	}
+
+	bool test_cbor_type_checks() {
+		cout << "start test_cbor_type_checks" << endl;
+		bool ok = true;
+		auto check = [&ok](bool passed, const char* what) {
+			if (!passed) {
+				cout << what << " failed" << endl;
+				ok = false;
+			}
+		};
+		auto int_value = CborObject::from_int(123);
+		auto string_value = CborObject::from_string("hello");
+		auto map_value = CborObject::create_map({ { "a", CborObject::from_int(1) } });
+		auto null_value = CborObject::create_null();
+		check(throws<CborException>([&]() { int_value->as_string(); }), "as_string of an int");
+		check(throws<CborException>([&]() { int_value->as_array(); }), "as_array of an int");
+		check(throws<CborException>([&]() { int_value->as_map(); }), "as_map of an int");
+		check(throws<CborException>([&]() { int_value->as_bytes(); }), "as_bytes of an int");
+		check(throws<CborException>([&]() { string_value->as_int(); }), "as_int of a string");
+		check(throws<CborException>([&]() { map_value->as_mutable_array(); }), "as_mutable_array of a map");
+		check(throws<CborException>([&]() { null_value->as_float64(); }), "as_float64 of null");
+		check(throws<CborException>([&]() { null_value->as_bool(); }), "as_bool of null");
+
+		// scalars are copied by their type
+		std::vector<CborObjectP> scalars = { CborObject::from_bool(true), CborObject::from_int(-5), CborObject::from_extra_integer(UINT64_MAX, true),
+			CborObject::from_float64(1.5), CborObject::from_tag(24), CborObject::from_extra_tag(UINT64_MAX), CborObject::create_undefined(), null_value };
+		for (const auto& scalar : scalars) {
+			CborObject copied(*scalar);
+			auto assigned = CborObject::from_string("replaced");
+			*assigned = *scalar;
+			check(cbor_encode(std::make_shared<CborObject>(copied)) == cbor_encode(scalar) && cbor_encode(assigned) == cbor_encode(scalar), "copy of a scalar");
+		}
+
+		// array diff items whose op is not a string
+		CborDiff differ;
+		auto old_array = CborObject::create_array({ CborObject::from_int(1), CborObject::from_int(2) });
+		for (const auto& op : { int_value, map_value }) {
+			auto diff = std::make_shared<DiffResult>(*CborObject::create_array({
+				CborObject::create_array({ op, CborObject::from_int(0), CborObject::from_int(3) }) }));
+			check(throws<CborDiffException>([&]() { differ.patch(old_array, diff); }), "patch with a wrong array op");
+			check(throws<CborDiffException>([&]() { differ.rollback(old_array, diff); }), "rollback with a wrong array op");
+			auto value = old_array;
+			check(throws<CborDiffException>([&]() { differ.patch_inplace(value, diff); }), "patch_inplace with a wrong array op");
+			check(throws<CborDiffException>([&]() { differ.rollback_inplace(value, diff); }), "rollback_inplace with a wrong array op");
+			check(!throws<std::exception>([&]() { diff->pretty_str(); }), "pretty_str of a wrong array op");
+		}
+		cout << "test_cbor_type_checks " << (ok ? "passed" : "failed") << endl;
+		return ok;
+	}
+
+	bool test_cbor_encoding() {
+		cout << "start test_cbor_encoding" << endl;
+		bool ok = true;
+		auto check = [&ok](bool passed, const std::string& what) {
+			if (!passed) {
+				cout << what << " failed" << endl;
+				ok = false;
+			}
+		};
+		// values around each length of the head (inline, 1, 2, 4 and 8 bytes)
+		std::vector<CborObjectP> objects = { CborObject::create_null(), CborObject::create_undefined(),
+			CborObject::from_bool(true), CborObject::from_bool(false) };
+		for (int64_t n : { (int64_t)0, (int64_t)23, (int64_t)24, (int64_t)255, (int64_t)256, (int64_t)65535, (int64_t)65536,
+			(int64_t)4294967295LL, (int64_t)4294967296LL, INT64_MAX }) {
+			objects.push_back(CborObject::from_int(n));
+			objects.push_back(CborObject::from_int(-n - 1));
+		}
+		for (bool sign : { false, true }) {
+			objects.push_back(CborObject::from_extra_integer(UINT64_MAX, sign));
+			objects.push_back(CborObject::from_extra_integer((uint64_t)INT64_MAX + 1, sign));
+		}
+		for (double d : { 0.0, -1.5, 0.1, 1e300, -2.5e-300 }) {
+			objects.push_back(CborObject::from_float64(d));
+		}
+		for (size_t len : { 0, 23, 24, 255, 256, 65536 }) {
+			objects.push_back(CborObject::from_string(std::string(len, 'a')));
+			objects.push_back(CborObject::from_bytes(CborBytesValue(len, 'b')));
+		}
+		for (uint64_t tag : { 0, 24, 256 }) {
+			objects.push_back(CborObject::from_tag((CborTagValue)tag));
+			objects.push_back(CborObject::from_extra_tag(tag));
+		}
+		objects.push_back(CborObject::create_array(CborArrayValue()));
+		objects.push_back(CborObject::create_map(CborMapValue()));
+		CborArrayValue items(30, CborObject::from_int(1000));
+		items.push_back(CborObject::from_string("end"));
+		auto array_value = CborObject::create_array(items);
+		objects.push_back(array_value);
+		CborMapValue members;
+		for (size_t i = 0; i < 30; i++) {
+			members[std::string(i, 'k')] = (i % 2) ? array_value : CborObject::from_float64((double)i);
+		}
+		members["nested"] = CborObject::create_map({ { "inner", CborObject::create_map({ { "x", CborObject::from_int(-1) } }) } });
+		objects.push_back(CborObject::create_map(members));
+		for (size_t i = 0; i < objects.size(); i++) {
+			check(encoder::encoded_size(objects[i].get()) == cbor_encode(objects[i]).size(), "encoded_size of object " + std::to_string(i));
+		}
+
+		// contract storage values decoded straight from the cbor bytes are the ones decoded through the CborObject tree
+		std::vector<CborObjectP> documents = { CborObject::from_bool(true), CborObject::from_int(-123456789012LL),
+			CborObject::from_float64(2.5), CborObject::from_string("hello"), CborObject::from_string(""),
+			CborObject::create_array({ CborObject::from_bool(true), CborObject::from_bool(false) }),
+			CborObject::create_array({ CborObject::from_int(1), CborObject::from_int(-2) }),
+			CborObject::create_array({ CborObject::from_float64(1.5), CborObject::from_float64(0.25) }),
+			CborObject::create_array({ CborObject::from_string("a"), CborObject::from_string("b") }),
+			CborObject::create_array({ CborObject::from_int(1), CborObject::from_string("b"), CborObject::from_bool(true) }),
+			CborObject::create_map({ { "a", CborObject::from_bool(false) }, { "b", CborObject::from_bool(true) } }),
+			CborObject::create_map({ { "a", CborObject::from_int(1) }, { "b", CborObject::from_int(2) } }),
+			CborObject::create_map({ { "a", CborObject::from_float64(1.5) } }),
+			CborObject::create_map({ { "a", CborObject::from_string("x") }, { "b", CborObject::from_string("y") } }),
+			CborObject::create_map({ { "a", CborObject::from_int(1) }, { "b", CborObject::from_string("y") } }),
+			CborObject::create_array(CborArrayValue()), CborObject::create_map(CborMapValue()),
+			CborObject::create_map({ { "a", array_value }, { "b", CborObject::create_map({ { "c", CborObject::from_int(3) } }) } }),
+			CborObject::create_array({ array_value, CborObject::create_map({ { "c", CborObject::from_string("d") } }) }) };
+		lua_State *L = uvm::lua::lib::create_lua_state();
+		for (size_t i = 0; i < documents.size(); i++) {
+			auto encoded = cbor_encode(documents[i]);
+			auto from_document = cbor_to_uvm_storage_value(L, cbor_decode(encoded).get());
+			auto from_bytes = cbor_to_uvm_storage_value(L, encoded.data(), encoded.size());
+			check(from_document.type == from_bytes.type
+				&& cbor_encode(uvm_storage_value_to_cbor(from_document)) == cbor_encode(uvm_storage_value_to_cbor(from_bytes)),
+				"storage value of document " + std::to_string(i));
+		}
+		// values a storage has no type for fail both ways
+		std::vector<CborObjectP> unsupported = { CborObject::from_bytes(CborBytesValue(3, 'b')), CborObject::create_undefined(),
+			CborObject::create_array({ CborObject::from_int(1), CborObject::from_tag(24) }) };
+		for (size_t i = 0; i < unsupported.size(); i++) {
+			auto encoded = cbor_encode(unsupported[i]);
+			check(throws<std::exception>([&]() { cbor_to_uvm_storage_value(L, cbor_decode(encoded).get()); })
+				&& throws<std::exception>([&]() { cbor_to_uvm_storage_value(L, encoded.data(), encoded.size()); }),
+				"storage value of unsupported document " + std::to_string(i));
+		}
+		uvm::lua::lib::close_lua_state(L);
+		cout << "test_cbor_encoding " << (ok ? "passed" : "failed") << endl;
+		return ok;
+	}
+
+	bool test_cbor_patch_rollback() {
+		cout << "start test_cbor_patch_rollback" << endl;
+		bool ok = true;
+		auto check = [&ok](bool passed, const char* what) {
+			if (!passed) {
+				cout << what << " failed" << endl;
+				ok = false;
+			}
+		};
+		auto old_value = CborObject::create_map({
+			{ "name", CborObject::from_string("token") },
+			{ "supply", CborObject::from_int(1000) },
+			{ "owners", CborObject::create_array({ CborObject::from_string("a"), CborObject::from_string("b") }) },
+			{ "balances", CborObject::create_map({ { "a", CborObject::from_int(600) }, { "b", CborObject::from_int(400) } }) },
+			{ "paused", CborObject::from_bool(false) } });
+		auto new_value = CborObject::create_map({
+			{ "name", CborObject::from_string("token") },
+			{ "supply", CborObject::from_int(1500) },
+			{ "owners", CborObject::create_array({ CborObject::from_string("a"), CborObject::from_string("b"), CborObject::from_string("c") }) },
+			{ "balances", CborObject::create_map({ { "a", CborObject::from_int(600) }, { "c", CborObject::from_int(900) } }) },
+			{ "decimals", CborObject::from_int(8) } });
+		auto old_encoded = cbor_encode(old_value);
+		auto new_encoded = cbor_encode(new_value);
+		CborDiff differ;
+		auto diff = differ.diff(old_value, new_value);
+		auto diff_encoded = cbor_encode(diff->value());
+
+		// patch and rollback return new trees and leave their input and the diff as they were
+		auto patched = differ.patch(old_value, diff);
+		check(cbor_encode(patched) == new_encoded, "patch");
+		check(cbor_encode(old_value) == old_encoded, "input of patch unchanged");
+		auto rolled_back = differ.rollback(patched, diff);
+		check(cbor_encode(rolled_back) == old_encoded, "rollback of patch");
+		check(cbor_encode(patched) == new_encoded, "input of rollback unchanged");
+		check(cbor_encode(diff->value()) == diff_encoded, "diff unchanged");
+
+		// the in place versions copy the nodes old_value shares with them before changing them
+		auto value = old_value;
+		differ.patch_inplace(value, diff);
+		check(cbor_encode(value) == new_encoded, "patch_inplace");
+		check(cbor_encode(old_value) == old_encoded, "shared tree of patch_inplace unchanged");
+		auto patched_value = value;
+		differ.rollback_inplace(value, diff);
+		check(cbor_encode(value) == old_encoded, "rollback_inplace of patch_inplace");
+		check(cbor_encode(patched_value) == new_encoded, "shared tree of rollback_inplace unchanged");
+		check(cbor_encode(diff->value()) == diff_encoded, "diff unchanged by the in place versions");
+
+		// a diff of a map doesn't apply to an array, nor a diff of an array to a map
+		auto array_value = CborObject::create_array({ CborObject::from_int(1), CborObject::from_int(2) });
+		auto array_diff = differ.diff(array_value, CborObject::create_array({ CborObject::from_int(1), CborObject::from_int(2), CborObject::from_int(3) }));
+		check(throws<CborDiffException>([&]() { differ.patch(array_value, diff); }), "patch of an array with a map diff");
+		check(throws<CborDiffException>([&]() { differ.rollback(array_value, diff); }), "rollback of an array with a map diff");
+		check(throws<CborDiffException>([&]() { differ.patch(old_value, array_diff); }), "patch of a map with an array diff");
+		check(throws<CborDiffException>([&]() { differ.rollback(old_value, array_diff); }), "rollback of a map with an array diff");
+		check(cbor_encode(old_value) == old_encoded, "input of a failed patch unchanged");
+		cout << "test_cbor_patch_rollback " << (ok ? "passed" : "failed") << endl;
+		return ok;
+	}
 }
\ No newline at end of file
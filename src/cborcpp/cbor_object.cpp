@@ -2,17 +2,200 @@
 #include <fc/crypto/hex.hpp>
 #include <string>
 #include <sstream>
+#include <cstdlib>
+#include <new>
 
 namespace cbor {
 
+	static thread_local CborArena* current_arena = nullptr;
+
+	// chunks start small for the many one-value documents and double up to this size
+	static const size_t cbor_arena_first_chunk_size = 256;
+	static const size_t cbor_arena_max_chunk_size = 1024 * 1024;
+
+	CborArena::CborArena()
+	: _refs(1), _chunks(nullptr), _pos(nullptr), _end(nullptr), _next_chunk_size(cbor_arena_first_chunk_size) {
+
+	}
+
+	CborArena::~CborArena() {
+		while (_chunks) {
+			auto next = _chunks->next;
+			free(_chunks);
+			_chunks = next;
+		}
+	}
+
+	CborArena* CborArena::create() {
+		return new CborArena();
+	}
+
+	void* CborArena::allocate(size_t size) {
+		static_assert(sizeof(Chunk) % 16 == 0, "arena chunk header must keep 16 bytes alignment");
+		size = (size + 15) & ~size_t(15);
+		if (size_t(_end - _pos) < size) {
+			auto chunk_size = std::max(_next_chunk_size, size);
+			auto chunk = static_cast<Chunk*>(malloc(sizeof(Chunk) + chunk_size));
+			if (!chunk)
+				throw std::bad_alloc();
+			chunk->next = _chunks;
+			chunk->size = chunk_size;
+			_chunks = chunk;
+			_pos = reinterpret_cast<char*>(chunk) + sizeof(Chunk);
+			_end = _pos + chunk_size;
+			_next_chunk_size = std::min(_next_chunk_size * 2, cbor_arena_max_chunk_size);
+		}
+		auto result = _pos;
+		_pos += size;
+		_refs.fetch_add(1, std::memory_order_relaxed);
+		return result;
+	}
+
+	CborArenaScope::CborArenaScope()
+	: _arena(CborArena::create()), _outer_arena(current_arena) {
+		current_arena = _arena;
+	}
+
+	CborArenaScope::~CborArenaScope() {
+		current_arena = _outer_arena;
+		_arena->release();
+	}
+
+#if defined(CBOR_OBJECT_USE_VARIANT)
 	CborObject::CborObject()
-	: type(COT_NULL), array_or_map_size(0), is_positive_extra(false){
-		value.bool_val = 0;
+	: type(COT_NULL), is_positive_extra(false), array_or_map_size(0) {
+	}
+
+	CborObject::CborObject(CborObjectType type_)
+	: type(type_), is_positive_extra(false), array_or_map_size(0) {
 	}
 
 	CborObject::CborObject(const CborObject& other)
-	: type(other.type), value(other.value), array_or_map_size(other.array_or_map_size), is_positive_extra(other.is_positive_extra) {
+	: type(other.type), is_positive_extra(other.is_positive_extra), array_or_map_size(other.array_or_map_size), value(other.value) {
+
+	}
+
+	CborObject& CborObject::operator=(const CborObject& other) {
+		type = other.type;
+		is_positive_extra = other.is_positive_extra;
+		array_or_map_size = other.array_or_map_size;
+		value = other.value;
+		return *this;
+	}
+#else
+	CborObject::CborObject()
+	: type(COT_NULL), is_positive_extra(false), array_or_map_size(0) {
+	}
+
+	CborObject::CborObject(CborObjectType type_)
+	: type(type_), is_positive_extra(false), array_or_map_size(0) {
+		init_value(nullptr);
+	}
+
+	CborObject::CborObject(const CborObject& other)
+	: type(other.type), is_positive_extra(other.is_positive_extra), array_or_map_size(other.array_or_map_size) {
+		init_value(&other);
+	}
+
+	CborObject& CborObject::operator=(const CborObject& other) {
+		if (this == &other)
+			return *this;
+		destroy_value();
+		type = other.type;
+		is_positive_extra = other.is_positive_extra;
+		array_or_map_size = other.array_or_map_size;
+		try {
+			init_value(&other);
+		}
+		catch (...) {
+			// stays a valid null object if copying the other value throws
+			type = COT_NULL;
+			value.int_val = 0;
+			throw;
+		}
+		return *this;
+	}
+
+	// constructs the member of value selected by type, as a copy of the other object's value if there is one
+	void CborObject::init_value(const CborObject* other) {
+		switch (type) {
+		case COT_STRING:
+		case COT_ERROR:
+			if (other)
+				new (&value.string_val) CborStringValue(other->value.string_val);
+			else
+				new (&value.string_val) CborStringValue();
+			break;
+		case COT_BYTES:
+			if (other)
+				new (&value.bytes_val) CborBytesValue(other->value.bytes_val);
+			else
+				new (&value.bytes_val) CborBytesValue();
+			break;
+		case COT_ARRAY:
+			if (other)
+				new (&value.array_val) CborArrayValue(other->value.array_val);
+			else
+				new (&value.array_val) CborArrayValue();
+			break;
+		case COT_MAP:
+			if (other)
+				new (&value.map_val) CborMapValue(other->value.map_val);
+			else
+				new (&value.map_val) CborMapValue();
+			break;
+		case COT_BOOL:
+			value.bool_val = other ? other->value.bool_val : false;
+			break;
+		case COT_INT:
+			value.int_val = other ? other->value.int_val : 0;
+			break;
+		case COT_EXTRA_INT:
+		case COT_EXTRA_TAG:
+			value.extra_int_val = other ? other->value.extra_int_val : 0;
+			break;
+		case COT_FLOAT:
+			value.float64_val = other ? other->value.float64_val : 0;
+			break;
+		case COT_TAG:
+			value.tag_or_special_val = other ? other->value.tag_or_special_val : 0;
+			break;
+		default:
+			// null and undefined have no value
+			value.int_val = 0;
+			break;
+		}
+	}
+
+	void CborObject::destroy_value() {
+		switch (type) {
+		case COT_STRING:
+		case COT_ERROR:
+			value.string_val.~CborStringValue();
+			break;
+		case COT_BYTES:
+			value.bytes_val.~CborBytesValue();
+			break;
+		case COT_ARRAY:
+			value.array_val.~CborArrayValue();
+			break;
+		case COT_MAP:
+			value.map_val.~CborMapValue();
+			break;
+		default:
+			break;
+		}
+	}
+#endif
 
+	void CborObject::throw_wrong_type(const char* accessor) const {
+		throw CborException(std::string("cbor object of type ") + std::to_string(int(type)) + " can't be read by " + accessor);
+	}
+
+		CborObjectP CborObject::make_object(CborObjectType type) {
+		if (current_arena)
+			return std::allocate_shared<CborObject>(CborArenaAllocator<CborObject>(current_arena), type);
+		return std::make_shared<CborObject>(type);
 	}
 
 	CborIntValue CborObject::force_as_int() const {
@@ -191,8 +374,7 @@ namespace cbor {
 	}*/
 
 	CborObjectP CborObject::from_int(CborIntValue value) {
-		auto result = std::make_shared<CborObject>();
-		result->type = COT_INT;
+		auto result = make_object(COT_INT);
 #if defined(CBOR_OBJECT_USE_VARIANT)
 		result->value = value;
 #else
@@ -201,8 +383,7 @@ namespace cbor {
 		return result;
 	}
 	CborObjectP CborObject::from_bool(CborBoolValue value) {
-		auto result = std::make_shared<CborObject>();
-		result->type = COT_BOOL;
+		auto result = make_object(COT_BOOL);
 #if defined(CBOR_OBJECT_USE_VARIANT)
 		result->value = value;
 #else
@@ -211,8 +392,7 @@ namespace cbor {
 		return result;
 	}
 	CborObjectP CborObject::from_bytes(const CborBytesValue& value) {
-		auto result = std::make_shared<CborObject>();
-		result->type = COT_BYTES;
+		auto result = make_object(COT_BYTES);
 #if defined(CBOR_OBJECT_USE_VARIANT)
 		result->value = value;
 #else
@@ -221,8 +401,7 @@ namespace cbor {
 		return result;
 	}
 	CborObjectP CborObject::from_float64(const CborDoubleValue& value) {
-		auto result = std::make_shared<CborObject>();
-		result->type = COT_FLOAT;
+		auto result = make_object(COT_FLOAT);
 #if defined(CBOR_OBJECT_USE_VARIANT)
 		result->value = value;
 #else
@@ -231,8 +410,7 @@ namespace cbor {
 		return result;
 	}
 	CborObjectP CborObject::from_string(const std::string& value) {
-		auto result = std::make_shared<CborObject>();
-		result->type = COT_STRING;
+		auto result = make_object(COT_STRING);
 #if defined(CBOR_OBJECT_USE_VARIANT)
 		result->value = value;
 #else
@@ -241,52 +419,43 @@ namespace cbor {
 		return result;
 	}
 	CborObjectP CborObject::create_array(size_t size) {
-		auto result = std::make_shared<CborObject>();
-		result->type = COT_ARRAY;
+		auto result = make_object(COT_ARRAY);
 #if defined(CBOR_OBJECT_USE_VARIANT)
 		result->value = CborArrayValue();
-#else
-		result->value.array_val = CborArrayValue();
 #endif
 		result->array_or_map_size = size;
 		return result;
 	}
 	CborObjectP CborObject::create_array(const CborArrayValue& items) {
-		auto result = std::make_shared<CborObject>();
-		result->type = COT_ARRAY;
+		auto result = make_object(COT_ARRAY);
 #if defined(CBOR_OBJECT_USE_VARIANT)
 		result->value = CborArrayValue(items);
 #else
-		result->value.array_val = CborArrayValue(items);
+		result->value.array_val = items;
 #endif
 		result->array_or_map_size = items.size();
 		return result;
 	}
 	CborObjectP CborObject::create_map(size_t size) {
-		auto result = std::make_shared<CborObject>();
-		result->type = COT_MAP;
+		auto result = make_object(COT_MAP);
 #if defined(CBOR_OBJECT_USE_VARIANT)
 		result->value = CborMapValue();
-#else
-		result->value.map_val = CborMapValue();
 #endif
 		result->array_or_map_size = size;
 		return result;
 	}
 	CborObjectP CborObject::create_map(const CborMapValue& items) {
-		auto result = std::make_shared<CborObject>();
-		result->type = COT_MAP;
+		auto result = make_object(COT_MAP);
 #if defined(CBOR_OBJECT_USE_VARIANT)
 		result->value = CborMapValue(items);
 #else
-		result->value.map_val = CborMapValue(items);
+		result->value.map_val = items;
 #endif
 		result->array_or_map_size = items.size();
 		return result;
 	}
 	CborObjectP CborObject::from_tag(CborTagValue value) {
-		auto result = std::make_shared<CborObject>();
-		result->type = COT_TAG;
+		auto result = make_object(COT_TAG);
 #if defined(CBOR_OBJECT_USE_VARIANT)
 		result->value = value;
 #else
@@ -295,30 +464,18 @@ namespace cbor {
 		return result;
 	}
 	CborObjectP CborObject::create_undefined() {
-		auto result = std::make_shared<CborObject>();
-		result->type = COT_UNDEFINED;
-#if !CBOR_OBJECT_USE_VARIANT
-		result->value.bool_val = 0;
-#endif
-		return result;
+		return make_object(COT_UNDEFINED);
 	}
 	CborObjectP CborObject::create_null() {
-		auto result = std::make_shared<CborObject>();
-		result->type = COT_NULL;
-#if !CBOR_OBJECT_USE_VARIANT
-		result->value.bool_val = 0;
-#endif
-		return result;
+		return make_object(COT_NULL);
 	}
 	/*CborObjectP CborObject::from_special(uint32_t value) {
-		auto result = std::make_shared<CborObject>();
-		result->type = COT_SPECIAL;
+		auto result = make_object(COT_SPECIAL);
 		result->value = value;
 		return result;
 	}*/
 	CborObjectP CborObject::from_extra_integer(uint64_t value, bool sign) {
-		auto result = std::make_shared<CborObject>();
-		result->type = COT_EXTRA_INT;
+		auto result = make_object(COT_EXTRA_INT);
 #if defined(CBOR_OBJECT_USE_VARIANT)
 		result->value = value;
 #else
@@ -328,8 +485,7 @@ namespace cbor {
 		return result;
 	}
 	CborObjectP CborObject::from_extra_tag(uint64_t value) {
-		auto result = std::make_shared<CborObject>();
-		result->type = COT_EXTRA_TAG;
+		auto result = make_object(COT_EXTRA_TAG);
 #if defined(CBOR_OBJECT_USE_VARIANT)
 		result->value = value;
 #else
@@ -338,8 +494,7 @@ namespace cbor {
 		return result;
 	}
 	/*CborObjectP CborObject::from_extra_special(uint64_t value) {
-		auto result = std::make_shared<CborObject>();
-		result->type = COT_EXTRA_SPECIAL;
+		auto result = make_object(COT_EXTRA_SPECIAL);
 		result->value = value;
 		return result;
 	}*/
@@ -17,6 +17,7 @@
 #include "cborcpp/decoder.h"
 
 #include <limits.h>
+#include <stdexcept>
 #include <fc/string.hpp>
 
 using namespace cbor;
@@ -41,7 +42,12 @@ decoder::~decoder() {
 //	return result;
 //}
 
-static void put_decoded_value(CborObjectP& result, std::vector<CborObjectP>& structures_stack, bool& iter_in_map_key, CborObjectP& map_key_temp, CborObjectP value) {
+// a map key is only needed until its value is decoded, so a string key is kept in a string instead of a node of the document
+static bool is_map_key_position(const std::vector<CborObjectP>& structures_stack, bool iter_in_map_key) {
+	return iter_in_map_key && !structures_stack.empty() && structures_stack.back()->type == COT_MAP;
+}
+
+static void put_decoded_value(CborObjectP& result, std::vector<CborObjectP>& structures_stack, bool& iter_in_map_key, CborObjectP& map_key_temp, const std::string& map_key, CborObjectP value) {
 	auto old_structures_stack_size = structures_stack.size();
 	if (structures_stack.empty()) {
 		if (result)
@@ -55,7 +61,8 @@ static void put_decoded_value(CborObjectP& result, std::vector<CborObjectP>& str
 		}
 		return;
 	}
-	auto last = structures_stack[old_structures_stack_size - 1];
+	// kept alive by the decoded tree
+	auto last = structures_stack[old_structures_stack_size - 1].get();
 	if (last->type == COT_ARRAY) {
 #if defined(CBOR_OBJECT_USE_VARIANT)
 		auto& array_value = last->value.get<CborArrayValue>();
@@ -72,16 +79,19 @@ static void put_decoded_value(CborObjectP& result, std::vector<CborObjectP>& str
 		if (iter_in_map_key)
 			map_key_temp = value;
 		else {
-			if (map_key_temp->type != COT_STRING) {
+			// string keys are in map_key, map_key_temp only holds keys of other types
+			if (map_key_temp && map_key_temp->type != COT_STRING) {
 				throw cbor_decode_exception("invalid map key type");
 			}
-			const auto& key = map_key_temp->as_string();
+			const auto& key = map_key_temp ? map_key_temp->as_string() : map_key;
 #if defined(CBOR_OBJECT_USE_VARIANT)
 			auto& map_value = last->value.get<CborMapValue>();
 #else
 			auto& map_value = last->value.map_val;
 #endif
-			map_value[key] = value;
+			// canonical cbor has the keys in order, so the hint saves the lookup. a repeated key keeps the last value
+			auto it = map_value.emplace_hint(map_value.end(), key, value);
+			it->second = value;
 			if (map_value.size() >= last->array_or_map_size) {
 				// full, pop from structure
 				structures_stack.pop_back();
@@ -100,12 +110,94 @@ static void put_decoded_value(CborObjectP& result, std::vector<CborObjectP>& str
 	}
 }
 
-CborObjectP decoder::run() {
-	CborObjectP result;
-	std::vector<CborObjectP> structures_stack;
-	bool iter_in_map_key = true;
-	CborObjectP map_key_temp;
+// a length read from a 4 bytes size can be negative here. the decoder used to copy the data into a vector of that
+// length, keep the error that gave
+static void check_data_length(int length) {
+	if (length < 0)
+		throw std::length_error("cannot create std::vector larger than max_size()");
+}
+
+namespace {
+	// builds the tree of decoder::run() from the decoded values
+	class object_builder final : public listener {
+	private:
+		CborObjectP _result;
+		std::vector<CborObjectP> _structures_stack;
+		bool _iter_in_map_key = true;
+		CborObjectP _map_key_temp;
+		std::string _map_key;
+
+		void put(CborObjectP value) {
+			put_decoded_value(_result, _structures_stack, _iter_in_map_key, _map_key_temp, _map_key, std::move(value));
+		}
+	public:
+		CborObjectP result() const {
+			if (!_result)
+				throw cbor_decode_exception("cbor decoded nothing");
+			if (!_structures_stack.empty())
+				throw cbor_decode_exception("cbor decode fail with not finished structures");
+			return _result;
+		}
+
+		void on_integer(CborIntValue value) override {
+			put(CborObject::from_int(value));
+		}
+
+		void on_extra_integer(CborExtraIntValue value, bool is_positive) override {
+			put(CborObject::from_extra_integer(value, is_positive));
+		}
+
+		void on_float64(CborDoubleValue value) override {
+			put(CborObject::from_float64(value));
+		}
+
+		void on_bytes(const char *data, size_t size) override {
+			put(CborObject::from_bytes(CborBytesValue(data, data + size)));
+		}
+
+		void on_string(const char *data, size_t size) override {
+			if (is_map_key_position(_structures_stack, _iter_in_map_key)) {
+				_map_key.assign(data, size);
+				_map_key_temp.reset();
+				_iter_in_map_key = false;
+			}
+			else {
+				put(CborObject::from_string(std::string(data, size)));
+			}
+		}
 
+		void on_array(uint32_t size) override {
+			put(CborObject::create_array(size));
+		}
+
+		void on_map(uint32_t size) override {
+			put(CborObject::create_map(size));
+		}
+
+		void on_tag(CborTagValue tag) override {
+			put(CborObject::from_tag(tag));
+		}
+
+		void on_extra_tag(CborExtraIntValue tag) override {
+			put(CborObject::from_extra_tag(tag));
+		}
+
+		void on_bool(bool value) override {
+			put(CborObject::from_bool(value));
+		}
+
+		void on_null() override {
+			put(CborObject::create_null());
+		}
+
+		void on_undefined() override {
+			put(CborObject::create_undefined());
+		}
+	};
+}
+
+template <typename Listener>
+void decoder::decode(Listener &listener_instance) {
 	unsigned int temp;
 	while (1) {
 		if (_state == STATE_TYPE) {
@@ -117,7 +209,7 @@ CborObjectP decoder::run() {
 				switch (majorType) {
 				case 0: // positive integer
 					if (minorType < 24) {
-						put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_int(minorType));
+						listener_instance.on_integer(minorType);
 					}
 					else if (minorType == 24) { // 1 byte
 						_currentLength = 1;
@@ -142,7 +234,7 @@ CborObjectP decoder::run() {
 					break;
 				case 1: // negative integer
 					if (minorType < 24) {
-						put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_int(-1 - minorType));
+						listener_instance.on_integer(-1 - minorType);
 					}
 					else if (minorType == 24) { // 1 byte
 						_currentLength = 1;
@@ -219,7 +311,7 @@ CborObjectP decoder::run() {
 					break;
 				case 4: // array
 					if (minorType < 24) {
-						put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::create_array(minorType));
+						listener_instance.on_array(minorType);
 					}
 					else if (minorType == 24) {
 						_state = STATE_ARRAY;
@@ -244,7 +336,7 @@ CborObjectP decoder::run() {
 					break;
 				case 5: // map
 					if (minorType < 24) {
-						put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::create_map(minorType));
+						listener_instance.on_map(minorType);
 					}
 					else if (minorType == 24) {
 						_state = STATE_MAP;
@@ -269,7 +361,7 @@ CborObjectP decoder::run() {
 					break;
 				case 6: // tag
 					if (minorType < 24) {
-						put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_tag(minorType));
+						listener_instance.on_tag(minorType);
 					}
 					else if (minorType == 24) {
 						_state = STATE_TAG;
@@ -294,15 +386,15 @@ CborObjectP decoder::run() {
 					break;
 					//             case 7: // special
 					//                 if (minorType < 20) {
-										 //put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_special(minorType));
+										 //listener_instance.on_special(minorType);
 					//                 } else if (minorType == 20) {
-										 //put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_bool(false));
+										 //listener_instance.on_bool(false);
 					//                 } else if (minorType == 21) {
-										 //put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_bool(true));
+										 //listener_instance.on_bool(true);
 					//                 } else if (minorType == 22) {
-										 //put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::create_null());
+										 //listener_instance.on_null();
 					//                 } else if (minorType == 23) {
-										 //put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::create_undefined());
+										 //listener_instance.on_undefined();
 					//                 } else if(minorType == 24) {
 					//                     _state = STATE_SPECIAL;
 					//                     _currentLength = 1;
@@ -322,16 +414,16 @@ CborObjectP decoder::run() {
 					//                 break;
 				case 7: // float
 					if (minorType == 20) {
-						put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_bool(false));
+						listener_instance.on_bool(false);
 					}
 					else if (minorType == 21) {
-						put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_bool(true));
+						listener_instance.on_bool(true);
 					}
 					else if (minorType == 22) {
-						put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::create_null());
+						listener_instance.on_null();
 					}
 					else if (minorType == 23) {
-						put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::create_undefined());
+						listener_instance.on_undefined();
 					}
 					else if (minorType < 24) {
 						_state = STATE_FLOAT_DATA;
@@ -366,25 +458,25 @@ CborObjectP decoder::run() {
 			if (_in->has_bytes(_currentLength)) {
 				switch (_currentLength) {
 				case 1:
-					put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_int(_in->get_byte()));
+					listener_instance.on_integer(_in->get_byte());
 					_state = STATE_TYPE;
 					break;
 				case 2:
-					put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_int(_in->get_short()));
+					listener_instance.on_integer(_in->get_short());
 					_state = STATE_TYPE;
 					break;
 				case 4:
 					temp = _in->get_int();
 					if (temp <= INT_MAX) {
-						put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_int(temp));
+						listener_instance.on_integer(temp);
 					}
 					else {
-						put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_extra_integer(temp, true));
+						listener_instance.on_extra_integer(temp, true);
 					}
 					_state = STATE_TYPE;
 					break;
 				case 8:
-					put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_extra_integer(_in->get_long(), true));
+					listener_instance.on_extra_integer(_in->get_long(), true);
 					_state = STATE_TYPE;
 					break;
 				}
@@ -395,25 +487,25 @@ CborObjectP decoder::run() {
 			if (_in->has_bytes(_currentLength)) {
 				switch (_currentLength) {
 				case 1:
-					put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_int(-(int)_in->get_byte() - 1));
+					listener_instance.on_integer(-(int)_in->get_byte() - 1);
 					_state = STATE_TYPE;
 					break;
 				case 2:
-					put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_int(-(int)_in->get_short() - 1));
+					listener_instance.on_integer(-(int)_in->get_short() - 1);
 					_state = STATE_TYPE;
 					break;
 				case 4:
 					temp = _in->get_int();
 					if (temp <= INT_MAX) {
-						put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_int(-(int)temp - 1));
+						listener_instance.on_integer(-(int)temp - 1);
 					}
 					else {
-						put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_extra_integer(temp + 1, false));
+						listener_instance.on_extra_integer(temp + 1, false);
 					}
 					_state = STATE_TYPE;
 					break;
 				case 8:
-					put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_extra_integer(_in->get_long() + 1, false));
+					listener_instance.on_extra_integer(_in->get_long() + 1, false);
 					break;
 				}
 			}
@@ -444,10 +536,10 @@ CborObjectP decoder::run() {
 		}
 		else if (_state == STATE_BYTES_DATA) {
 			if (_in->has_bytes(_currentLength)) {
-				std::vector<char> data(_currentLength);
-				_in->get_bytes(data.data(), _currentLength);
+				check_data_length(_currentLength);
+				auto data = _in->get_bytes_view(_currentLength);
 				_state = STATE_TYPE;
-				put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_bytes(data));
+				listener_instance.on_bytes(data, (size_t)_currentLength);
 			}
 			else break;
 		}
@@ -476,11 +568,10 @@ CborObjectP decoder::run() {
 		}
 		else if (_state == STATE_STRING_DATA) {
 			if (_in->has_bytes(_currentLength)) {
-				std::vector<char> data(_currentLength);
-				_in->get_bytes(data.data(), _currentLength);
+				check_data_length(_currentLength);
+				auto data = _in->get_bytes_view(_currentLength);
 				_state = STATE_TYPE;
-				std::string str(data.data(), (size_t)_currentLength);
-				put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_string(str));
+				listener_instance.on_string(data, (size_t)_currentLength);
 			}
 			else break;
 		}
@@ -509,16 +600,16 @@ CborObjectP decoder::run() {
 		}
 		else if (_state == STATE_FLOAT_DATA) {
 			if (_in->has_bytes(_currentLength)) {
-				std::vector<char> data(_currentLength);
-				_in->get_bytes(data.data(), _currentLength);
+				check_data_length(_currentLength);
+				auto data = _in->get_bytes_view(_currentLength);
 				_state = STATE_TYPE;
-				std::string str(data.data(), (size_t)_currentLength);
+				std::string str(data, (size_t)_currentLength);
 				size_t fixed_size = CBOR_ENCODE_DOUBLE_STRING_SIZE;
 				if (str.size() < fixed_size) {
 					_in->skip_bytes(fixed_size - str.size());
 				}
 				CborDoubleValue value = fc::to_double(str); // std::stod(str);
-				put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_float64(value));
+				listener_instance.on_float64(value);
 			}
 			else break;
 		}
@@ -527,15 +618,15 @@ CborObjectP decoder::run() {
 			if (_in->has_bytes(_currentLength)) {
 				switch (_currentLength) {
 				case 1:
-					put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::create_array(_in->get_byte()));
+					listener_instance.on_array(_in->get_byte());
 					_state = STATE_TYPE;
 					break;
 				case 2:
-					put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::create_array(_in->get_short()));
+					listener_instance.on_array(_in->get_short());
 					_state = STATE_TYPE;
 					break;
 				case 4:
-					put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::create_array(_in->get_int()));
+					listener_instance.on_array(_in->get_int());
 					_state = STATE_TYPE;
 					break;
 				case 8:
@@ -550,15 +641,15 @@ CborObjectP decoder::run() {
 			if (_in->has_bytes(_currentLength)) {
 				switch (_currentLength) {
 				case 1:
-					put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::create_map(_in->get_byte()));
+					listener_instance.on_map(_in->get_byte());
 					_state = STATE_TYPE;
 					break;
 				case 2:
-					put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::create_map(_currentLength = _in->get_short()));
+					listener_instance.on_map(_currentLength = _in->get_short());
 					_state = STATE_TYPE;
 					break;
 				case 4:
-					put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::create_map(_in->get_int()));
+					listener_instance.on_map(_in->get_int());
 					_state = STATE_TYPE;
 					break;
 				case 8:
@@ -573,19 +664,19 @@ CborObjectP decoder::run() {
 			if (_in->has_bytes(_currentLength)) {
 				switch (_currentLength) {
 				case 1:
-					put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_tag(_in->get_byte()));
+					listener_instance.on_tag(_in->get_byte());
 					_state = STATE_TYPE;
 					break;
 				case 2:
-					put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_tag(_in->get_short()));
+					listener_instance.on_tag(_in->get_short());
 					_state = STATE_TYPE;
 					break;
 				case 4:
-					put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_tag(_in->get_int()));
+					listener_instance.on_tag(_in->get_int());
 					_state = STATE_TYPE;
 					break;
 				case 8:
-					put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_extra_tag(_in->get_long()));
+					listener_instance.on_extra_tag(_in->get_long());
 					_state = STATE_TYPE;
 					break;
 				}
@@ -596,19 +687,19 @@ CborObjectP decoder::run() {
 			if (_in->has_bytes(_currentLength)) {
 				switch (_currentLength) {
 					case 1:
-						put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_special(_in->get_byte()));
+						listener_instance.on_special(_in->get_byte());
 						_state = STATE_TYPE;
 						break;
 					case 2:
-						put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_special(_in->get_short()));
+						listener_instance.on_special(_in->get_short());
 						_state = STATE_TYPE;
 						break;
 					case 4:
-						put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_special(_in->get_int()));
+						listener_instance.on_special(_in->get_int());
 						_state = STATE_TYPE;
 						break;
 					case 8:
-						put_decoded_value(result, structures_stack, iter_in_map_key, map_key_temp, CborObject::from_extra_special(_in->get_long()));
+						listener_instance.on_extra_special(_in->get_long());
 						_state = STATE_TYPE;
 						break;
 				}
@@ -621,10 +712,17 @@ CborObjectP decoder::run() {
 			throw cbor_decode_exception("UNKNOWN STATE");
 		}
 	}
-	if (!result)
-		throw cbor_decode_exception("cbor decoded nothing");
-	if (!structures_stack.empty())
-		throw cbor_decode_exception("cbor decode fail with not finished structures");
-	return result;
+}
+
+CborObjectP decoder::run() {
+	// the nodes of the decoded document share one arena
+	CborArenaScope arena_scope;
+	object_builder builder;
+	decode(builder);
+	return builder.result();
+}
+
+void decoder::run(listener &listener_instance) {
+	decode(listener_instance);
 }
 
@@ -16,95 +16,149 @@
 
 #include "cborcpp/encoder.h"
 #include "cborcpp/exceptions.h"
+#include <algorithm>
 #include <iomanip>
+#include <limits>
 #include <string>
 #include <sstream>
+#include <string.h>
 
 using namespace cbor;
 
 
 encoder::encoder(output &out) {
     _out = &out;
+    _buffered = 0;
 }
 
 encoder::~encoder() {
 
 }
 
+void encoder::put_byte(unsigned char value) {
+    if(_buffered == buffer_capacity) {
+        flush();
+    }
+    _buffer[_buffered++] = value;
+}
+
+void encoder::put_bytes(const unsigned char *data, size_t size) {
+    if(size == 0) {
+        return;
+    }
+    if(size > buffer_capacity - _buffered) {
+        flush();
+        if(size >= buffer_capacity) {
+            _out->put_bytes(data, (int) size);
+            return;
+        }
+    }
+    memcpy(_buffer + _buffered, data, size);
+    _buffered += size;
+}
+
+void encoder::flush() {
+    if(_buffered > 0) {
+        _out->put_bytes(_buffer, (int) _buffered);
+        _buffered = 0;
+    }
+}
+
+// header bytes write_type_value writes for value
+static size_t type_value_size(uint64_t value) {
+    if(value < 24ULL) {
+        return 1;
+    } else if(value < 256ULL) {
+        return 2;
+    } else if(value < 65536ULL) {
+        return 3;
+    } else if(value < 4294967296ULL) {
+        return 5;
+    } else {
+        return 9;
+    }
+}
+
 void encoder::write_type_value(int major_type, uint32_t value) {
     major_type <<= 5;
     if(value < 24) {
-        _out->put_byte((unsigned char) (major_type | value));
+        put_byte((unsigned char) (major_type | value));
     } else if(value < 256) {
-        _out->put_byte((unsigned char) (major_type | 24));
-        _out->put_byte((unsigned char) value);
+        put_byte((unsigned char) (major_type | 24));
+        put_byte((unsigned char) value);
     } else if(value < 65536) {
-        _out->put_byte((unsigned char) (major_type | 25));
-        _out->put_byte((unsigned char) (value >> 8));
-        _out->put_byte((unsigned char) value);
+        put_byte((unsigned char) (major_type | 25));
+        put_byte((unsigned char) (value >> 8));
+        put_byte((unsigned char) value);
     } else {
-        _out->put_byte((unsigned char) (major_type | 26));
-        _out->put_byte((unsigned char) (value >> 24));
-        _out->put_byte((unsigned char) (value >> 16));
-        _out->put_byte((unsigned char) (value >> 8));
-        _out->put_byte((unsigned char) value);
+        put_byte((unsigned char) (major_type | 26));
+        put_byte((unsigned char) (value >> 24));
+        put_byte((unsigned char) (value >> 16));
+        put_byte((unsigned char) (value >> 8));
+        put_byte((unsigned char) value);
     }
 }
 
 void encoder::write_type_value(int major_type, uint64_t value) {
     major_type <<= 5;
     if(value < 24ULL) {
-        _out->put_byte((unsigned char) (major_type | value));
+        put_byte((unsigned char) (major_type | value));
     } else if(value < 256ULL) {
-        _out->put_byte((unsigned char) (major_type | 24));
-        _out->put_byte((unsigned char) value);
+        put_byte((unsigned char) (major_type | 24));
+        put_byte((unsigned char) value);
     } else if(value < 65536ULL) {
-        _out->put_byte((unsigned char) (major_type | 25));
-        _out->put_byte((unsigned char) (value >> 8));
-        _out->put_byte((unsigned char) value);
+        put_byte((unsigned char) (major_type | 25));
+        put_byte((unsigned char) (value >> 8));
+        put_byte((unsigned char) value);
     } else if(value < 4294967296ULL) {
-        _out->put_byte((unsigned char) (major_type | 26));
-        _out->put_byte((unsigned char) (value >> 24));
-        _out->put_byte((unsigned char) (value >> 16));
-        _out->put_byte((unsigned char) (value >> 8));
-        _out->put_byte((unsigned char) value);
+        put_byte((unsigned char) (major_type | 26));
+        put_byte((unsigned char) (value >> 24));
+        put_byte((unsigned char) (value >> 16));
+        put_byte((unsigned char) (value >> 8));
+        put_byte((unsigned char) value);
     } else {
-        _out->put_byte((unsigned char) (major_type | 27));
-        _out->put_byte((unsigned char) (value >> 56));
-        _out->put_byte((unsigned char) (value >> 48));
-        _out->put_byte((unsigned char) (value >> 40));
-        _out->put_byte((unsigned char) (value >> 32));
-        _out->put_byte((unsigned char) (value >> 24));
-        _out->put_byte((unsigned char) (value >> 16));
-        _out->put_byte((unsigned char) (value >> 8));
-        _out->put_byte((unsigned char) value);
+        put_byte((unsigned char) (major_type | 27));
+        put_byte((unsigned char) (value >> 56));
+        put_byte((unsigned char) (value >> 48));
+        put_byte((unsigned char) (value >> 40));
+        put_byte((unsigned char) (value >> 32));
+        put_byte((unsigned char) (value >> 24));
+        put_byte((unsigned char) (value >> 16));
+        put_byte((unsigned char) (value >> 8));
+        put_byte((unsigned char) value);
     }
 }
 
-void encoder::write_type_value(int major_type, CborDoubleValue value) {
+std::string encoder::float64_string(CborDoubleValue value) {
 	std::stringstream ss;
 	ss << std::setprecision(std::numeric_limits<double>::digits10 + 2) << std::fixed << value;
-	std::string value_str = ss.str();
+	return ss.str();
+}
+
+void encoder::write_type_value(int major_type, CborDoubleValue value) {
+	std::string value_str = float64_string(value);
 	size_t fixed_size = CBOR_ENCODE_DOUBLE_STRING_SIZE; // save float as type + array_size + array_chars + (fixed_size-len(array) count of 0)
 	write_type_value(major_type, (unsigned int)value_str.size());
-	_out->put_bytes((const unsigned char *)value_str.c_str(), (int)value_str.size());
+	put_bytes((const unsigned char *)value_str.c_str(), value_str.size());
 	if (value_str.size() < fixed_size) {
-		std::vector<char> zeros(fixed_size - value_str.size());
-		memset(zeros.data(), 0x00, zeros.size());
-		_out->put_bytes((const unsigned char *) zeros.data(), zeros.size());
+		static const unsigned char zeros[CBOR_ENCODE_DOUBLE_STRING_SIZE] = { 0 };
+		put_bytes(zeros, fixed_size - value_str.size());
 	}
 }
 
 void encoder::write_int(uint32_t value) {
     write_type_value(0, value);
+    flush();
 }
 
 void encoder::write_int(uint64_t value) {
     write_type_value(0, value);
+    flush();
 }
 
 void encoder::write_neg_int(uint64_t value) {
 	write_type_value(1, value);
+	flush();
 }
 
 void encoder::write_int(int64_t value) {
@@ -113,6 +167,7 @@ void encoder::write_int(int64_t value) {
     } else {
         write_type_value(0, (uint64_t) value);
     }
+    flush();
 }
 
 void encoder::write_int(int32_t value) {
@@ -121,34 +176,39 @@ void encoder::write_int(int32_t value) {
     } else {
         write_type_value(0, (uint32_t) value);
     }
+    flush();
 }
 
 void encoder::write_bytes(const unsigned char *data, unsigned int size) {
     write_type_value(2, size);
-    _out->put_bytes(data, size);
+    put_bytes(data, size);
+    flush();
 }
 
 void encoder::write_string(const char *data, unsigned int size) {
     write_type_value(3, size);
-    _out->put_bytes((const unsigned char *) data, size);
+    put_bytes((const unsigned char *) data, size);
+    flush();
 }
 
-void encoder::write_string(const std::string str) {
-    write_type_value(3, (unsigned int) str.size());
-    _out->put_bytes((const unsigned char *) str.c_str(), (int) str.size());
+void encoder::write_string(const std::string& str) {
+    write_string(str.c_str(), (unsigned int) str.size());
 }
 
 
 void encoder::write_array(int size) {
     write_type_value(4, (unsigned int) size);
+    flush();
 }
 
 void encoder::write_map(int size) {
     write_type_value(5, (unsigned int) size);
+    flush();
 }
 
 void encoder::write_tag(const unsigned int tag) {
     write_type_value(6, tag);
+    flush();
 }
 
 //void encoder::write_special(int special) {
@@ -158,64 +218,79 @@ void encoder::write_tag(const unsigned int tag) {
 // float major type as special type
 void encoder::write_float64(CborDoubleValue value) {
 	write_type_value(7, value);
+	flush();
 }
 
 void encoder::write_bool(bool value) {
     if (value) {
-        _out->put_byte((unsigned char) 0xf5);
+        put_byte((unsigned char) 0xf5);
     } else {
-        _out->put_byte((unsigned char) 0xf4);
+        put_byte((unsigned char) 0xf4);
     }
+    flush();
 }
 
 void encoder::write_null() {
-    _out->put_byte((unsigned char) 0xf6);
+    put_byte((unsigned char) 0xf6);
+    flush();
 }
 
 void encoder::write_undefined() {
-    _out->put_byte((unsigned char) 0xf7);
+    put_byte((unsigned char) 0xf7);
+    flush();
 }
 
 void encoder::write_cbor_object(const CborObject* value) {
+	encode_cbor_object(value);
+	flush();
+}
+
+void encoder::encode_cbor_object(const CborObject* value) {
 	if (!value)
 		return;
 	switch (value->object_type()) {
 	case CborObjectType::COT_NULL:
-		write_null();
+		put_byte((unsigned char) 0xf6);
 		return;
 	case CborObjectType::COT_UNDEFINED:
-		write_undefined();
+		put_byte((unsigned char) 0xf7);
 		return;
 	case CborObjectType::COT_BOOL:
-		write_bool(value->as_bool());
-		return;
-	case CborObjectType::COT_INT:
-		write_int(value->as_int());
+		put_byte(value->as_bool() ? (unsigned char) 0xf5 : (unsigned char) 0xf4);
 		return;
-	case CborObjectType::COT_EXTRA_INT:
-		if (value->is_positive_extra) {
-			write_int(value->as_extra_int());
+	case CborObjectType::COT_INT: {
+		auto int_value = value->as_int();
+		if (int_value < 0) {
+			write_type_value(1, (uint64_t)-(int_value + 1));
 		}
 		else {
-			write_neg_int(value->as_extra_int());
+			write_type_value(0, (uint64_t)int_value);
 		}
 		return;
-	case CborObjectType::COT_STRING:
-		write_string(value->as_string());
+	}
+	case CborObjectType::COT_EXTRA_INT:
+		write_type_value(value->is_positive_extra ? 0 : 1, (uint64_t) value->as_extra_int());
+		return;
+	case CborObjectType::COT_STRING: {
+		const auto& str = value->as_string();
+		write_type_value(3, (unsigned int) str.size());
+		put_bytes((const unsigned char *) str.c_str(), str.size());
 		return;
+	}
 	case CborObjectType::COT_FLOAT:
-		write_float64(value->as_float64());
+		write_type_value(7, value->as_float64());
 		return;
 	case CborObjectType::COT_BYTES: {
 		const auto& bytes = value->as_bytes();
-		write_bytes((const unsigned char*)bytes.data(), bytes.size());
+		write_type_value(2, (unsigned int) bytes.size());
+		put_bytes((const unsigned char*)bytes.data(), bytes.size());
 		return;
 	}
 	case CborObjectType::COT_TAG:
-		write_tag(value->as_tag());
+		write_type_value(6, (unsigned int) value->as_tag());
 		return;
 	case CborObjectType::COT_EXTRA_TAG:
-		write_tag(value->as_extra_tag());
+		write_type_value(6, (unsigned int) value->as_extra_tag());
 		return;
 	/*case CborObjectType::COT_SPECIAL:
 		write_special(value->as_special());
@@ -225,18 +300,19 @@ void encoder::write_cbor_object(const CborObject* value) {
 		return;*/
 	case CborObjectType::COT_ARRAY: {
 		const auto& array_value = value->as_array();
-		write_array(array_value.size());
+		write_type_value(4, (unsigned int) array_value.size());
 		for (const auto& item : array_value) {
-			write_cbor_object(item.get());
+			encode_cbor_object(item.get());
 		}
 		return;
 	}
 	case CborObjectType::COT_MAP: {
 		const auto& map_value = value->as_map();
-		write_map(map_value.size());
+		write_type_value(5, (unsigned int) map_value.size());
 		for (const auto& p : map_value) {
-			write_string(p.first);
-			write_cbor_object(p.second.get());
+			write_type_value(3, (unsigned int) p.first.size());
+			put_bytes((const unsigned char *) p.first.c_str(), p.first.size());
+			encode_cbor_object(p.second.get());
 		}
 		return;
 	}
@@ -245,3 +321,57 @@ void encoder::write_cbor_object(const CborObject* value) {
 	}
 	}
 }
+
+size_t encoder::encoded_size(const CborObject* value) {
+	if (!value)
+		return 0;
+	switch (value->object_type()) {
+	case CborObjectType::COT_NULL:
+	case CborObjectType::COT_UNDEFINED:
+	case CborObjectType::COT_BOOL:
+		return 1;
+	case CborObjectType::COT_INT: {
+		auto int_value = value->as_int();
+		return type_value_size(int_value < 0 ? (uint64_t)-(int_value + 1) : (uint64_t)int_value);
+	}
+	case CborObjectType::COT_EXTRA_INT:
+		return type_value_size(value->as_extra_int());
+	case CborObjectType::COT_STRING: {
+		auto str_size = (unsigned int) value->as_string().size();
+		return type_value_size(str_size) + str_size;
+	}
+	case CborObjectType::COT_FLOAT: {
+		size_t str_size = float64_string(value->as_float64()).size();
+		return type_value_size((unsigned int) str_size) + std::max(str_size, (size_t) CBOR_ENCODE_DOUBLE_STRING_SIZE);
+	}
+	case CborObjectType::COT_BYTES: {
+		auto bytes_size = (unsigned int) value->as_bytes().size();
+		return type_value_size(bytes_size) + bytes_size;
+	}
+	case CborObjectType::COT_TAG:
+		return type_value_size((unsigned int) value->as_tag());
+	case CborObjectType::COT_EXTRA_TAG:
+		return type_value_size((unsigned int) value->as_extra_tag());
+	case CborObjectType::COT_ARRAY: {
+		const auto& array_value = value->as_array();
+		size_t size = type_value_size((unsigned int) array_value.size());
+		for (const auto& item : array_value) {
+			size += encoded_size(item.get());
+		}
+		return size;
+	}
+	case CborObjectType::COT_MAP: {
+		const auto& map_value = value->as_map();
+		size_t size = type_value_size((unsigned int) map_value.size());
+		for (const auto& p : map_value) {
+			auto key_size = (unsigned int) p.first.size();
+			size += type_value_size(key_size) + key_size + encoded_size(p.second.get());
+		}
+		return size;
+	}
+	case CborObjectType::COT_ERROR: {
+		throw cbor_encode_exception("invalid cbor object type");
+	}
+	}
+	return 0;
+}
@@ -70,6 +70,12 @@ void input::get_bytes(void *to, int count) {
     _offset += count;
 }
 
+const char *input::get_bytes_view(int count) {
+    const char *view = (const char *) (_data + _offset);
+    _offset += count;
+    return view;
+}
+
 void input::skip_bytes(int count) {
 	_offset += count;
 }
\ No newline at end of file
@@ -24,8 +24,8 @@ using namespace cbor;
 
 
 void output_dynamic::init(unsigned int initalCapacity) {
-    this->_capacity = initalCapacity;
-    this->_buffer = new unsigned char[initalCapacity];
+    this->_capacity = initalCapacity > 0 ? initalCapacity : 1;
+    this->_buffer = (unsigned char *) malloc(_capacity);
     this->_offset = 0;
 }
 
@@ -38,7 +38,7 @@ output_dynamic::output_dynamic(unsigned int inital_capacity) {
 }
 
 output_dynamic::~output_dynamic() {
-    delete _buffer;
+    free(_buffer);
 }
 
 unsigned char *output_dynamic::data() const {
@@ -60,6 +60,9 @@ void output_dynamic::put_byte(unsigned char value) {
 }
 
 void output_dynamic::put_bytes(const unsigned char *data, int size) {
+    if(size <= 0) {
+        return;
+    }
     while(_offset + size > _capacity) {
         _capacity *= 2;
         _buffer = (unsigned char *) realloc(_buffer, _capacity);
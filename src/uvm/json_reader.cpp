@@ -1,8 +1,9 @@
 #define json_reader_cpp
 
 #include <uvm/json_reader.h>
-
-using namespace uvm::blockchain;
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
 
 bool Json_Reader::addError(const std::string& message,
 	Token& token,
@@ -18,6 +19,29 @@ Json_Reader::Char Json_Reader::getNextChar() {
 		return 0;
 	return *current_++;
 }
+// a word with a byte equal to c
+#define json_word_has_byte(word, c) ((((word) ^ (UINT64_C(0x0101010101010101) * (uint8_t)(c))) - UINT64_C(0x0101010101010101)) \
+	& ~((word) ^ (UINT64_C(0x0101010101010101) * (uint8_t)(c))) & UINT64_C(0x8080808080808080))
+
+static inline bool is_string_special_char(char c) {
+	return c == '"' || c == '\\' || c == '\n' || c == '\r';
+}
+
+// skip the bytes of a string token that need no decoding, 8 bytes at a time
+static Location skip_plain_string_chars(Location current, Location end) {
+	while (end - current >= 8) {
+		uint64_t word;
+		memcpy(&word, current, sizeof(word));
+		if (json_word_has_byte(word, '"') | json_word_has_byte(word, '\\')
+			| json_word_has_byte(word, '\n') | json_word_has_byte(word, '\r'))
+			break;
+		current += 8;
+	}
+	while (current != end && !is_string_special_char(*current))
+		++current;
+	return current;
+}
+
 void Json_Reader::skipSpaces() {
 	while (current_ != end_) {
 		Char c = *current_;
@@ -70,7 +94,6 @@ bool Json_Reader::readKeyToken(Token& token) {
 	case '"':
 		token.type_ = tokenString;
 		ok = readString();
-		//is_skip_quote = true;
 		break;
 	default:
 		//try read string  if pre is { or ,
@@ -179,16 +202,82 @@ bool Json_Reader::readToken(Token& token) {
 	token.end_ = current_;
 	return ok;
 }
+// read a string token after its opening quote. the escapes are decoded while scanning, into decoded_ and only
+// when the string has some, otherwise string_ points to the source.
+// a terminated string that can't be decoded is still a valid token, its error is kept in string_error_
 bool Json_Reader::readString() {
-	Char c = 0;
+	Location start = current_;
+	Location plain = current_; // start of the bytes not copied to decoded_ yet
+	bool escaped = false;
+	string_error_ = nullptr;
 	while (current_ != end_) {
-		c = getNextChar();
-		if (c == '\\')
-			getNextChar();
-		else if (c == '"')
+		current_ = skip_plain_string_chars(current_, end_);
+		if (current_ == end_)
+			break;
+		Char c = *current_;
+		if (c == '"') {
+			if (escaped) {
+				decoded_.append(plain, current_);
+				string_ = decoded_.data();
+				string_size_ = decoded_.size();
+			}
+			else {
+				string_ = start;
+				string_size_ = current_ - start;
+			}
+			++current_;
+			return true;
+		}
+		if (c == '\n' || c == '\r') {
+			if (!string_error_)
+				string_error_ = "unfinished string";
+			++current_;
+			continue;
+		}
+		if (!escaped) {
+			escaped = true;
+			decoded_.clear();
+		}
+		decoded_.append(plain, current_);
+		if (++current_ == end_)
+			break;
+		Char escape = *current_++;
+		switch (escape) {
+		case '"':
+			decoded_ += '"';
+			break;
+		case '/':
+			decoded_ += '/';
+			break;
+		case '\\':
+			decoded_ += '\\';
+			break;
+		case 'b':
+			decoded_ += '\b';
+			break;
+		case 'f':
+			decoded_ += '\f';
+			break;
+		case 'n':
+			decoded_ += '\n';
+			break;
+		case 'r':
+			decoded_ += '\r';
+			break;
+		case 't':
+			decoded_ += '\t';
 			break;
+		case 'u':
+			// the code point isn't decoded, its digits are kept as they are
+			break;
+		default:
+			if (!string_error_)
+				string_error_ = "Bad escape sequence in string";
+			break;
+		}
+		plain = current_;
 	}
-	return c == '"';
+	return false;
 }
 
 bool Json_Reader::readNumber(bool checkInf) {
@@ -218,164 +307,64 @@ bool Json_Reader::readNumber(bool checkInf) {
 	return true;
 }
 
-bool Json_Reader::parse(lua_State *L, std::string& str,UvmStorageValue* root) {
-	while(!nodes_.empty()) {
-		nodes_.pop();
-	}
-	if (!L || !root) {
+bool Json_Reader::parse(lua_State *L, const char* str, size_t size) {
+	if (!L || !str) {
 		return false;
 	}
 	error.message_ = "";
 
 	L_ = L;
-	UvmStorageValue value;
-	nodes_.push(value);
-	//UvmStorageValue* pval = reinterpret_cast<UvmStorageValue*>(uvm::lua::lib::malloc_managed_string(L_, sizeof(UvmStorageValue),nullptr));
-	//nodes_.push(*pval);
 	Token token;
-	source_ = str;
-	begin_ = str.c_str();
-	end_ = str.length() + begin_;
+	begin_ = str;
+	end_ = str + size;
 	current_ = begin_;
-	bool ok = readValue();
-
-	if(ok){
-		if (nodes_.size() == 1) {
-			if (current_ < end_) {
-				ok = false;
-				addError("extra data after json object", token, current_);
-			}
-			else {
-				*root = nodes_.top();  //parse scuccess
-			}
+	members_.clear();
+	members_values_count_ = 0;
+	auto top = lua_gettop(L);
+	lua_createtable(L, 0, 0);
+	members_values_index_ = lua_gettop(L);
+	bool ok = readValue(1);
+
+	if (ok) {
+		if (current_ < end_) {
+			ok = false;
+			addError("extra data after json object", token, current_);
 		}
 		else {
-			ok = false;
-			addError("internal error(stack not balance)", token, current_);
+			lua_replace(L, members_values_index_); //parse scuccess
 		}
 	}
-
-	while(!nodes_.empty()) {
-		nodes_.pop();
+	if (!ok) {
+		lua_settop(L, top);
 	}
+	members_.clear();
 	return ok;
 }
-UvmStorageValue* Json_Reader::currentValue() { return (&(nodes_.top())); }
-
-bool Json_Reader::decodeString(Token& token,bool is_skip_quote,std::string& decoded) {
-	Location current;
-	Location end;
-	if (is_skip_quote) {
-		current = token.start_ + 1; // skip '"'
-		end = token.end_ - 1;       // do not include '"'
-	}
-	else {
-		current = token.start_ ; 
-		end = token.end_ ; 
-	}
-	//std::string decoded;
-	
-	while (current != end) {
-		Char c = *current++;
-		if (c == '"')
-			break;
-		else if (c == '\n' || c == '\r') {
-			return addError("unfinished string", token, current);
-		}
-		else if (c == '\\') {
-			if (current == end)
-				return addError("Empty escape sequence in string", token, current);
-			Char escape = *current++;
-			switch (escape) {
-			case '"':
-				decoded += '"';
-				break;
-			case '/':
-				decoded += '/';
-				break;
-			case '\\':
-				decoded += '\\';
-				break;
-			case 'b':
-				decoded += '\b';
-				break;
-			case 'f':
-				decoded += '\f';
-				break;
-			case 'n':
-				decoded += '\n';
-				break;
-			case 'r':
-				decoded += '\r';
-				break;
-			case 't':
-				decoded += '\t';
-				break;
-			case 'u': {
-				/*unsigned int unicode;
-				if (!decodeUnicodeCodePoint(token, current, end, unicode))
-					return false;
-				decoded += codePointToUTF8(unicode);*/
-			} break;
-			default:
-				return addError("Bad escape sequence in string", token, current);
-			}
-		}
-		else {
-			decoded += c;
-		}
-	}
-	
-	return true;
-}
 
 //exist node
-bool Json_Reader::readObject(Token& token) {
+bool Json_Reader::readObject(Token& token, int depth) {
 	Token tokenName;
-	std::string name;
 	std::string errormsg;
 
-	auto obj = currentValue();
-	obj->type = StorageValueTypes::storage_value_unknown_table;
-	obj->value.table_value = uvm::lua::lib::create_managed_lua_table_map(L_);
-	auto ptab = obj->value.table_value;
-	//UvmStorageValue obj;
-	//obj.type = StorageValueTypes::storage_value_unknown_table;
-	//nodes_.push(obj);
+	// as if the previous member name token ended at the start, for the errors of the first member name
+	tokenName.start_ = tokenName.end_ = begin_;
+	auto members_begin = members_.size();
+	auto values_begin = members_values_count_;
 	if (current_ != end_ && *current_ == '}') // empty map
 	{
 		Token endMap;
 		readToken(endMap);
+		lua_createtable(L_, 0, 0);
 		return true;
 	}
 	while (readKeyToken(tokenName)) {
-		/*bool initialTokenOk = true;
-		while (tokenName.type_ == tokenComment && initialTokenOk)
-			initialTokenOk = readToken(tokenName);
-		if (!initialTokenOk)
+		if (tokenName.type_ != tokenString) {
 			break;
-		if (tokenName.type_ == tokenObjectEnd && name.empty()) // empty object
-			return true;
-		*/
-		name.clear();
-		if (tokenName.type_ == tokenString) {
-			bool is_skip_quote = false;
-			if (*tokenName.start_ == '"') {
-				is_skip_quote = true;
-			}
-			if (!decodeString(tokenName, is_skip_quote, name)) {
-				return addError("invalid object member name.", tokenName, current_);
-			}
 		}
-		/*else if (tokenName.type_ == tokenNumber && features_.allowNumericKeys_) {
-			Value numberName;
-			if (!decodeNumber(tokenName, numberName))
-				return recoverFromError(tokenObjectEnd);
-			name = JSONCPP_STRING(numberName.asCString());
-		}*/
-		else {
-			break;
+		if (string_error_) {
+			return addError("invalid object member name.", tokenName, current_);
 		}
+		std::string name(string_, string_size_);
 
 		Token colon;
 		if (!readToken(colon) || colon.type_ != tokenMemberSeparator) {
@@ -384,55 +373,53 @@ bool Json_Reader::readObject(Token& token) {
 				errormsg = errormsg + ", but got '" + *(colon.start_) + "'";
 			}
 			return addError(errormsg, colon, current_);
-
-			//return addError("Missing ':' after object member name", colon,current_);
 		}
-		UvmStorageValue value;
-		nodes_.push(value);
-		//UvmStorageValue* pval = reinterpret_cast<UvmStorageValue*>(uvm::lua::lib::malloc_managed_string(L_, sizeof(UvmStorageValue), nullptr));
-		//nodes_.push(*pval);
-		bool ok = readValue(); //recursion
+		bool ok = readValue(depth + 1); //recursion
 		if (!ok) {
-			nodes_.pop();
 			return false;
 		}// error already set
-		ptab->erase(name);
-		ptab->insert(std::map<std::string, UvmStorageValue>::value_type(name, *currentValue()));
-		//ptab->[name] = *currentValue();
-		nodes_.pop();
-		
+		lua_rawseti(L_, members_values_index_, ++members_values_count_);
+		members_.push_back(std::make_pair(std::move(name), members_values_count_));
+
 		Token comma;
 		if (!readToken(comma) ||
-			(comma.type_ != tokenObjectEnd && comma.type_ != tokenArraySeparator /*&&
-				comma.type_ != tokenComment*/)) {
+			(comma.type_ != tokenObjectEnd && comma.type_ != tokenArraySeparator)) {
 			errormsg = "Missing ',' or '}' in object declaration";
 			if (comma.start_ < end_ && comma.start_ >= begin_) {
 				errormsg = errormsg + ", but got '" + *(comma.end_) + "'";
 			}
 			return addError(errormsg, comma, current_);
-			//return addError("Missing ',' or '}' in object declaration",comma, current_);
 		}
-		/*bool finalizeTokenOk = true;
-		while (comma.type_ == tokenComment && finalizeTokenOk)
-			finalizeTokenOk = readToken(comma);*/
-		if (comma.type_ == tokenObjectEnd)
+		if (comma.type_ == tokenObjectEnd) {
+			// set the members in the order of the UvmTableMap the reader used to build, the last one of the same name wins
+			auto members = members_.begin() + members_begin;
+			lua_table_less less;
+			std::stable_sort(members, members_.end(), [&less](const std::pair<std::string, int>& a, const std::pair<std::string, int>& b) {
+				return less(a.first, b.first);
+			});
+			lua_createtable(L_, 0, 0);
+			for (auto it = members; it != members_.end(); ++it) {
+				auto next = it + 1;
+				if (next != members_.end() && next->first == it->first)
+					continue;
+				lua_rawgeti(L_, members_values_index_, it->second);
+				lua_setfield(L_, -2, it->first.c_str());
+			}
+			members_.resize(members_begin);
+			members_values_count_ = values_begin;
 			return true;
+		}
 	}
 	errormsg = "Missing '}' or object member name";
 	if (tokenName.end_ < end_ && tokenName.start_ >= begin_) {
 		errormsg = errormsg + ", but got '" + *(tokenName.start_) + "'";
 	}
 	return addError(errormsg, tokenName, current_);
-
-	//return addError("Missing '}' or object member name", tokenName,current_);
 }
 
-bool Json_Reader::readArray(Token& token) {
+bool Json_Reader::readArray(Token& token, int depth) {
 	skipSpaces();
-	auto arr = currentValue();
-	arr->type = StorageValueTypes::storage_value_unknown_array;
-	arr->value.table_value = uvm::lua::lib::create_managed_lua_table_map(L_);
-	auto parr = arr->value.table_value;
+	lua_createtable(L_, 0, 0);
 
 	if (current_ != end_ && *current_ == ']') // empty array
 	{
@@ -441,28 +428,16 @@ bool Json_Reader::readArray(Token& token) {
 		return true;
 	}
 
-	int index = 0;
+	lua_Integer index = 0;
 	for (;;) {
-		UvmStorageValue value;
-		nodes_.push(value);
-		bool ok = readValue();
+		bool ok = readValue(depth + 1);
 		if (!ok) { // error already set
-			nodes_.pop();
 			return false;
 		}
-		std::string idx = std::to_string(++index);  //begin from 1
-		parr->erase(idx);
-		//parr->insert(std::map<std::string, UvmStorageValue>::value_type(idx, *currentValue()));
-		(*parr)[idx] = *currentValue();
-		nodes_.pop();
-		////////////////
+		lua_seti(L_, -2, ++index);  //begin from 1
 
 		Token currentToken;
-		// Accept Comment after last item in the array.
 		ok = readToken(currentToken);
-		/*while (currentToken.type_ == tokenComment && ok) {
-			ok = readToken(currentToken);
-		}*/
 		bool badTokenType = (currentToken.type_ != tokenArraySeparator &&
 			currentToken.type_ != tokenArrayEnd);
 		if (!ok || badTokenType) {
@@ -478,104 +453,73 @@ bool Json_Reader::readArray(Token& token) {
 	return true;
 }
 
-bool Json_Reader::decodeNumber(Token& token, UvmStorageValue* number) {
-	// Attempts to parse the number as an integer. If the number is
-	// larger than the maximum supported value of an integer then
-	// we decode the number as a double.
+bool Json_Reader::decodeNumber(Token& token) {
+	// a number is a double only if it has a fractional part
 	Location current = token.start_;
 	bool isNegative = *current == '-';
-	bool isDouble = false;
 	if (isNegative)
 		++current;
-
-	while (current < token.end_) {
-		Char c = *current++;
-		if (c == '.') {
-			isDouble = true;
-			break;
-		}
-	}
-
-	if (isDouble) {
-		return decodeDouble(token, number);
+	if (memchr(current, '.', token.end_ - current)) {
+		return decodeDouble(token);
 	}
 	else {
-		return decodeInteger(token, number);
-	}
-
-	
-
-
-	/*
-	// TODO: Help the compiler do the div and mod at compile time or get rid of
-	// them.
-	Value::LargestUInt maxIntegerValue =
-		isNegative ? Value::LargestUInt(Value::maxLargestInt) + 1
-		: Value::maxLargestUInt;
-	Value::LargestUInt threshold = maxIntegerValue / 10;
-	Value::LargestUInt value = 0;
-	while (current < token.end_) {
-		Char c = *current++;
-		if (c < '0' || c > '9')
-			return decodeDouble(token, number);
-		Value::UInt digit(static_cast<Value::UInt>(c - '0'));
-		if (value >= threshold) {
-			// We've hit or exceeded the max value divided by 10 (rounded down). If
-			// a) we've only just touched the limit, b) this is the last digit, and
-			// c) it's small enough to fit in that rounding delta, we're okay.
-			// Otherwise treat this number as a double to avoid overflow.
-			if (value > threshold || current != token.end_ ||
-				digit > maxIntegerValue % 10) {
-				return decodeDouble(token, decoded);
-			}
-		}
-		value = value * 10 + digit;
+		return decodeInteger(token);
 	}
-	if (isNegative && value == maxIntegerValue)
-		decoded = Value::minLargestInt;
-	else if (isNegative)
-		decoded = -Value::LargestInt(value);
-	else if (value <= Value::LargestUInt(Value::maxInt))
-		decoded = Value::LargestInt(value);
-	else
-		decoded = value;
-	
-	return true;
-	*/
 }
 
-bool Json_Reader::decodeInteger(Token& token, UvmStorageValue* intVal) {
+bool Json_Reader::decodeInteger(Token& token) {
+	// up to 18 digits can't overflow, longer numbers are left to the stream
+	Location current = token.start_;
+	bool isNegative = *current == '-';
+	if (isNegative)
+		++current;
+	Location digits = current;
+	uint64_t fast_value = 0;
+	while (current < token.end_ && *current >= '0' && *current <= '9' && current - digits < 18) {
+		fast_value = fast_value * 10 + (*current - '0');
+		++current;
+	}
+	if (current > digits && (current == token.end_ || *current < '0' || *current > '9')) {
+		lua_pushinteger(L_, isNegative ? -(lua_Integer)fast_value : (lua_Integer)fast_value);
+		return true;
+	}
 	lua_Integer value = 0;
 	std::string buffer(token.start_, token.end_);
 	std::istringstream is(buffer);
 	if (!(is >> value))
 		return addError("'" + std::string(token.start_, token.end_) +
 			"' is not a integer.", token, current_);
-	intVal->type = StorageValueTypes::storage_value_int;
-	intVal->value.int_value = value;
+	lua_pushinteger(L_, value);
 	return true;
 }
 
-bool Json_Reader::decodeDouble(Token& token, UvmStorageValue* doubleVal) {
+bool Json_Reader::decodeDouble(Token& token) {
 	lua_Number value = 0;
 	std::string buffer(token.start_, token.end_);
+	// strtod gives what the stream gives when it reads the whole number without range error,
+	// the other numbers are left to the stream
+	char* parsed_end = nullptr;
+	errno = 0;
+	value = strtod(buffer.c_str(), &parsed_end);
+	if (parsed_end == buffer.c_str() + buffer.size() && errno != ERANGE) {
+		lua_pushnumber(L_, value);
+		return true;
+	}
+	value = 0;
 	std::istringstream is(buffer);
 	if (!(is >> value))
 		return addError("'" + std::string(token.start_, token.end_) +
 			"' is not a number.", token, current_);
-	doubleVal->type = StorageValueTypes::storage_value_number;
-	doubleVal->value.number_value = value;
+	lua_pushnumber(L_, value);
 	return true;
 }
 
 //exist node
-bool Json_Reader::readValue() {
+bool Json_Reader::readValue(int depth) {
 	Token token;
-	std::string decodestr;
-	UvmStorageValue number;
-	auto value = currentValue();
-	//  To preserve the old behaviour we cast size_t to int.
-	if (static_cast<int>(nodes_.size()) > UvmStackLimit)
+	if (depth > UvmStackLimit)
+		return addError("Exceeded stackLimit in readValue().", token, nullptr);
+	if (!lua_checkstack(L_, 2))
 		return addError("Exceeded stackLimit in readValue().", token, nullptr);
 
 	if (!readToken(token)) {
@@ -585,88 +529,35 @@ bool Json_Reader::readValue() {
 		}
 		return addError(errormsg, token, current_);
 	}
-	//skipCommentTokens(token);
 	bool successful = true;
 
 	switch (token.type_) {
 	
 	case tokenObjectBegin:
-		successful = readObject(token);
+		successful = readObject(token, depth);
 		break;
 	case tokenArrayBegin:
-		successful = readArray(token);
+		successful = readArray(token, depth);
 		break;
 	case tokenNumber:
-		successful = decodeNumber(token,&number);
-		if (successful) {
-			auto value = currentValue();
-			*value = number;
-		}
+		successful = decodeNumber(token);
 		break;
 	case tokenString:
-		successful = decodeString(token,true, decodestr);
-		if (successful) {
-			value->type = StorageValueTypes::storage_value_string;
-			value->value.string_value = uvm::lua::lib::malloc_managed_string(L_, decodestr.length() + 1);
-			memset(value->value.string_value, 0x0, decodestr.length() + 1);
-			strncpy(value->value.string_value, decodestr.c_str(), decodestr.length());
-			assert(nullptr != value->value.string_value);
-		}
+		if (string_error_)
+			return addError(string_error_, token, current_);
+		lua_pushlstring(L_, string_, string_size_);
 		break;
 	case tokenTrue: {
-		value->type = StorageValueTypes::storage_value_bool;
-		value->value.bool_value = true;
+		lua_pushboolean(L_, 1);
 	} break;
 	case tokenFalse: {
-		value->type = StorageValueTypes::storage_value_bool;
-		value->value.bool_value = false;
+		lua_pushboolean(L_, 0);
 	} break;
 	case tokenNil: {
-		value->type = StorageValueTypes::storage_value_null;
-	} break;
-	/*
-	case tokenNaN: {
-		Value v(std::numeric_limits<double>::quiet_NaN());
-		currentValue().swapPayload(v);
-		currentValue().setOffsetStart(token.start_ - begin_);
-		currentValue().setOffsetLimit(token.end_ - begin_);
+		lua_pushnil(L_);
 	} break;
-	case tokenPosInf: {
-		Value v(std::numeric_limits<double>::infinity());
-		currentValue().swapPayload(v);
-		currentValue().setOffsetStart(token.start_ - begin_);
-		currentValue().setOffsetLimit(token.end_ - begin_);
-	} break;
-	case tokenNegInf: {
-		Value v(-std::numeric_limits<double>::infinity());
-		currentValue().swapPayload(v);
-		currentValue().setOffsetStart(token.start_ - begin_);
-		currentValue().setOffsetLimit(token.end_ - begin_);
-	} break;
-	case tokenArraySeparator:
-	case tokenObjectEnd:
-	case tokenArrayEnd:
-		if (features_.allowDroppedNullPlaceholders_) {
-			// "Un-read" the current token and mark the current value as a null
-			// token.
-			current_--;
-			Value v;
-			currentValue().swapPayload(v);
-			currentValue().setOffsetStart(current_ - begin_ - 1);
-			currentValue().setOffsetLimit(current_ - begin_);
-			break;
-		} // else, fall through ...
-		*/
 	default:
-		currentValue()->type = StorageValueTypes::storage_value_not_support;
 		return addError("Syntax error: value, object or array expected.", token,nullptr);
 	}
-	/*
-	if (collectComments_) {
-		lastValueEnd_ = current_;
-		lastValue_ = &currentValue();
-	}
-	*/
-	//nodes_.pop();
 	return successful;
-}
\ No newline at end of file
+}
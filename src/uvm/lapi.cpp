@@ -393,8 +393,8 @@ LUA_API const char *lua_tolstring(lua_State *L, int idx, size_t *len) {
 LUA_API size_t lua_rawlen(lua_State *L, int idx) {
     StkId o = index2addr(L, idx);
     switch (ttype(o)) {
-    case LUA_TSHRSTR: return tsvalue(o)->value.size();
-    case LUA_TLNGSTR: return tsvalue(o)->value.size();
+    case LUA_TSHRSTR: return tsvalue(o)->len;
+    case LUA_TLNGSTR: return tsvalue(o)->len;
     case LUA_TUSERDATA: return uvalue(o)->len;
     case LUA_TTABLE: return luaH_getn(hvalue(o));
     default: return 0;
@@ -927,9 +927,20 @@ LUA_API void lua_setuservalue(lua_State *L, int idx) {
 	"results from function overflow current stack size")
 
 
+/*
+** A C function waiting in lua_call/lua_pcall keeps its values on the
+** stack, so the collector may run in the Lua code it calls ('issafepoint'
+** in lgc.cpp). 'ccall' is the flag to restore after the call.
+*/
+#define setccall(ci,ccall)	((ccall) = (ci)->callstatus & CIST_CCALL, (ci)->callstatus |= CIST_CCALL)
+#define resetccall(ci,ccall)	((ci)->callstatus = ((ci)->callstatus & ~CIST_CCALL) | (ccall))
+
+
 LUA_API void lua_callk(lua_State *L, int nargs, int nresults,
     lua_KContext ctx, lua_KFunction k) {
     StkId func;
+    CallInfo *ci = L->ci;
+    unsigned short ccall;
     lua_lock(L);
     api_check(L, k == nullptr || !isLua(L->ci),
         "cannot use continuations inside hooks");
@@ -937,13 +948,15 @@ LUA_API void lua_callk(lua_State *L, int nargs, int nresults,
     api_check(L, L->status == LUA_OK, "cannot do calls on non-normal thread");
     checkresults(L, nargs, nresults);
     func = L->top - (nargs + 1);
+    setccall(ci, ccall);
     if (k != nullptr && L->nny == 0) {  /* need to prepare continuation? */
-        L->ci->u.c.k = k;  /* save continuation */
-        L->ci->u.c.ctx = ctx;  /* save context */
+        ci->u.c.k = k;  /* save continuation */
+        ci->u.c.ctx = ctx;  /* save context */
         luaD_call(L, func, nresults);  /* do the call */
     }
     else  /* no continuation or no yieldable */
         luaD_callnoyield(L, func, nresults);  /* just do the call */
+    resetccall(ci, ccall);
     adjustresults(L, nresults);
     lua_unlock(L);
 }
@@ -971,6 +984,8 @@ LUA_API int lua_pcallk(lua_State *L, int nargs, int nresults, int errfunc,
     struct CallS c;
     int status;
     ptrdiff_t func;
+    CallInfo *ci = L->ci;
+    unsigned short ccall;
     lua_lock(L);
     api_check(L, k == nullptr || !isLua(L->ci),
         "cannot use continuations inside hooks");
@@ -985,12 +1000,12 @@ LUA_API int lua_pcallk(lua_State *L, int nargs, int nresults, int errfunc,
         func = savestack(L, o);
     }
     c.func = L->top - (nargs + 1);  /* function to be called */
+    setccall(ci, ccall);
     if (k == nullptr || L->nny > 0) {  /* no continuation or no yieldable? */
         c.nresults = nresults;  /* do a 'conventional' protected call */
         status = luaD_pcall(L, f_call, &c, savestack(L, c.func), func);
     }
     else {  /* prepare continuation (call is already protected by 'resume') */
-        CallInfo *ci = L->ci;
         ci->u.c.k = k;  /* save continuation */
         ci->u.c.ctx = ctx;  /* save context */
         /* save information for error recovery */
@@ -1004,6 +1019,7 @@ LUA_API int lua_pcallk(lua_State *L, int nargs, int nresults, int errfunc,
         L->errfunc = ci->u.c.old_errfunc;
         status = LUA_OK;  /* if it is here, there were no errors */
     }
+    resetccall(ci, ccall);
 	if (status == LUA_OK && (L->state & (lua_VMState::LVM_STATE_BREAK | lua_VMState::LVM_STATE_SUSPEND))) {
 		lua_unlock(L);
 		return status;
@@ -1085,7 +1101,58 @@ LUA_API int lua_status(lua_State *L) {
 */
 
 LUA_API int lua_gc(lua_State *L, int what, int data) {
-	return 0; // TODO: call vmgc's gc method
+    int res = 0;
+    vmgc::GcState *g;
+    lua_lock(L);
+    g = L->gc_state;
+    switch (what) {
+    case LUA_GCSTOP: {
+        g->gc_set_running(false);
+        break;
+    }
+    case LUA_GCRESTART: {
+        g->gc_set_running(true);
+        break;
+    }
+    case LUA_GCCOLLECT: {
+        luaC_fullgc(L, 0);
+        break;
+    }
+    case LUA_GCCOUNT: {
+        /* GC values are expressed in Kbytes: #bytes/2^10 */
+        res = lua_cast(int, g->usedsize() >> 10);
+        break;
+    }
+    case LUA_GCCOUNTB: {
+        res = lua_cast(int, g->usedsize() & 0x3ff);
+        break;
+    }
+    case LUA_GCSTEP: {
+        uint64_t cycles = g->gc_stats().cycles;
+        bool sweeping = g->gc_is_sweeping();
+        luaC_step(L);
+        /* end of cycle? */
+        res = !g->gc_is_sweeping() && (sweeping || g->gc_stats().cycles != cycles);
+        break;
+    }
+    case LUA_GCSETPAUSE: {
+        res = g->gc_pause();
+        g->gc_set_pause(data);
+        break;
+    }
+    case LUA_GCSETSTEPMUL: {
+        res = g->gc_stepmul();
+        g->gc_set_stepmul(data);
+        break;
+    }
+    case LUA_GCISRUNNING: {
+        res = g->gc_running();
+        break;
+    }
+    default: res = -1;  /* invalid option */
+    }
+    lua_unlock(L);
+    return res;
 }
 
 
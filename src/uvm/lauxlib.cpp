@@ -16,6 +16,7 @@
 #include <string.h>
 #include <signal.h>
 #include <cstdint>
+#include <cmath>
 #include <string>
 #include <sstream>
 #include <iostream>
@@ -1195,7 +1196,7 @@ static bool contract_table_traverser_to_wrap_api(lua_State *L, void *ud)
 
 static bool lua_get_contract_apis_direct(lua_State *L, UvmModuleByteStream *stream, char *error)
 {
-	int64_t *stopped_pointer = uvm::lua::lib::get_lua_state_value(L, LUA_STATE_STOP_TO_RUN_IN_LVM_STATE_MAP_KEY).int_pointer_value;
+	int64_t *stopped_pointer = L->state_context->stop_in_lvm;
     if (nullptr != stopped_pointer && (*stopped_pointer) > 0)
         return false;
     intptr_t stream_p = (intptr_t)stream;
@@ -2754,85 +2755,296 @@ static bool is_uvm_array_table(UvmTableMapP map) {
 	return is_array;
 }
 
-/**
- * parse map to json string
- * @param map
- * @param ss
- * @param is_array whether treat it as a json array(table have hash port and array part)
- */
-static void luatablemap_to_json_stream(UvmTableMapP map, uvm::util::stringbuffer& ss, bool is_array=false)
-{
-	if(!is_array)
-	{
-		// check whether is array
-		is_array = is_uvm_array_table(map);
+// same as boost::lexical_cast<int> of an array key in is_uvm_array_table: an optional sign and decimal digits
+// in the int range, parsed without throwing for the keys that aren't numbers
+static bool parse_uvm_array_key(const std::string& key, int& int_key) {
+	auto p = key.data();
+	auto end = p + key.size();
+	bool negative = false;
+	if (p != end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+	if (p == end)
+		return false;
+	int64_t value = 0;
+	for (; p != end; ++p) {
+		if (*p < '0' || *p > '9')
+			return false;
+		value = value * 10 + (*p - '0');
+		if (value > int64_t(INT32_MAX) + 1)
+			return false;
 	}
+	if (negative)
+		value = -value;
+	if (value > INT32_MAX)
+		return false;
+	int_key = int(value);
+	return true;
+}
 
-	if (is_array)
-		ss.put("[");
-	else
-		ss.put("{");
-    for (auto it = map->begin(); it != map->end(); ++it)
-    {
-        if (it != map->begin())
-            ss.put(",");
-        struct UvmStorageValue value = it->second;
-		if (!is_array)
+static void append_json_escaped(std::string& out, const char* str, size_t size) {
+	auto end = str + size;
+	auto plain = str;
+	for (auto p = str; p != end; ++p) {
+		const char* escaped;
+		switch (*p) {
+		case '\\': escaped = "\\\\"; break;
+		case '"': escaped = "\\\""; break;
+		case '\n': escaped = "\\n"; break;
+		case '\t': escaped = "\\t"; break;
+		case '\a': escaped = "\\a"; break;
+		case '\b': escaped = "\\b"; break;
+		case '\f': escaped = "\\f"; break;
+		case '\r': escaped = "\\r"; break;
+		case '\v': escaped = "\\v"; break;
+		default: continue;
+		}
+		out.append(plain, p);
+		out.append(escaped, 2);
+		plain = p + 1;
+	}
+	out.append(plain, end);
+}
+
+static void append_json_integer(std::string& out, lua_Integer value) {
+	char buf[24];
+	char* p = buf + sizeof(buf);
+	auto n = value < 0 ? (uint64_t)0 - (uint64_t)value : (uint64_t)value;
+	do {
+		*--p = (char)('0' + n % 10);
+		n /= 10;
+	} while (n);
+	if (value < 0)
+		*--p = '-';
+	out.append(p, buf + sizeof(buf) - p);
+}
+
+static void append_json_number(std::string& out, lua_Number value) {
+	// "%f" of an integral double is its integer digits and ".000000"
+	if (value > -1e15 && value < 1e15 && value == (lua_Number)(lua_Integer)value) {
+		if (value == 0 && std::signbit(value))
+			out += '-';
+		append_json_integer(out, (lua_Integer)value);
+		out.append(".000000", 7);
+		return;
+	}
+	char buf[512];
+	auto n = snprintf(buf, sizeof(buf), "%f", value);
+	out.append(buf, n);
+}
+
+namespace {
+	// writes a lua table as json straight into one buffer.
+	// it visits the table like luaL_traverse_table_with_nested (array part with lua_geti, then lua_next) and writes
+	// what the UvmTableMap of the table used to give: members ordered by lua_table_less, the last visited of the same
+	// key wins, a table whose keys are 1..n is an array, and the values are written as the storage values were
+	class LuaTableJsonWriter {
+	public:
+		LuaTableJsonWriter(lua_State *L, const void *root, std::string& out) : _L(L), _root(root), _out(out) {}
+
+		void write_table(int index, size_t recur_depth)
 		{
-			std::string key(it->first);
-			ss.put("\"")->put(uvm::util::escape_string(key))->put("\":");
+			auto L = _L;
+			if (!lua_checkstack(L, 4))
+				luaL_error(L, "table too deep to convert to json");
+			lua_len(L, index);
+			auto len = (size_t)lua_tointegerx(L, -1, nullptr);
+			lua_pop(L, 1);
+			auto members_begin = _members.size();
+			auto values_begin = _out.size();
+			for (size_t i = 0; i < len; ++i)
+			{
+				lua_pushinteger(L, i + 1);
+				lua_geti(L, index, i + 1);
+				write_member(recur_depth + 1);
+				lua_pop(L, 2);
+			}
+			lua_pushvalue(L, index);
+			int it = lua_gettop(L);
+			lua_pushnil(L);
+			while (lua_next(L, it))
+			{
+				if (lua_isinteger(L, -2))
+				{
+					auto key_int = lua_tointeger(L, -2);
+					if (((size_t)key_int) <= len && key_int > 0)
+					{
+						lua_pop(L, 1);
+						continue;
+					}
+				}
+				write_member(recur_depth + 1);
+				lua_pop(L, 1);
+			}
+			lua_pop(L, 1);
+			write_members(members_begin, values_begin);
 		}
-        switch (value.type)
-        {
-		case uvm::blockchain::StorageValueTypes::storage_value_null:
-            ss.put("null");
-            break;
-		case uvm::blockchain::StorageValueTypes::storage_value_bool:
-            ss.put(value.value.bool_value ? "true" : "false");
-            break;
-		case uvm::blockchain::StorageValueTypes::storage_value_int:
-            ss.put(value.value.int_value);
-            break;
-		case uvm::blockchain::StorageValueTypes::storage_value_number:
-			// char buff[50];
-			// l_sprintf(buff, sizeof(buff), LUA_NUMBER_FMT, value.value.number_value);
-			// ss.put(std::string(buff));
-            ss.put(value.value.number_value);
-            break;
-		case uvm::blockchain::StorageValueTypes::storage_value_string:
-        {
-            auto str=std::string(value.value.string_value);
-            ss.put("\"")->put(uvm::util::escape_string(str))->put("\"");
-            break;
-        }
-		case uvm::blockchain::StorageValueTypes::storage_value_userdata:
-            ss.put("\"userdata\"");
-		default: 
+
+	private:
+		struct Member {
+			std::string key;
+			size_t value_begin;
+			size_t value_end;
+		};
+
+		// the member with the key at -2 and the value at -1, as lua_table_to_map_traverser_with_nested reads it
+		void write_member(size_t recur_depth)
 		{
-			if (uvm::blockchain::is_any_table_storage_value_type(value.type)
-				|| uvm::blockchain::is_any_array_storage_value_type(value.type))
+			auto L = _L;
+			if (!lua_isstring(L, -2) && !lua_isinteger(L, -1))
+				return;
+			std::string key;
+			auto key_type = lua_type(L, -2);
+			if (key_type == LUA_TBOOLEAN)
+				key = std::to_string(lua_toboolean(L, -2));
+			else if (lua_isinteger(L, -2))
+				key = std::to_string(lua_tointeger(L, -2));
+			else if (key_type == LUA_TNUMFLT || key_type == LUA_TNUMINT || key_type == LUA_TNUMBER)
+				key = std::to_string(lua_tonumber(L, -2));
+			else if (key_type == LUA_TSTRING)
+				key = std::string(lua_tostring(L, -2));
+			else
+				return;
+			if (key == "package")
+				return;
+			auto value_begin = _out.size();
+			if (lua_istable(L, -1) && lua_topointer(L, -1) == _root)
+				_out.append("\"address\"");
+			else
+				write_value(lua_gettop(L), recur_depth);
+			_members.push_back(Member{ std::move(key), value_begin, _out.size() });
+		}
+
+		// same json as lua_type_to_storage_value_type_with_nested gave
+		void write_value(int index, size_t recur_depth)
+		{
+			auto L = _L;
+			if (recur_depth > LUA_MAP_TRAVERSER_MAX_DEPTH)
+			{
+				_out.append("null");
+				return;
+			}
+			switch (lua_type(L, index))
 			{
-				luatablemap_to_json_stream(value.value.table_value, ss);
+			case LUA_TNIL:
+				_out.append("null");
+				break;
+			case LUA_TBOOLEAN:
+				_out.append(lua_toboolean(L, index) ? "true" : "false");
+				break;
+			case LUA_TNUMBER:
+				if (lua_isinteger(L, index))
+					append_json_integer(_out, lua_tointeger(L, index));
+				else
+					append_json_number(_out, lua_tonumber(L, index));
+				break;
+			case LUA_TSTRING: {
+				// the storage value kept the string up to its first '\0'
+				auto str = lua_tostring(L, index);
+				_out += '"';
+				append_json_escaped(_out, str, strlen(str));
+				_out += '"';
+				break;
+			}
+			case LUA_TTABLE: {
+				try {
+					lua_len(L, index);
+				}
+				catch (...)
+				{
+					_out.append("null");
+					break;
+				}
+				auto len = (size_t)lua_tointegerx(L, -1, nullptr);
+				lua_pop(L, 1);
+				if (len > INT32_MAX)
+				{
+					// too big table
+					_out.append("null");
+					break;
+				}
+				write_table(index, recur_depth + 1);
+				break;
+			}
+			case LUA_TUSERDATA:
+				if (global_uvm_chain_api->is_object_in_pool(L, (intptr_t)lua_touserdata(L, index), UvmOutsideObjectTypes::OUTSIDE_STREAM_STORAGE_TYPE))
+					_out.append("\"userdata\"");
+				else
+					_out.append("\"userdata\"\"userdata\"");
+				break;
+			default:
+				_out.append("\"userdata\"");
 				break;
 			}
-			ss.put("\"userdata\"");
 		}
-        }
-    }
-	if (is_array)
-		ss.put("]");
-	else
-		ss.put("}");
+
+		// replace the values written from values_begin by the table json
+		void write_members(size_t members_begin, size_t values_begin)
+		{
+			_order.clear();
+			for (auto i = members_begin; i < _members.size(); ++i)
+				_order.push_back(i);
+			lua_table_less less;
+			auto member_less = [&](size_t a, size_t b) { return less(_members[a].key, _members[b].key); };
+			if (std::adjacent_find(_order.begin(), _order.end(), [&](size_t a, size_t b) { return !member_less(a, b); }) != _order.end())
+			{
+				std::stable_sort(_order.begin(), _order.end(), member_less);
+				// keep the last visited of each key
+				size_t unique_count = 0;
+				for (size_t i = 0; i < _order.size(); ++i)
+				{
+					if (i + 1 < _order.size() && !member_less(_order[i], _order[i + 1]))
+						continue;
+					_order[unique_count++] = _order[i];
+				}
+				_order.resize(unique_count);
+			}
+
+			bool is_array = true;
+			_seen_keys.assign(_order.size(), false);
+			for (auto i : _order)
+			{
+				int int_key = 0;
+				if (!parse_uvm_array_key(_members[i].key, int_key) || int_key < 1 || size_t(int_key) > _order.size() || _seen_keys[int_key - 1])
+				{
+					is_array = false;
+					break;
+				}
+				_seen_keys[int_key - 1] = true;
+			}
+
+			_scratch.clear();
+			_scratch += is_array ? '[' : '{';
+			for (size_t i = 0; i < _order.size(); ++i)
+			{
+				const auto& member = _members[_order[i]];
+				if (i > 0)
+					_scratch += ',';
+				if (!is_array)
+				{
+					_scratch += '"';
+					append_json_escaped(_scratch, member.key.data(), member.key.size());
+					_scratch.append("\":");
+				}
+				_scratch.append(_out, member.value_begin, member.value_end - member.value_begin);
+			}
+			_scratch += is_array ? ']' : '}';
+			_out.resize(values_begin);
+			_out.append(_scratch);
+			_members.resize(members_begin);
+		}
+
+		lua_State *_L;
+		const void *_root;
+		std::string& _out;
+		std::vector<Member> _members;
+		std::vector<size_t> _order;
+		std::vector<bool> _seen_keys;
+		std::string _scratch;
+	};
 }
 
-static const char *tojsonstring_with_nested(lua_State *L, int idx, size_t *len, std::list<const void*> &jsons)
+LUALIB_API const char *(luaL_tojsonstring)(lua_State *L, int idx, size_t *len)
 {
-    const void *addr = lua_topointer(L, idx);
-    if (nullptr != addr && uvm::util::find(jsons.begin(), jsons.end(), addr))
-    {
-        lua_pushfstring(L, "%p", addr);
-        return lua_tolstring(L, -1, len);
-    }
     if (!luaL_callmeta(L, idx, "__tojsonstring")) {  /* no metafield? */
         switch (lua_type(L, idx)) {
         case LUA_TNUMBER: {
@@ -2853,12 +3065,10 @@ static const char *tojsonstring_with_nested(lua_State *L, int idx, size_t *len,
             break;
         case LUA_TTABLE:
         {
-            jsons.push_back(addr);
-            UvmTableMapP map = luaL_create_lua_table_map_in_memory_pool(L);
-            luaL_traverse_table_with_nested(L, idx, lua_table_to_map_traverser_with_nested, map, jsons, 0);
-            uvm::util::stringbuffer ss;
-            luatablemap_to_json_stream(map, ss);
-			std::string result_str(ss.str());
+            idx = lua_absindex(L, idx);
+            std::string result_str;
+            LuaTableJsonWriter writer(L, lua_topointer(L, idx), result_str);
+            writer.write_table(idx, 0);
             if (len)
                 *len = result_str.size();
             lua_pushlstring(L, result_str.c_str(), result_str.size());
@@ -2873,12 +3083,6 @@ static const char *tojsonstring_with_nested(lua_State *L, int idx, size_t *len,
     return lua_tolstring(L, -1, len);
 }
 
-LUALIB_API const char *(luaL_tojsonstring)(lua_State *L, int idx, size_t *len)
-{
-    std::list<const void*> jsons;
-    return tojsonstring_with_nested(L, idx, len, jsons);
-}
-
 static cbor::CborObjectP uvm_json_item_to_cbor(const UvmStorageValue& value) {
 	switch (value.type) {
 	case uvm::blockchain::StorageValueTypes::storage_value_null:
@@ -846,7 +846,10 @@ int luaD_protectedparser(lua_State *L, ZIO *z, const char *name,
     const char *mode) {
     struct SParser p;
     int status;
+    CallInfo *ci = L->ci;
+    unsigned short parser = ci->callstatus & CIST_PARSER;
     L->nny++;  /* cannot yield during parsing */
+    ci->callstatus |= CIST_PARSER;  /* a reader calling Lua must not collect the chunk being built */
     p.z = z; p.name = name; p.mode = mode;
     p.dyd.actvar.arr = nullptr; p.dyd.actvar.size = 0;
     p.dyd.gt.arr = nullptr; p.dyd.gt.size = 0;
@@ -857,6 +860,7 @@ int luaD_protectedparser(lua_State *L, ZIO *z, const char *name,
     luaM_freearray(L, p.dyd.actvar.arr, p.dyd.actvar.size);
     luaM_freearray(L, p.dyd.gt.arr, p.dyd.gt.size);
     luaM_freearray(L, p.dyd.label.arr, p.dyd.label.size);
+    ci->callstatus = (ci->callstatus & ~CIST_PARSER) | parser;
     L->nny--;
     return status;
 }
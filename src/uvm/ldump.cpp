@@ -101,7 +101,11 @@ static void DumpConstants(const uvm_types::GcProto *f, DumpState *D) {
     DumpInt(n, D);
     for (i = 0; i < n; i++) {
         const TValue *o = &f->ks[i];
-        DumpByte(ttype(o), D);
+        /* string tag by length as lundump reads it back, not by how the string was created */
+        if (ttisstring(o))
+            DumpByte(tsslen(tsvalue(o)) <= LUAI_MAXSHORTLEN ? LUA_TSHRSTR : LUA_TLNGSTR, D);
+        else
+            DumpByte(ttype(o), D);
         switch (ttype(o)) {
         case LUA_TNIL:
             break;
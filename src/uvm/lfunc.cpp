@@ -18,6 +18,7 @@
 #include "uvm/lgc.h"
 #include "uvm/lmem.h"
 #include "uvm/lobject.h"
+#include "uvm/lopcodes.h"
 #include "uvm/lstate.h"
 
 
@@ -109,6 +110,48 @@ void luaF_freeproto(lua_State *L, uvm_types::GcProto *f) {
 }
 
 
+/*
+** Precompute gas metering runs of 'f'. A run follows the fall-through
+** path of the code: a test that skips its jump continues after that
+** jump, and the run ends at every other jump, loop or call instruction.
+** 'gasblocks[pc]' is the number of instructions a run starting at 'pc'
+** executes; the VM charges it at once and gives back the rest when a
+** test takes its jump or anything can observe the counter.
+*/
+void luaF_buildgasblocks(uvm_types::GcProto *f) {
+	int n = int(f->codes.size());
+	f->gasblocks.resize(n);
+	for (int pc = n - 1; pc >= 0; pc--) {
+		Instruction i = f->codes[pc];
+		int next = pc + 1;  /* next instruction executed in the run, -1 if the run ends */
+		switch (GET_OPCODE(i)) {
+		case UOP_EQ: case UOP_LT: case UOP_LE:
+		case UOP_TEST: case UOP_TESTSET:
+		case UOP_LOADKX:  /* next instruction is skipped or only read */
+			next = pc + 2;
+			break;
+		case UOP_LOADBOOL:
+			if (GETARG_C(i))
+				next = pc + 2;
+			break;
+		case UOP_SETLIST:
+			if (GETARG_C(i) == 0)  /* followed by an EXTRAARG */
+				next = pc + 2;
+			break;
+		case UOP_JMP: case UOP_FORLOOP: case UOP_FORPREP:
+		case UOP_TFORCALL: case UOP_TFORLOOP:
+		case UOP_CALL: case UOP_TAILCALL: case UOP_RETURN:
+		case UOP_CCALL: case UOP_CSTATICCALL:
+			next = -1;
+			break;
+		default:
+			break;
+		}
+		f->gasblocks[pc] = (next < 0 || next >= n) ? 1 : f->gasblocks[next] + 1;
+	}
+}
+
+
 /*
 ** Look for n-th local variable at line 'line' in function 'func'.
 ** Returns nullptr if not found.
@@ -28,93 +28,203 @@
 
 
 /*
-** internal state for collector while inside the atomic phase. The
-** collector should never be in this state while running regular code.
+** The collector marks in one atomic step and sweeps incrementally.
+** Table writes have no write barriers in this VM, so the mark phase
+** cannot be interleaved with the mutator. Dead objects are freed a few
+** at a time in allocation order, and all steps are triggered by the
+** used size only, so the heap evolves the same way on every node.
 */
-#define GCSinsideatomic		(GCSpause + 1)
 
-/*
-** cost of sweeping one element (the size of a small object divided
-** by some adjust for the sweep speed)
-*/
-#define GCSWEEPCOST	((sizeof(TString) + 4) / 4)
+/* dead objects freed by one sweep step */
+#define GCSWEEPSTEP(g)	(lua_cast(size_t, GC_SWEEP_STEP_COUNT) * (g)->gc_stepmul() / 100 + 1)
+
 
-/* maximum number of elements to sweep in each single step */
-#define GCSWEEPMAX	(cast_int((GCSTEPSIZE / GCSWEEPCOST) / 4))
+typedef struct GCMarkState {
+	lua_State *L;
+	vmgc::GcState *g;
+	std::vector<vmgc::GcObject*> gray;  /* marked objects not traversed yet */
+	std::vector<uvm_types::GcProto*> protos;  /* marked prototypes */
+} GCMarkState;
 
-/* cost of calling one finalizer */
-#define GCFINALIZECOST	GCSWEEPCOST
 
+static void reallymarkobject(GCMarkState *ms, vmgc::GcObject *o) {
+	if (!ms->g->gc_mark(o))
+		return;
+	switch (o->tt) {
+	case LUA_TSHRSTR: case LUA_TLNGSTR: case LUA_TTHREAD:
+		break;  /* nothing to traverse */
+	default:
+		ms->gray.push_back(o);
+	}
+}
+
+#define markvalue(ms,o)	{ if (iscollectable(o)) reallymarkobject(ms, gcvalue(o)); }
 
 /*
-** macro to adjust 'stepmul': 'stepmul' is actually used like
-** 'stepmul / STEPMULADJ' (value chosen by tests)
+** mark an object that can be nullptr (either because it is really optional,
+** or it was stripped as debug info, or inside an uncompleted structure)
 */
-#define STEPMULADJ		200
+#define markobjectN(ms,t)	{ if (t) reallymarkobject(ms, t); }
 
 
 /*
-** macro to adjust 'pause': 'pause' is actually used like
-** 'pause / PAUSEADJ' (value chosen by tests)
+
+** barrier that moves collector backward, that is, mark the black object
+** pointing to a white object as gray again.
 */
-#define PAUSEADJ		100
+void luaC_barrierback_(lua_State *L, uvm_types::GcTable *t) {
+
+}
 
 
 /*
-** 'makewhite' erases all color bits then sets only the current white
-** bit
+** barrier for assignments to closed upvalues. Because upvalues are
+** shared among closures, it is impossible to know the color of all
+** closures pointing to it. So, we assume that the object being assigned
+** must be marked.
 */
-#define maskcolors	(~(bitmask(BLACKBIT) | WHITEBITS))
-#define makewhite(g,x)	\
- (x->marked = cast_byte((x->marked & maskcolors) | luaC_white(g)))
+void luaC_upvalbarrier_(lua_State *L, UpVal *uv) {
 
-#define white2gray(x)	resetbits(x->marked, WHITEBITS)
-#define black2gray(x)	resetbit(x->marked, BLACKBIT)
+}
 
+/* }====================================================== */
 
-#define valiswhite(x)   (iscollectable(x) && iswhite(gcvalue(x)))
 
-#define checkdeadkey(n)	lua_assert(!ttisdeadkey(gkey(n)) || ttisnil(gval(n)))
+/*
+** {======================================================
+** Mark
+** =======================================================
+*/
 
+static void traversetable(GCMarkState *ms, uvm_types::GcTable *h) {
+	markobjectN(ms, h->metatable);
+	for (const auto &v : h->array)
+		markvalue(ms, &v);
+	for (const auto &node : h->nodes) {
+		markvalue(ms, &node.key);
+		markvalue(ms, &node.value);
+	}
+}
 
-#define checkconsistency(obj)  \
-  lua_longassert(!iscollectable(obj) || righttt(obj))
 
+static void traverseproto(GCMarkState *ms, uvm_types::GcProto *f) {
+	ms->protos.push_back(f);
+	markobjectN(ms, f->source);
+	for (const auto &k : f->ks)
+		markvalue(ms, &k);
+	for (auto p : f->ps)
+		markobjectN(ms, p);
+	for (const auto &uv : f->upvalues)
+		markobjectN(ms, uv.name);
+	for (const auto &lv : f->locvars)
+		markobjectN(ms, lv.varname);
+}
 
-#define markvalue(g,o) { checkconsistency(o); \
-  if (valiswhite(o)) reallymarkobject(g,gcvalue(o)); }
 
-#define markobject(g,t)	{ if (iswhite(t)) reallymarkobject(g, obj2gco(t)); }
+static void traverseLclosure(GCMarkState *ms, uvm_types::GcLClosure *cl) {
+	markobjectN(ms, cl->p);
+	for (auto uv : cl->upvals) {
+		if (uv)  /* open upvalues point to the stack, which is marked anyway */
+			markvalue(ms, uv->v);
+	}
+}
 
-/*
-** mark an object that can be nullptr (either because it is really optional,
-** or it was stripped as debug info, or inside an uncompleted structure)
-*/
-#define markobjectN(g,t)	{ if (t) markobject(g,t); }
 
+static void traverseCclosure(GCMarkState *ms, uvm_types::GcCClosure *cl) {
+	for (const auto &v : cl->upvalue)
+		markvalue(ms, &v);
+}
 
-/*
 
-** barrier that moves collector backward, that is, mark the black object
-** pointing to a white object as gray again.
-*/
-void luaC_barrierback_(lua_State *L, uvm_types::GcTable *t) {
+static void traverseudata(GCMarkState *ms, uvm_types::GcUserdata *u) {
+	markobjectN(ms, u->metatable);
+	if (u->ttuv_ & BIT_ISCOLLECTABLE)
+		markobjectN(ms, u->user_.gco);
+}
 
+
+static void propagateall(GCMarkState *ms) {
+	while (!ms->gray.empty()) {
+		vmgc::GcObject *o = ms->gray.back();
+		ms->gray.pop_back();
+		switch (o->tt) {
+		case LUA_TTABLE: traversetable(ms, gco2t(o)); break;
+		case LUA_TLCL: traverseLclosure(ms, gco2lcl(o)); break;
+		case LUA_TCCL: traverseCclosure(ms, gco2ccl(o)); break;
+		case LUA_TUSERDATA: traverseudata(ms, gco2u(o)); break;
+		case LUA_TPROTO: traverseproto(ms, gco2p(o)); break;
+		default: lua_assert(0);
+		}
+	}
 }
 
 
 /*
-** barrier for assignments to closed upvalues. Because upvalues are
-** shared among closures, it is impossible to know the color of all
-** closures pointing to it. So, we assume that the object being assigned
-** must be marked.
+** mark the live part of the stack and clear the rest, so stale slots
+** never point to objects freed by this cycle
 */
-void luaC_upvalbarrier_(lua_State *L, UpVal *uv) {
+static void traversestack(GCMarkState *ms, lua_State *L) {
+	StkId o = L->stack;
+	if (o == nullptr)
+		return;  /* stack not completely built yet */
+	for (; o < L->top; o++)
+		markvalue(ms, o);
+	for (; o < L->stack + L->stacksize; o++)
+		setnilvalue(o);
+	for (o = L->evalstack; o != nullptr && o < L->evalstacktop; o++)
+		markvalue(ms, o);
+}
+
+
+static void markroots(GCMarkState *ms) {
+	lua_State *L = ms->L;
+	int i, j;
+	traversestack(ms, L);
+	markvalue(ms, &L->l_registry);
+	markobjectN(ms, L->memerrmsg);
+	for (i = 0; i < TM_N; i++)
+		markobjectN(ms, L->tmname[i]);
+	for (i = 0; i < LUA_NUMTAGS; i++)
+		markobjectN(ms, L->mt[i]);
+	for (i = 0; i < STRCACHE_N; i++)
+		for (j = 0; j < STRCACHE_M; j++)
+			markobjectN(ms, L->strcache[i][j]);
+	/* contract tables are looked up by address, never reuse them */
+	if (L->contract_table_addresses) {
+		for (auto addr : *L->contract_table_addresses)
+			markobjectN(ms, reinterpret_cast<uvm_types::GcTable*>(addr));
+	}
+}
+
 
+/*
+** mark all objects reachable from the roots and queue the others for
+** the sweep
+*/
+static void atomic(lua_State *L) {
+	GCMarkState ms;
+	ms.L = L;
+	ms.g = L->gc_state;
+	ms.g->gc_begin_mark();
+	markroots(&ms);
+	propagateall(&ms);
+	/* a dead closure must not come back through the cache of its prototype */
+	for (auto p : ms.protos) {
+		if (p->cache && !ms.g->gc_is_marked(p->cache))
+			p->cache = nullptr;
+	}
+	ms.g->gc_end_mark();
 }
 
 /* }====================================================== */
 
+
+/*
+** {======================================================
+** Sweep
+** =======================================================
+*/
+
 static void freeLclosure(lua_State *L, uvm_types::GcLClosure *cl) {
     int i;
     for (i = 0; i < cl->nupvalues; i++) {
@@ -132,6 +242,45 @@ void luaC_upvdeccount(lua_State *L, UpVal *uv) {
 		L->gc_state->gc_free(uv);
 }
 
+
+/* release the raw buffers owned by a dead object, before its destructor */
+static void freeobj(lua_State *L, vmgc::GcObject *o) {
+	switch (o->tt) {
+	case LUA_TLCL: freeLclosure(L, gco2lcl(o)); break;
+	case LUA_TUSERDATA: L->gc_state->gc_free(gco2u(o)->gc_value); break;
+	case LUA_TSHRSTR: luaS_remove(L, gco2ts(o)); break;  /* remove it from the string table */
+	default: break;
+	}
+}
+
+
+static void setpause(vmgc::GcState *g) {
+	ptrdiff_t estimate = g->usedsize();
+	ptrdiff_t threshold = (estimate / 100) * g->gc_pause();
+	if (threshold < DEFAULT_GC_MIN_THRESHOLD)
+		threshold = DEFAULT_GC_MIN_THRESHOLD;
+	g->gc_set_threshold(threshold);
+	g->gc_stats().live_size = estimate;
+}
+
+
+/* returns 1 when the sweep of the cycle is finished */
+static int sweepstep(lua_State *L) {
+	vmgc::GcState *g = L->gc_state;
+	/* free at least stepmul% of the bytes allowed between two steps, so
+	   the sweep keeps ahead of scripts allocating many small objects */
+	uint64_t goal = g->gc_stats().swept_bytes + uint64_t(GC_STEP_SIZE) * g->gc_stepmul() / 100;
+	do {
+		g->gc_sweep_step(GCSWEEPSTEP(g), [L](vmgc::GcObject *o) { freeobj(L, o); });
+	} while (g->gc_is_sweeping() && g->gc_stats().swept_bytes < goal);
+	if (g->gc_is_sweeping()) {
+		g->gc_set_threshold(g->usedsize() + GC_STEP_SIZE);
+		return 0;
+	}
+	setpause(g);
+	return 1;
+}
+
 /* }====================================================== */
 
 
@@ -140,27 +289,56 @@ void luaC_freeallobjects(lua_State *L) {
 	L->gc_state->gc_free_all();
 }
 
+
+/*
+** C functions may keep objects in local variables the collector cannot
+** see, so a collection only runs while every C function in the call
+** chain is the one calling the API or waits in lua_call/lua_pcall (the
+** libraries keep the values they use after the call on the stack), and
+** no chunk is being loaded. A C function that reaches Lua any other
+** way (a metamethod run by lua_gettable, lua_arith...) still stops it.
+*/
+static int issafepoint(lua_State *L) {
+	CallInfo *ci;
+	for (ci = L->ci; ci != nullptr; ci = ci->previous) {
+		if (ci->callstatus & CIST_PARSER)
+			return 0;  /* prototypes being built are not anchored yet */
+		if (ci != L->ci && ci != &L->base_ci && !isLua(ci) && !(ci->callstatus & CIST_CCALL))
+			return 0;
+	}
+	return 1;
+}
+
+
 /*
-** performs a basic GC step when collector is running
+** performs a basic GC step when collector is running: the whole mark
+** phase when a cycle starts, then a bounded part of the sweep
 */
 void luaC_step(lua_State *L) {
-
+	vmgc::GcState *g = L->gc_state;
+	if (!g->gc_running() || !issafepoint(L)) {
+		g->gc_set_threshold(g->usedsize() + GC_STEP_SIZE);  /* try again later */
+		return;
+	}
+	g->gc_stats().steps++;
+	if (!g->gc_is_sweeping())
+		atomic(L);
+	sweepstep(L);
 }
 
 
 /*
-** Performs a full GC cycle; if 'isemergency', set a flag to avoid
-** some operations which could change the interpreter state in some
-** unexpected ways (running finalizers and shrinking some structures).
-** Before running the collection, check 'keepinvariant'; if it is true,
-** there may be some objects marked as black, so the collector has
-** to sweep all objects to turn them back to white (as white has not
-** changed, nothing will be collected).
+** Performs a full GC cycle. Emergency collections are not run: they
+** come from allocation sites inside the core, which may hold objects
+** not anchored yet.
 */
 void luaC_fullgc(lua_State *L, int isemergency) {
-
+	vmgc::GcState *g = L->gc_state;
+	if (isemergency || !issafepoint(L))
+		return;
+	g->gc_stats().steps++;
+	atomic(L);
+	while (!sweepstep(L)) {}
 }
 
 /* }====================================================== */
-
-
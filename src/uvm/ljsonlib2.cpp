@@ -40,8 +40,9 @@ static int json_to_lua(lua_State *L)
 		return 0;
 	if (!lua_isstring(L, 1))
 		return 0;
-	std::string json_str(luaL_checkstring(L, 1));
-	auto json_str_size = json_str.size();
+	// the json is read in place, up to its first '\0' as before
+	const char* json_str = luaL_checkstring(L, 1);
+	auto json_str_size = strlen(json_str);
 	size_t little_large_size = 10000;
 	size_t very_large_size = 100000;
 	if (json_str_size > little_large_size) {
@@ -56,14 +57,12 @@ static int json_to_lua(lua_State *L)
 			}
 		}
 	}
-	auto json_parser = std::make_shared<Json_Reader>();
-	UvmStorageValue root;
-	if (json_parser->parse(L, json_str, &root)) {
-		lua_push_storage_value(L, root);
+	Json_Reader json_parser;
+	if (json_parser.parse(L, json_str, json_str_size)) {
 		return 1;
 	}
 	else {
-		global_uvm_chain_api->throw_exception(L, UVM_API_SIMPLE_ERROR, "parse json error(%s)", json_parser->error.message_.c_str());
+		global_uvm_chain_api->throw_exception(L, UVM_API_SIMPLE_ERROR, "parse json error(%s)", json_parser.error.message_.c_str());
 		return 0;
 	}
 
@@ -467,11 +467,17 @@ static int searcher_uvm(lua_State *L) {
             }
         }
     } stream_scope(L, name, stream.get());
-    uvm_types::GcLClosure *closure = uvm::lua::lib::luaU_undump_from_stream(L, stream.get(), uvm::lua::lib::unwrap_any_contract_name(origin_contract_name).c_str());
-	if (!closure)
-	{
-		return 1;
-	}
+    // hot contracts are loaded from the decoded prototypes cached by bytecode
+    uvm_types::GcLClosure *closure = uvm::lua::lib::load_contract_proto_from_cache(L, stream.get());
+    bool from_cache = closure != nullptr;
+    if (!from_cache)
+    {
+        closure = uvm::lua::lib::luaU_undump_from_stream(L, stream.get(), uvm::lua::lib::unwrap_any_contract_name(origin_contract_name).c_str());
+    }
+    if (!closure)
+    {
+        return 1;
+    }
 #if(CHECK_CONTRACT_CODE_EVERY_TIME)
     if (!uvm::lua::lib::check_contract_proto(L, closure->p, error))
     {
@@ -483,8 +489,13 @@ static int searcher_uvm(lua_State *L) {
         return 1;
     }
 #endif
+    if (from_cache)
+        return checkload(L, 1, name);
 
-    return checkload(L, (luaL_loadbufferx(L, stream->buff.data(), stream->buff.size(), stream->is_bytes ? "binary" : "text", nullptr) == LUA_OK), name);
+    bool loaded = luaL_loadbufferx(L, stream->buff.data(), stream->buff.size(), stream->is_bytes ? "binary" : "text", nullptr) == LUA_OK;
+    if (loaded)
+        uvm::lua::lib::put_contract_proto_to_cache(stream.get(), clLvalue(L->top - 1));
+    return checkload(L, loaded, name);
 }
 
 
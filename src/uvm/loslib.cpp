@@ -20,6 +20,7 @@
 
 #include "uvm/lauxlib.h"
 #include "uvm/lualib.h"
+#include "uvm/uvm_lib.h"
 
 /*
 ** {==================================================================
@@ -174,6 +175,13 @@ static int os_clock(lua_State *L) {
 }
 
 
+/* instructions executed so far by this state (the gas counter) */
+static int os_instructions(lua_State *L) {
+    lua_pushinteger(L, uvm::lua::lib::get_lua_state_instructions_executed_count(L));
+    return 1;
+}
+
+
 /*
 ** {======================================================
 ** Time/Date operations
@@ -368,6 +376,7 @@ static const luaL_Reg syslib[] = {
     { "execute", os_execute },
     { "exit", os_exit },
     { "getenv", os_getenv },
+    { "instructions", os_instructions },
     { "remove", os_remove },
     { "rename", os_rename },
     { "setlocale", os_setlocale },
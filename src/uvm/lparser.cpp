@@ -42,7 +42,7 @@
 /* because all strings are unified by the scanner, the parser
    can use pointer equality for string equality */
 //#define eqstr(a,b)	((a) == (b))
-#define eqstr(a,b)	(((a)->value).compare((b)->value) == 0 )
+#define eqstr(a,b)	((a) == (b) || (tsslen(a) == tsslen(b) && memcmp(getstr(a), getstr(b), tsslen(a)) == 0))
 
 
 /*
@@ -609,6 +609,7 @@ static void close_func(LexState *ls) {
 	if (fs->nups > f->upvalues.size()) {
 		f->upvalues.resize(fs->nups);
 	}
+	luaF_buildgasblocks(f);
     lua_assert(fs->bl == nullptr);
     ls->fs = fs->prev;
     luaC_checkGC(L);
@@ -245,8 +245,15 @@ static void close_state(lua_State *L) {
 	if (L->using_contract_id_stack) {
 		delete L->using_contract_id_stack;
 	}
+	if (L->state_context) {
+		delete L->state_context;
+		L->state_context = nullptr;
+	}
 	if (L->gc_state) {
-		delete L->gc_state;
+		if (L->gc_state->pooled())
+			vmgc::GcStatePool::thread_pool().release(L->gc_state);
+		else
+			delete L->gc_state;
 		// L->ud = nullptr;
 	}
     // (*g->frealloc)(L->ud, fromstate(L), sizeof(LG), 0);  /* free main block */
@@ -255,7 +262,8 @@ static void close_state(lua_State *L) {
 LUA_API lua_State *lua_newstate(lua_Alloc f, void *ud) {
     int i;
     lua_State *L;
-	auto gc_state = new vmgc::GcState(LUA_MALLOC_TOTAL_SIZE);
+	auto& gc_pool = vmgc::GcStatePool::thread_pool();
+	auto gc_state = gc_pool.enabled() ? gc_pool.acquire(LUA_MALLOC_TOTAL_SIZE) : new vmgc::GcState(LUA_MALLOC_TOTAL_SIZE);
 	if (!gc_state) return nullptr;
     LG *l = lua_cast(LG *, (*f)(ud ? ud : gc_state, nullptr, LUA_TTHREAD, sizeof(LG)));
     if (l == nullptr) return nullptr;
@@ -275,8 +283,8 @@ LUA_API lua_State *lua_newstate(lua_Alloc f, void *ud) {
 	L->ud = ud ? ud : gc_state;
 	L->seed = 1; // makeseed(L);
 	setnilvalue(&L->l_registry);
-	//L->strt.size = L->strt.nuse = 0;
-	//L->strt.hash = nullptr;
+	L->strt.size = L->strt.nuse = 0;
+	L->strt.hash = nullptr;
 
 	L->panic = nullptr;
     preinit_thread(L);
@@ -295,6 +303,7 @@ LUA_API lua_State *lua_newstate(lua_Alloc f, void *ud) {
 	L->allow_contract_modify = 0;
 	L->contract_table_addresses = new std::list<intptr_t>();
 	L->using_contract_id_stack = new std::stack<contract_info_stack_entry>();
+	L->state_context = new UvmStateContext();
 	L->call_op_msg = OpCode(0);
 	L->ci_depth = 0;
 
@@ -308,6 +317,11 @@ LUA_API lua_State *lua_newstate(lua_Alloc f, void *ud) {
 }
 
 
+LUA_API void lua_setgcarena(int enable) {
+	vmgc::GcStatePool::thread_pool().set_enabled(enable != 0);
+}
+
+
 LUA_API void lua_close(lua_State *L) {
     uvm::lua::lib::close_lua_state_values(L);
 	delete L->contract_table_addresses;
@@ -36,10 +36,10 @@
 ** equality for long strings
 */
 int luaS_eqlngstr(uvm_types::GcString *a, uvm_types::GcString *b) {
-	size_t len = a->value.size();
+	size_t len = a->len;
     lua_assert(a->tt == LUA_TLNGSTR && b->tt == LUA_TLNGSTR);
     return (a == b) ||  /* same instance or... */
-        ((len == b->value.size()) &&  /* equal length and ... */
+        ((len == b->len) &&  /* equal length and ... */
         (memcmp(getstr(a), getstr(b), len) == 0));  /* equal contents */
 }
 
@@ -55,8 +55,34 @@ unsigned int luaS_hash(const char *str, size_t l, unsigned int seed) {
 
 unsigned int luaS_hashlongstr(uvm_types::GcString *ts) {
     lua_assert(ts->tt == LUA_TLNGSTR);
-    auto h = luaS_hash(getstr(ts), ts->value.size(), 1);
-    return h;
+    return ts->hash();
+}
+
+
+/*
+** resizes the string table
+*/
+void luaS_resize(lua_State *L, int newsize) {
+    int i;
+    stringtable *tb = &L->strt;
+    auto newhash = static_cast<uvm_types::GcString **>(
+        L->gc_state->gc_malloc_vector(newsize, sizeof(uvm_types::GcString *)));
+    for (i = 0; i < newsize; i++)
+        newhash[i] = nullptr;
+    for (i = 0; i < tb->size; i++) {  /* rehash */
+        uvm_types::GcString *p = tb->hash[i];
+        while (p) {  /* for each node in the list */
+            uvm_types::GcString *hnext = p->hnext;  /* save next */
+            unsigned int h = lmod(p->hashv, newsize);  /* new position */
+            p->hnext = newhash[h];  /* chain it */
+            newhash[h] = p;
+            p = hnext;
+        }
+    }
+    if (tb->hash)
+        L->gc_state->gc_free(tb->hash);
+    tb->hash = newhash;
+    tb->size = newsize;
 }
 
 
@@ -74,7 +100,7 @@ void luaS_clearcache(lua_State *L) {
 */
 void luaS_init(lua_State *L) {
     int i, j;
-    // luaS_resize(L, MINSTRTABSIZE);  /* initial size of string table */
+    luaS_resize(L, MINSTRTABSIZE);  /* initial size of string table */
     /* pre-create memory-error message */
     L->memerrmsg = luaS_newliteral(L, MEMERRMSG);
     for (i = 0; i < STRCACHE_N; i++)  /* fill cache with valid strings */
@@ -89,20 +115,39 @@ void luaS_init(lua_State *L) {
 */
 static uvm_types::GcString *createstrobj(lua_State *L, size_t l, int tag, unsigned int h) {
 	uvm_types::GcString *ts;
-    auto o =  L->gc_state->gc_new_object<uvm_types::GcString>();
-	o->value.resize(l);
-	ts = o;
+    ts = L->gc_state->gc_new_object_with_extra<uvm_types::GcString>((l + 1) * sizeof(char));
+    ts->tt = ts->tt_ = tag;
+    ts->len = l;
+    ts->hashv = h;
+    getstr(ts)[l] = '\0';  /* ending 0 */
     return ts;
 }
 
 
+/*
+** long string whose bytes are filled by the caller, its hash is
+** computed on first use
+*/
 uvm_types::GcString *luaS_createlngstrobj(lua_State *L, size_t l) {
-	uvm_types::GcString *ts = createstrobj(L, l, LUA_TLNGSTR, L->seed);
-	ts->value.resize(l);
+	uvm_types::GcString *ts = createstrobj(L, l, LUA_TLNGSTR, 0);
     return ts;
 }
 
+
+/*
+** removes a dead short string from the string table
+*/
 void luaS_remove(lua_State *L, uvm_types::GcString *ts) {
+    stringtable *tb = &L->strt;
+    if (tb->size == 0)
+        return;
+    uvm_types::GcString **p = &tb->hash[lmod(ts->hashv, tb->size)];
+    while (*p != ts && *p != nullptr)  /* find previous element */
+        p = &(*p)->hnext;
+    if (*p == ts) {
+        *p = (*p)->hnext;  /* remove element from its list */
+        tb->nuse--;
+    }
 }
 
 
@@ -111,10 +156,29 @@ void luaS_remove(lua_State *L, uvm_types::GcString *ts) {
 */
 static uvm_types::GcString *internshrstr(lua_State *L, const char *str, size_t l) {
 	uvm_types::GcString *ts;
-    unsigned int h = luaS_hash(str, l, L->seed);
+    stringtable *tb = &L->strt;
+    unsigned int h = luaS_hash(str, l, 1);  /* same hash as the table keys */
+    uvm_types::GcString **list = &tb->hash[lmod(h, tb->size)];
     lua_assert(str != nullptr);  /* otherwise 'memcmp'/'memcpy' are undefined */
+    for (ts = *list; ts != nullptr; ts = ts->hnext) {
+        if (l == ts->len &&
+            (memcmp(str, getstr(ts), l * sizeof(char)) == 0)) {
+            /* found! */
+            if (L->gc_state->gc_is_sweeping())  /* dead (but not collected yet)? */
+                L->gc_state->gc_mark(ts);  /* resurrect it */
+            return ts;
+        }
+    }
+    if (tb->nuse >= tb->size && tb->size <= MAX_INT / 2) {
+        luaS_resize(L, tb->size * 2);
+        list = &tb->hash[lmod(h, tb->size)];  /* recompute with new size */
+    }
     ts = createstrobj(L, l, LUA_TSHRSTR, h);
+    ts->hashed = true;
     memcpy(getstr(ts), str, l * sizeof(char));
+    ts->hnext = *list;
+    *list = ts;
+    tb->nuse++;
     return ts;
 }
 
@@ -123,8 +187,7 @@ static uvm_types::GcString *internshrstr(lua_State *L, const char *str, size_t l
 ** new string (with explicit length)
 */
 uvm_types::GcString *luaS_newlstr(lua_State *L, const char *str, size_t l) {
-	
-	/*if (l <= LUAI_MAXSHORTLEN)  //short string?
+    if (l <= LUAI_MAXSHORTLEN)  /* short string? */
         return internshrstr(L, str, l);
     else {
 		uvm_types::GcString *ts;
@@ -133,15 +196,7 @@ uvm_types::GcString *luaS_newlstr(lua_State *L, const char *str, size_t l) {
         ts = luaS_createlngstrobj(L, l);
         memcpy(getstr(ts), str, l * sizeof(char));
         return ts;
-    }*/
-	
-	
-	auto ts = L->gc_state->gc_intern_string<uvm_types::GcString>(str,l);
-	//if (isNewStr) {
-	//	ts->value = std::string(str, l);
-	//}
-	return ts;
-
+    }
 }
 
 
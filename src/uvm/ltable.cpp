@@ -72,65 +72,84 @@ static unsigned int arrayindex(const TValue *key) {
     return 0;  /* 'key' did not match some condition */
 }
 
-//static std::string lua_value_to_str(const TValue *key)
-//{
-//	if (ttisstring(key))
-//	{
-//		return std::string(svalue(key));
-//	}
-//	else if (ttisinteger(key))
-//	{
-//		return std::to_string((lua_Integer)nvalue(key));
-//	}
-//	else if (ttisnumber(key))
-//	{
-//		return std::to_string(nvalue(key));
-//	}
-//	else
-//		return "";
-//}
-
-
-static bool val_to_table_key(const TValue* key, std::string& out) {
-	if (ttisnil(key)) {
-		return false;
+/*
+** Keys of the hash part are identified by their table key chars: the
+** decimal form of integers, the bytes of strings, and a tagged address
+** or value for tables, light userdata and booleans. So the integer 1
+** and the string "1" are the same key of the hash part.
+*/
+#define TABLEKEY_BUFSIZE 64
+
+typedef struct TableKeyChars {
+	const char *data;
+	size_t len;
+	char buf[TABLEKEY_BUFSIZE];
+} TableKeyChars;
+
+
+/* writes the decimal form of 'v' at the end of buf[0..size), returns its start */
+static char *format_integer(char *buf, size_t size, int64_t v) {
+	char *p = buf + size;
+	uint64_t u = v < 0 ? (uint64_t)0 - (uint64_t)v : (uint64_t)v;
+	do {
+		*--p = lua_cast(char, '0' + u % 10);
+		u /= 10;
+	} while (u != 0);
+	if (v < 0)
+		*--p = '-';
+	return p;
+}
+
+
+static void integer_key_chars(lua_Integer k, TableKeyChars *out) {
+	out->data = format_integer(out->buf, TABLEKEY_BUFSIZE, k);
+	out->len = lua_cast(size_t, (out->buf + TABLEKEY_BUFSIZE) - out->data);
+}
+
+
+static void tagged_key_chars(const char *tag, int64_t v, TableKeyChars *out) {
+	size_t taglen = strlen(tag);
+	char num[24];
+	const char *digits = format_integer(num, sizeof(num), v);
+	size_t numlen = lua_cast(size_t, (num + sizeof(num)) - digits);
+	memcpy(out->buf, tag, taglen);
+	memcpy(out->buf + taglen, digits, numlen);
+	out->data = out->buf;
+	out->len = taglen + numlen;
+}
+
+
+static bool table_key_chars(const TValue *key, TableKeyChars *out) {
+	if (ttisinteger(key)) {
+		integer_key_chars(ivalue(key), out);
+		return true;
 	}
 	else if (ttisfloat(key)) {
 		lua_Integer k;
-		if (luaV_tointeger(key, &k, 0)) {
-			out = std::to_string(k);
-			return true;
-		}
-		else {
+		if (!luaV_tointeger(key, &k, 0))
 			return false;
-		}
-	}
-	else if (ttisinteger(key)) {
-		lua_Integer k;
-		if (luaV_tointeger(key, &k, 0)) {
-			out = std::to_string(k);
-			return true;
-		}
-		else {
-			lua_Number n = key->value_.n;
-			out = std::to_string(n);
-			return true;
-		}
+		integer_key_chars(k, out);
+		return true;
 	}
 	else if (ttisstring(key)) {
-		out = getstr(gco2ts(key->value_.gco));
+		auto ts = tsvalue(key);
+		out->data = getstr(ts);
+		out->len = tsslen(ts);
 		return true;
 	}
 	else if (ttislightuserdata(key)) {
-		out = std::string("$lightuserdata@") + std::to_string(intptr_t(key->value_.p));
+		tagged_key_chars("$lightuserdata@", intptr_t(pvalue(key)), out);
 		return true;
 	}
 	else if (ttistable(key)) {
-		out = std::string("$table@") + std::to_string(intptr_t(key->value_.gco));
+		tagged_key_chars("$table@", intptr_t(gcvalue(key)), out);
 		return true;
 	}
 	else if (ttisboolean(key)) {
-		out = std::string("$boolean@") + (key->value_.b ? "true" : "false");
+		const char *chars = bvalue(key) ? "$boolean@true" : "$boolean@false";
+		out->len = strlen(chars);
+		memcpy(out->buf, chars, out->len);
+		out->data = out->buf;
 		return true;
 	}
 	else {
@@ -139,53 +158,111 @@ static bool val_to_table_key(const TValue* key, std::string& out) {
 }
 
 
-static bool findindex_of_sorted_table(lua_State *L, uvm_types::GcTable *t, StkId key, unsigned int* array_index, std::string* map_key, bool* is_map_key) {
-	unsigned int i = arrayindex(key);
-	/*if (i == 0 && ttisnil(key)) {
-		*array_index = 0;
-		*is_map_key = false;
-		return true;
-	}*/
-	if (i != 0 && i <= t->array.size())  /* is 'key' inside array part? */
-	{
-		*array_index = i;
-		*is_map_key = false;
-		return true;  /* yes; that's the index */
-	}
-	else {
-		std::string key_str;
-		if (!val_to_table_key(key, key_str)) {
-			return false;
-		}
-		auto key_it = t->keys.find(key_str);
-		if (key_it == t->keys.end())
-			return false;
-		*map_key = key_str;
-		*is_map_key = true;
+static unsigned int table_key_hash(const TValue *key, const TableKeyChars *kc) {
+	if (ttisstring(key))
+		return tsvalue(key)->hash();
+	return luaS_hash(kc->data, kc->len, 1);
+}
+
+
+static bool same_table_key(const TValue *nodekey, const TValue *key, const TableKeyChars *kc) {
+	if (ttisinteger(nodekey) && ttisinteger(key))
+		return ivalue(nodekey) == ivalue(key);
+	if (ttisshrstring(nodekey) && ttisshrstring(key))
+		return tsvalue(nodekey) == tsvalue(key);  /* short strings are interned */
+	if (ttisstring(nodekey) && ttisstring(key) && tsvalue(nodekey) == tsvalue(key))
 		return true;
+	TableKeyChars nodekc;
+	table_key_chars(nodekey, &nodekc);
+	return nodekc.len == kc->len && memcmp(nodekc.data, kc->data, kc->len) == 0;
+}
+
+
+/* returns the index of the node of 'key' in the hash part, or -1 */
+static ptrdiff_t findnode(const uvm_types::GcTable *t, const TValue *key, const TableKeyChars *kc, unsigned int h) {
+	if (t->slots.empty())
+		return -1;
+	size_t mask = t->slots.size() - 1;
+	for (size_t i = h & mask; t->slots[i] != 0; i = (i + 1) & mask) {
+		const auto &n = t->nodes[t->slots[i] - 1];
+		if (n.hash == h && same_table_key(&n.key, key, kc))
+			return ptrdiff_t(t->slots[i] - 1);
 	}
+	return -1;
+}
+
+
+static void insertslot(uvm_types::GcTable *t, size_t nodeindex) {
+	size_t mask = t->slots.size() - 1;
+	size_t i = t->nodes[nodeindex].hash & mask;
+	while (t->slots[i] != 0)
+		i = (i + 1) & mask;
+	t->slots[i] = lua_cast(uint32_t, nodeindex + 1);
+}
+
+
+/* rebuild the slots with 'nslots' (a power of 2) entries */
+static void rehash(uvm_types::GcTable *t, size_t nslots) {
+	t->slots.assign(nslots, 0);
+	for (size_t j = 0; j < t->nodes.size(); j++)
+		insertslot(t, j);
 }
 
-//static const char* NOT_FOUND_KEY = "$NOT_FOUND$";
+
+/* merge the nodes added since the last iteration into the sorted order */
+static void sortnodes(uvm_types::GcTable *t) {
+	if (t->sorted_count == t->nodes.size())
+		return;
+	uvm_types::table_sort_comparator cmp;
+	auto bykey = [t, &cmp](uint32_t a, uint32_t b) {
+		return cmp(t->nodes[a].key, t->nodes[b].key);
+	};
+	auto mid = t->sorted.size();
+	for (size_t j = t->sorted_count; j < t->nodes.size(); j++)
+		t->sorted.push_back(lua_cast(uint32_t, j));
+	std::sort(t->sorted.begin() + mid, t->sorted.end(), bykey);
+	std::inplace_merge(t->sorted.begin(), t->sorted.begin() + mid, t->sorted.end(), bykey);
+	t->sorted_pos.resize(t->nodes.size());
+	for (size_t pos = 0; pos < t->sorted.size(); pos++)
+		t->sorted_pos[t->sorted[pos]] = lua_cast(uint32_t, pos);
+	t->sorted_count = t->nodes.size();
+	t->next_cursor = 0;
+}
+
+
+/* position in sorted to go on after 'key', or -1 if 'key' is not in the hash part */
+static ptrdiff_t nextpos(uvm_types::GcTable *t, const TValue *key) {
+	auto cursor = t->next_cursor;
+	if (cursor < t->sorted.size()) {
+		/* usual case of pairs: 'key' is the key returned by the last call */
+		const TValue *last = &t->nodes[t->sorted[cursor]].key;
+		if (ttisinteger(last) ? (ttisinteger(key) && ivalue(last) == ivalue(key))
+			: (ttisstring(last) && ttisstring(key) && tsvalue(last) == tsvalue(key)))
+			return ptrdiff_t(cursor + 1);
+	}
+	TableKeyChars kc;
+	if (!table_key_chars(key, &kc))
+		return -1;
+	auto n = findnode(t, key, &kc, table_key_hash(key, &kc));
+	if (n < 0)
+		return -1;
+	return ptrdiff_t(t->sorted_pos[n] + 1);
+}
 
 
+/*
+** array part first, then the hash part in table_sort_comparator order.
+** integer and string keys are returned as they were stored, other keys
+** as their table key chars
+*/
 int luaH_next(lua_State *L, uvm_types::GcTable *t, StkId key) {
-	unsigned int array_index;
-	std::string map_key;
-	bool is_map_key;
-	bool use_first_map_key = false;
-	// array_index is index of key1-based0 means not found
-    bool found_key = findindex_of_sorted_table(L, t, key, &array_index, &map_key, &is_map_key);  /* find original element */
-	UNUSED(found_key);
 	if (nullptr == t) {
 		return 0;
 	}
-	if (ttisnil(key)) {
-		array_index = 0;
-		is_map_key = false;
-	}
+	size_t pos = 0;  /* position in sorted hash part to go on */
 	auto array_part_size = t->array.size();
-	if (!is_map_key) {
+	unsigned int array_index = ttisnil(key) ? 0 : arrayindex(key);  /* 1-based */
+	if (ttisnil(key) || (array_index != 0 && array_index <= array_part_size)) {
 		// key in array part
 		for (auto i = array_index; i < array_part_size; i++) {
 			if (!ttisnil(&t->array[i])) {  /* a non-nil value? */
@@ -194,48 +271,36 @@ int luaH_next(lua_State *L, uvm_types::GcTable *t, StkId key) {
 				return 1;
 			}
 		}
-		use_first_map_key = true;
+		sortnodes(t);
 	}
-	// key in map part
-	auto item_value_it = t->entries.begin();
-	if (!use_first_map_key) {
-		auto it = t->keys.find(map_key);
-		if (it == t->keys.end()) {
+	else {
+		// key in map part
+		sortnodes(t);
+		auto next = nextpos(t, key);
+		if (next < 0)
 			return 0;
-		}
-		const auto& item_key = it->second;
-		item_value_it = t->entries.find(item_key);
-		if (item_value_it != t->entries.end())
-			item_value_it++;
+		pos = size_t(next);
 	}
-	do {
-		if (item_value_it == t->entries.end())
-			return 0;
-		if (ttisnil(&item_value_it->second))
-		{
-			item_value_it++;
-			continue;
-		}
-		if (ttisinteger(&item_value_it->first)) {
-			setobj2s(L, key, &item_value_it->first);
-			setobj2s(L, key + 1, &item_value_it->second);
-			return 1;
-		}
-
-		std::string item_key_str;
-		if (!val_to_table_key(&item_value_it->first, item_key_str)) {
-			item_value_it++;
+	for (; pos < t->sorted.size(); pos++) {
+		const auto &node = t->nodes[t->sorted[pos]];
+		if (ttisnil(&node.value))
 			continue;
+		if (ttisinteger(&node.key) || ttisstring(&node.key)) {
+			setobj2s(L, key, &node.key);
 		}
-		auto s = luaS_new(L, item_key_str.c_str());
-		if (!s) {
-			return 0;
+		else {
+			TableKeyChars node_kc;
+			table_key_chars(&node.key, &node_kc);
+			auto s = luaS_newlstr(L, node_kc.data, node_kc.len);
+			if (!s) {
+				return 0;
+			}
+			setsvalue(L, key, s);
 		}
-		setsvalue(L, key, s);
-		setobj2s(L, key + 1, &item_value_it->second);
+		setobj2s(L, key + 1, &node.value);
+		t->next_cursor = pos;
 		return 1;
-	} while (true);
-	
+	}
 	return 0;
 }
 
@@ -259,7 +324,7 @@ void luaH_resize(lua_State *L, uvm_types::GcTable *t, unsigned int nasize,
 
 
 void luaH_resizearray(lua_State *L, uvm_types::GcTable *t, unsigned int nasize) {
-	int nsize = t->entries.size();
+	int nsize = t->nodes.size();
     luaH_resize(L, t, nasize, nsize);
 }
 
@@ -283,6 +348,24 @@ void luaH_setisonlyread(lua_State *L, uvm_types::GcTable *t, bool isOnlyRead) {
 	t->isOnlyRead = isOnlyRead;
 }
 
+/*
+** rebuild the slots of nodes copied from a table of another lua_State.
+** table keys hash by their address, so their hash is computed again
+*/
+void luaH_rehashnodes(uvm_types::GcTable *t, size_t nslots) {
+	for (auto &n : t->nodes) {
+		if (ttistable(&n.key)) {
+			TableKeyChars kc;
+			table_key_chars(&n.key, &kc);
+			n.hash = table_key_hash(&n.key, &kc);
+		}
+	}
+	if (t->nodes.empty())
+		t->slots.clear();
+	else
+		rehash(t, nslots);
+}
+
 /*
 ** inserts a new key into a hash table; first, check whether key's main
 ** position is free. If not, check whether colliding node is in its main
@@ -316,18 +399,27 @@ TValue *luaH_newkey(lua_State *L, uvm_types::GcTable *t, const TValue *key, bool
 		t->array.push_back(*luaO_nilobject);
 		return &t->array[k-1];
 	}
-	TValue key_obj(*key);
-	std::string key_str;
-	if (!val_to_table_key(key, key_str)) {
+	TableKeyChars kc;
+	if (!table_key_chars(key, &kc)) {
 		auto msg = std::string("invalid table key type, got type ") + ttypename(key->tt_);
 		luaG_runerror(L, msg.c_str());
 		return nullptr;
 	}
-	
-	t->entries[key_obj] = *luaO_nilobject;
-	t->keys[key_str] = key_obj;
-	auto it = t->entries.find(key_obj);
-	return &it->second;
+	unsigned int h = table_key_hash(key, &kc);
+	auto n = findnode(t, key, &kc, h);
+	if (n >= 0) {
+		setnilvalue(&t->nodes[n].value);
+		return &t->nodes[n].value;
+	}
+	if ((t->nodes.size() + 1) * 4 > t->slots.size() * 3)  /* keep load factor under 3/4 */
+		rehash(t, t->slots.empty() ? 8 : t->slots.size() * 2);
+	uvm_types::GcTableNode node;
+	node.key = *key;
+	setnilvalue(&node.value);
+	node.hash = h;
+	t->nodes.push_back(node);
+	insertslot(t, t->nodes.size() - 1);
+	return &t->nodes.back().value;
 }
 
 
@@ -337,53 +429,42 @@ TValue *luaH_newkey(lua_State *L, uvm_types::GcTable *t, const TValue *key, bool
 const TValue *luaH_getint(uvm_types::GcTable *t, lua_Integer key) {
     if (l_castS2U(key) - 1 < t->array.size())
         return &t->array[key - 1];
+    else if (t->nodes.empty())
+        return luaO_nilobject;
     else {
-		const auto& key_str = std::to_string(key);
-		auto key_obj_it = t->keys.find(key_str);
-		if (key_obj_it == t->keys.end())
-			return luaO_nilobject;
-		const auto& key_obj = key_obj_it->second;
-		auto val_it = t->entries.find(key_obj);
-		if(val_it == t->entries.end())
-			return luaO_nilobject;
-		return &val_it->second;
+        TValue k;
+        setivalue(&k, key);
+        TableKeyChars kc;
+        integer_key_chars(key, &kc);
+        auto n = findnode(t, &k, &kc, luaS_hash(kc.data, kc.len, 1));
+        return n < 0 ? luaO_nilobject : &t->nodes[n].value;
     }
 }
 
 
 /*
-** search function for short strings
+** "Generic" get version. (Not that generic: not valid for integers,
+** which may be in array part, nor for floats with integral values.)
 */
-const TValue *luaH_getshortstr(uvm_types::GcTable *t, uvm_types::GcString *key) {
-	std::string key_str = key->value;
-	auto key_obj_it = t->keys.find(key_str);
-	if (key_obj_it == t->keys.end())
+static const TValue *getgeneric(uvm_types::GcTable *t, const TValue *key) {
+	if (t->nodes.empty())
 		return luaO_nilobject;
-	const auto& key_obj = key_obj_it->second;
-	auto val_it = t->entries.find(key_obj);
-	if (val_it == t->entries.end())
+	TableKeyChars kc;
+	if (!table_key_chars(key, &kc)) {
 		return luaO_nilobject;
-	return &val_it->second;
+	}
+	auto n = findnode(t, key, &kc, table_key_hash(key, &kc));
+	return n < 0 ? luaO_nilobject : &t->nodes[n].value;
 }
 
 
 /*
-** "Generic" get version. (Not that generic: not valid for integers,
-** which may be in array part, nor for floats with integral values.)
+** search function for short strings
 */
-static const TValue *getgeneric(uvm_types::GcTable *t, const TValue *key) {
-	std::string key_str;
-	if (!val_to_table_key(key, key_str)) {
-		return luaO_nilobject;
-	}
-	auto key_obj_it = t->keys.find(key_str);
-	if (key_obj_it == t->keys.end())
-		return luaO_nilobject;
-	const auto& key_obj = key_obj_it->second;
-	auto val_it = t->entries.find(key_obj);
-	if (val_it == t->entries.end())
-		return luaO_nilobject;
-	return &val_it->second;
+const TValue *luaH_getshortstr(uvm_types::GcTable *t, uvm_types::GcString *key) {
+	TValue ko;
+	setsvalue(lua_cast(lua_State *, nullptr), &ko, key);
+	return getgeneric(t, &ko);
 }
 
 
@@ -486,7 +567,7 @@ int luaH_getn(uvm_types::GcTable *t) {
         return i;
     }
     /* else must find a boundary in hash part */
-    else if (t->entries.empty())  /* hash part is empty? */
+    else if (t->nodes.empty())  /* hash part is empty? */
         return j;  /* that is easy... */
     else return unbound_search(t, j);
 }
@@ -272,6 +272,7 @@ static void LoadFunction(LoadState *S, uvm_types::GcProto *f, uvm_types::GcStrin
 		return;
 	}
     LoadDebug(S, f);
+	luaF_buildgasblocks(f);
 }
 
 
@@ -77,7 +77,8 @@ using uvm::lua::api::global_uvm_chain_api;
 
 #endif
 
-static std::shared_ptr<uvm::core::ExecuteContext> last_execute_context;
+// per thread, so vms running on different threads don't see each other's execute context
+static thread_local std::shared_ptr<uvm::core::ExecuteContext> last_execute_context;
 /*
 ** Try to convert a value to a float. The float case is already handled
 ** by the macro 'tonumber'.
@@ -211,7 +212,7 @@ void luaV_finishset(uvm::core::ExecuteContext* ctx, lua_State *L, const TValue *
 			&& std::find(L->contract_table_addresses->begin(), L->contract_table_addresses->end(), table_addr) != L->contract_table_addresses->end()) {
 			auto msg = std::string("can't modify contract properties");
 			if (ttisstring(key))
-				msg += " " + tsvalue(key)->value;
+				msg += " " + std::string(svalue(key), vslen(key));
 			luaG_runerror(L, msg.c_str());
 			return;
 		}
@@ -266,9 +267,9 @@ void luaV_finishset(uvm::core::ExecuteContext* ctx, lua_State *L, const TValue *
 */
 static int l_strcmp(const uvm_types::GcString *ls, const uvm_types::GcString *rs) {
 	const char *l = getstr(ls);
-	size_t ll = ls->value.size();
+	size_t ll = ls->len;
 	const char *r = getstr(rs);
-	size_t lr = rs->value.size();
+	size_t lr = rs->len;
 	if (ll != lr)
 		return (int)ll - (int)lr;
 	for (;;) {  /* for each segment */
@@ -511,7 +512,7 @@ int luaV_equalobj(lua_State *L, const TValue *t1, const TValue *t2) {
 #define tostring(L,o)  \
 	(ttisstring(o) || (cvt2str(o) && (luaO_tostring(L, o), 1)))
 
-#define isemptystr(o)	(ttisshrstring(o) && tsvalue(o)->value.size() == 0)
+#define isemptystr(o)	(ttisshrstring(o) && tsvalue(o)->len == 0)
 
 /* copy strings in stack from top - n up to top - 1 to buffer */
 static void copy2buff(StkId top, int n, char *buff) {
@@ -587,11 +588,11 @@ void luaV_objlen(lua_State *L, StkId ra, const TValue *rb) {
 		return;
 	}
 	case LUA_TSHRSTR: {
-		setivalue(ra, tsvalue(rb)->value.size());
+		setivalue(ra, tsvalue(rb)->len);
 		return;
 	}
 	case LUA_TLNGSTR: {
-		setivalue(ra, tsvalue(rb)->value.size());
+		setivalue(ra, tsvalue(rb)->len);
 		return;
 	}
 	default: {  /* try metamethod */
@@ -812,15 +813,39 @@ void luaV_finishOp(uvm::core::ExecuteContext* ctx, lua_State *L) {
     ci->u.l.savedpc += GETARG_sBx(i) + e; }
 
 /* for test instructions, execute the jump instruction that follows it */
-#define donextjump(ci)	{ i = *ci->u.l.savedpc; dojump(ci, i, 1); }
+/*
+** gas of a run is charged when the run is entered (see 'executeOps');
+** give back the part not executed yet before anything can look at the
+** counter or the run is left by a jump
+*/
+#define settlegas()	{ if (gas.left > 0) { *insts_executed_count -= gas.left; gas.left = 0; } }
+
+#define donextjump(ci)	{ settlegas(); i = *ci->u.l.savedpc; dojump(ci, i, 1); }
+
+/* skip the jump after a test, or take it, following 'A' */
+#define condjump(ci,c) \
+  { if ((c) != GETARG_A(i)) ci->u.l.savedpc++; else donextjump(ci); }
 
 
-#define Protect(x)	{ {x;}; base = ci->u.l.base; }
+#define Protect(x)	{ settlegas(); {x;}; base = ci->u.l.base; }
 
 #define checkGC(L,c)  \
-	{  }
+	{ luaC_condGC(L, L->top = (c),  /* limit of live values */ \
+                         Protect(L->top = ci->top));  /* restore top */ }
 
 
+/*
+** computed goto dispatch ('ljumptab.h') where the compiler supports
+** labels as values, a switch otherwise
+*/
+#if !defined(UVM_USE_JUMPTABLE)
+#if defined(__GNUC__)
+#define UVM_USE_JUMPTABLE	1
+#else
+#define UVM_USE_JUMPTABLE	0
+#endif
+#endif
+
 #define vmdispatch(o)	switch(o)
 #define vmcase(l)	case l:
 #define vmbreak		break
@@ -844,7 +869,7 @@ void luaV_finishOp(uvm::core::ExecuteContext* ctx, lua_State *L) {
 			&& std::find(L->contract_table_addresses->begin(), L->contract_table_addresses->end(), table_addr) != L->contract_table_addresses->end()) { \
 			auto msg = std::string("can't modify contract properties");  \
 			if (ttisstring(k))                    \
-				msg += " " + tsvalue(k)->value;   \
+				msg += " " + std::string(svalue(k), vslen(k));   \
 			luaG_runerror(L, msg.c_str()); \
 			return false; \
 		} \
@@ -872,6 +897,7 @@ void luaV_finishOp(uvm::core::ExecuteContext* ctx, lua_State *L) {
 
 #define lua_check_in_vm_error(cond, error_msg) {    \
 if (!(cond)) {      \
+  settlegas(); \
   L->force_stopping = true; \
   luaG_runerror(L, error_msg); \
   vmbreak;                                   \
@@ -880,6 +906,7 @@ if (!(cond)) {      \
 
 #define lua_check_in_vm_error_in_current_line(cond, error_msg) {    \
 if (!(cond)) {      \
+  settlegas(); \
   L->force_stopping = true; \
   const auto& msg = std::string(error_msg) + " in line " + std::to_string(current_line()); \
   luaG_runerror(L, msg.c_str()); \
@@ -888,6 +915,7 @@ if (!(cond)) {      \
 }
 
 #define luaG_runerror_in_current_line(L, error_msg) { \
+	settlegas(); \
 	const auto& msg = std::string(error_msg) + " in line " + std::to_string(current_line()); \
 	luaG_runerror(L, msg.c_str());    \
 }
@@ -1093,17 +1121,51 @@ namespace uvm {
 
 		//return has_next_op
 		bool ExecuteContext::executeToNextOp(lua_State *L) {
+			return executeOps(L, true);
+		}
+
+		/* gas charged for the current run but not executed yet */
+		struct PendingGas {
+			int64_t *count;
+			int64_t left;
+			~PendingGas() {
+				if (left > 0)
+					*count -= left;  /* leaving the loop in the middle of a run */
+			}
+		};
+
+		//return has_next_op
+		bool ExecuteContext::executeOps(lua_State *L, bool single_step) {
 			/* main loop of interpreter */
 			//恢复state
 			if (L->state != lua_VMState::LVM_STATE_NONE) {
 				L->state = lua_VMState::LVM_STATE_NONE;
 			}
 
+			// chosen once for the whole run of instructions
 			bool use_step_log = global_uvm_chain_api != nullptr && global_uvm_chain_api->use_step_log(L);
             bool use_gas_log = global_uvm_chain_api != nullptr && global_uvm_chain_api->use_gas_log(L);
 			UNUSED(use_gas_log);
+			auto depth = L->ci_depth;
+			// charge gas per run of instructions unless every instruction has to be seen
+			bool use_gas_blocks = !single_step && !use_step_log;
+			PendingGas gas{ insts_executed_count, 0 };
+			int64_t gas_limit = has_insts_limit ? insts_limit : INT64_MAX;
+			// the closure only changes together with the call depth, which ends this run
+			const int *gas_costs = nullptr;
+			const Instruction *gas_code = nullptr;
+			if (use_gas_blocks && ci && cl) {
+				if (cl->p->gasblocks.size() != cl->p->codes.size())
+					luaF_buildgasblocks(cl->p);
+				gas_costs = cl->p->gasblocks.data();
+				gas_code = cl->p->codes.data();
+			}
 
-			
+#if UVM_USE_JUMPTABLE
+#include "uvm/ljumptab.h"
+#endif
+
+			for (;;) {
 				if (!ci || ci->u.l.savedpc == nullptr) {
 					global_uvm_chain_api->throw_exception(L, UVM_API_LVM_LIMIT_OVER_ERROR, "wrong bytecode instruction, can't find savedpc");
 					//vmbreak;
@@ -1119,21 +1181,34 @@ namespace uvm {
 
 				StkId ra;
 
-				*insts_executed_count += 1; // executed instructions count
-
-											// limit instructions count, and executed instructions
-				if (has_insts_limit && *insts_executed_count > insts_limit)
-				{
-					global_uvm_chain_api->throw_exception(L, UVM_API_LVM_LIMIT_OVER_ERROR, "over instructions limit");
-					//vmbreak;
-					return false;
+				if (gas.left > 0) {
+					gas.left -= 1; // already charged when the run was entered
+				}
+				else {
+					// executed instructions count, the whole run at once
+					int64_t cost = 1;
+					if (gas_costs)
+						cost = gas_costs[ci->u.l.savedpc - 1 - gas_code];
+					// near the limit go one by one, so the error is raised at the same instruction
+					if (*insts_executed_count + cost > gas_limit)
+						cost = 1;
+					*insts_executed_count += cost;
+					gas.left = cost - 1;
+
+												// limit instructions count, and executed instructions
+					if (*insts_executed_count > gas_limit)
+					{
+						global_uvm_chain_api->throw_exception(L, UVM_API_LVM_LIMIT_OVER_ERROR, "over instructions limit");
+						//vmbreak;
+						return false;
+					}
+					if (stopped_pointer && *stopped_pointer > 0)
+						return false;
+						//vmbreak;
+					if (L->force_stopping)
+						return false;
+						//vmbreak;
 				}
-				if (stopped_pointer && *stopped_pointer > 0)
-					return false;
-					//vmbreak;
-				if (L->force_stopping)
-					return false;
-					//vmbreak;
 
 
 				// when over contract api limit, also vmbreak
@@ -1194,6 +1269,7 @@ namespace uvm {
 						lua_check_in_vm_error_in_current_line(upval_index < cl->nupvalues && upval_index >= 0, "upvalue error");
 						if (nullptr == cl->upvals[upval_index])
 						{
+							settlegas();
 							*stopped_pointer = 1;
 							vmbreak;
 						}
@@ -1506,31 +1582,29 @@ namespace uvm {
 					vmcase(UOP_EQ) {
 						TValue *rb = RKB(i);
 						TValue *rc = RKC(i);
-						Protect(
-							if (luaV_equalobj(L, rb, rc) != GETARG_A(i))
-								ci->u.l.savedpc++;
-							else
-								donextjump(ci);
-						)
-							vmbreak;
+						if (ttisnumber(rb) && ttisnumber(rc))  /* no metamethod can run */
+							condjump(ci, luaV_equalobj(L, rb, rc))
+						else
+							Protect(condjump(ci, luaV_equalobj(L, rb, rc)))
+						vmbreak;
 					}
 					vmcase(UOP_LT) {
-						Protect(
-							if (luaV_lessthan(L, RKB(i), RKC(i)) != GETARG_A(i))
-								ci->u.l.savedpc++;
-							else
-								donextjump(ci);
-						)
-							vmbreak;
+						TValue *rb = RKB(i);
+						TValue *rc = RKC(i);
+						if (ttisnumber(rb) && ttisnumber(rc))
+							condjump(ci, LTnum(rb, rc))
+						else
+							Protect(condjump(ci, luaV_lessthan(L, rb, rc)))
+						vmbreak;
 					}
 					vmcase(UOP_LE) {
-						Protect(
-							if (luaV_lessequal(L, RKB(i), RKC(i)) != GETARG_A(i))
-								ci->u.l.savedpc++;
-							else
-								donextjump(ci);
-						)
-							vmbreak;
+						TValue *rb = RKB(i);
+						TValue *rc = RKC(i);
+						if (ttisnumber(rb) && ttisnumber(rc))
+							condjump(ci, LEnum(rb, rc))
+						else
+							Protect(condjump(ci, luaV_lessequal(L, rb, rc)))
+						vmbreak;
 					}
 					vmcase(UOP_TEST) {
 						if (GETARG_C(i) ? l_isfalse(ra) : !l_isfalse(ra))
@@ -1838,6 +1912,7 @@ namespace uvm {
 						uvm_types::GcProto *p = cl->p->ps[p_index];
 						uvm_types::GcLClosure *ncl = getcached(p, cl->upvals.empty() ? nullptr : cl->upvals.data(), base);  /* cached closure */
 						if (ncl == nullptr) {  /* no match? */
+							settlegas();  /* may raise an error on a bad upvalue index */
 							pushclosure(L, p, cl->upvals.data(), cl->nupvalues, base, ra);  /* create a new one */
 						}
 						else {
@@ -1968,6 +2043,9 @@ namespace uvm {
 						
 					}
 				}
+#if UVM_USE_JUMPTABLE
+			l_opdone:
+#endif
 
 				if (!enum_has_flag(L->state, lua_VMState::LVM_STATE_FAULT) && L->allow_debug && L->using_contract_id_stack && !L->using_contract_id_stack->empty())
 				{
@@ -1992,9 +2070,11 @@ namespace uvm {
 						}
 					}
 				}
-			
-			//return false;
-			return true;
+
+				// leave the loop when the frame changes (the caller prepares the new frame) or the state needs the caller
+				if (single_step || L->ci_depth != depth || L->state != lua_VMState::LVM_STATE_NONE)
+					return true;
+			}
 		}
 
 		bool ExecuteContext::executeToNextCi(lua_State* L) {
@@ -2004,7 +2084,7 @@ namespace uvm {
 			auto depth = L->ci_depth;
 			bool has_next_op = false;
 			for (;;) {
-				has_next_op = executeToNextOp(L);
+				has_next_op = executeOps(L, false);
 				if (!has_next_op ||enum_has_flag(L->state, lua_VMState::LVM_STATE_FAULT) || enum_has_flag(L->state, lua_VMState::LVM_STATE_HALT) || enum_has_flag(L->state, lua_VMState::LVM_STATE_BREAK)){
 					return false;
 				}
@@ -2035,30 +2115,27 @@ namespace uvm {
 			k = cl->p->ks.empty() ? nullptr : cl->p->ks.data();  /* local reference to function's constant table */
 			base = ci->u.l.base;  /* local copy of function's base */
 
-			auto insts_limit = uvm::lua::lib::get_lua_state_value(L, INSTRUCTIONS_LIMIT_LUA_STATE_MAP_KEY).int_value;
-			auto *stopped_pointer = uvm::lua::lib::get_lua_state_value(L, LUA_STATE_STOP_TO_RUN_IN_LVM_STATE_MAP_KEY).int_pointer_value;
+			UvmStateContext *context = L->state_context;
+			auto insts_limit = context->instructions_limit;
+			auto *stopped_pointer = context->stop_in_lvm;
 			if (nullptr == stopped_pointer)
 			{
 				uvm::lua::lib::notify_lua_state_stop(L);
 				uvm::lua::lib::resume_lua_state_running(L);
-				stopped_pointer = uvm::lua::lib::get_lua_state_value(L, LUA_STATE_STOP_TO_RUN_IN_LVM_STATE_MAP_KEY).int_pointer_value;
+				stopped_pointer = context->stop_in_lvm;
 			}
 			bool has_insts_limit = insts_limit > 0 ? true : false;
-			auto *insts_executed_count = uvm::lua::lib::get_lua_state_value(L, INSTRUCTIONS_EXECUTED_COUNT_LUA_STATE_MAP_KEY).int_pointer_value;
+			auto *insts_executed_count = context->instructions_executed_count;
 			if (nullptr == insts_executed_count)
 			{
 				insts_executed_count = static_cast<int64_t*>(lua_malloc(L, sizeof(int64_t)));
 				*insts_executed_count = 0;
-				UvmStateValue lua_state_value_of_exected_count;
-				lua_state_value_of_exected_count.int_pointer_value = insts_executed_count;
-				uvm::lua::lib::set_lua_state_value(L, INSTRUCTIONS_EXECUTED_COUNT_LUA_STATE_MAP_KEY, lua_state_value_of_exected_count, LUA_STATE_VALUE_INT_POINTER);
+				context->instructions_executed_count = insts_executed_count;
 			}
 			if (*insts_executed_count < 0)
 				*insts_executed_count = 0;
 
-			lua_getglobal(L, "last_return");
-			bool use_last_return = true; // lua_istable(L, -1);
-			lua_pop(L, 1);
+			bool use_last_return = true;
 
 			this->insts_executed_count = insts_executed_count;
 			this->stopped_pointer = stopped_pointer;
@@ -2087,7 +2164,7 @@ namespace uvm {
 
 			for (size_t i = 0; i < cl->p->locvars.size(); i++) {
 				const auto& locvar = cl->p->locvars[i];
-				std::string varname(locvar.varname->value);
+				std::string varname(getstr(locvar.varname), tsslen(locvar.varname));
 				// ignore varname when current pc outside varname scope
 				if (currentpc<locvar.startpc || currentpc > locvar.endpc) {
 					continue;
@@ -2107,7 +2184,7 @@ namespace uvm {
 			}
 			uint32_t level = 0;
 			for (size_t i = 0; i < cl->upvals.size(); i++) {
-				std::string upval_name = cl->p->upvalues[i].name->value;
+				std::string upval_name(getstr(cl->p->upvalues[i].name), tsslen(cl->p->upvalues[i].name));
 				const auto& upval = cl->upvals[i];
 				TValue value = *upval->v;
 				result[upval_name] = value;
@@ -2155,7 +2232,7 @@ namespace uvm {
 						_line = _ci_line(_ci);
 						_ci->u.l.savedpc++;
 					}			
-					auto _funcname = _cl->p->source->value;
+					auto _funcname = std::string(getstr(_cl->p->source), tsslen(_cl->p->source));
 					result.push_back(std::string("func:") + _funcname + std::string("    line:") + std::to_string(_line));
 				}				
 				_ci = _ci->previous;
@@ -6,6 +6,7 @@
 #include <cstdio>
 #include <string>
 #include <utility>
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <set>
@@ -13,13 +14,14 @@
 #include <list>
 #include <unordered_map>
 #include <memory>
-#include <mutex>
 #include <thread>
+#include <mutex>
 #include <fstream>
 
 #include <fc/crypto/hex.hpp>
 #include <fc/crypto/base58.hpp>
 #include <fc/crypto/elliptic.hpp>
+#include <fc/crypto/sha256.hpp>
 
 #include <uvm/uvm_api.h>
 #include <uvm/uvm_lib.h>
@@ -34,6 +36,9 @@
 #include <uvm/lauxlib.h>
 #include <uvm/lualib.h>
 #include <uvm/lfunc.h>
+#include <uvm/lstring.h>
+#include <uvm/lgc.h>
+#include <uvm/ldo.h>
 #include <uvm/ltable.h>
 #include <uvm/uvm_storage.h>
 #include <uvm/exceptions.h>
@@ -48,7 +53,8 @@ namespace uvm
     {
       namespace api
       {
-        IUvmChainApi *global_uvm_chain_api = nullptr;
+        UvmChainApiHolder global_uvm_chain_api;
+        thread_local IUvmChainApi *UvmChainApiHolder::_thread_api = nullptr;
       }
 
       using uvm::lua::api::global_uvm_chain_api;
@@ -84,37 +90,11 @@ namespace uvm
 				"cbor_encode", "cbor_decode", "signature_recover", "get_address_role","send_message"
             };
 
-            typedef lua_State* L_Key1;
-
-            typedef std::unordered_map<std::string, UvmStateValueNode> L_VM1;
-
-            typedef std::shared_ptr<L_VM1> L_V1;
-
-            typedef std::unordered_map<L_Key1, L_V1> LStatesMap;
-
-            static LStatesMap states_map;
-
-            static LStatesMap *get_lua_states_value_hashmap()
+            static UvmStateContext *get_lua_state_context(lua_State *L)
             {
-                return &states_map;
-            }
-
-            static std::mutex states_map_mutex;
-
-            static L_V1 create_value_map_for_lua_state(lua_State *L)
-            {
-                LStatesMap *states_map = get_lua_states_value_hashmap();
-                auto it = states_map->find(L);
-                if (it == states_map->end())
-                {
-                    states_map_mutex.lock();
-                    L_V1 map = std::make_shared<L_VM1>();
-                    states_map->insert(std::make_pair(L, map));
-                    states_map_mutex.unlock();
-                    return map;
-                }
-                else
-                    return it->second;
+                if (nullptr == L->state_context)
+                    L->state_context = new UvmStateContext();
+                return L->state_context;
             }
 
 			// transfer from contract to account
@@ -784,8 +764,8 @@ namespace uvm
             // pair: (value_string, is_upvalue)
             typedef std::unordered_map<std::string, std::pair<std::string, bool>> LuaDebuggerInfoList;
 
-            static LuaDebuggerInfoList g_debug_infos;
-            static bool g_debug_running = false;
+            static thread_local LuaDebuggerInfoList g_debug_infos;
+            static thread_local bool g_debug_running = false;
 
             static LuaDebuggerInfoList *get_lua_debugger_info_list_in_state(lua_State *L)
             {
@@ -1563,13 +1543,122 @@ end
 			return __real_pairs_by_keys_func(t)
 			end
 			*/
+
+			// instructions the lua __real_pairs_by_keys_func runs, the native version charges the same gas
+#define PAIRS_BY_KEYS_GAS 23
+#define PAIRS_BY_KEYS_NUMBER_KEY_GAS 10
+#define PAIRS_BY_KEYS_STRING_KEY_GAS 15
+			// instructions of one call to its iterator, for a number key and for a string key(or the end)
+#define PAIRS_BY_KEYS_NEXT_NUMBER_GAS 12
+#define PAIRS_BY_KEYS_NEXT_GAS 16
+
+			// whether running 'cost' more instructions goes over the instructions limit
+			static bool over_lvm_instructions_limit(lua_State *L, int64_t cost)
+			{
+				UvmStateContext *context = get_lua_state_context(L);
+				int64_t *insts_executed_count = context->instructions_executed_count;
+				return nullptr != insts_executed_count && context->instructions_limit > 0
+					&& *insts_executed_count + cost > context->instructions_limit;
+			}
+
+			// count 'cost' executed instructions, and stop like lvm does when it goes over the limit
+			static bool charge_lvm_instructions(lua_State *L, int64_t cost)
+			{
+				UvmStateContext *context = get_lua_state_context(L);
+				int64_t *insts_executed_count = context->instructions_executed_count;
+				if (nullptr == insts_executed_count)
+					return true;
+				if (over_lvm_instructions_limit(L, cost))
+				{
+					*insts_executed_count = context->instructions_limit + 1;
+					uvm::lua::api::global_uvm_chain_api->throw_exception(L, UVM_API_LVM_LIMIT_OVER_ERROR, "over instructions limit");
+					return false;
+				}
+				*insts_executed_count += cost;
+				return true;
+			}
+
+			// upvalues: table, sorted keys, count of number keys, position
+			static int uvm_core_lib_pairs_by_keys_next(lua_State *L)
+			{
+				auto i = lua_tointeger(L, lua_upvalueindex(4)) + 1;
+				lua_pushinteger(L, i);
+				lua_replace(L, lua_upvalueindex(4));
+				auto number_key_size = lua_tointeger(L, lua_upvalueindex(3));
+				if (!charge_lvm_instructions(L, i <= number_key_size ? PAIRS_BY_KEYS_NEXT_NUMBER_GAS : PAIRS_BY_KEYS_NEXT_GAS))
+					return 0;
+				lua_rawgeti(L, lua_upvalueindex(2), i); // nil after the last key, then t[nil] like the lua version
+				lua_pushvalue(L, -1);
+				lua_gettable(L, lua_upvalueindex(1));
+				return 2;
+			}
+
 			static int uvm_core_lib_pairs_by_keys(lua_State *L)
 			{
 				lua_getglobal(L, "uvm_core_lib_pairs_by_keys_func_loader");
 				lua_call(L, 0, 0);
-				lua_getglobal(L, "__real_pairs_by_keys_func");
+
+				// number keys first, then string keys, each sorted by '<'.
+				// other tables(__pairs, or keys of other types, which the lua version iterates by tostring) still use the lua version
+				bool native = lua_type(L, 1) == LUA_TTABLE;
+				if (native && luaL_getmetafield(L, 1, "__pairs") != LUA_TNIL)
+				{
+					lua_pop(L, 1);
+					native = false;
+				}
+				std::vector<TValue> number_keys;
+				std::vector<TValue> string_keys;
+				if (native)
+				{
+					lua_pushnil(L);
+					while (lua_next(L, 1))
+					{
+						lua_pop(L, 1);
+						const TValue *key = L->top - 1;
+						if (ttisnumber(key))
+							number_keys.push_back(*key);
+						else if (ttisstring(key))
+							string_keys.push_back(*key);
+						else
+						{
+							lua_pop(L, 1);
+							native = false;
+							break;
+						}
+					}
+				}
+				auto number_key_size = number_keys.size();
+				auto string_key_size = string_keys.size();
+				int64_t gas = PAIRS_BY_KEYS_GAS + PAIRS_BY_KEYS_NUMBER_KEY_GAS * (int64_t)number_key_size
+					+ PAIRS_BY_KEYS_STRING_KEY_GAS * (int64_t)string_key_size;
+				// when it runs out of gas let the lua version stop at the same instruction it always did
+				if (!native || over_lvm_instructions_limit(L, gas))
+				{
+					lua_getglobal(L, "__real_pairs_by_keys_func");
+					lua_pushvalue(L, 1);
+					lua_call(L, 1, 1);
+					return 1;
+				}
+				charge_lvm_instructions(L, gas);
+				auto less = [L](const TValue &a, const TValue &b) { return luaV_lessthan(L, &a, &b) != 0; };
+				std::sort(number_keys.begin(), number_keys.end(), less);
+				std::sort(string_keys.begin(), string_keys.end(), less);
+
 				lua_pushvalue(L, 1);
-				lua_call(L, 1, 1);
+				lua_createtable(L, (int)(number_key_size + string_key_size), 0);
+				lua_Integer pos = 0;
+				for (const auto *keys : { &number_keys, &string_keys })
+				{
+					for (const auto &key : *keys)
+					{
+						setobj2s(L, L->top, &key);
+						api_incr_top(L);
+						lua_rawseti(L, -2, ++pos);
+					}
+				}
+				lua_pushinteger(L, (lua_Integer)number_key_size);
+				lua_pushinteger(L, 0);
+				lua_pushcclosure(L, &uvm_core_lib_pairs_by_keys_next, 4);
 				return 1;
 			}
 
@@ -1638,19 +1727,12 @@ end
 				}
 
 				//¼storage change list
-				UvmStateValueNode state_value_node = uvm::lua::lib::get_lua_state_value_node(L, LUA_STORAGE_CHANGELIST_KEY);
-				UvmStorageChangeList *list;
-				if (state_value_node.type != LUA_STATE_VALUE_POINTER || nullptr == state_value_node.value.pointer_value)
+				UvmStorageChangeList *list = L->state_context->storage_changelist;
+				if (nullptr == list)
 				{
 					list = (UvmStorageChangeList*)lua_malloc(L, sizeof(UvmStorageChangeList));
 					new (list)UvmStorageChangeList();
-					UvmStateValue value_to_store;
-					value_to_store.pointer_value = list;
-					uvm::lua::lib::set_lua_state_value(L, LUA_STORAGE_CHANGELIST_KEY, value_to_store, LUA_STATE_VALUE_POINTER);
-				}
-				else
-				{
-					list = (UvmStorageChangeList*)state_value_node.value.pointer_value;
+					L->state_context->storage_changelist = list;
 				}
 				int origContractStackSize = L->using_contract_id_stack->size();
 
@@ -1948,6 +2030,184 @@ end
                 return L;
             }
 
+			// fully initialized states indexed by [use_contract][allow_change_global], built on first use.
+			// they never run code, new states copy their registry and basic type metatables.
+			// the states are closed by close_lua_state_prototypes or at process exit
+			class LuaStatePrototypes
+			{
+			public:
+				lua_State *states[2][2] = { { nullptr, nullptr }, { nullptr, nullptr } };
+				std::mutex mutex;
+
+				~LuaStatePrototypes() {
+					close_all();
+				}
+
+				void close_all() {
+					std::lock_guard<std::mutex> lock(mutex);
+					for (auto &row : states) {
+						for (auto &L : row) {
+							if (L)
+								close_lua_state(L);
+							L = nullptr;
+						}
+					}
+				}
+			};
+			static LuaStatePrototypes lua_state_prototypes;
+
+			// copies the values reachable from a prototype state into a new state.
+			// strings are interned again in the new state, tables and C closures get new objects in its gc state
+			class LuaStatePrototypeCloner
+			{
+			private:
+				lua_State *_to;
+				std::unordered_map<const vmgc::GcObject*, vmgc::GcObject*> _copies;
+
+				uvm_types::GcTable *clone_table(const uvm_types::GcTable *src)
+				{
+					auto found = _copies.find(src);
+					if (found != _copies.end())
+						return static_cast<uvm_types::GcTable*>(found->second);
+					auto t = luaH_new(_to);
+					_copies[src] = t;
+					if (!clone_table_items(src, t))
+						return nullptr;
+					return t;
+				}
+
+			public:
+				LuaStatePrototypeCloner(lua_State *from, lua_State *to) : _to(to) {
+					// the new state has its own main thread, registry and globals table already, they are filled by the caller
+					_copies[from] = to;
+					_copies[gcvalue(&from->l_registry)] = gcvalue(&to->l_registry);
+					_copies[gcvalue(luaH_getint(hvalue(&from->l_registry), LUA_RIDX_GLOBALS))]
+						= gcvalue(luaH_getint(hvalue(&to->l_registry), LUA_RIDX_GLOBALS));
+				}
+
+				// returns false if the value can't be copied to another state, eg. lua closures, userdata and threads
+				bool clone_value(const TValue *src, TValue *dst)
+				{
+					if (!iscollectable(src)) {
+						setobj(_to, dst, src);
+						return true;
+					}
+					if (ttisstring(src)) {
+						// short strings are interned, so they need no entry in the copies
+						auto ts = tsvalue(src);
+						setsvalue(_to, dst, luaS_newlstr(_to, getstr(ts), tsslen(ts)));
+						return true;
+					}
+					auto found = _copies.find(gcvalue(src));
+					if (found != _copies.end()) {
+						val_(dst).gco = found->second;
+						settt_(dst, rttype(src));
+						return true;
+					}
+					if (ttistable(src)) {
+						auto t = clone_table(hvalue(src));
+						if (!t)
+							return false;
+						sethvalue(_to, dst, t);
+						return true;
+					}
+					if (ttisCclosure(src)) {
+						auto f = clCvalue(src);
+						auto cl = luaF_newCclosure(_to, f->nupvalues);
+						cl->f = f->f;
+						_copies[f] = cl;
+						for (size_t i = 0; i < f->upvalue.size(); i++) {
+							if (!clone_value(&f->upvalue[i], &cl->upvalue[i]))
+								return false;
+						}
+						setclCvalue(_to, dst, cl);
+						return true;
+					}
+					return false;
+				}
+
+				bool clone_table_items(const uvm_types::GcTable *src, uvm_types::GcTable *dst)
+				{
+					dst->array.resize(src->array.size());
+					for (size_t i = 0; i < src->array.size(); i++) {
+						if (!clone_value(&src->array[i], &dst->array[i]))
+							return false;
+					}
+					dst->nodes.resize(src->nodes.size());
+					for (size_t i = 0; i < src->nodes.size(); i++) {
+						const auto &n = src->nodes[i];
+						auto &copy = dst->nodes[i];
+						if (!clone_value(&n.key, &copy.key) || !clone_value(&n.value, &copy.value))
+							return false;
+						copy.hash = n.hash;
+					}
+					luaH_rehashnodes(dst, src->slots.size());
+					if (src->metatable) {
+						dst->metatable = clone_table(src->metatable);
+						if (!dst->metatable)
+							return false;
+					}
+					dst->flags = src->flags;
+					dst->isOnlyRead = src->isOnlyRead;
+					return true;
+				}
+			};
+
+			static lua_State *clone_lua_state(lua_State *prototype)
+			{
+				lua_State *L = luaL_newstate();
+				if (L->strt.size < prototype->strt.size)
+					luaS_resize(L, prototype->strt.size);
+				LuaStatePrototypeCloner cloner(prototype, L);
+				auto registry = hvalue(&prototype->l_registry);
+				auto new_registry = hvalue(&L->l_registry);
+				bool ok = cloner.clone_table_items(hvalue(luaH_getint(registry, LUA_RIDX_GLOBALS)),
+					hvalue(luaH_getint(new_registry, LUA_RIDX_GLOBALS)))
+					&& cloner.clone_table_items(registry, new_registry);
+				for (int i = 0; ok && i < LUA_NUMTAGS; i++) {
+					if (nullptr == prototype->mt[i])
+						continue;
+					TValue mt, copy;
+					sethvalue(prototype, &mt, prototype->mt[i]);
+					ok = cloner.clone_value(&mt, &copy);
+					if (ok)
+						L->mt[i] = hvalue(&copy);
+				}
+				if (!ok) {
+					close_lua_state(L);
+					return nullptr;
+				}
+				reset_lvm_instructions_executed_count(L);
+				lua_atpanic(L, panic_message);
+				return L;
+			}
+
+			lua_State *create_lua_state_from_prototype(bool use_contract, bool allow_change_global)
+			{
+				lua_State *prototype;
+				{
+					std::lock_guard<std::mutex> lock(lua_state_prototypes.mutex);
+					auto &slot = lua_state_prototypes.states[use_contract ? 1 : 0][allow_change_global ? 1 : 0];
+					if (nullptr == slot) {
+						slot = create_lua_state(use_contract, allow_change_global);
+						// the prototype may outlive the thread's gc state pool, so it owns its gc state
+						if (slot)
+							slot->gc_state->set_pooled(false);
+					}
+					prototype = slot;
+				}
+				// the prototype is only read here, so states can be cloned from it in many threads at once
+				auto L = prototype ? clone_lua_state(prototype) : nullptr;
+				if (nullptr == L)
+					L = create_lua_state(use_contract, allow_change_global);
+				return L;
+			}
+
+			void close_lua_state_prototypes()
+			{
+				lua_state_prototypes.close_all();
+			}
+
             bool commit_storage_changes(lua_State *L)
             {
                 if (!uvm::lua::api::global_uvm_chain_api->has_exception(L))
@@ -1961,74 +2221,68 @@ end
             {
                 //luaL_commit_storage_changes(L);
 				uvm::lua::api::global_uvm_chain_api->release_objects_in_pool(L);
-                LStatesMap *states_map = get_lua_states_value_hashmap();
-                if (nullptr != states_map)
+                UvmStateContext *context = get_lua_state_context(L);
+                auto lua_table_map_list_p = get_lua_state_value(L, LUA_TABLE_MAP_LIST_STATE_MAP_KEY).pointer_value;
+                if (nullptr != lua_table_map_list_p)
                 {
-                    auto lua_table_map_list_p = get_lua_state_value(L, LUA_TABLE_MAP_LIST_STATE_MAP_KEY).pointer_value;
-                    if (nullptr != lua_table_map_list_p)
+                    auto list_p = (std::list<UvmTableMapP>*) lua_table_map_list_p;
+                    for (auto it = list_p->begin(); it != list_p->end(); ++it)
                     {
-                        auto list_p = (std::list<UvmTableMapP>*) lua_table_map_list_p;
-                        for (auto it = list_p->begin(); it != list_p->end(); ++it)
-                        {
-                            UvmTableMapP lua_table_map = *it;
-                            // lua_table_map->~UvmTableMap();
-                            // lua_free(L, lua_table_map);
-                            delete lua_table_map;
-                        }
-                        delete list_p;
+                        UvmTableMapP lua_table_map = *it;
+                        // lua_table_map->~UvmTableMap();
+                        // lua_free(L, lua_table_map);
+                        delete lua_table_map;
                     }
+                    delete list_p;
+                }
 
-                    L_V1 map = create_value_map_for_lua_state(L);
-                    for (auto it = map->begin(); it != map->end(); ++it)
+                for (auto it = context->values.begin(); it != context->values.end(); ++it)
+                {
+                    if (it->second.type == LUA_STATE_VALUE_INT_POINTER)
                     {
-                        if (it->second.type == LUA_STATE_VALUE_INT_POINTER)
-                        {
-                            lua_free(L, it->second.value.int_pointer_value);
-                            it->second.value.int_pointer_value = nullptr;
-                        }
+                        lua_free(L, it->second.value.int_pointer_value);
+                        it->second.value.int_pointer_value = nullptr;
                     }
-                    // close values in state values(some pointers need free), eg. storage infos, contract infos
-                    UvmStateValueNode storage_changelist_node = get_lua_state_value_node(L, LUA_STORAGE_CHANGELIST_KEY);
-                    if (storage_changelist_node.type == LUA_STATE_VALUE_POINTER && nullptr != storage_changelist_node.value.pointer_value)
+                }
+                // close values in state values(some pointers need free), eg. storage infos, contract infos
+                if (nullptr != context->storage_changelist)
+                {
+                    UvmStorageChangeList *list = context->storage_changelist;
+                    for (auto it = list->begin(); it != list->end(); ++it)
                     {
-                        UvmStorageChangeList *list = (UvmStorageChangeList*)storage_changelist_node.value.pointer_value;
-                        for (auto it = list->begin(); it != list->end(); ++it)
+                        UvmStorageValue before = it->before;
+                        UvmStorageValue after = it->after;
+                        if (lua_storage_is_table(before.type))
                         {
-                            UvmStorageValue before = it->before;
-                            UvmStorageValue after = it->after;
-                            if (lua_storage_is_table(before.type))
-                            {
-                                // free_lua_table_map(L, before.value.table_value);
-                            }
-                            if (lua_storage_is_table(after.type))
-                            {
-                                // free_lua_table_map(L, after.value.table_value);
-                            }
+                            // free_lua_table_map(L, before.value.table_value);
+                        }
+                        if (lua_storage_is_table(after.type))
+                        {
+                            // free_lua_table_map(L, after.value.table_value);
                         }
-                        list->~UvmStorageChangeList();
-                        lua_free(L, list);
                     }
+                    list->~UvmStorageChangeList();
+                    lua_free(L, list);
+                    context->storage_changelist = nullptr;
+                }
 
-                    UvmStateValueNode storage_table_read_list_node = get_lua_state_value_node(L, LUA_STORAGE_READ_TABLES_KEY);
-                    if (storage_table_read_list_node.type == LUA_STATE_VALUE_POINTER && nullptr != storage_table_read_list_node.value.pointer_value)
-                    {
-                        UvmStorageTableReadList *list = (UvmStorageTableReadList*)storage_table_read_list_node.value.pointer_value;
-                        list->~UvmStorageTableReadList();
-                        lua_free(L, list);
-                    }
+                if (nullptr != context->storage_read_tables)
+                {
+                    UvmStorageTableReadList *list = context->storage_read_tables;
+                    list->~UvmStorageTableReadList();
+                    lua_free(L, list);
+                    context->storage_read_tables = nullptr;
+                }
 
-					int64_t *insts_executed_count = get_lua_state_value(L, INSTRUCTIONS_EXECUTED_COUNT_LUA_STATE_MAP_KEY).int_pointer_value;
-                    if (nullptr != insts_executed_count)
-                    {
-                        lua_free(L, insts_executed_count);
-                    }
-					int64_t *stopped_pointer = uvm::lua::lib::get_lua_state_value(L, LUA_STATE_STOP_TO_RUN_IN_LVM_STATE_MAP_KEY).int_pointer_value;
-                    if (nullptr != stopped_pointer)
-                    {
-                        lua_free(L, stopped_pointer);
-                    }
-                    
-                    states_map->erase(L);
+                if (nullptr != context->instructions_executed_count)
+                {
+                    lua_free(L, context->instructions_executed_count);
+                    context->instructions_executed_count = nullptr;
+                }
+                if (nullptr != context->stop_in_lvm)
+                {
+                    lua_free(L, context->stop_in_lvm);
+                    context->stop_in_lvm = nullptr;
                 }
 
                 lua_close(L);
@@ -2039,13 +2293,12 @@ end
             */
             void close_all_lua_state_values()
             {
-                LStatesMap *states_map = get_lua_states_value_hashmap();
-                states_map->clear();
+                // the values live in each lua_State now and are released by lua_close
             }
             void close_lua_state_values(lua_State *L)
             {
-                LStatesMap *states_map = get_lua_states_value_hashmap();
-                states_map->erase(L);
+                delete L->state_context;
+                L->state_context = nullptr;
             }
 
             UvmStateValueNode get_lua_state_value_node(lua_State *L, const char *key)
@@ -2059,14 +2312,45 @@ end
                     return nil_value_node;
                 }
 
-                // LStatesMap *states_map = get_lua_states_value_hashmap();
-                L_V1 map = create_value_map_for_lua_state(L);
-                std::string key_str(key);
-                auto it = map->find(key_str);
-                if (it == map->end())
-                    return nil_value_node;
+                UvmStateContext *context = get_lua_state_context(L);
+                UvmStateValueNode node = nil_value_node;
+                if (strcmp(key, INSTRUCTIONS_LIMIT_LUA_STATE_MAP_KEY) == 0)
+                {
+                    node.type = LUA_STATE_VALUE_INT;
+                    node.value.int_value = context->instructions_limit;
+                }
+                else if (strcmp(key, INSTRUCTIONS_EXECUTED_COUNT_LUA_STATE_MAP_KEY) == 0)
+                {
+                    node.value.int_pointer_value = context->instructions_executed_count;
+                    node.type = node.value.int_pointer_value ? LUA_STATE_VALUE_INT_POINTER : LUA_STATE_VALUE_nullptr;
+                }
+                else if (strcmp(key, LUA_STATE_STOP_TO_RUN_IN_LVM_STATE_MAP_KEY) == 0)
+                {
+                    node.value.int_pointer_value = context->stop_in_lvm;
+                    node.type = node.value.int_pointer_value ? LUA_STATE_VALUE_INT_POINTER : LUA_STATE_VALUE_nullptr;
+                }
+                else if (strcmp(key, LUA_IN_SANDBOX_STATE_KEY) == 0)
+                {
+                    node.type = LUA_STATE_VALUE_INT;
+                    node.value.int_value = context->in_sandbox;
+                }
+                else if (strcmp(key, LUA_STORAGE_CHANGELIST_KEY) == 0)
+                {
+                    node.value.pointer_value = context->storage_changelist;
+                    node.type = node.value.pointer_value ? LUA_STATE_VALUE_POINTER : LUA_STATE_VALUE_nullptr;
+                }
+                else if (strcmp(key, LUA_STORAGE_READ_TABLES_KEY) == 0)
+                {
+                    node.value.pointer_value = context->storage_read_tables;
+                    node.type = node.value.pointer_value ? LUA_STATE_VALUE_POINTER : LUA_STATE_VALUE_nullptr;
+                }
                 else
-                    return map->at(key_str);
+                {
+                    auto it = context->values.find(std::string(key));
+                    if (it != context->values.end())
+                        node = it->second;
+                }
+                return node;
             }
 
             UvmStateValue get_lua_state_value(lua_State *L, const char *key)
@@ -2075,18 +2359,17 @@ end
             }
             void set_lua_state_instructions_limit(lua_State *L, int limit)
             {
-                UvmStateValue value = { limit };
-                set_lua_state_value(L, INSTRUCTIONS_LIMIT_LUA_STATE_MAP_KEY, value, LUA_STATE_VALUE_INT);
+                get_lua_state_context(L)->instructions_limit = limit;
             }
 
             int get_lua_state_instructions_limit(lua_State *L)
             {
-                return get_lua_state_value(L, INSTRUCTIONS_LIMIT_LUA_STATE_MAP_KEY).int_value;
+                return get_lua_state_context(L)->instructions_limit;
             }
 
             int get_lua_state_instructions_executed_count(lua_State *L)
             {
-				int64_t *insts_executed_count = get_lua_state_value(L, INSTRUCTIONS_EXECUTED_COUNT_LUA_STATE_MAP_KEY).int_pointer_value;
+				int64_t *insts_executed_count = get_lua_state_context(L)->instructions_executed_count;
                 if (nullptr == insts_executed_count)
                 {
                     return 0;
@@ -2097,23 +2380,24 @@ end
                     return *insts_executed_count;
             }
 
+            vmgc::GcStats get_lua_state_gc_stats(lua_State *L)
+            {
+                return L->gc_state->gc_stats();
+            }
+
             void enter_lua_sandbox(lua_State *L)
             {
-                UvmStateValue value;
-                value.int_value = 1;
-                set_lua_state_value(L, LUA_IN_SANDBOX_STATE_KEY, value, LUA_STATE_VALUE_INT);
+                get_lua_state_context(L)->in_sandbox = 1;
             }
 
             void exit_lua_sandbox(lua_State *L)
             {
-                UvmStateValue value;
-                value.int_value = 0;
-                set_lua_state_value(L, LUA_IN_SANDBOX_STATE_KEY, value, LUA_STATE_VALUE_INT);
+                get_lua_state_context(L)->in_sandbox = 0;
             }
 
             bool check_in_lua_sandbox(lua_State *L)
             {
-                return get_lua_state_value_node(L, LUA_IN_SANDBOX_STATE_KEY).value.int_value > 0;
+                return get_lua_state_context(L)->in_sandbox > 0;
             }
 
             /**
@@ -2121,19 +2405,14 @@ end
             */
             void notify_lua_state_stop(lua_State *L)
             {
-				int64_t *pointer = get_lua_state_value(L, LUA_STATE_STOP_TO_RUN_IN_LVM_STATE_MAP_KEY).int_pointer_value;
-                if (nullptr == pointer)
+                UvmStateContext *context = get_lua_state_context(L);
+                if (nullptr == context->stop_in_lvm)
                 {
-					pointer = static_cast<int64_t*>(L->gc_state->gc_malloc(sizeof(int64_t)));
-                    *pointer = 1;
-                    UvmStateValue value;
-                    value.int_pointer_value = pointer;
-                    set_lua_state_value(L, LUA_STATE_STOP_TO_RUN_IN_LVM_STATE_MAP_KEY, value, LUA_STATE_VALUE_INT_POINTER);
-                }
-                else
-                {
-                    *pointer = 1;
+					context->stop_in_lvm = static_cast<int64_t*>(L->gc_state->gc_malloc(sizeof(int64_t)));
+                    if (nullptr == context->stop_in_lvm)
+                        return;
                 }
+                *context->stop_in_lvm = 1;
             }
 
             /**
@@ -2141,7 +2420,7 @@ end
             */
             bool check_lua_state_notified_stop(lua_State *L)
             {
-				int64_t *pointer = get_lua_state_value(L, LUA_STATE_STOP_TO_RUN_IN_LVM_STATE_MAP_KEY).int_pointer_value;
+				int64_t *pointer = get_lua_state_context(L)->stop_in_lvm;
                 if (nullptr == pointer)
                     return false;
                 return (*pointer) > 0;
@@ -2152,7 +2431,7 @@ end
             */
             void resume_lua_state_running(lua_State *L)
             {
-				int64_t *pointer = get_lua_state_value(L, LUA_STATE_STOP_TO_RUN_IN_LVM_STATE_MAP_KEY).int_pointer_value;
+				int64_t *pointer = get_lua_state_context(L)->stop_in_lvm;
                 if (nullptr != pointer)
                 {
                     *pointer = 0;
@@ -2164,6 +2443,37 @@ end
                 if (nullptr == L || nullptr == key || strlen(key) < 1)
                 {
                     return;
+                }
+                UvmStateContext *context = get_lua_state_context(L);
+                if (strcmp(key, INSTRUCTIONS_LIMIT_LUA_STATE_MAP_KEY) == 0)
+                {
+                    context->instructions_limit = value.int_value;
+                    return;
+                }
+                else if (strcmp(key, INSTRUCTIONS_EXECUTED_COUNT_LUA_STATE_MAP_KEY) == 0)
+                {
+                    context->instructions_executed_count = value.int_pointer_value;
+                    return;
+                }
+                else if (strcmp(key, LUA_STATE_STOP_TO_RUN_IN_LVM_STATE_MAP_KEY) == 0)
+                {
+                    context->stop_in_lvm = value.int_pointer_value;
+                    return;
+                }
+                else if (strcmp(key, LUA_IN_SANDBOX_STATE_KEY) == 0)
+                {
+                    context->in_sandbox = value.int_value;
+                    return;
+                }
+                else if (strcmp(key, LUA_STORAGE_CHANGELIST_KEY) == 0)
+                {
+                    context->storage_changelist = (UvmStorageChangeList*)value.pointer_value;
+                    return;
+                }
+                else if (strcmp(key, LUA_STORAGE_READ_TABLES_KEY) == 0)
+                {
+                    context->storage_read_tables = (UvmStorageTableReadList*)value.pointer_value;
+                    return;
                 }
 				char* str_value = nullptr;
 				if (type == LUA_STATE_VALUE_STRING) {
@@ -2172,15 +2482,12 @@ end
 						return;
 					}
 				}
-                L_V1 map = create_value_map_for_lua_state(L);
                 UvmStateValueNode node_v;
                 node_v.type = type;
                 node_v.value = value;
 				if (node_v.type == LUA_STATE_VALUE_STRING)
 					node_v.value.string_value = str_value;
-                std::string key_str(key);
-                map->erase(key_str);
-                map->insert(std::make_pair(key_str, node_v));
+                context->values[std::string(key)] = node_v;
             }
 
             static const char* reader_of_stream(lua_State *L, void *ud, size_t *size)
@@ -2229,6 +2536,209 @@ end
 				return cl;
             }
 
+			// prototype decoded from contract bytecode, not bound to any lua_State
+			struct CachedProtoString
+			{
+				bool is_null = true;
+				std::string value;
+			};
+
+			struct CachedProto
+			{
+				lu_byte numparams = 0;
+				lu_byte is_vararg = 0;
+				lu_byte maxstacksize = 0;
+				int linedefined = 0;
+				int lastlinedefined = 0;
+				std::vector<TValue> ks;  // string constants are kept in ks_strings
+				std::vector<CachedProtoString> ks_strings;
+				std::vector<Instruction> codes;
+				std::vector<std::shared_ptr<const CachedProto>> ps;
+				std::vector<int> lineinfos;
+				std::vector<LocVar> locvars;  // names are kept in locvar_names
+				std::vector<CachedProtoString> locvar_names;
+				std::vector<Upvaldesc> upvalues;  // names are kept in upvalue_names
+				std::vector<CachedProtoString> upvalue_names;
+				std::vector<int> gasblocks;
+				CachedProtoString source;
+				bool source_from_parent = false;
+			};
+
+			struct CachedContractProto
+			{
+				lu_byte nupvalues = 0;
+				std::shared_ptr<const CachedProto> proto;
+			};
+
+			// sha256 of bytecode => decoded prototypes, the most recently used first
+			typedef std::list<std::pair<std::string, CachedContractProto>> ContractProtoCacheList;
+			static ContractProtoCacheList contract_proto_cache;
+			static std::unordered_map<std::string, ContractProtoCacheList::iterator> contract_proto_cache_index;
+			static std::mutex contract_proto_cache_mutex;
+
+			static CachedProtoString to_cached_proto_string(const uvm_types::GcString *ts)
+			{
+				CachedProtoString result;
+				if (ts)
+				{
+					result.is_null = false;
+					result.value.assign(getstr(ts), ts->len);
+				}
+				return result;
+			}
+
+			static uvm_types::GcString *from_cached_proto_string(lua_State *L, const CachedProtoString &str)
+			{
+				if (str.is_null)
+					return nullptr;
+				return luaS_newlstr(L, str.value.data(), str.value.size());
+			}
+
+			static std::shared_ptr<const CachedProto> to_cached_proto(const uvm_types::GcProto *f, const uvm_types::GcString *psource)
+			{
+				auto result = std::make_shared<CachedProto>();
+				result->numparams = f->numparams;
+				result->is_vararg = f->is_vararg;
+				result->maxstacksize = f->maxstacksize;
+				result->linedefined = f->linedefined;
+				result->lastlinedefined = f->lastlinedefined;
+				result->ks = f->ks;
+				result->ks_strings.resize(f->ks.size());
+				for (size_t i = 0; i < f->ks.size(); i++)
+				{
+					if (ttisstring(&f->ks[i]))
+					{
+						result->ks_strings[i] = to_cached_proto_string(tsvalue(&f->ks[i]));
+						val_(&result->ks[i]).gco = nullptr;
+					}
+				}
+				result->codes = f->codes;
+				for (const auto *sub : f->ps)
+					result->ps.push_back(to_cached_proto(sub, f->source));
+				result->lineinfos = f->lineinfos;
+				result->locvars = f->locvars;
+				for (auto &locvar : result->locvars)
+				{
+					result->locvar_names.push_back(to_cached_proto_string(locvar.varname));
+					locvar.varname = nullptr;
+				}
+				result->upvalues = f->upvalues;
+				for (auto &upvalue : result->upvalues)
+				{
+					result->upvalue_names.push_back(to_cached_proto_string(upvalue.name));
+					upvalue.name = nullptr;
+				}
+				result->gasblocks = f->gasblocks;
+				result->source_from_parent = psource && f->source == psource;
+				if (!result->source_from_parent)
+					result->source = to_cached_proto_string(f->source);
+				return result;
+			}
+
+			// fill a new proto in the same order luaU_undump does, so every gc object is reachable when created
+			static void from_cached_proto(lua_State *L, const CachedProto &cached, uvm_types::GcProto *f, uvm_types::GcString *psource)
+			{
+				f->source = cached.source_from_parent ? psource : from_cached_proto_string(L, cached.source);
+				f->linedefined = cached.linedefined;
+				f->lastlinedefined = cached.lastlinedefined;
+				f->numparams = cached.numparams;
+				f->is_vararg = cached.is_vararg;
+				f->maxstacksize = cached.maxstacksize;
+				f->codes = cached.codes;
+				f->ks = cached.ks;
+				for (size_t i = 0; i < f->ks.size(); i++)
+				{
+					if (ttisstring(&f->ks[i]))
+						setsvalue2n(L, &f->ks[i], from_cached_proto_string(L, cached.ks_strings[i]));
+				}
+				f->upvalues = cached.upvalues;
+				f->ps.resize(cached.ps.size(), nullptr);
+				for (size_t i = 0; i < cached.ps.size(); i++)
+				{
+					f->ps[i] = luaF_newproto(L);
+					from_cached_proto(L, *cached.ps[i], f->ps[i], f->source);
+				}
+				f->lineinfos = cached.lineinfos;
+				f->locvars = cached.locvars;
+				for (size_t i = 0; i < f->locvars.size(); i++)
+					f->locvars[i].varname = from_cached_proto_string(L, cached.locvar_names[i]);
+				for (size_t i = 0; i < f->upvalues.size(); i++)
+					f->upvalues[i].name = from_cached_proto_string(L, cached.upvalue_names[i]);
+				f->gasblocks = cached.gasblocks;
+			}
+
+			static bool is_cacheable_contract_stream(UvmModuleByteStream *stream)
+			{
+				return stream && stream->is_bytes && !stream->buff.empty() && stream->buff[0] == LUA_SIGNATURE[0];
+			}
+
+			// key by digest so the cache doesn't keep a second copy of every contract's bytecode
+			static std::string contract_proto_cache_key(UvmModuleByteStream *stream)
+			{
+				auto digest = fc::sha256::hash(stream->buff.data(), stream->buff.size());
+				return std::string(digest.data(), digest.data_size());
+			}
+
+			uvm_types::GcLClosure *load_contract_proto_from_cache(lua_State *L, UvmModuleByteStream *stream)
+			{
+				if (!is_cacheable_contract_stream(stream))
+					return nullptr;
+				// luaU_undump refuses to load in a state with pending error, let it report that
+				if (strlen(L->runerror) > 0 || strlen(L->compile_error) > 0)
+					return nullptr;
+				auto key = contract_proto_cache_key(stream);
+				CachedContractProto cached;
+				{
+					std::lock_guard<std::mutex> lock(contract_proto_cache_mutex);
+					auto found = contract_proto_cache_index.find(key);
+					if (found == contract_proto_cache_index.end())
+						return nullptr;
+					contract_proto_cache.splice(contract_proto_cache.begin(), contract_proto_cache, found->second);
+					cached = found->second->second;
+				}
+				uvm_types::GcLClosure *cl = luaF_newLclosure(L, cached.nupvalues);
+				setclLvalue(L, L->top, cl);
+				luaD_inctop(L);
+				cl->p = luaF_newproto(L);
+				from_cached_proto(L, *cached.proto, cl->p, nullptr);
+				luaF_initupvals(L, cl);
+				if (cl->nupvalues >= 1) {
+					// set global table as 1st upvalue, as lua_load does
+					uvm_types::GcTable *reg = hvalue(&L->l_registry);
+					const TValue *gt = luaH_getint(reg, LUA_RIDX_GLOBALS);
+					setobj(L, cl->upvals[0]->v, gt);
+					luaC_upvalbarrier(L, cl->upvals[0]);
+				}
+				return cl;
+			}
+
+			void put_contract_proto_to_cache(UvmModuleByteStream *stream, uvm_types::GcLClosure *closure)
+			{
+				if (!is_cacheable_contract_stream(stream) || !closure || !closure->p)
+					return;
+				CachedContractProto cached;
+				cached.nupvalues = closure->nupvalues;
+				cached.proto = to_cached_proto(closure->p, nullptr);
+				auto key = contract_proto_cache_key(stream);
+				std::lock_guard<std::mutex> lock(contract_proto_cache_mutex);
+				if (contract_proto_cache_index.find(key) != contract_proto_cache_index.end())
+					return;
+				contract_proto_cache.emplace_front(key, cached);
+				contract_proto_cache_index[key] = contract_proto_cache.begin();
+				while (contract_proto_cache.size() > CONTRACT_PROTO_CACHE_MAX_COUNT)
+				{
+					contract_proto_cache_index.erase(contract_proto_cache.back().first);
+					contract_proto_cache.pop_back();
+				}
+			}
+
+			void clear_contract_proto_cache()
+			{
+				std::lock_guard<std::mutex> lock(contract_proto_cache_mutex);
+				contract_proto_cache_index.clear();
+				contract_proto_cache.clear();
+			}
+
 #define UPVALNAME_OF_PROTO(proto, x) (((proto)->upvalues[x].name) ? getstr((proto)->upvalues[x].name) : "-")
 #define MYK(x)		(-1-(x))
 
@@ -2694,7 +3204,7 @@ end
 
 			void reset_lvm_instructions_executed_count(lua_State *L)
             {
-				int64_t *insts_executed_count = get_lua_state_value(L, INSTRUCTIONS_EXECUTED_COUNT_LUA_STATE_MAP_KEY).int_pointer_value;
+				int64_t *insts_executed_count = get_lua_state_context(L)->instructions_executed_count;
 				if (insts_executed_count)
 				{
 					*insts_executed_count = 0;
@@ -2703,7 +3213,7 @@ end
 
             void increment_lvm_instructions_executed_count(lua_State *L, int add_count)
             {
-				int64_t *insts_executed_count = get_lua_state_value(L, INSTRUCTIONS_EXECUTED_COUNT_LUA_STATE_MAP_KEY).int_pointer_value;
+				int64_t *insts_executed_count = get_lua_state_context(L)->instructions_executed_count;
               if (insts_executed_count)
               {
                 *insts_executed_count = *insts_executed_count + add_count;
@@ -30,15 +30,9 @@ namespace uvm
 #endif
 		}
 
-		static char *FILE_SEPRATOR_STR = nullptr;
-
 		char *file_separator_str()
 		{
-			if (FILE_SEPRATOR_STR)
-				return FILE_SEPRATOR_STR;
-			FILE_SEPRATOR_STR = (char*)calloc(2, sizeof(char));
-			FILE_SEPRATOR_STR[0] = file_separator();
-			FILE_SEPRATOR_STR[1] = '\0';
+			static char FILE_SEPRATOR_STR[2] = { file_separator(), '\0' };
 			return FILE_SEPRATOR_STR;
 		}
 
@@ -56,8 +56,7 @@ namespace uvm
 			}
 
 			int64_t* GasManager::gas_ref() const {
-				int64_t *insts_executed_count = uvm::lua::lib::get_lua_state_value(_L, INSTRUCTIONS_EXECUTED_COUNT_LUA_STATE_MAP_KEY).int_pointer_value;
-				return insts_executed_count;
+				return _L->state_context->instructions_executed_count;
 			}
 
 			int64_t* GasManager::gas_ref_or_new() {
@@ -69,16 +68,18 @@ namespace uvm
 						return nullptr;
 					}
 					*ref = 0;
-					UvmStateValue lua_state_value_of_exected_count;
-					lua_state_value_of_exected_count.int_pointer_value = ref;
-					uvm::lua::lib::set_lua_state_value(_L, INSTRUCTIONS_EXECUTED_COUNT_LUA_STATE_MAP_KEY, lua_state_value_of_exected_count, LUA_STATE_VALUE_INT_POINTER);
+					_L->state_context->instructions_executed_count = ref;
 				}
 				return ref;
 			}
 
             UvmStateScope::UvmStateScope(bool use_contract, bool allow_change_global)
                 :_use_contract(use_contract), _allow_change_global(allow_change_global){
+#if USE_LUA_STATE_PROTOTYPE
+                this->_L = create_lua_state_from_prototype(use_contract, allow_change_global);
+#else
                 this->_L = create_lua_state(use_contract, allow_change_global);
+#endif
             }
             UvmStateScope::UvmStateScope(const UvmStateScope &other) : _L(other._L) {}
             UvmStateScope::~UvmStateScope() {
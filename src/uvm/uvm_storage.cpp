@@ -17,21 +17,14 @@ using uvm::lua::api::global_uvm_chain_api;
 
 static UvmStorageTableReadList *get_or_init_storage_table_read_list(lua_State *L)
 {
-	UvmStateValueNode state_value_node = uvm::lua::lib::get_lua_state_value_node(L, LUA_STORAGE_READ_TABLES_KEY);
-	UvmStorageTableReadList *list = nullptr;;
-	if (state_value_node.type != LUA_STATE_VALUE_POINTER || nullptr == state_value_node.value.pointer_value)
+	UvmStorageTableReadList *list = L->state_context->storage_read_tables;
+	if (nullptr == list)
 	{
 		list = (UvmStorageTableReadList*)lua_malloc(L, sizeof(UvmStorageTableReadList));
 		if (!list)
 			return nullptr;
 		new (list)UvmStorageTableReadList();
-		UvmStateValue value_to_store;
-		value_to_store.pointer_value = list;
-		uvm::lua::lib::set_lua_state_value(L, LUA_STORAGE_READ_TABLES_KEY, value_to_store, LUA_STATE_VALUE_POINTER);
-	}
-	else
-	{
-		list = (UvmStorageTableReadList*)state_value_node.value.pointer_value;
+		L->state_context->storage_read_tables = list;
 	}
 	return list;
 }
@@ -49,13 +42,8 @@ static struct UvmStorageValue get_last_storage_changed_value(lua_State *L, const
 			UvmStorageTableReadList *table_read_list = get_or_init_storage_table_read_list(L);
 			if (table_read_list)
 			{
-				for (auto it = table_read_list->begin(); it != table_read_list->end(); ++it)
-				{
-					if (it->contract_id == contract_id_str && it->key == key && it->fast_map_key==fast_map_key && it->is_fast_map == is_fast_map)
-					{
-						return;
-					}
-				}
+				if (table_read_list->find_last(contract_id_str, key, fast_map_key, is_fast_map))
+					return;
 				UvmStorageChangeItem change_item;
 				change_item.contract_id = contract_id_str;
 				change_item.key = key;
@@ -76,9 +64,7 @@ static struct UvmStorageValue get_last_storage_changed_value(lua_State *L, const
 			if (!list)
 				return value;
 			new (list)UvmStorageChangeList();
-			UvmStateValue value_to_store;
-			value_to_store.pointer_value = list;
-			uvm::lua::lib::set_lua_state_value(L, LUA_STORAGE_CHANGELIST_KEY, value_to_store, LUA_STATE_VALUE_POINTER);
+			L->state_context->storage_changelist = list;
 		}
 
 		UvmStorageChangeItem change_item;
@@ -92,11 +78,9 @@ static struct UvmStorageValue get_last_storage_changed_value(lua_State *L, const
 
 		return value;
 	}
-	for (auto it = list->rbegin(); it != list->rend(); ++it)
-	{
-		if (it->contract_id == contract_id_str && it->key == key && it->fast_map_key==fast_map_key && it->is_fast_map == is_fast_map)
-			return it->after;
-	}
+	auto last_change = list->find_last(contract_id_str, key, fast_map_key, is_fast_map);
+	if (last_change)
+		return last_change->after;
 	auto value = global_uvm_chain_api->get_storage_value_from_uvm_by_address(L, contract_id, key, fast_map_key, is_fast_map);
 	post_when_read_table(value);
 	return value;
@@ -178,6 +162,42 @@ bool lua_push_storage_value(lua_State *L, const UvmStorageValue &value)
 	return true;
 }
 
+// type of a storage array (decoded from cbor or json), by the type of its first item
+static uvm::blockchain::StorageValueTypes array_storage_value_type(uvm::blockchain::StorageValueTypes first_item_type)
+{
+	switch (first_item_type)
+	{
+	case uvm::blockchain::StorageValueTypes::storage_value_bool:
+		return uvm::blockchain::StorageValueTypes::storage_value_bool_array;
+	case uvm::blockchain::StorageValueTypes::storage_value_int:
+		return uvm::blockchain::StorageValueTypes::storage_value_int_array;
+	case uvm::blockchain::StorageValueTypes::storage_value_number:
+		return uvm::blockchain::StorageValueTypes::storage_value_number_array;
+	case uvm::blockchain::StorageValueTypes::storage_value_string:
+		return uvm::blockchain::StorageValueTypes::storage_value_string_array;
+	default:
+		return uvm::blockchain::StorageValueTypes::storage_value_unknown_array;
+	}
+}
+
+// type of a storage table (decoded from a cbor map or a json object), by the type of the value of its first key
+static uvm::blockchain::StorageValueTypes map_storage_value_type(uvm::blockchain::StorageValueTypes first_item_type)
+{
+	switch (first_item_type)
+	{
+	case uvm::blockchain::StorageValueTypes::storage_value_bool:
+		return uvm::blockchain::StorageValueTypes::storage_value_bool_table;
+	case uvm::blockchain::StorageValueTypes::storage_value_int:
+		return uvm::blockchain::StorageValueTypes::storage_value_int_table;
+	case uvm::blockchain::StorageValueTypes::storage_value_number:
+		return uvm::blockchain::StorageValueTypes::storage_value_number_table;
+	case uvm::blockchain::StorageValueTypes::storage_value_string:
+		return uvm::blockchain::StorageValueTypes::storage_value_string_table;
+	default:
+		return uvm::blockchain::StorageValueTypes::storage_value_unknown_table;
+	}
+}
+
 UvmStorageValue cbor_to_uvm_storage_value(lua_State *L, cbor::CborObject* cbor_value) {
 	UvmStorageValue value;
 	if (cbor_value->is_null())
@@ -229,26 +249,7 @@ UvmStorageValue cbor_to_uvm_storage_value(lua_State *L, cbor::CborObject* cbor_v
 				item_values.push_back(item_value);
 				(*value.value.table_value)[std::to_string(i + 1)] = item_value;
 			}
-			switch (item_values[0].type)
-			{
-			case uvm::blockchain::StorageValueTypes::storage_value_null:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_unknown_array;
-				break;
-			case uvm::blockchain::StorageValueTypes::storage_value_bool:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_bool_array;
-				break;
-			case uvm::blockchain::StorageValueTypes::storage_value_int:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_int_array;
-				break;
-			case uvm::blockchain::StorageValueTypes::storage_value_number:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_number_array;
-				break;
-			case uvm::blockchain::StorageValueTypes::storage_value_string:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_string_array;
-				break;
-			default:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_unknown_array;
-			}
+			value.type = array_storage_value_type(item_values[0].type);
 		}
 		return value;
 	}
@@ -269,26 +270,7 @@ UvmStorageValue cbor_to_uvm_storage_value(lua_State *L, cbor::CborObject* cbor_v
 				item_values.push_back(item_value);
 				(*value.value.table_value)[p.first] = item_value;
 			}
-			switch (item_values[0].type)
-			{
-			case uvm::blockchain::StorageValueTypes::storage_value_null:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_unknown_table;
-				break;
-			case uvm::blockchain::StorageValueTypes::storage_value_bool:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_bool_table;
-				break;
-			case uvm::blockchain::StorageValueTypes::storage_value_int:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_int_table;
-				break;
-			case uvm::blockchain::StorageValueTypes::storage_value_number:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_number_table;
-				break;
-			case uvm::blockchain::StorageValueTypes::storage_value_string:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_string_table;
-				break;
-			default:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_unknown_table;
-			}
+			value.type = map_storage_value_type(item_values[0].type);
 		}
 		return value;
 	}
@@ -297,6 +279,214 @@ UvmStorageValue cbor_to_uvm_storage_value(lua_State *L, cbor::CborObject* cbor_v
 		throw cbor::CborException("not supported cbor value type");
 	}
 }
+
+namespace {
+	// builds the storage value of a cbor document while it is decoded, the value cbor_to_uvm_storage_value gives
+	// for the decoded document but without its CborObject tree. it follows the structure rules of decoder::run()
+	class CborStorageValueBuilder final : public cbor::listener {
+	private:
+		struct Structure
+		{
+			UvmStorageValue *value; // where the array or map is kept, nullptr for a map used as a map key
+			bool is_map;
+			uint32_t size;
+			size_t items_count;
+			std::string first_key; // smallest key of a map, its value gives the table type
+		};
+		lua_State *_L;
+		UvmStorageValue _result;
+		bool _has_result = false;
+		std::vector<Structure> _structures_stack;
+		bool _iter_in_map_key = true;
+		bool _map_key_is_string = false;
+		std::string _map_key;
+		std::list<UvmStorageValue> _key_structures;
+
+		// returns where the value is kept
+		UvmStorageValue *put(const UvmStorageValue &value)
+		{
+			if (_structures_stack.empty())
+			{
+				if (_has_result)
+					throw cbor::cbor_decode_exception("multiple cbor object when decoding");
+				_result = value;
+				_has_result = true;
+				return &_result;
+			}
+			auto &last = _structures_stack.back();
+			UvmStorageValue *slot = nullptr;
+			if (!last.is_map)
+			{
+				slot = &(*last.value->value.table_value)[std::to_string(++last.items_count)];
+				*slot = value;
+				if (last.items_count >= last.size)
+					pop_structure();
+			}
+			else
+			{
+				if (_iter_in_map_key)
+					_map_key_is_string = false;
+				else
+				{
+					if (!_map_key_is_string)
+						throw cbor::cbor_decode_exception("invalid map key type");
+					auto table = last.value->value.table_value;
+					if (table->empty() || _map_key < last.first_key)
+						last.first_key = _map_key;
+					slot = &(*table)[_map_key];
+					*slot = value;
+					if (table->size() >= last.size)
+						pop_structure();
+				}
+				_iter_in_map_key = !_iter_in_map_key;
+			}
+			return slot;
+		}
+
+		void put_structure(bool is_map, uint32_t size)
+		{
+			UvmStorageValue value;
+			value.type = is_map ? uvm::blockchain::StorageValueTypes::storage_value_unknown_table
+				: uvm::blockchain::StorageValueTypes::storage_value_unknown_array;
+			value.value.table_value = uvm::lua::lib::create_managed_lua_table_map(_L);
+			auto slot = put(value);
+			if (size > 0)
+			{
+				Structure structure = { slot, is_map, size, 0 };
+				if (!slot)
+				{
+					// a map key is dropped, its items still have to go somewhere
+					_key_structures.push_back(value);
+					structure.value = &_key_structures.back();
+				}
+				_structures_stack.push_back(structure);
+			}
+		}
+
+		// a full array or map gets its type from its first item
+		void pop_structure()
+		{
+			const auto &structure = _structures_stack.back();
+			auto table = structure.value->value.table_value;
+			if (structure.is_map)
+				structure.value->type = map_storage_value_type((*table)[structure.first_key].type);
+			else
+				structure.value->type = array_storage_value_type((*table)["1"].type);
+			_structures_stack.pop_back();
+		}
+
+		void not_supported()
+		{
+			throw cbor::CborException("not supported cbor value type");
+		}
+	public:
+		explicit CborStorageValueBuilder(lua_State *L) : _L(L) {}
+
+		UvmStorageValue result() const
+		{
+			if (!_has_result)
+				throw cbor::cbor_decode_exception("cbor decoded nothing");
+			if (!_structures_stack.empty())
+				throw cbor::cbor_decode_exception("cbor decode fail with not finished structures");
+			return _result;
+		}
+
+		void on_integer(cbor::CborIntValue value) override
+		{
+			UvmStorageValue storage_value;
+			storage_value.type = uvm::blockchain::StorageValueTypes::storage_value_int;
+			storage_value.value.int_value = value;
+			put(storage_value);
+		}
+
+		void on_extra_integer(cbor::CborExtraIntValue value, bool is_positive) override
+		{
+			// as CborObject::force_as_int
+			auto int_value = static_cast<cbor::CborIntValue>(value);
+			on_integer(is_positive || int_value < 0 ? int_value : -int_value);
+		}
+
+		void on_float64(cbor::CborDoubleValue value) override
+		{
+			UvmStorageValue storage_value;
+			storage_value.type = uvm::blockchain::StorageValueTypes::storage_value_number;
+			storage_value.value.number_value = value;
+			put(storage_value);
+		}
+
+		void on_bytes(const char *data, size_t size) override
+		{
+			not_supported();
+		}
+
+		void on_string(const char *data, size_t size) override
+		{
+			if (_iter_in_map_key && !_structures_stack.empty() && _structures_stack.back().is_map)
+			{
+				_map_key.assign(data, size);
+				_map_key_is_string = true;
+				_iter_in_map_key = false;
+				return;
+			}
+			UvmStorageValue storage_value;
+			storage_value.type = uvm::blockchain::StorageValueTypes::storage_value_string;
+			storage_value.value.string_value = uvm::lua::lib::malloc_and_copy_string(_L, std::string(data, size).c_str());
+			put(storage_value);
+		}
+
+		void on_array(uint32_t size) override
+		{
+			put_structure(false, size);
+		}
+
+		void on_map(uint32_t size) override
+		{
+			put_structure(true, size);
+		}
+
+		void on_tag(cbor::CborTagValue tag) override
+		{
+			not_supported();
+		}
+
+		void on_extra_tag(cbor::CborExtraIntValue tag) override
+		{
+			not_supported();
+		}
+
+		void on_bool(bool value) override
+		{
+			UvmStorageValue storage_value;
+			storage_value.type = uvm::blockchain::StorageValueTypes::storage_value_bool;
+			storage_value.value.bool_value = value;
+			put(storage_value);
+		}
+
+		void on_null() override
+		{
+			UvmStorageValue storage_value;
+			storage_value.type = uvm::blockchain::StorageValueTypes::storage_value_null;
+			storage_value.value.int_value = 0;
+			put(storage_value);
+		}
+
+		void on_undefined() override
+		{
+			not_supported();
+		}
+	};
+}
+
+// decodes the cbor bytes straight into storage values, without a CborObject tree. a value storage has no type for
+// (bytes, tags, undefined) fails the decoding where it is met, the rest of the document is not read
+UvmStorageValue cbor_to_uvm_storage_value(lua_State *L, const char *cbor_data, size_t cbor_size) {
+	cbor::input input(const_cast<char*>(cbor_data), (int)cbor_size);
+	cbor::decoder decoder(input);
+	CborStorageValueBuilder builder(L);
+	decoder.run(builder);
+	return builder.result();
+}
+
 cbor::CborObjectP uvm_storage_value_to_cbor(UvmStorageValue value) {
 	using namespace cbor;
 	switch (value.type)
@@ -438,26 +628,7 @@ UvmStorageValue json_to_uvm_storage_value(lua_State *L, jsondiff::JsonValue json
 				item_values.push_back(item_value);
 				(*value.value.table_value)[std::to_string(i + 1)] = item_value;
 			}
-			switch (item_values[0].type)
-			{
-			case uvm::blockchain::StorageValueTypes::storage_value_null:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_unknown_array;
-				break;
-			case uvm::blockchain::StorageValueTypes::storage_value_bool:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_bool_array;
-				break;
-			case uvm::blockchain::StorageValueTypes::storage_value_int:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_int_array;
-				break;
-			case uvm::blockchain::StorageValueTypes::storage_value_number:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_number_array;
-				break;
-			case uvm::blockchain::StorageValueTypes::storage_value_string:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_string_array;
-				break;
-			default:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_unknown_array;
-			}
+			value.type = array_storage_value_type(item_values[0].type);
 		}
 		return value;
 	}
@@ -478,26 +649,7 @@ UvmStorageValue json_to_uvm_storage_value(lua_State *L, jsondiff::JsonValue json
 				item_values.push_back(item_value);
 				(*value.value.table_value)[p.key()] = item_value;
 			}
-			switch (item_values[0].type)
-			{
-			case uvm::blockchain::StorageValueTypes::storage_value_null:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_unknown_table;
-				break;
-			case uvm::blockchain::StorageValueTypes::storage_value_bool:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_bool_table;
-				break;
-			case uvm::blockchain::StorageValueTypes::storage_value_int:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_int_table;
-				break;
-			case uvm::blockchain::StorageValueTypes::storage_value_number:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_number_table;
-				break;
-			case uvm::blockchain::StorageValueTypes::storage_value_string:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_string_table;
-				break;
-			default:
-				value.type = uvm::blockchain::StorageValueTypes::storage_value_unknown_table;
-			}
+			value.type = map_storage_value_type(item_values[0].type);
 		}
 		return value;
 	}
@@ -507,6 +659,149 @@ UvmStorageValue json_to_uvm_storage_value(lua_State *L, jsondiff::JsonValue json
 	}
 }
 
+static bool is_scalar_storage_value(const UvmStorageValue& value)
+{
+	switch (value.type)
+	{
+	case uvm::blockchain::StorageValueTypes::storage_value_null:
+	case uvm::blockchain::StorageValueTypes::storage_value_bool:
+	case uvm::blockchain::StorageValueTypes::storage_value_int:
+	case uvm::blockchain::StorageValueTypes::storage_value_number:
+	case uvm::blockchain::StorageValueTypes::storage_value_string:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// same result as comparing the cbor encodings of the two values in cbor_diff
+static bool scalar_storage_values_equal(const UvmStorageValue& a, const UvmStorageValue& b)
+{
+	if (a.type != b.type)
+		return false;
+	switch (a.type)
+	{
+	case uvm::blockchain::StorageValueTypes::storage_value_null:
+		return true;
+	case uvm::blockchain::StorageValueTypes::storage_value_bool:
+		return a.value.bool_value == b.value.bool_value;
+	case uvm::blockchain::StorageValueTypes::storage_value_int:
+		return a.value.int_value == b.value.int_value;
+	case uvm::blockchain::StorageValueTypes::storage_value_number:
+		// numbers are encoded as fixed precision text, so different doubles may still encode the same
+		if (memcmp(&a.value.number_value, &b.value.number_value, sizeof(lua_Number)) == 0)
+			return true;
+		return cbor_diff::cbor_encode(uvm_storage_value_to_cbor(a)) == cbor_diff::cbor_encode(uvm_storage_value_to_cbor(b));
+	case uvm::blockchain::StorageValueTypes::storage_value_string:
+		return strcmp(a.value.string_value, b.value.string_value) == 0;
+	default:
+		return false;
+	}
+}
+
+static cbor::CborObjectP scalar_storage_values_diff(const UvmStorageValue& a, const UvmStorageValue& b)
+{
+	cbor::CborMapValue result_json;
+	result_json[CBORDIFF_KEY_OLD_VALUE] = uvm_storage_value_to_cbor(a);
+	result_json[CBORDIFF_KEY_NEW_VALUE] = uvm_storage_value_to_cbor(b);
+	return cbor::CborObject::create_map(result_json);
+}
+
+static cbor::CborObjectP array_item_diff(const char *op, size_t index, cbor::CborObjectP value)
+{
+	cbor::CborArrayValue item_diff;
+	item_diff.push_back(cbor::CborObject::from_string(op));
+	item_diff.push_back(cbor::CborObject::from_int(index));
+	item_diff.push_back(value);
+	return cbor::CborObject::create_array(item_diff);
+}
+
+// Build the cbor_diff of two storage tables of scalars from their entries, so only the
+// changed items are converted to cbor instead of both whole tables.
+// The result is the same as CborDiff::diff on the full cbor values.
+// Returns nullptr when the tables can't be diffed this way (nested or unsupported values,
+// table replaced by array or the reverse, diff keys colliding with table keys),
+// then the caller falls back to the full diff.
+cbor_diff::DiffResultP diff_storage_tables_by_items(const UvmStorageValue& before, const UvmStorageValue& after)
+{
+	const auto &before_items = *before.value.table_value;
+	const auto &after_items = *after.value.table_value;
+	for (const auto &p : before_items)
+	{
+		if (!is_scalar_storage_value(p.second))
+			return nullptr;
+	}
+	for (const auto &p : after_items)
+	{
+		if (!is_scalar_storage_value(p.second))
+			return nullptr;
+	}
+	if (uvm::blockchain::is_any_table_storage_value_type(before.type)
+		&& uvm::blockchain::is_any_table_storage_value_type(after.type))
+	{
+		// both maps are sorted by the same order, walk them side by side
+		cbor::CborMapValue diff_json;
+		const auto &key_less = before_items.key_comp();
+		auto before_it = before_items.begin();
+		auto after_it = after_items.begin();
+		while (before_it != before_items.end() || after_it != after_items.end())
+		{
+			if (after_it == after_items.end()
+				|| (before_it != before_items.end() && key_less(before_it->first, after_it->first)))
+			{
+				if (!diff_json.emplace(before_it->first + CBORDIFF_KEY_DELETED_POSTFIX, uvm_storage_value_to_cbor(before_it->second)).second)
+					return nullptr;
+				++before_it;
+			}
+			else if (before_it == before_items.end() || key_less(after_it->first, before_it->first))
+			{
+				if (!diff_json.emplace(after_it->first + CBORDIFF_KEY_ADDED_POSTFIX, uvm_storage_value_to_cbor(after_it->second)).second)
+					return nullptr;
+				++after_it;
+			}
+			else
+			{
+				if (!scalar_storage_values_equal(before_it->second, after_it->second)
+					&& !diff_json.emplace(before_it->first, scalar_storage_values_diff(before_it->second, after_it->second)).second)
+					return nullptr;
+				++before_it;
+				++after_it;
+			}
+		}
+		if (diff_json.empty())
+			return cbor_diff::DiffResult::make_undefined_diff_result();
+		return std::make_shared<cbor_diff::DiffResult>(*cbor::CborObject::create_map(diff_json));
+	}
+	if (uvm::blockchain::is_any_array_storage_value_type(before.type)
+		&& uvm::blockchain::is_any_array_storage_value_type(after.type))
+	{
+		// arrays are encoded in table order, items are matched by position
+		cbor::CborArrayValue diff_json;
+		auto before_it = before_items.begin();
+		auto after_it = after_items.begin();
+		size_t i = 0;
+		for (; before_it != before_items.end(); ++before_it, ++i)
+		{
+			if (after_it == after_items.end())
+			{
+				diff_json.push_back(array_item_diff("-", i, uvm_storage_value_to_cbor(before_it->second)));
+				continue;
+			}
+			if (!scalar_storage_values_equal(before_it->second, after_it->second))
+				diff_json.push_back(array_item_diff("~", i, scalar_storage_values_diff(before_it->second, after_it->second)));
+			++after_it;
+		}
+		for (; after_it != after_items.end(); ++after_it, ++i)
+		{
+			diff_json.push_back(array_item_diff("+", i, uvm_storage_value_to_cbor(after_it->second)));
+		}
+		if (diff_json.empty())
+			return cbor_diff::DiffResult::make_undefined_diff_result();
+		return std::make_shared<cbor_diff::DiffResult>(*cbor::CborObject::create_array(diff_json));
+	}
+	return nullptr;
+}
+
 static UvmStorageChangeItem diff_storage_change_if_is_table(lua_State *L, UvmStorageChangeItem change_item, bool use_cbor_diff)
 {
 	if (!lua_storage_is_table(change_item.after.type))
@@ -516,6 +811,11 @@ static UvmStorageChangeItem diff_storage_change_if_is_table(lua_State *L, UvmSto
 	try
 	{
 		if (use_cbor_diff) {
+			const auto &items_diff = diff_storage_tables_by_items(change_item.before, change_item.after);
+			if (items_diff) {
+				change_item.cbor_diff = *items_diff;
+				return change_item;
+			}
 			const auto &before_cbor = uvm_storage_value_to_cbor(change_item.before);
 			const auto &after_cbor = uvm_storage_value_to_cbor(change_item.after);
 			cbor_diff::CborDiff differ;
@@ -558,38 +858,31 @@ static UvmStorageChangeItem diff_storage_change_if_is_table(lua_State *L, UvmSto
 
 bool luaL_commit_storage_changes(lua_State *L)
 {
-	UvmStateValueNode storage_changelist_node = uvm::lua::lib::get_lua_state_value_node(L, LUA_STORAGE_CHANGELIST_KEY);
+	UvmStorageChangeList *changelist = L->state_context->storage_changelist;
 	if (global_uvm_chain_api->has_exception(L))
 	{
-		if (storage_changelist_node.type == LUA_STATE_VALUE_POINTER && nullptr != storage_changelist_node.value.pointer_value)
-		{
-			UvmStorageChangeList *list = (UvmStorageChangeList*)storage_changelist_node.value.pointer_value;
-			list->clear();
-		}
+		if (changelist)
+			changelist->clear();
 		return false;
 	}
 	auto use_cbor_diff = global_uvm_chain_api->use_cbor_diff(L);
 	// merge changes
 	std::unordered_map<std::string, std::shared_ptr<std::unordered_map<std::string, UvmStorageChangeItem>>> changes; // contract_id => (storage_unique_key => change_item)
 	UvmStorageTableReadList *table_read_list = get_or_init_storage_table_read_list(L);
-	if (storage_changelist_node.type != LUA_STATE_VALUE_POINTER && table_read_list)
+	if (!changelist && table_read_list)
 	{
-		storage_changelist_node.type = LUA_STATE_VALUE_POINTER;
-		auto *list = (UvmStorageChangeList*)lua_malloc(L, sizeof(UvmStorageChangeList));
-		if (!list)
+		changelist = (UvmStorageChangeList*)lua_malloc(L, sizeof(UvmStorageChangeList));
+		if (!changelist)
 		{
 			return false;
 		}
-		new (list)UvmStorageChangeList();
-		UvmStateValue value_to_store;
-		value_to_store.pointer_value = list;
-		uvm::lua::lib::set_lua_state_value(L, LUA_STORAGE_CHANGELIST_KEY, value_to_store, LUA_STATE_VALUE_POINTER);
-		storage_changelist_node.value.pointer_value = list;
+		new (changelist)UvmStorageChangeList();
+		L->state_context->storage_changelist = changelist;
 	}
 
-	if (storage_changelist_node.type == LUA_STATE_VALUE_POINTER && nullptr != storage_changelist_node.value.pointer_value)
+	if (changelist)
 	{
-		UvmStorageChangeList *list = (UvmStorageChangeList*)storage_changelist_node.value.pointer_value;
+		UvmStorageChangeList *list = changelist;
 		
 		bool mod_change_list = false;
 		int64_t mod_change_list_fork_height = -1;
@@ -913,11 +1206,8 @@ bool luaL_commit_storage_changes(lua_State *L)
 		return false;
 	}
 	auto result = global_uvm_chain_api->commit_storage_changes_to_uvm(L, changes);
-	if (storage_changelist_node.type == LUA_STATE_VALUE_POINTER && nullptr != storage_changelist_node.value.pointer_value)
-	{
-		UvmStorageChangeList *list = (UvmStorageChangeList*)storage_changelist_node.value.pointer_value;
-		list->clear();
-	}
+	if (changelist)
+		changelist->clear();
 	return result;
 }
 
@@ -948,9 +1238,9 @@ namespace uvm {
 				return 1;
 			}
 			lua_pop(L, 1);
-			const auto &state_value_node = uvm::lua::lib::get_lua_state_value_node(L, LUA_STORAGE_CHANGELIST_KEY);
+			UvmStorageChangeList *changelist = L->state_context->storage_changelist;
 			int result;
-			if (state_value_node.type != LUA_STATE_VALUE_POINTER || !state_value_node.value.pointer_value)
+			if (!changelist)
 			{
 				const auto &value = get_last_storage_changed_value(L, contract_id, nullptr, std::string(name), fast_map_key ? std::string(fast_map_key) : std::string(""), is_fast_map);
 				lua_push_storage_value(L, value);
@@ -970,8 +1260,7 @@ namespace uvm {
 			}
 			else
 			{
-				UvmStorageChangeList *list = (UvmStorageChangeList*)state_value_node.value.pointer_value;
-				const auto &value = get_last_storage_changed_value(L, contract_id, list, std::string(name), fast_map_key ? std::string(fast_map_key) : std::string(""), is_fast_map);
+				const auto &value = get_last_storage_changed_value(L, contract_id, changelist, std::string(name), fast_map_key ? std::string(fast_map_key) : std::string(""), is_fast_map);
 				lua_push_storage_value(L, value);
 				if (lua_storage_is_table(value.type))
 				{
@@ -1022,16 +1311,7 @@ namespace uvm {
 				auto *table_read_list = get_or_init_storage_table_read_list(L);
 				if (table_read_list)
 				{
-					bool found = false;
-					for (auto it = table_read_list->begin(); it != table_read_list->end(); ++it)
-					{
-						if (it->contract_id == std::string(contract_id) && it->key == name && it->fast_map_key== fast_map_key_str && it->is_fast_map==is_fast_map)
-						{
-							found = true;
-							break;
-						}
-					}
-					if (!found)
+					if (!table_read_list->find_last(contract_id, name, fast_map_key_str, is_fast_map))
 					{
 						UvmStorageChangeItem change_item;
 						change_item.contract_id = contract_id;
@@ -1054,9 +1334,8 @@ namespace uvm {
 			*/
 
 			// log the value before and the new value
-			UvmStateValueNode state_value_node = uvm::lua::lib::get_lua_state_value_node(L, LUA_STORAGE_CHANGELIST_KEY);
-			UvmStorageChangeList *list;
-			if (state_value_node.type != LUA_STATE_VALUE_POINTER || nullptr == state_value_node.value.pointer_value)
+			UvmStorageChangeList *list = L->state_context->storage_changelist;
+			if (nullptr == list)
 			{
 				list = (UvmStorageChangeList*)lua_malloc(L, sizeof(UvmStorageChangeList));
 				if (!list)
@@ -1064,13 +1343,7 @@ namespace uvm {
 					return 0;
 				}
 				new (list)UvmStorageChangeList();
-				UvmStateValue value_to_store;
-				value_to_store.pointer_value = list;
-				uvm::lua::lib::set_lua_state_value(L, LUA_STORAGE_CHANGELIST_KEY, value_to_store, LUA_STATE_VALUE_POINTER);
-			}
-			else
-			{
-				list = (UvmStorageChangeList*)state_value_node.value.pointer_value;
+				L->state_context->storage_changelist = list;
 			}
 			if (uvm::lua::lib::check_in_lua_sandbox(L))
 			{
@@ -1188,22 +1461,21 @@ namespace uvm {
 				if ((!lua_storage_is_table(before.type) || before.value.table_value->size() < 1) && after.value.table_value->size() > 0)
 				{
 					// if before table is empty and after table not empty, search type before
-					for (auto it = list->begin(); it != list->end(); ++it)
+					auto storage_changes = list->find(contract_id, name, fast_map_key_str, is_fast_map);
+					for (size_t i = 0; storage_changes && i < storage_changes->size(); ++i)
 					{
-						if (it->contract_id == std::string(contract_id) && it->key == std::string(name) && it->fast_map_key==fast_map_key_str && it->is_fast_map==is_fast_map)
+						const auto &it = (*storage_changes)[i];
+						if (lua_storage_is_table(it->after.type) && it->after.value.table_value->size() > 0)
 						{
-							if (lua_storage_is_table(it->after.type) && it->after.value.table_value->size() > 0)
+							for (auto it2 = it->after.value.table_value->begin(); it2 != it->after.value.table_value->end(); ++it2)
 							{
-								for (auto it2 = it->after.value.table_value->begin(); it2 != it->after.value.table_value->end(); ++it2)
+								if (it2->second.type != uvm::blockchain::StorageValueTypes::storage_value_null)
 								{
-									if (it2->second.type != uvm::blockchain::StorageValueTypes::storage_value_null)
+									if (it2->second.type != table_value_type)
 									{
-										if (it2->second.type != table_value_type)
-										{
-											global_uvm_chain_api->throw_exception(L, UVM_API_SIMPLE_ERROR, "storage table type must be same");
-											uvm::lua::lib::notify_lua_state_stop(L);
-											return 0;
-										}
+										global_uvm_chain_api->throw_exception(L, UVM_API_SIMPLE_ERROR, "storage table type must be same");
+										uvm::lua::lib::notify_lua_state_stop(L);
+										return 0;
 									}
 								}
 							}
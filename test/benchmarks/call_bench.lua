@@ -0,0 +1,63 @@
+-- call frame benchmarks: deep recursion through contract-style method calls
+-- every call and return enters a new frame in lvm, so this measures the per-frame setup
+-- usage: uvm_single_exec test/benchmarks/call_bench.lua
+local os = require 'os'
+
+local function bench(name, fn, depth, n)
+    local insts_before = os.instructions()
+    local start = os.clock()
+    for i = 1, n do
+        fn(depth)
+    end
+    local seconds = os.clock() - start
+    local insts = os.instructions() - insts_before
+    local calls = depth * n
+    local rate = 0
+    if seconds > 0 then
+        rate = calls / seconds
+    end
+    print(string.format('%-20s depth=%-5d n=%-7d insts=%-10d %.3fs %12.0f calls/s', name, depth, n, insts, seconds, rate))
+end
+
+local M = {}
+M.storage = { total = 0 }
+
+function M:sum(depth)
+    if depth == 0 then
+        return 0
+    end
+    return depth + self:sum(depth - 1)
+end
+
+function M:ping(depth)
+    if depth == 0 then
+        return self.storage.total
+    end
+    return self:pong(depth - 1)
+end
+
+function M:pong(depth)
+    if depth == 0 then
+        return self.storage.total
+    end
+    return self:ping(depth - 1)
+end
+
+local function method_sum(depth)
+    return M:sum(depth)
+end
+
+local function mutual(depth)
+    return M:ping(depth)
+end
+
+local function tail(depth)
+    if depth == 0 then
+        return 0
+    end
+    return tail(depth - 1)
+end
+
+bench('method recursion', method_sum, 150, 5000)
+bench('mutual recursion', mutual, 150, 5000)
+bench('tail calls', tail, 150, 5000)
@@ -0,0 +1,71 @@
+-- interpreter dispatch benchmarks: calls, loops, table fill, string building
+-- usage: uvm_single_exec test/benchmarks/interp_bench.lua
+local os = require 'os'
+
+local function bench(name, fn, n)
+    local insts_before = os.instructions()
+    local start = os.clock()
+    fn(n)
+    local seconds = os.clock() - start
+    local insts = os.instructions() - insts_before
+    local rate = 0
+    if seconds > 0 then
+        rate = insts / seconds
+    end
+    print(string.format('%-16s n=%-8d insts=%-12d %.3fs %14.0f insts/s', name, n, insts, seconds, rate))
+end
+
+local function fib(n)
+    if n < 2 then
+        return n
+    end
+    return fib(n - 1) + fib(n - 2)
+end
+
+local function loops(n)
+    local sum = 0
+    for i = 1, n do
+        local x = i % 7
+        if x == 3 then
+            sum = sum + i
+        elseif x > 3 then
+            sum = sum - x
+        else
+            sum = sum + x * 2
+        end
+    end
+    local j = 0
+    while j < n do
+        j = j + 1
+    end
+    return sum + j
+end
+
+local function table_fill(n)
+    local t = {}
+    for i = 1, n do
+        t[i] = i
+    end
+    local total = 0
+    for i = 1, #t do
+        total = total + t[i]
+    end
+    return total
+end
+
+local function string_build(n)
+    local parts = {}
+    for i = 1, n do
+        parts[#parts + 1] = 'item' .. tostring(i)
+    end
+    local s = ''
+    for i = 1, 200 do
+        s = s .. parts[i]
+    end
+    return #s + #table.concat(parts, ',')
+end
+
+bench('fib', fib, 25)
+bench('loops', loops, 1000000)
+bench('table fill', table_fill, 200000)
+bench('string build', string_build, 50000)
@@ -0,0 +1,54 @@
+-- json.loads and json.dumps benchmarks on documents of about 1KB, 100KB and 1MB
+-- usage: uvm_single_exec test/benchmarks/json_bench.lua
+local os = require 'os'
+
+-- an array of records like the ones contracts keep in json: strings, numbers, bools and small nested values
+local function make_document(size)
+    local parts = {}
+    local length = 2
+    local i = 0
+    while length < size do
+        i = i + 1
+        local record = string.format(
+            '{"id":%d,"owner":"address%d","name":"item \\"%d\\"","amount":%d,"price":%d.25,"active":%s,"tags":["a","b",%d],"meta":{"created":%d,"note":"line\\nbreak"}}',
+            i, i, i, i * 1000, i, i % 2 == 0 and 'true' or 'false', i, 1536033055 + i)
+        if i > 1 then
+            record = ',' .. record
+        end
+        parts[#parts + 1] = record
+        length = length + #record
+    end
+    return '[' .. table.concat(parts) .. ']', i
+end
+
+local function report(name, bytes, rounds, seconds, op)
+    local rate = 0
+    if seconds > 0 then
+        rate = bytes * rounds / seconds / 1024 / 1024
+    end
+    print(string.format('%-8s %-6s bytes=%-8d rounds=%-6d %.3fs %8.1f MB/s %10.1f us/op', name, op, bytes, rounds, seconds, rate, seconds * 1000000 / rounds))
+end
+
+local function bench(name, size, rounds)
+    local doc, records = make_document(size)
+    local value = json.loads(doc)
+    if #value ~= records or value[records].id ~= records then
+        error('unexpected json.loads result for ' .. name)
+    end
+    local start = os.clock()
+    for i = 1, rounds do
+        json.loads(doc)
+    end
+    report(name, #doc, rounds, os.clock() - start, 'loads')
+
+    local dumped = json.dumps(value)
+    start = os.clock()
+    for i = 1, rounds do
+        json.dumps(value)
+    end
+    report(name, #dumped, rounds, os.clock() - start, 'dumps')
+end
+
+bench('1KB', 1024, 20000)
+bench('100KB', 100 * 1024, 200)
+bench('1MB', 1024 * 1024, 20)
@@ -0,0 +1,50 @@
+// lua_State startup benchmark: create_lua_state against copies of the prototype state
+// usage: uvm_startup_bench [cycles]
+#include <uvm/lprefix.h>
+#include <uvm/lua.h>
+#include <uvm/uvm_lib.h>
+#include "uvm_api.demo.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using uvm::lua::api::global_uvm_chain_api;
+
+typedef lua_State *(*create_state_func)(bool use_contract, bool allow_change_global);
+
+static double median(std::vector<double>& values) {
+	std::sort(values.begin(), values.end());
+	return values[values.size() / 2];
+}
+
+// median microseconds to create and to close a contract state
+static void bench_startup(const char* name, create_state_func create_state, size_t cycles) {
+	std::vector<double> create_us, close_us;
+	for (size_t i = 0; i < cycles; i++) {
+		auto start = std::chrono::steady_clock::now();
+		auto L = create_state(true, false);
+		auto created = std::chrono::steady_clock::now();
+		uvm::lua::lib::close_lua_state(L);
+		auto closed = std::chrono::steady_clock::now();
+		create_us.push_back(std::chrono::duration<double, std::micro>(created - start).count());
+		close_us.push_back(std::chrono::duration<double, std::micro>(closed - created).count());
+	}
+	std::cout << name << "\tcreate: " << median(create_us) << " us"
+		<< "\tclose: " << median(close_us) << " us" << std::endl;
+}
+
+int main(int argc, char** argv) {
+	size_t cycles = argc > 1 ? size_t(std::atol(argv[1])) : 10000;
+	global_uvm_chain_api = new uvm::lua::api::DemoUvmChainApi();
+	for (int arena = 0; arena < 2; arena++) {
+		lua_setgcarena(arena);
+		std::cout << (arena ? "with gc state pool" : "without gc state pool") << std::endl;
+		bench_startup("create_lua_state", &uvm::lua::lib::create_lua_state, cycles);
+		bench_startup("from prototype", &uvm::lua::lib::create_lua_state_from_prototype, cycles);
+		uvm::lua::lib::close_lua_state_prototypes();
+	}
+	return 0;
+}
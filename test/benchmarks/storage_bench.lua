@@ -0,0 +1,52 @@
+-- storage change list benchmarks: many fast_map_set/fast_map_get calls in one contract call
+-- usage: uvm_single_exec test/benchmarks/storage_bench.lua
+local os = require 'os'
+
+local function bench(name, fn, n)
+    local start = os.clock()
+    local result = fn(n)
+    local seconds = os.clock() - start
+    local rate = 0
+    if seconds > 0 then
+        rate = n / seconds
+    end
+    print(string.format('%-20s n=%-7d %.3fs %12.0f ops/s  (%s)', name, n, seconds, rate, tostring(result)))
+end
+
+local function set_new_keys(n)
+    for i = 1, n do
+        fast_map_set('balances', 'user' .. tostring(i), i)
+    end
+    return n
+end
+
+local function get_changed_keys(n)
+    local sum = 0
+    for i = 1, n do
+        sum = sum + fast_map_get('balances', 'user' .. tostring(i))
+    end
+    return sum
+end
+
+local function update_keys(n)
+    for i = 1, n do
+        local key = 'user' .. tostring(i % 100 + 1)
+        fast_map_set('balances', key, fast_map_get('balances', key) + 1)
+    end
+    return fast_map_get('balances', 'user1')
+end
+
+local function get_unread_keys(n)
+    local count = 0
+    for i = 1, n do
+        if fast_map_get('orders', 'order' .. tostring(i)) == nil then
+            count = count + 1
+        end
+    end
+    return count
+end
+
+bench('set new keys', set_new_keys, 10000)
+bench('get changed keys', get_changed_keys, 10000)
+bench('update keys', update_keys, 10000)
+bench('get unread keys', get_unread_keys, 10000)
@@ -0,0 +1,80 @@
+-- string micro benchmarks: concat, interning, field lookups, string library
+-- usage: uvm_single_exec test/benchmarks/string_bench.lua
+local os = require 'os'
+
+local function bench(name, ops, fn)
+    local start = os.clock()
+    fn(ops)
+    local seconds = os.clock() - start
+    local rate = 0
+    if seconds > 0 then
+        rate = ops / seconds
+    end
+    print(string.format('%-20s ops=%-10d %.3fs %12.0f ops/s', name, ops, seconds, rate))
+end
+
+-- same loop as test/test_many_string_operations.lua
+local function concat_tostring(ops)
+    for i = 1, ops do
+        local s = "hello" .. tostring(i)
+    end
+end
+
+local function concat_same(ops)
+    local a, b = 'balance', 'Of'
+    for i = 1, ops do
+        local s = a .. b
+    end
+end
+
+local function concat_long(ops)
+    local prefix = string.rep('x', 64)
+    for i = 1, ops do
+        local s = prefix .. tostring(i)
+    end
+end
+
+local function field_lookup(ops)
+    local t = { name = 'token', symbol = 'TKN', balance = 1, owner = 'someone' }
+    local sum = 0
+    for i = 1, ops do
+        sum = sum + t.balance
+    end
+end
+
+local function built_key_lookup(ops)
+    local t = {}
+    for i = 1, 100 do
+        t['user' .. tostring(i)] = i
+    end
+    local sum = 0
+    for i = 1, ops do
+        sum = sum + t['user' .. tostring(i % 100 + 1)]
+    end
+end
+
+local function string_equal(ops)
+    local a = 'address' .. tostring(1)
+    local n = 0
+    for i = 1, ops do
+        if a == 'address1' then
+            n = n + 1
+        end
+    end
+end
+
+local function string_lib(ops)
+    for i = 1, ops do
+        local s = string.sub('hello world', 1, 5)
+        local l = string.len(s)
+        local u = string.upper(s)
+    end
+end
+
+bench('concat tostring', 1000000, concat_tostring)
+bench('concat same', 1000000, concat_same)
+bench('concat long', 300000, concat_long)
+bench('field lookup', 3000000, field_lookup)
+bench('built key lookup', 1000000, built_key_lookup)
+bench('string equal', 3000000, string_equal)
+bench('string lib', 300000, string_lib)
@@ -0,0 +1,152 @@
+-- table micro benchmarks: get/set/next/len at various sizes
+-- usage: uvm_single_exec test/benchmarks/table_bench.lua
+local os = require 'os'
+
+local function bench(name, size, rounds, fn)
+    local start = os.clock()
+    local ops = fn(size, rounds)
+    local seconds = os.clock() - start
+    local rate = 0
+    if seconds > 0 then
+        rate = ops / seconds
+    end
+    print(string.format('%-16s size=%-8d ops=%-10d %.3fs %12.0f ops/s', name, size, ops, seconds, rate))
+end
+
+local function fill_array(size)
+    local t = {}
+    for i = 1, size do
+        t[i] = i
+    end
+    return t
+end
+
+local function fill_map(size)
+    local t = {}
+    for i = 1, size do
+        t['key' .. tostring(i)] = i
+    end
+    return t
+end
+
+local function key_names(size)
+    local names = {}
+    for i = 1, size do
+        names[i] = 'key' .. tostring(i)
+    end
+    return names
+end
+
+local function set_array(size, rounds)
+    for r = 1, rounds do
+        local t = {}
+        for i = 1, size do
+            t[i] = i
+        end
+    end
+    return size * rounds
+end
+
+local function set_map(size, rounds)
+    local names = key_names(size)
+    for r = 1, rounds do
+        local t = {}
+        for i = 1, size do
+            t[names[i]] = i
+        end
+    end
+    return size * rounds
+end
+
+local function set_sparse_int(size, rounds)
+    for r = 1, rounds do
+        local t = {}
+        for i = size, 1, -1 do
+            t[i * 7] = i
+        end
+    end
+    return size * rounds
+end
+
+local function get_map(size, rounds)
+    local t = fill_map(size)
+    local names = key_names(size)
+    local sum = 0
+    for r = 1, rounds do
+        for i = 1, size do
+            sum = sum + t[names[i]]
+        end
+    end
+    return size * rounds
+end
+
+local function get_field(size, rounds)
+    local t = fill_map(size)
+    t.balance = 1
+    local sum = 0
+    for r = 1, rounds * size do
+        sum = sum + t.balance
+    end
+    return size * rounds
+end
+
+local function next_map(size, rounds)
+    local t = fill_map(size)
+    local count = 0
+    for r = 1, rounds do
+        for k, v in pairs(t) do
+            count = count + 1
+        end
+    end
+    return count
+end
+
+local function raw_next_map(size, rounds)
+    local t = fill_map(size)
+    local count = 0
+    for r = 1, rounds do
+        local k, v = next(t)
+        while k ~= nil do
+            count = count + 1
+            k, v = next(t, k)
+        end
+    end
+    return count
+end
+
+local function next_array(size, rounds)
+    local t = fill_array(size)
+    local count = 0
+    for r = 1, rounds do
+        for k, v in pairs(t) do
+            count = count + 1
+        end
+    end
+    return count
+end
+
+local function len_array(size, rounds)
+    local t = fill_array(size)
+    local n = 0
+    for r = 1, rounds * 100 do
+        n = n + #t
+    end
+    return rounds * 100
+end
+
+local sizes = { 10, 1000, 100000 }
+for _, size in ipairs(sizes) do
+    local rounds = 200000 // size
+    if rounds < 2 then
+        rounds = 2
+    end
+    bench('set array', size, rounds, set_array)
+    bench('set map', size, rounds, set_map)
+    bench('set sparse int', size, rounds, set_sparse_int)
+    bench('get map', size, rounds, get_map)
+    bench('get field', size, rounds, get_field)
+    bench('next map', size, rounds, next_map)
+    bench('raw next map', size, rounds, raw_next_map)
+    bench('next array', size, rounds, next_array)
+    bench('len array', size, rounds, len_array)
+end
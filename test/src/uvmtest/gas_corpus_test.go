@@ -0,0 +1,120 @@
+package main
+
+import (
+	"bufio"
+	"bytes"
+	"io/ioutil"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"regexp"
+	"runtime"
+	"strconv"
+	"strings"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func findUvmTestDir() string {
+	dir, err := os.Getwd()
+	if err != nil {
+		panic(err)
+	}
+	dirAbs, err := filepath.Abs(dir)
+	if err != nil {
+		panic(err)
+	}
+	uvmDir := filepath.Dir(filepath.Dir(filepath.Dir(dirAbs)))
+	return filepath.Join(uvmDir, "test")
+}
+
+func findUvmSinglePath() string {
+	uvmDir := filepath.Dir(findUvmTestDir())
+	if runtime.GOOS == "windows" {
+		return filepath.Join(uvmDir, "x64", "Debug", "uvm_single.exe")
+	}
+	return filepath.Join(uvmDir, "uvm_single_exec")
+}
+
+// copyUvmModules copies the contracts the corpus scripts import (test/src/uvmtest/uvm_modules) into dir
+func copyUvmModules(testDir string, dir string) error {
+	modulesDir := filepath.Join(testDir, "src", "uvmtest", "uvm_modules")
+	files, err := ioutil.ReadDir(modulesDir)
+	if err != nil {
+		return err
+	}
+	if err = os.Mkdir(filepath.Join(dir, "uvm_modules"), 0755); err != nil {
+		return err
+	}
+	for _, file := range files {
+		if file.IsDir() {
+			continue
+		}
+		data, err := ioutil.ReadFile(filepath.Join(modulesDir, file.Name()))
+		if err != nil {
+			return err
+		}
+		if err = ioutil.WriteFile(filepath.Join(dir, "uvm_modules", file.Name()), data, 0644); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// execCommandInDir runs program in dir and returns its stdout, stderr and the error of a failed or non-zero exit
+func execCommandInDir(dir string, program string, args ...string) (string, string, error) {
+	cmd := exec.Command(program, args...)
+	var outb, errb bytes.Buffer
+	cmd.Dir = dir
+	cmd.Stdout = &outb
+	cmd.Stderr = &errb
+	err := cmd.Run()
+	return outb.String(), errb.String(), err
+}
+
+var gasOutputPattern = regexp.MustCompile(`(?m)^gas: (\d+)$`)
+var callGasOutputPattern = regexp.MustCompile(`(?m)^gas after call: (\d+)$`)
+
+// TestGasCorpus runs every script of test/gas_corpus.txt, or calls the contract api of the line,
+// and checks it succeeds using exactly the recorded gas. Every line runs in a new empty directory
+// holding only uvm_modules, so no contract storage file is left over from an earlier line
+func TestGasCorpus(t *testing.T) {
+	testDir := findUvmTestDir()
+	f, err := os.Open(filepath.Join(testDir, "gas_corpus.txt"))
+	assert.True(t, err == nil)
+	defer f.Close()
+	scanner := bufio.NewScanner(f)
+	for scanner.Scan() {
+		line := strings.TrimSpace(scanner.Text())
+		if len(line) == 0 || strings.HasPrefix(line, "#") {
+			continue
+		}
+		fields := strings.Fields(line)
+		if !assert.True(t, len(fields) == 2 || len(fields) == 4, line) {
+			continue
+		}
+		expected, err := strconv.ParseInt(fields[1], 10, 64)
+		assert.True(t, err == nil)
+		dir := t.TempDir()
+		if !assert.True(t, copyUvmModules(testDir, dir) == nil, line) {
+			continue
+		}
+		var out, errOut string
+		var match []string
+		if len(fields) == 4 {
+			out, errOut, err = execCommandInDir(dir, findUvmSinglePath(), "-g", "-k", filepath.Join(testDir, fields[0]), fields[2], fields[3])
+			match = callGasOutputPattern.FindStringSubmatch(out)
+		} else {
+			out, errOut, err = execCommandInDir(dir, findUvmSinglePath(), "-g", filepath.Join(testDir, fields[0]))
+			match = gasOutputPattern.FindStringSubmatch(out)
+		}
+		if !assert.True(t, err == nil, line+"\n"+out+errOut) {
+			continue
+		}
+		if assert.NotNil(t, match, line) {
+			gas, _ := strconv.ParseInt(match[1], 10, 64)
+			assert.Equal(t, expected, gas, line)
+		}
+	}
+}
@@ -395,6 +395,111 @@ func TestDicewinExec(t *testing.T) {
 	testDicewinExec(t)
 }
 
+func TestTokenContractMultithread(t *testing.T) {
+	fmt.Println("TestTokenContractMultithread")
+	out, errOut := execCommand(simpleChainPath, "test_multithread", testContractPath("./token.gpc"), "8")
+	fmt.Println(out)
+	fmt.Println(errOut)
+	assert.Contains(t, out, "test_token_contract_multithread passed on 8 threads")
+}
+
+func TestParallelBlockExecution(t *testing.T) {
+	fmt.Println("TestParallelBlockExecution")
+	out, errOut := execCommand(simpleChainPath, "test_parallel_block", testContractPath("./token.gpc"), "500")
+	fmt.Println(out)
+	fmt.Println(errOut)
+	assert.Contains(t, out, "test_parallel_block_execution passed")
+}
+
+func TestChainLookups(t *testing.T) {
+	fmt.Println("TestChainLookups")
+	out, errOut := execCommand(simpleChainPath, "test_chain_lookups", "10000")
+	fmt.Println(out)
+	fmt.Println(errOut)
+	assert.Contains(t, out, "test_chain_lookups passed")
+}
+
+func TestStateDb(t *testing.T) {
+	fmt.Println("TestStateDb")
+	out, errOut := execCommand(simpleChainPath, "test_state_db", testContractPath("./token.gpc"))
+	fmt.Println(out)
+	fmt.Println(errOut)
+	assert.Contains(t, out, "test_state_db passed")
+}
+
+func TestStorageDiffByItems(t *testing.T) {
+	fmt.Println("TestStorageDiffByItems")
+	out, errOut := execCommand(simpleChainPath, "test_storage_diff", "200000")
+	fmt.Println(out)
+	fmt.Println(errOut)
+	assert.Contains(t, out, "test_storage_diff_by_items passed")
+}
+
+func TestCborTypeChecks(t *testing.T) {
+	fmt.Println("TestCborTypeChecks")
+	out, errOut := execCommand(simpleChainPath, "test_cbor")
+	fmt.Println(out)
+	fmt.Println(errOut)
+	assert.Contains(t, out, "test_cbor_type_checks passed")
+	assert.Contains(t, out, "test_cbor_encoding passed")
+	assert.Contains(t, out, "test_cbor_patch_rollback passed")
+}
+
+func TestContractStoragesPage(t *testing.T) {
+	fmt.Println("TestContractStoragesPage")
+	cmd := execCommandBackground(simpleChainPath)
+	assert.True(t, cmd != nil)
+	fmt.Printf("simplechain pid: %d\n", cmd.Process.Pid)
+	defer func() {
+		kill(cmd)
+	}()
+	time.Sleep(1 * time.Second)
+
+	caller1 := "SPLtest1"
+	res, err := simpleChainRPC("create_contract_from_file", caller1, testContractPath("./token.gpc"), 50000, 10)
+	assert.True(t, err == nil)
+	contractAddr := res.Get("contract_address").MustString()
+	simpleChainRPC("generate_block")
+	_, err = invokeContract(caller1, contractAddr, "init_token", "test,TEST,10000,100")
+	assert.True(t, err == nil)
+	simpleChainRPC("generate_block")
+
+	res, err = simpleChainRPC("get_contract_storages", contractAddr)
+	assert.True(t, err == nil)
+	storages := res.MustMap()
+	assert.True(t, len(storages) > 2)
+
+	paged := make(map[string]interface{})
+	startAfter := ""
+	for pages := 0; pages <= len(storages); pages++ {
+		res, err = simpleChainRPC("get_contract_storages_page", contractAddr, startAfter, 2)
+		assert.True(t, err == nil)
+		page := res.Get("storages").MustMap()
+		assert.True(t, len(page) <= 2)
+		for name, value := range page {
+			paged[name] = value
+		}
+		next, err := res.Get("next").String()
+		if err != nil {
+			break
+		}
+		startAfter = next
+	}
+	assert.Equal(t, storages, paged)
+
+	// an empty page would never reach the end, so a limit of 0 is an error
+	res, err = simpleChainRPC("get_contract_storages_page", contractAddr, "", 0)
+	assert.True(t, err == nil)
+	_, err = res.Get("storages").Map()
+	assert.True(t, err != nil)
+
+	res, err = simpleChainRPC("get_contract_storages_page", contractAddr, "", 1000000)
+	assert.True(t, err == nil)
+	assert.Equal(t, storages, res.Get("storages").MustMap())
+	_, err = res.Get("next").String()
+	assert.True(t, err != nil)
+}
+
 // ----------------------------------------------------
 func invokeContractOffline(caller string, contractAddress string, apiName string, apiArg string) (*simplejson.Json, error) {
 	res, err := simpleChainRPC("invoke_contract_offline", caller, contractAddress, apiName, []string{apiArg}, 0, 0)
@@ -0,0 +1,13 @@
+-- dumped string constants keep the baseline tags: 4 for strings up to 40 bytes, 20 for longer ones
+local function f()
+    return 'short', 'xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx'
+end
+local dumped = string.dump(f)
+
+if not string.find(dumped, "\4\6short", 1, true) then
+    error("short string constant is not dumped with tag 4")
+end
+if not string.find(dumped, "\20\51" .. string.rep("x", 50), 1, true) then
+    error("long string constant is not dumped with tag 20")
+end
+print("dump string tags ok")
@@ -0,0 +1,47 @@
+-- the collector runs in Lua code called back from C functions (string.gsub, delegate_call),
+-- so loops there can allocate more than the gc heap limit in temporaries.
+-- run from test/tests_lua, the callee contract is written to a tmp file there
+local io = require 'io'
+local os = require 'os'
+
+-- about 700MB of strings, dead as soon as the next one is made
+local function churn()
+    local n = 0
+    for i = 1, 7000 do
+        local s = string.rep('x', 100000) .. tostring(i)
+        n = n + #s
+    end
+    return n
+end
+local expected = tostring(churn())
+
+local replaced = string.gsub('a', 'a', function(c) return tostring(churn()) end)
+if replaced ~= expected then
+    error("allocating in a gsub callback failed")
+end
+print("gc in gsub callback ok")
+
+local function callee_contract()
+    local M = {}
+    function M:init()
+    end
+    function M:start(arg)
+        local n = 0
+        for i = 1, 7000 do
+            local s = string.rep('x', 100000) .. tostring(i)
+            n = n + #s
+        end
+        return tostring(n)
+    end
+    return M
+end
+local callee_path = './tmp_gc_in_c_calls_callee.out'
+local f = io.open(callee_path, 'wb')
+f:write(string.dump(callee_contract))
+f:close()
+local result = delegate_call(callee_path, 'start', 'x')
+os.remove(callee_path)
+if result ~= expected then
+    error("allocating in a delegate_call api failed")
+end
+print("gc in delegate_call ok")
@@ -0,0 +1,36 @@
+-- pairs iterates number keys first, then string keys: shorter strings first, same length by bytes
+local t = { 10, 20, 30 }
+t[-5] = 'neg'
+t[100] = 'h'
+t.b = 1
+t.a = 2
+t.aa = 3
+t.B = 4
+t[''] = 5
+t.ab = 6
+
+local s = ''
+for k, v in pairs(t) do
+	s = s .. ';' .. tostring(k) .. ':' .. tostring(v)
+end
+print(s)
+-- ;-5:neg;1:10;2:20;3:30;100:h;:5;B:4;a:2;b:1;aa:3;ab:6
+
+local count = 0
+for k, v in pairs(t) do
+	count = count + 1
+	if k == 2 then
+		break
+	end
+end
+print(count)
+-- 3
+
+local m = { x = 1, y = 2 }
+local seen = ''
+for k, v in pairs(m) do
+	m.y = nil
+	seen = seen .. ';' .. k .. ':' .. tostring(v)
+end
+print(seen)
+-- ;x:1;y:nil
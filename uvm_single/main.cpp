@@ -76,7 +76,7 @@ static void print_usage(const char *badoption) {
 	else
 		lua_writestringerror("unrecognized option '%s'\n", badoption);
 	lua_writestringerror(
-		"usage: %s [options] [script [args]]\n"
+		"usage: %s [options] [script [args]], script is a bytecode file or a contract package (.gpc)\n"
 		"Available options are:\n"
 		"  -e stat  execute string 'stat'\n"
 		"  -i       enter interactive mode after executing 'script'\n"
@@ -89,6 +89,7 @@ static void print_usage(const char *badoption) {
 		"  -t       run contract testcases, load script_path + '.test' bytecode file(contains a function accept contract table) to run testcases\n"
 		"  -k       call contract api, -k script_path contract_api api_argument [caller_address caller_pubkey]\n"
 		"  -x       run with debugger\n"
+		"  -g       print the gas (executed instructions count) used by 'script', and the total after the -k api call\n"
 		"  -c       compile source to bytecode\n"
 		"  -h       show help info\n"
 		"  --       stop handling options\n"
@@ -280,11 +281,47 @@ static int pushargs(lua_State *L) {
 
 //static bool use_type_check_compile = true;
 
+// load the bytecode of a contract package (.gpc): sha1 digest(20 bytes), big endian bytecode length, bytecode, abi...
+static int load_gpc_file(lua_State *L, const char *fname) {
+	std::ifstream in(fname, std::ios::in | std::ios::binary);
+	char digest[20];
+	unsigned char len_bytes[4];
+	if (!in.read(digest, sizeof(digest)) || !in.read((char*)len_bytes, sizeof(len_bytes))) {
+		lua_pushfstring(L, "invalid contract file %s", fname);
+		return LUA_ERRFILE;
+	}
+	int32_t len = int32_t((uint32_t(len_bytes[0]) << 24) | (uint32_t(len_bytes[1]) << 16) | (uint32_t(len_bytes[2]) << 8) | uint32_t(len_bytes[3]));
+	if (len <= 0) {
+		lua_pushfstring(L, "invalid contract file %s", fname);
+		return LUA_ERRFILE;
+	}
+	std::string code(len, '\0');
+	if (!in.read(&code[0], len)) {
+		lua_pushfstring(L, "invalid contract file %s", fname);
+		return LUA_ERRFILE;
+	}
+	return luaL_loadbufferx(L, code.data(), code.size(), fname, "b");
+}
+
+static bool is_gpc_file(const char *fname) {
+	size_t len = fname ? strlen(fname) : 0;
+	return len > 4 && strcmp(fname + len - 4, ".gpc") == 0;
+}
+
 static int handle_script(lua_State *L, char **argv, bool is_contract = false) {
 	int status;
 	const char *fname = argv[0];
 	if (strcmp(fname, "-") == 0 && strcmp(argv[-1], "--") != 0)
 		fname = NULL;  /* stdin */
+	if (is_gpc_file(fname))
+	{
+		status = load_gpc_file(L, fname);
+		if (status == LUA_OK) {
+			int n = pushargs(L);  /* push arguments to script */
+			status = docall(L, n, LUA_MULTRET);
+		}
+		return report(L, status);
+	}
 	bool is_bytecode_file = luaL_is_bytecode_file(L, fname);
 	if (is_bytecode_file)
 	{
@@ -315,6 +352,7 @@ static int handle_script(lua_State *L, char **argv, bool is_contract = false) {
 #define has_call    128 /* -k */
 #define has_debug   256 /* -x */
 #define has_help    512 /* -h */
+#define has_gas     1024 /* -g */
 
 /*
 ** Traverses all arguments from 'argv', returning a mask with those
@@ -372,6 +410,11 @@ static int collectargs(char **argv, int *first) {
 				return has_error;  /* invalid option */
 			args |= has_help;
 			break;
+		case 'g':
+			if (argv[i][2] != '\0')  /* extra characters after 1st? */
+				return has_error;  /* invalid option */
+			args |= has_gas;
+			break;
 		case 'e':
 			args |= has_e;  /* FALLTHROUGH */
 		case 'l':  /* both options need an argument */
@@ -458,19 +501,25 @@ static int pmain(lua_State *L) {
 	//	return 0;  /* something failed */
 	if (script < argc) {
 		auto run_script_result = handle_script(L, argv + script); /* execute main script (if there is one) */
+		if (args & has_gas)
+			printf("gas: %d\n", uvm::lua::lib::get_lua_state_instructions_executed_count(L));
 		if (run_script_result != LUA_OK) {
-			return LUA_ERRERR;
+			return 0;  /* something failed */
 		}
 		if (args & has_call) {
 			// call contract api
 			std::string result_string;
 			cbor::CborArrayValue arr;
 			arr.push_back(cbor::CborObject::from_string(contract_api_arg));
-			if (!uvm::lua::lib::call_last_contract_api(L, std::string(argv[script]), contract_api, arr,caller_address,caller_pubkey, &result_string)) {
-				return LUA_ERRERR;
+			auto call_ok = uvm::lua::lib::call_last_contract_api(L, std::string(argv[script]), contract_api, arr,caller_address,caller_pubkey, &result_string);
+			if (args & has_gas)
+				printf("gas after call: %d\n", uvm::lua::lib::get_lua_state_instructions_executed_count(L));
+			if (!call_ok) {
+				return 0;  /* something failed */
 			}
 			printf("result: %s\n", result_string.c_str());
-			return LUA_OK;
+			lua_pushboolean(L, 1);  /* signal no errors */
+			return 1;
 		}
 		if (args & has_test) {
 			// run ***.test, whose content is a function accept a contract table
@@ -486,19 +535,20 @@ static int pmain(lua_State *L) {
 			paths[0] = path;
 			auto load_test_script_result = handle_script(L, paths);
 			if (load_test_script_result != LUA_OK) {
-				return 1;
+				return 0;  /* something failed */
 			}
 			if (!lua_isfunction(L, -1)) {
 				perror("test script must contains a function accept contract table");
-				return 1;
+				return 0;
 			}
 			lua_getglobal(L, "_test_contract");
 			auto result = lua_pcall(L, 1, 1, 0);
 			if (result != LUA_OK) {
-				return 1;
+				return 0;
 			}
 			printf("test done\n");
-			return 0;
+			lua_pushboolean(L, 1);  /* signal no errors */
+			return 1;
 		}
 		if (args & has_debug) {
 			// TODO
@@ -38,7 +38,16 @@ namespace uvm {
 		namespace api {
 			// demo，API
 
-			static int has_error = 0;
+			// exception mark is kept per lua_State, so vms on other threads are not affected
+			static bool has_error(lua_State *L)
+			{
+				return L->state_context->has_exception;
+			}
+
+			static void set_has_error(lua_State *L, bool value)
+			{
+				L->state_context->has_exception = value;
+			}
 
 			/*static std::string get_file_name_str_from_contract_module_name(std::string name)
 			{
@@ -52,7 +61,7 @@ namespace uvm {
 			*/
 			bool DemoUvmChainApi::has_exception(lua_State *L)
 			{
-				return has_error ? true : false;
+				return has_error(L);
 			}
 
 			/**
@@ -60,7 +69,7 @@ namespace uvm {
 			*/
 			void DemoUvmChainApi::clear_exceptions(lua_State *L)
 			{
-				has_error = 0;
+				set_has_error(L, false);
 			}
 
 			/**
@@ -72,7 +81,7 @@ namespace uvm {
 			*/
 			void DemoUvmChainApi::throw_exception(lua_State *L, int code, const char *error_format, ...)
 			{
-				has_error = 1;
+				set_has_error(L, true);
 				char *msg = (char*)malloc(sizeof(char)*(LUA_VM_EXCEPTION_STRNG_MAX_LENGTH +1));
 				if(!msg)
 				{
@@ -323,14 +332,15 @@ namespace uvm {
             }
 
             // storage,mapkey contract_id + "$" + storage_name
-            // TODO: lua_closepost_callback，
-            static std::map<lua_State *, std::shared_ptr<std::map<std::string, UvmStorageValue>>> _demo_chain_storage_buffer;
 			static fc::mutable_variant_object storage_root;
 			static bool is_init_storage_file = false;
+			// storage_root is shared by the vms of all threads
+			static std::mutex storage_root_mutex;
 
 			UvmStorageValue DemoUvmChainApi::get_storage_value_from_uvm(lua_State *L, const char *contract_name,
 				const std::string& name, const std::string& fast_map_key, bool is_fast_map)
 			{
+				std::lock_guard<std::mutex> lock(storage_root_mutex);
 				if (!is_init_storage_file) {
 					if (fc::exists(fc::path("uvm_storage_demo.json"))) {
 						storage_root = fc::json::from_file(fc::path("uvm_storage_demo.json"), fc::json::legacy_parser).as<fc::mutable_variant_object>();
@@ -362,6 +372,7 @@ namespace uvm {
 			UvmStorageValue DemoUvmChainApi::get_storage_value_from_uvm_by_address(lua_State *L, const char *contract_address,
 				const std::string& name, const std::string& fast_map_key, bool is_fast_map)
 			{
+				std::lock_guard<std::mutex> lock(storage_root_mutex);
 				if (!is_init_storage_file) {
 					if (fc::exists(fc::path("uvm_storage_demo.json"))) {
 						storage_root = fc::json::from_file(fc::path("uvm_storage_demo.json"), fc::json::legacy_parser).as<fc::mutable_variant_object>();
@@ -391,6 +402,7 @@ namespace uvm {
 
 			bool DemoUvmChainApi::commit_storage_changes_to_uvm(lua_State *L, AllContractsChangesMap &changes)
 			{
+				std::lock_guard<std::mutex> lock(storage_root_mutex);
 				if (changes.size() == 0) {
 					return true;
 				}
@@ -8,7 +8,10 @@ namespace vmgc {
 	// all gc objects managed should extend GcObject
 	struct GcObject {
 		const static vmgc::gc_type type = 0;
+		// true if the object owns no resources outside its gc buffer, so reset can skip its destructor
+		const static bool trivial_members = false;
 		gc_type tt = 0; // gc object type
+		gc_type marked = 0; // mark color of the last collection cycle which reached this object
 
 		GcObject() {}
 		virtual ~GcObject() {}
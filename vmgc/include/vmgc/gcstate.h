@@ -12,6 +12,7 @@
 #include "vmgc/gcobject.h"
 #include <map>
 #include <unordered_map>
+#include <functional>
 
 
 
@@ -20,14 +21,24 @@ namespace vmgc {
 
 // 100MB
 #define DEFAULT_MAX_GC_HEAP_SIZE 100*1024*1024
-#define DEFAULT_MAX_GC_STRPOOL_SIZE 8*1024*1024
-
-#define	DEFAULT_GC_STR_HASHLIMIT 5
-#define DEFAULT_MAX_GC_SHORT_STRING_SIZE 32   //2^DEFAULT_GC_HASHLIMIT
 
 #define DEFAULT_MAX_SMALL_BUFFER_SIZE 128  //8ı
 #define DEFAULT_SMALL_BUFFER_VECTOR_SIZE (DEFAULT_MAX_SMALL_BUFFER_SIZE/8)     
 
+// segregated size classes: 16 small classes by 8 bytes, then 4 classes per power of two up to 64KB
+#define GC_MAX_SIZE_CLASS_SIZE (64*1024)
+#define GC_SIZE_CLASSES_COUNT (DEFAULT_SMALL_BUFFER_VECTOR_SIZE + 9*4)
+#define GC_LARGE_SIZE_CLASS 255  // buffers bigger than GC_MAX_SIZE_CLASS_SIZE own a whole block
+
+// tracing collection schedule, all measured in used bytes so every node collects at the same points
+#define DEFAULT_GC_MIN_THRESHOLD 1*1024*1024 // never collect while the heap is smaller than this
+#define DEFAULT_GC_PAUSE 200 // next cycle starts when the heap grows to pause% of the live size
+#define DEFAULT_GC_STEPMUL 200 // sweep speed, in % of GC_SWEEP_STEP_COUNT
+#define GC_SWEEP_STEP_COUNT 100 // dead objects freed by one sweep step at stepmul 100
+#define GC_STEP_SIZE 16*1024 // bytes allowed to be allocated between two sweep steps
+
+#define DEFAULT_GC_STATE_POOL_SIZE 4 // idle gc states kept by a GcStatePool
+
 	struct GcObject;
 
 	struct Buffer {
@@ -66,26 +77,24 @@ namespace vmgc {
 
 	//typedef Buffer Block;
 
+	// side-table record of a malloced buffer, keyed by its address
 	struct GcBuffer {
 		intptr_t pos;
 		ptrdiff_t size;
+		intptr_t blockpos; // start of the block owning this buffer
+		uint8_t size_class; // index of size class, or GC_LARGE_SIZE_CLASS
 		bool isGcObj;
+		bool trivialMembers; // gc object whose destructor can be skipped by reset
 		//bool isFree;
+		uint64_t serial; // allocation order, the sweep frees dead objects in this order
 	};
 
-	class Hasher {
-	public:
-		size_t operator()(const Block& b) const {
-			//calculate hash here.
-			return std::hash<long long>()(b.blockpos);
-		}
-	};
-	class Equal
-	{
-	public:
-		bool operator()(const Block& b1, const Block& b2) const {
-			return (b1.blockpos == b2.blockpos);
-		}
+	struct GcStats {
+		uint64_t cycles = 0; // finished mark phases
+		uint64_t steps = 0; // collector steps, including the mark steps
+		uint64_t swept_objects = 0;
+		uint64_t swept_bytes = 0;
+		ptrdiff_t live_size = 0; // used size at the end of the last finished sweep
 	};
 
 
@@ -95,35 +104,95 @@ namespace vmgc {
 		ptrdiff_t _used_size;
 		ptrdiff_t _max_gc_size;
 
-		std::shared_ptr<std::unordered_map<Block, std::vector<GcBuffer>, Hasher, Equal>> _malloced_blocks_buffers;
-		std::shared_ptr<std::vector<std::pair<Block, Buffer>>> _empty_small_buffers[DEFAULT_SMALL_BUFFER_VECTOR_SIZE]; //empty_size => [ [start_ptr, size], ... ]
-		std::shared_ptr<std::vector<std::pair<Block, Buffer>>> _empty_big_buffers; //
-		std::shared_ptr<std::vector<std::pair<intptr_t, intptr_t> > > _malloced_str_blocks; // [ [start_ptr, size], ... ]
-		std::shared_ptr<std::unordered_map<unsigned int,std::pair<intptr_t, ptrdiff_t>>> _gc_strpool;
-		std::pair<intptr_t, ptrdiff_t>  _empty_str_buffer; // [start_ptr, size]
-		void insert_empty_buffer(const Buffer &buf, const Block &block);
-		void GcState::insert_malloced_blocks_buffers(Block &block, GcBuffer& gcbuf, bool isNewBlock);
+		std::shared_ptr<std::map<intptr_t, Block>> _malloced_blocks; // sorted block index, blockpos => block
+		std::shared_ptr<std::unordered_map<intptr_t, GcBuffer>> _malloced_buffers; // buffer pos => buffer, O(1) lookup when free
+		std::shared_ptr<std::vector<intptr_t>> _free_buffers[GC_SIZE_CLASSES_COUNT]; // size class => [ buffer_pos, ... ]
+		intptr_t _bump_blockpos; // block used for bump allocation of new buffers
+		intptr_t _bump_pos;
+		intptr_t _bump_end;
+		uint64_t _next_serial;
+		gc_type _current_mark;
+		std::vector<GcObject*> _sweep_list; // dead objects found by the last mark, in allocation order
+		size_t _sweep_pos;
+		ptrdiff_t _gc_threshold;
+		int _gc_pause;
+		int _gc_stepmul;
+		bool _gc_running;
+		GcStats _gc_stats;
+		std::vector<intptr_t> _retained_blocks; // blocks kept by the last reset, reused before malloc new ones
+		size_t _retained_blocks_pos;
+		bool _pooled;
+		const Block* find_block(intptr_t pos) const;
+		intptr_t malloc_block(size_t block_size);
+		intptr_t next_block();
+		void retain_bump_blocks();
+		void retire_bump_block();
+		intptr_t split_bigger_free_buffer(int size_class);
 
 	public:
 		// @throws vmgc::GcException
 		GcState(ptrdiff_t max_gc_heap_size = DEFAULT_MAX_GC_HEAP_SIZE);
 		virtual ~GcState();
 
-		void* gc_malloc(size_t size, bool isGcObj=false);
+		void* gc_malloc(size_t size, bool isGcObj=false, bool trivialMembers=false);
 		void gc_free(void* p);
 		void gc_free_array(void* p, size_t count, size_t element_size);
 		void* gc_realloc(void *p, size_t oldsize, size_t newsize);
 		void* gc_malloc_vector(size_t count, size_t element_size);
 		void* gc_grow_vector(void *p, size_t nelements, size_t* size, size_t element_size, size_t limit);
 		ptrdiff_t usedsize() const;
+		// size of the malloced buffer starting at p, 0 if p is not a buffer of this gc state
+		ptrdiff_t buffer_size(void* p) const;
+
+		static int size_class_index(size_t size);
+		static size_t size_class_size(int size_class);
 		void gc_free_all();
-		void* gc_intern_strpool(size_t sz, size_t strsize, const char* str, bool* isNewStr);
+		// free all objects but keep the heap blocks for the next user of this state.
+		// only destructors of objects owning outside resources are called, raw buffers are dropped at once
+		void reset();
+		inline ptrdiff_t max_gc_size() const { return _max_gc_size; }
+		// also frees retained blocks over the new limit
+		void set_max_gc_size(ptrdiff_t max_gc_size);
+		// heap blocks size, including blocks retained by reset
+		inline ptrdiff_t malloced_blocks_size() const { return _total_malloced_blocks_size; }
+		inline bool pooled() const { return _pooled; }
+		inline void set_pooled(bool pooled) { _pooled = pooled; }
+
+		// tracing collection: the owner marks every reachable object between gc_begin_mark and gc_end_mark,
+		// then frees the unreached objects by gc_sweep_step
+		void gc_begin_mark();
+		// returns false if the object is marked already in this cycle
+		inline bool gc_mark(GcObject* obj) {
+			if (obj->marked == _current_mark)
+				return false;
+			obj->marked = _current_mark;
+			return true;
+		}
+		inline bool gc_is_marked(const GcObject* obj) const { return obj->marked == _current_mark; }
+		// collect the unmarked objects into the sweep list, returns their count
+		size_t gc_end_mark();
+		inline bool gc_is_sweeping() const { return _sweep_pos < _sweep_list.size(); }
+		// free at most max_count dead objects, before_free is called on each one before its destructor.
+		// an object marked again after gc_end_mark (e.g. a string found again by the owner's intern table) is kept
+		size_t gc_sweep_step(size_t max_count, const std::function<void(GcObject*)>& before_free);
+
+		// bytes allocated over the threshold of next collector step
+		inline ptrdiff_t gc_debt() const { return _used_size - _gc_threshold; }
+		inline ptrdiff_t gc_threshold() const { return _gc_threshold; }
+		inline void gc_set_threshold(ptrdiff_t threshold) { _gc_threshold = threshold; }
+		inline int gc_pause() const { return _gc_pause; }
+		inline void gc_set_pause(int pause) { _gc_pause = pause; }
+		inline int gc_stepmul() const { return _gc_stepmul; }
+		inline void gc_set_stepmul(int stepmul) { _gc_stepmul = stepmul; }
+		inline bool gc_running() const { return _gc_running; }
+		inline void gc_set_running(bool running) { _gc_running = running; }
+		inline GcStats& gc_stats() { return _gc_stats; }
 
 		template <typename T>
 		T* gc_new_object()
 		{
 			size_t sz = sizeof(T);
-			auto p = gc_malloc(sz,true);
+			auto p = gc_malloc(sz, true, T::trivial_members);
 			if (!p) {
 				return nullptr;
 			}
@@ -134,6 +203,21 @@ namespace vmgc {
 			return static_cast<T*>(obj_p);
 		}
 
+		// object followed by extra_size bytes in the same buffer, e.g. the bytes of a string
+		template <typename T>
+		T* gc_new_object_with_extra(size_t extra_size)
+		{
+			size_t sz = sizeof(T) + extra_size;
+			auto p = gc_malloc(sz, true, T::trivial_members);
+			if (!p) {
+				return nullptr;
+			}
+			GcObject* obj_p = static_cast<GcObject*>(p);
+			new (obj_p)T();
+			obj_p->tt = T::type;
+			return static_cast<T*>(obj_p);
+		}
+
 		template <typename T>
 		T* gc_new_object_vector(size_t count)
 		{
@@ -142,7 +226,7 @@ namespace vmgc {
 			size_t sz = sizeof(T);
 			std::vector<T*> malloced_items;
 			for (size_t i = 0; i < count; i++) {
-				auto p = gc_malloc(sz,true);
+				auto p = gc_malloc(sz, true, T::trivial_members);
 				if (!p) {
 					for (const auto& item : malloced_items) {
 						gc_free(item);
@@ -193,37 +277,28 @@ namespace vmgc {
 			return new_p;
 		}
 
-		void fill_gc_string(GcObject* p, const char* str, size_t size);
+    };
 
-		// short string into str pool, reused
-		template <typename T>
-		T* gc_intern_string(const char* str, size_t size)
-		{
-			T* ts = nullptr;
-			bool isNewStr = true;
-			if (size < DEFAULT_MAX_GC_SHORT_STRING_SIZE) { 
-				size_t sz = sizeof(T);
-				auto p = gc_intern_strpool(sz, size, str, &isNewStr);
-				if (!p) {
-					ts = gc_new_object<T>();
-					fill_gc_string(ts, str, size);
-					return ts;
-				}
-				GcObject* obj_p = static_cast<GcObject*>(p);
-				if (isNewStr) {
-					new (obj_p)T();
-					fill_gc_string(obj_p, str, size);
-					obj_p->tt = T::type;
-				}
-				ts = static_cast<T*>(obj_p);
-			}
-			else {
-				ts = gc_new_object<T>();
-				fill_gc_string(ts, str, size);
-			}
-			return ts;
-		}
+	// idle gc states kept with their heap blocks, so short lived lua states don't malloc/free blocks every time
+	class GcStatePool {
+	private:
+		std::vector<GcState*> _idle_states;
+		size_t _max_idle_count;
+		bool _enabled;
+	public:
+		GcStatePool(size_t max_idle_count = DEFAULT_GC_STATE_POOL_SIZE);
+		~GcStatePool();
 
+		inline bool enabled() const { return _enabled; }
+		inline void set_enabled(bool enabled) { _enabled = enabled; }
+		inline size_t idle_count() const { return _idle_states.size(); }
 
-    };
+		// @throws vmgc::GcException
+		GcState* acquire(ptrdiff_t max_gc_heap_size = DEFAULT_MAX_GC_HEAP_SIZE);
+		// reset the state and keep it for next acquire, or delete it when the pool is full
+		void release(GcState* state);
+
+		// pool of the current thread
+		static GcStatePool& thread_pool();
+	};
 }
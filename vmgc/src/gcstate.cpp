@@ -1,12 +1,9 @@
 #include "vmgc/gcstate.h"
 #include "vmgc/gcobject.h"
 #include <algorithm>
-#include "uvm/lstring.h"
 
 namespace vmgc {
 #define DEFAULT_GC_BLOCK_SIZE 256*1024  
-
-#define MAX_GC_STR_POOL_ITEMS_COUNT 16*1024
 //#define MAX_GC_BLOCKS_SIZE 500*1024*1024 
 
 	GcState::GcState(ptrdiff_t max_gc_size) {
@@ -14,68 +11,125 @@ namespace vmgc {
 		_used_size = 0;
 		_max_gc_size = max_gc_size;
 
-		for (int i = 0; i < DEFAULT_SMALL_BUFFER_VECTOR_SIZE; i++) {
-			_empty_small_buffers[i] = std::make_shared<std::vector<std::pair<Block, Buffer>>>();
+		for (int i = 0; i < GC_SIZE_CLASSES_COUNT; i++) {
+			_free_buffers[i] = std::make_shared<std::vector<intptr_t>>();
+		}
+		_bump_blockpos = 0;
+		_bump_pos = 0;
+		_bump_end = 0;
+
+		this->_malloced_blocks = std::make_shared<std::map<intptr_t, Block>>();
+		this->_malloced_buffers = std::make_shared<std::unordered_map<intptr_t, GcBuffer>>();
+
+		_next_serial = 0;
+		_current_mark = 1;
+		_sweep_pos = 0;
+		_gc_threshold = DEFAULT_GC_MIN_THRESHOLD;
+		_gc_pause = DEFAULT_GC_PAUSE;
+		_gc_stepmul = DEFAULT_GC_STEPMUL;
+		_gc_running = true;
+
+		_retained_blocks_pos = 0;
+		_pooled = false;
+	}
+
+	void GcState::gc_free_all()
+	{
+		for (const auto& item : (*_malloced_buffers)) {
+			if (item.second.isGcObj) {
+				auto gc_obj = (GcObject*)item.second.pos;
+				gc_obj->~GcObject();
+			}
 		}
-		this->_empty_big_buffers = std::make_shared<std::vector<std::pair<Block, Buffer>>>();
+		_malloced_buffers->clear();
+		_sweep_list.clear();
+		_sweep_pos = 0;
 
-		//////////////////
-		this->_malloced_str_blocks = std::make_shared<std::vector<std::pair<intptr_t, intptr_t>>>();
-		this->_gc_strpool = std::make_shared<std::unordered_map<unsigned int, std::pair<intptr_t, ptrdiff_t>>>();	
-		this->_malloced_blocks_buffers = std::make_shared<std::unordered_map<Block, std::vector<GcBuffer>, Hasher, Equal>>();
+		for (int i = 0; i < GC_SIZE_CLASSES_COUNT; i++) {
+			_free_buffers[i]->clear();
+		}
+		_bump_blockpos = 0;
+		_bump_pos = 0;
+		_bump_end = 0;
 
-		_empty_str_buffer.first = 0;
-		_empty_str_buffer.second = 0;
+		_used_size = 0;
+		retain_bump_blocks();
 	}
 
-	void GcState::gc_free_all()
+	// keep the bump allocation blocks for reuse and free the blocks of large buffers.
+	// kept blocks stay counted in _total_malloced_blocks_size
+	void GcState::retain_bump_blocks()
 	{
-		for (auto& item : (*_malloced_blocks_buffers)) {
-		//for (auto it = _malloced_blocks_buffers->begin(); it != _malloced_blocks_buffers->end(); it++) {
-			auto &buffers = item.second;
-			for (auto bufit = buffers.begin(); bufit != buffers.end(); bufit++) {
-				if (bufit->isGcObj) {
-					auto gc_obj = (GcObject*)bufit->pos;
-					gc_obj->~GcObject();
-				}
+		_retained_blocks.clear();
+		for (auto it = _malloced_blocks->begin(); it != _malloced_blocks->end();) {
+			if (it->second.blocksize == DEFAULT_GC_BLOCK_SIZE) {
+				_retained_blocks.push_back(it->first);
+				++it;
+			}
+			else {
+				_total_malloced_blocks_size -= it->second.blocksize;
+				free((void*)(it->first));
+				it = _malloced_blocks->erase(it);
 			}
-			buffers.clear();
 		}
+		_retained_blocks_pos = 0;
+	}
 
-		for (int i = 0; i < DEFAULT_SMALL_BUFFER_VECTOR_SIZE; i++) {
-			_empty_small_buffers[i]->clear();
+	void GcState::set_max_gc_size(ptrdiff_t max_gc_size)
+	{
+		_max_gc_size = max_gc_size;
+		// retained blocks not handed out yet are dropped until the kept heap fits the new limit
+		while (_total_malloced_blocks_size > _max_gc_size && _retained_blocks_pos < _retained_blocks.size()) {
+			auto blockpos = _retained_blocks.back();
+			_retained_blocks.pop_back();
+			auto block_it = _malloced_blocks->find(blockpos);
+			_total_malloced_blocks_size -= block_it->second.blocksize;
+			_malloced_blocks->erase(block_it);
+			free((void*)blockpos);
 		}
+	}
 
-		_empty_big_buffers->clear();
+	void GcState::reset()
+	{
+		for (const auto& item : (*_malloced_buffers)) {
+			const auto& gcbuf = item.second;
+			if (gcbuf.isGcObj && !gcbuf.trivialMembers) {
+				auto gc_obj = (GcObject*)gcbuf.pos;
+				gc_obj->~GcObject();
+			}
+		}
+		_malloced_buffers->clear();
+		_sweep_list.clear();
+		_sweep_pos = 0;
 
-		////////////////////////////////////
-		for (const auto& item : *_gc_strpool) {
-			auto gc_obj = (GcObject*)item.second.first;
-			gc_obj->~GcObject();
+		for (int i = 0; i < GC_SIZE_CLASSES_COUNT; i++) {
+			_free_buffers[i]->clear();
 		}
-		_gc_strpool->clear();
+		_bump_blockpos = 0;
+		_bump_pos = 0;
+		_bump_end = 0;
 
-		_empty_str_buffer.first = 0;
-		_empty_str_buffer.second = 0;
+		// blocks of DEFAULT_GC_BLOCK_SIZE are reused in address order
+		retain_bump_blocks();
 
 		_used_size = 0;
-		_total_malloced_blocks_size = 0;
+		_next_serial = 0;
+		_current_mark = 1;
+		_gc_threshold = DEFAULT_GC_MIN_THRESHOLD;
+		_gc_pause = DEFAULT_GC_PAUSE;
+		_gc_stepmul = DEFAULT_GC_STEPMUL;
+		_gc_running = true;
+		_gc_stats = GcStats();
 	}
 
 
 	GcState::~GcState() {
 		gc_free_all();
 
-		for (auto& item : (*_malloced_blocks_buffers)) {
-		//for (auto it = _malloced_blocks_buffers->begin(); it != _malloced_blocks_buffers->end(); it++) {
-			free((void*)(item.first.blockpos));
-		}
-		_malloced_blocks_buffers->clear();
-
-		for (const auto& item : (*_malloced_str_blocks)) {
+		for (const auto& item : (*_malloced_blocks)) {
 			free((void*)(item.first));
 		}
-		_malloced_str_blocks->clear();
+		_malloced_blocks->clear();
 	}
 
 	static size_t align8(size_t s) {
@@ -84,34 +138,103 @@ namespace vmgc {
 		return ((s >> 3) + 1) << 3;
 	}
 
+	// size classes: 8, 16, ..., 128, then 4 classes per power of two up to GC_MAX_SIZE_CLASS_SIZE
+	// (160, 192, 224, 256, 320, 384, 448, 512, ...), so the waste of a buffer is at most 25%
+	int GcState::size_class_index(size_t size) {
+		if (size <= DEFAULT_MAX_SMALL_BUFFER_SIZE)
+			return int(size / 8) - 1;
+		int k = 0;
+		for (size_t s = size - 1; s > 1; s >>= 1)
+			k++;
+		size_t step = size_t(1) << (k - 2);
+		return DEFAULT_SMALL_BUFFER_VECTOR_SIZE + (k - 7) * 4 + int((size - 1 - (size_t(1) << k)) / step);
+	}
 
-	void GcState::insert_empty_buffer(const Buffer &buf, const Block &block) {
-		auto size = buf.size;
-		std::pair<Block, Buffer>eb(block, buf);
-		if (size > 0) {
-			if ((size > DEFAULT_MAX_SMALL_BUFFER_SIZE) || (size % 8) != 0) {
-				_empty_big_buffers->push_back(eb);
-			}
-			else {
-				_empty_small_buffers[(size / 8) - 1]->push_back(eb);
-			}
-		}
+	size_t GcState::size_class_size(int index) {
+		if (index < DEFAULT_SMALL_BUFFER_VECTOR_SIZE)
+			return size_t(index + 1) * 8;
+		int k = (index - DEFAULT_SMALL_BUFFER_VECTOR_SIZE) / 4 + 7;
+		int j = (index - DEFAULT_SMALL_BUFFER_VECTOR_SIZE) % 4;
+		return (size_t(1) << k) + size_t(j + 1) * (size_t(1) << (k - 2));
 	}
 
-	void GcState::insert_malloced_blocks_buffers(Block &block, GcBuffer& gcbuf,bool isNewBlock) {
-		if (isNewBlock) {
-			std::vector<GcBuffer> bufs;
-			bufs.push_back(gcbuf);
+	// find the block containing pos by the sorted block index, O(log(blocks count))
+	const Block* GcState::find_block(intptr_t pos) const {
+		auto it = _malloced_blocks->upper_bound(pos);
+		if (it == _malloced_blocks->begin())
+			return nullptr;
+		--it;
+		if (pos >= it->second.blockpos + it->second.blocksize)
+			return nullptr;
+		return &it->second;
+	}
 
-			(*_malloced_blocks_buffers)[block] = bufs;
+	intptr_t GcState::malloc_block(size_t block_size) {
+		if (ptrdiff_t(block_size) + _total_malloced_blocks_size > _max_gc_size) {
+			return 0;
 		}
-		else {
-			(*_malloced_blocks_buffers)[block].push_back(gcbuf);
+		auto p = malloc(block_size);
+		if (!p) {
+			return 0;
+		}
+		_total_malloced_blocks_size += block_size;
+		Block block((intptr_t)p, (ptrdiff_t)block_size);
+		(*_malloced_blocks)[block.blockpos] = block;
+		return block.blockpos;
+	}
+
+	// new block for bump allocation, a block retained by reset if any left
+	intptr_t GcState::next_block() {
+		if (_retained_blocks_pos < _retained_blocks.size()) {
+			return _retained_blocks[_retained_blocks_pos++];
 		}
+		return malloc_block(DEFAULT_GC_BLOCK_SIZE);
 	}
 
+	// put the unused tail of the bump block into the free lists, largest classes first
+	void GcState::retire_bump_block() {
+		while (_bump_end - _bump_pos >= 8) {
+			size_t rest = size_t(_bump_end - _bump_pos);
+			int index = size_class_index(rest);
+			if (index >= GC_SIZE_CLASSES_COUNT) {
+				index = GC_SIZE_CLASSES_COUNT - 1;
+			}
+			else if (size_class_size(index) > rest) {
+				index--;
+			}
+			_free_buffers[index]->push_back(_bump_pos);
+			_bump_pos += size_class_size(index);
+		}
+		_bump_blockpos = 0;
+		_bump_pos = 0;
+		_bump_end = 0;
+	}
+
+	// when the heap limit is reached, split a free buffer of a bigger class instead of malloc new block
+	intptr_t GcState::split_bigger_free_buffer(int index) {
+		for (int i = index + 1; i < GC_SIZE_CLASSES_COUNT; i++) {
+			auto& bigger = *_free_buffers[i];
+			if (bigger.empty())
+				continue;
+			auto pos = bigger.back();
+			bigger.pop_back();
+			auto class_size = size_class_size(index);
+			auto rest = size_class_size(i) - class_size;
+			auto rest_pos = pos + intptr_t(class_size);
+			while (rest >= 8) {
+				int rest_index = size_class_index(rest);
+				if (size_class_size(rest_index) > rest)
+					rest_index--;
+				_free_buffers[rest_index]->push_back(rest_pos);
+				rest_pos += size_class_size(rest_index);
+				rest -= size_class_size(rest_index);
+			}
+			return pos;
+		}
+		return 0;
+	}
 
-	void* GcState::gc_malloc(size_t size, bool isGcObj) {
+	void* GcState::gc_malloc(size_t size, bool isGcObj, bool trivialMembers) {
 		if (size <= 0){
 			throw GcException(std::string("not enough memery in gc , used gc size: ") + std::to_string(_used_size));
 			return nullptr;
@@ -120,85 +243,64 @@ namespace vmgc {
 
 		GcBuffer b;
 		b.isGcObj = isGcObj;
+		b.trivialMembers = trivialMembers;
 		b.pos = 0;
 		b.size = size;
-		_used_size += size;
-
-		//find _empty_small_buffers 
-		if (size <= DEFAULT_MAX_SMALL_BUFFER_SIZE) {
-			auto pbuffers = _empty_small_buffers[size/8 - 1];
-			if (!pbuffers->empty()) {  //finded
-				auto& buf = pbuffers->back();
-				b.pos = buf.second.pos;
-				//(*_malloced_gcbuffers)[buf.first] = b;
-				insert_malloced_blocks_buffers(buf.first,b,false);
-				pbuffers->pop_back();
-				return (void*)b.pos;
+		b.blockpos = 0;
+		b.serial = _next_serial++;
+
+		if (size > GC_MAX_SIZE_CLASS_SIZE) {
+			// large buffer owns a whole block, which is returned to system when freed
+			auto blockpos = malloc_block(size);
+			if (!blockpos) {
+				throw GcException(std::string("not enough memery in gc , used gc size: ") + std::to_string(_used_size));
+				return nullptr;
 			}
+			b.pos = blockpos;
+			b.size_class = GC_LARGE_SIZE_CLASS;
+			b.blockpos = blockpos;
+			(*_malloced_buffers)[b.pos] = b;
+			_used_size += size;
+			return (void*)b.pos;
 		}
 
-		//find _empty_big_buffers 
-		for (auto it = _empty_big_buffers->begin(); it != _empty_big_buffers->end(); it++) {
-			auto bufsz = it->second.size;
-			if (ptrdiff_t(size) <= bufsz) {
-				auto bufpos = it->second.pos;
-				b.pos = bufpos;
-				auto block = it->first;
-				if (size < size_t(bufsz)) {
-					auto aferSize = bufsz - size;
-					auto afterPos = bufpos + size;
-					if ((aferSize <= DEFAULT_MAX_SMALL_BUFFER_SIZE) && (size % 8) == 0) {
-						Buffer buf(afterPos, aferSize);
-						std::pair<Block, Buffer>eb(block, buf);
-						_empty_small_buffers[(aferSize / 8) - 1]->push_back(eb);
-						_empty_big_buffers->erase(it);
-					}
-					else {
-						it->second.pos = afterPos;
-						it->second.size = aferSize;
-					}
-				}
-				else {
-					_empty_big_buffers->erase(it);
-				}
-				
-				insert_malloced_blocks_buffers(block, b, false);
-				return (void*)bufpos;
-			}
-
-		}
+		auto index = size_class_index(size);
+		auto class_size = size_class_size(index);
+		b.size_class = static_cast<uint8_t>(index);
 
-			
-		//malloc new block
-		//check max size
-		size_t mallocSize = DEFAULT_GC_BLOCK_SIZE;
-		if (size > DEFAULT_GC_BLOCK_SIZE) {
-			mallocSize = size;
+		auto& free_buffers = *_free_buffers[index];
+		if (!free_buffers.empty()) {
+			b.pos = free_buffers.back();
+			free_buffers.pop_back();
+			b.blockpos = find_block(b.pos)->blockpos;
 		}
-		if (ptrdiff_t(mallocSize) + _total_malloced_blocks_size > _max_gc_size) {
-			_used_size -= size;
-			throw GcException(std::string("not enough memery in gc , used gc size: ") + std::to_string(_used_size) );
-			return nullptr;
-		}
-		auto p = malloc(mallocSize);
-		if (!p) {
-			_used_size -= size;
-			throw GcException(std::string("not enough memery in gc , used gc size: ") + std::to_string(_used_size));
-			return nullptr;
+		else if (_bump_end - _bump_pos >= ptrdiff_t(class_size)) {
+			b.pos = _bump_pos;
+			b.blockpos = _bump_blockpos;
+			_bump_pos += class_size;
 		}
-		_total_malloced_blocks_size += mallocSize;
-
-		Block block((intptr_t)p, (ptrdiff_t)mallocSize);
-		b.pos = (intptr_t)p;
-
-		insert_malloced_blocks_buffers(block, b,true);
-
-		if (size < mallocSize) {
-			//add empty buff
-
-			Buffer eb((intptr_t)p + size, mallocSize - size);
-			insert_empty_buffer(eb, block);
+		else {
+			auto blockpos = next_block();
+			if (blockpos) {
+				retire_bump_block();
+				_bump_blockpos = blockpos;
+				_bump_pos = blockpos;
+				_bump_end = blockpos + DEFAULT_GC_BLOCK_SIZE;
+				b.pos = _bump_pos;
+				b.blockpos = _bump_blockpos;
+				_bump_pos += class_size;
+			}
+			else {
+				b.pos = split_bigger_free_buffer(index);
+				if (!b.pos) {
+					throw GcException(std::string("not enough memery in gc , used gc size: ") + std::to_string(_used_size));
+					return nullptr;
+				}
+				b.blockpos = find_block(b.pos)->blockpos;
+			}
 		}
+		(*_malloced_buffers)[b.pos] = b;
+		_used_size += size;
 		return (void*)b.pos;
 	}
 
@@ -206,24 +308,73 @@ namespace vmgc {
 		if (nullptr == p)
 			return;
 		
-		auto pos = (intptr_t)p;
-		for (auto it = _malloced_blocks_buffers->begin(); it != _malloced_blocks_buffers->end(); it++) {
-			auto block_pos = it->first.blockpos;
-			if ((pos >=block_pos) && (pos<(block_pos + it->first.blocksize))) {
-				auto &block_buffers = it->second;
-				for (auto bufit = block_buffers.begin(); bufit != block_buffers.end(); bufit++) {
-					if (pos == bufit->pos) {  //
-
-						Buffer eb(pos, bufit->size);
-						insert_empty_buffer(eb, it->first);
-
-						_used_size -= bufit->size;
-						block_buffers.erase(bufit);
-						return;
-					}
-				}
-			}
+		auto it = _malloced_buffers->find((intptr_t)p);
+		if (it == _malloced_buffers->end())
+			return;
+		const auto& gcbuf = it->second;
+		if (gcbuf.size_class == GC_LARGE_SIZE_CLASS) {
+			auto block_it = _malloced_blocks->find(gcbuf.blockpos);
+			_total_malloced_blocks_size -= block_it->second.blocksize;
+			_malloced_blocks->erase(block_it);
+			free(p);
+		}
+		else {
+			_free_buffers[gcbuf.size_class]->push_back(gcbuf.pos);
+		}
+		_used_size -= gcbuf.size;
+		_malloced_buffers->erase(it);
+	}
+
+	void GcState::gc_begin_mark() {
+		// objects left in the sweep list are still unreachable, the new mark finds them again
+		_sweep_list.clear();
+		_sweep_pos = 0;
+		_current_mark = (_current_mark == 1) ? 2 : 1;
+	}
+
+	size_t GcState::gc_end_mark() {
+		std::vector<std::pair<uint64_t, GcObject*>> dead;
+		for (const auto& item : (*_malloced_buffers)) {
+			if (!item.second.isGcObj)
+				continue;
+			auto gc_obj = (GcObject*)item.second.pos;
+			if (gc_obj->marked != _current_mark)
+				dead.push_back(std::make_pair(item.second.serial, gc_obj));
+		}
+		// the buffers index is unordered, sort by allocation order to free in the same order on every node
+		std::sort(dead.begin(), dead.end(), [](const std::pair<uint64_t, GcObject*>& a, const std::pair<uint64_t, GcObject*>& b) {
+			return a.first < b.first;
+		});
+		_sweep_list.clear();
+		_sweep_list.reserve(dead.size());
+		for (const auto& item : dead) {
+			_sweep_list.push_back(item.second);
+		}
+		_sweep_pos = 0;
+		_gc_stats.cycles++;
+		return _sweep_list.size();
+	}
+
+	size_t GcState::gc_sweep_step(size_t max_count, const std::function<void(GcObject*)>& before_free) {
+		size_t count = 0;
+		while (count < max_count && _sweep_pos < _sweep_list.size()) {
+			auto gc_obj = _sweep_list[_sweep_pos++];
+			if (gc_obj->marked == _current_mark)
+				continue;  // marked again by the owner since the end of the mark
+			auto used_size = _used_size;
+			if (before_free)
+				before_free(gc_obj);
+			gc_obj->~GcObject();
+			gc_free(gc_obj);
+			_gc_stats.swept_objects++;
+			_gc_stats.swept_bytes += uint64_t(used_size - _used_size);
+			count++;
+		}
+		if (_sweep_pos >= _sweep_list.size()) {
+			_sweep_list.clear();
+			_sweep_pos = 0;
 		}
+		return count;
 	}
 
 	void GcState::gc_free_array(void* p, size_t count, size_t size)
@@ -257,8 +408,8 @@ namespace vmgc {
 		}
 		else
 		{
-			if (newsz <= oldsz) {
-				//no op
+			if (newsz <= oldsz || ptrdiff_t(newsz) <= buffer_size(p)) {
+				//no op, the buffer is big enough already
 				return p;
 			}
 			newp = gc_malloc(newsz);
@@ -311,85 +462,53 @@ namespace vmgc {
 		return _used_size;
 	}
 
-	void GcState::fill_gc_string(GcObject* p, const char* str, size_t size) {
-		auto sp = static_cast<uvm_types::GcString*>(p);
-		sp->value = std::string(str,size);
-		sp->tt = sp->tt_;
+	ptrdiff_t GcState::buffer_size(void* p) const {
+		auto it = _malloced_buffers->find((intptr_t)p);
+		if (it == _malloced_buffers->end())
+			return 0;
+		return it->second.size;
 	}
 
-	//ֳ֧С2^5hashڵڴֻϴʷײ
-	static unsigned int gc_str_hash(const char *str, size_t l, unsigned int seed) {
-		unsigned int h = seed ^ lua_cast(unsigned int, l);
-		size_t step = (l >> DEFAULT_GC_STR_HASHLIMIT) + 1;
-		for (; l >= step; l -= step)
-			h ^= ((h << 5) + (h >> 2) + cast_byte(str[l - 1]));
-		return h;
+	GcStatePool::GcStatePool(size_t max_idle_count) {
+		_max_idle_count = max_idle_count;
+		_enabled = false;
 	}
 
-	void* GcState::gc_intern_strpool(size_t sz, size_t strsize, const char* str, bool* isNewStr) {
-		void* p = nullptr;
-		unsigned int seed = 1;
-		unsigned int h = gc_str_hash(str, strsize, seed);
-
-		auto it = _gc_strpool->find(h);
+	GcStatePool::~GcStatePool() {
+		for (auto state : _idle_states) {
+			delete state;
+		}
+		_idle_states.clear();
+	}
 
-		if (it == _gc_strpool->end()) {
-			if (_gc_strpool->size() >= MAX_GC_STR_POOL_ITEMS_COUNT) {
-				return nullptr;
-			}
-			*isNewStr = true;
+	GcState* GcStatePool::acquire(ptrdiff_t max_gc_heap_size) {
+		GcState* state;
+		if (_idle_states.empty()) {
+			state = new GcState(max_gc_heap_size);
 		}
 		else {
-			*isNewStr = false;
-			p = (void *)it->second.first; 
-
-			uvm_types::GcString* gcstr = static_cast<uvm_types::GcString*>(p);
-			if (strncmp(gcstr->value.c_str(), str, strsize) != 0) { //ײ
-				//new it 
-				*isNewStr = true;
-			}
+			state = _idle_states.back();
+			_idle_states.pop_back();
+			state->set_max_gc_size(max_gc_heap_size);
 		}
+		state->set_pooled(true);
+		return state;
+	}
 
-		if (*isNewStr) {
-			//add 
-			size_t align8sz = align8(sz);
-
-			if (align8sz <= size_t(_empty_str_buffer.second)) {
-				_gc_strpool->insert(std::pair<unsigned int, std::pair<intptr_t, ptrdiff_t>>(h, std::pair<intptr_t, ptrdiff_t>(_empty_str_buffer.first, align8sz)));
-				p = (void*) _empty_str_buffer.first;
-
-				_empty_str_buffer.first = _empty_str_buffer.first + align8sz;
-				_empty_str_buffer.second = _empty_str_buffer.second - align8sz;
-
-			}
-			else {
-				//malloc new block
-				if (DEFAULT_GC_BLOCK_SIZE + _total_malloced_blocks_size > _max_gc_size) {
-					throw GcException(std::string("not enough memery in gc , used gc size: ") + std::to_string(_used_size));
-					return nullptr;
-				}
-				p = malloc(DEFAULT_GC_BLOCK_SIZE);
-				if (!p) {
-					throw GcException(std::string("not enough memery in gc , used gc size: ") + std::to_string(_used_size));
-					return nullptr;
-				}
-				_total_malloced_blocks_size += DEFAULT_GC_BLOCK_SIZE;
-
-				std::pair<intptr_t, intptr_t> block;
-				block.first = (intptr_t)p;
-				block.second = DEFAULT_GC_BLOCK_SIZE;
-				_malloced_str_blocks->push_back(block);
-
-				_gc_strpool->insert(std::pair<unsigned int, std::pair<intptr_t, ptrdiff_t>>(h, std::pair<intptr_t, ptrdiff_t>((intptr_t)p, align8sz)));
-
-				if (align8sz < DEFAULT_GC_BLOCK_SIZE) {
-					_empty_str_buffer.first = (intptr_t)p + align8sz;
-					_empty_str_buffer.second = DEFAULT_GC_BLOCK_SIZE - align8sz;
-				}
-			}
-			_used_size += align8sz;
+	void GcStatePool::release(GcState* state) {
+		if (!state)
+			return;
+		if (_idle_states.size() >= _max_idle_count) {
+			delete state;
+			return;
 		}
-		return p;
+		state->reset();
+		_idle_states.push_back(state);
+	}
+
+	GcStatePool& GcStatePool::thread_pool() {
+		static thread_local GcStatePool pool;
+		return pool;
 	}
 
 }
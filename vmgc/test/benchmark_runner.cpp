@@ -0,0 +1,108 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <random>
+#include "vmgc/vmgc.h"
+
+using namespace vmgc;
+
+struct BenchObject : vmgc::GcObject
+{
+	const static vmgc::gc_type type = 101;
+	int64_t value = 0;
+	virtual ~BenchObject() {}
+};
+
+static double elapsed_seconds(std::chrono::steady_clock::time_point start) {
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(end - start).count();
+}
+
+// allocate `live_count` objects and raw buffers, then free them in random order
+static void bench_alloc_free(size_t live_count) {
+	GcState state(1024 * 1024 * 1024);
+	std::vector<void*> items;
+	items.reserve(live_count);
+	std::mt19937 rng(12345);
+	const size_t raw_sizes[] = { 8, 16, 24, 40, 64, 96, 128, 200, 512 };
+
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < live_count; i++) {
+		if (i % 2 == 0)
+			items.push_back(state.gc_new_object<BenchObject>());
+		else
+			items.push_back(state.gc_malloc(raw_sizes[i % (sizeof(raw_sizes) / sizeof(raw_sizes[0]))]));
+	}
+	auto alloc_seconds = elapsed_seconds(start);
+
+	std::shuffle(items.begin(), items.end(), rng);
+	start = std::chrono::steady_clock::now();
+	for (auto p : items) {
+		state.gc_free(p);
+	}
+	auto free_seconds = elapsed_seconds(start);
+
+	// steady state: keep live_count objects alive while churning
+	items.clear();
+	for (size_t i = 0; i < live_count; i++) {
+		items.push_back(state.gc_malloc(raw_sizes[i % (sizeof(raw_sizes) / sizeof(raw_sizes[0]))]));
+	}
+	const size_t churn_count = 100000;
+	start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < churn_count; i++) {
+		auto idx = rng() % items.size();
+		state.gc_free(items[idx]);
+		items[idx] = state.gc_malloc(raw_sizes[i % (sizeof(raw_sizes) / sizeof(raw_sizes[0]))]);
+	}
+	auto churn_seconds = elapsed_seconds(start);
+
+	std::cout << "live objects: " << live_count
+		<< "\talloc: " << size_t(live_count / alloc_seconds) << " ops/s"
+		<< "\tfree: " << size_t(live_count / free_seconds) << " ops/s"
+		<< "\tchurn(free+alloc): " << size_t(churn_count / churn_seconds) << " ops/s"
+		<< std::endl;
+}
+
+// one short transaction: fresh gc state, some objects and buffers, then close
+static void run_transaction(GcState* state) {
+	for (size_t i = 0; i < 2000; i++) {
+		state->gc_new_object<BenchObject>();
+		state->gc_malloc(16 + (i % 8) * 24);
+	}
+}
+
+// create-run-close cycles per second, with new gc state per cycle and with the gc state pool
+static void bench_state_cycles(size_t cycles) {
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < cycles; i++) {
+		auto state = new GcState();
+		run_transaction(state);
+		delete state;
+	}
+	auto new_seconds = elapsed_seconds(start);
+
+	GcStatePool pool;
+	start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < cycles; i++) {
+		auto state = pool.acquire();
+		run_transaction(state);
+		pool.release(state);
+	}
+	auto pool_seconds = elapsed_seconds(start);
+
+	std::cout << "state cycles: " << cycles
+		<< "\tnew/delete: " << size_t(cycles / new_seconds) << " cycles/s"
+		<< "\tpool acquire/release: " << size_t(cycles / pool_seconds) << " cycles/s"
+		<< std::endl;
+}
+
+int main(int argc, char** argv) {
+	const size_t live_counts[] = { 10000, 100000, 1000000 };
+	for (auto live_count : live_counts) {
+		bench_alloc_free(live_count);
+	}
+	bench_state_cycles(10000);
+	return 0;
+}
@@ -92,4 +92,250 @@ BOOST_AUTO_TEST_CASE(gc_grow_vector)
 	state.gc_free_array(p4, count4, sizeof(GcString));
 }
 
+BOOST_AUTO_TEST_CASE(free_by_address_test)
+{
+	GcState state;
+	std::vector<void*> items;
+	for (size_t i = 0; i < 10000; i++) {
+		items.push_back(state.gc_malloc(8 + (i % 40) * 8));
+	}
+	BOOST_CHECK(state.buffer_size(items[1]) == 16);
+	BOOST_CHECK(state.buffer_size((char*)items[1] + 8) == 0);
+	auto p = state.gc_realloc(items[1], 16, 16);
+	BOOST_CHECK(p == items[1]);
+	for (size_t i = 0; i < items.size(); i += 2) {
+		state.gc_free(items[i]);
+	}
+	for (size_t i = 1; i < items.size(); i += 2) {
+		state.gc_free(items[i]);
+	}
+	BOOST_CHECK(state.usedsize() == 0);
+	// freeing an unknown pointer is ignored
+	state.gc_free(items[0]);
+	BOOST_CHECK(state.usedsize() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(size_classes_test)
+{
+	for (size_t size = 8; size <= GC_MAX_SIZE_CLASS_SIZE; size += 8) {
+		auto index = GcState::size_class_index(size);
+		BOOST_REQUIRE(index >= 0 && index < GC_SIZE_CLASSES_COUNT);
+		BOOST_REQUIRE(GcState::size_class_size(index) >= size);
+		BOOST_REQUIRE(index == 0 || GcState::size_class_size(index - 1) < size);
+	}
+	BOOST_CHECK(GcState::size_class_size(GC_SIZE_CLASSES_COUNT - 1) == GC_MAX_SIZE_CLASS_SIZE);
+
+	// usedsize keeps counting the 8-aligned requested size, not the size class
+	GcState state;
+	auto p1 = state.gc_malloc(130);
+	BOOST_CHECK(state.usedsize() == 136);
+	auto p2 = state.gc_malloc(GC_MAX_SIZE_CLASS_SIZE + 1);
+	BOOST_CHECK(state.usedsize() == 136 + GC_MAX_SIZE_CLASS_SIZE + 8);
+	state.gc_free(p2);
+	state.gc_free(p1);
+	BOOST_CHECK(state.usedsize() == 0);
+	// freed buffer of same size class is reused
+	auto p3 = state.gc_malloc(150);
+	BOOST_CHECK(p3 == p1);
+}
+
+BOOST_AUTO_TEST_CASE(heap_limit_test)
+{
+	GcState state(1024 * 1024);
+	std::vector<void*> items;
+	// fill the heap with 1KB buffers, then free them and reuse the memory for smaller buffers
+	try {
+		for (;;) {
+			items.push_back(state.gc_malloc(1024));
+		}
+	}
+	catch (const GcException&) {
+	}
+	BOOST_CHECK(items.size() > 512);
+	for (auto p : items) {
+		state.gc_free(p);
+	}
+	BOOST_CHECK(state.usedsize() == 0);
+	for (size_t i = 0; i < items.size(); i++) {
+		state.gc_malloc(512);
+	}
+	BOOST_CHECK(state.usedsize() == ptrdiff_t(items.size() * 512));
+}
+
+BOOST_AUTO_TEST_CASE(mark_sweep_test)
+{
+	GcState state;
+	std::vector<GcString*> objects;
+	for (int i = 0; i < 10; i++) {
+		auto p = state.gc_new_object<GcString>();
+		p->value = std::to_string(i);
+		objects.push_back(p);
+	}
+	auto raw = state.gc_malloc(64);
+	auto size_before = state.usedsize();
+
+	// keep the even objects, the sweep frees the odd ones in allocation order
+	state.gc_begin_mark();
+	for (int i = 0; i < 10; i += 2) {
+		BOOST_CHECK(state.gc_mark(objects[i]));
+		BOOST_CHECK(!state.gc_mark(objects[i]));
+	}
+	BOOST_CHECK(state.gc_end_mark() == 5);
+	BOOST_CHECK(state.gc_is_sweeping());
+	std::vector<std::string> freed;
+	auto record = [&](GcObject* obj) { freed.push_back(static_cast<GcString*>(obj)->value); };
+	BOOST_CHECK(state.gc_sweep_step(2, record) == 2);
+	BOOST_CHECK(state.gc_sweep_step(10, record) == 3);
+	BOOST_CHECK(!state.gc_is_sweeping());
+	BOOST_CHECK(freed == std::vector<std::string>({ "1", "3", "5", "7", "9" }));
+	BOOST_CHECK(state.usedsize() == size_before - ptrdiff_t(5 * state.buffer_size(objects[0])));
+	BOOST_CHECK(state.buffer_size(raw) == 64); // raw buffers are not traced
+	BOOST_CHECK(state.gc_stats().swept_objects == 5);
+
+	// marks of the previous cycle are not kept
+	state.gc_begin_mark();
+	BOOST_CHECK(!state.gc_is_marked(objects[0]));
+	BOOST_CHECK(state.gc_end_mark() == 5);
+	state.gc_sweep_step(100, nullptr);
+	BOOST_CHECK(state.usedsize() == 64);
+}
+
+struct PlainObject : vmgc::GcObject
+{
+	const static vmgc::gc_type type = 102;
+	const static bool trivial_members = true;
+	static int destructed_count;
+	int64_t value = 0;
+
+	virtual ~PlainObject() {
+		destructed_count++;
+	}
+};
+int PlainObject::destructed_count = 0;
+
+BOOST_AUTO_TEST_CASE(reset_test)
+{
+	GcState state;
+	std::vector<void*> first_round;
+	for (int i = 0; i < 1000; i++) {
+		first_round.push_back(state.gc_malloc(64));
+	}
+	auto big = state.gc_malloc(128 * 1024);
+	auto str = state.gc_new_object<GcString>();
+	str->value = std::string(100, 'a');
+	state.gc_new_object<PlainObject>();
+	BOOST_CHECK(state.buffer_size(big) == 128 * 1024);
+
+	// blocks are kept, objects with trivial members are dropped without destructor
+	PlainObject::destructed_count = 0;
+	state.reset();
+	BOOST_CHECK(state.usedsize() == 0);
+	BOOST_CHECK(PlainObject::destructed_count == 0);
+	BOOST_CHECK(state.buffer_size(first_round[0]) == 0);
+	BOOST_CHECK(state.buffer_size(big) == 0);
+
+	// same allocation sequence gets the same addresses from the retained blocks
+	for (int i = 0; i < 1000; i++) {
+		BOOST_CHECK(state.gc_malloc(64) == first_round[i]);
+	}
+	BOOST_CHECK(state.usedsize() == 1000 * 64);
+}
+
+BOOST_AUTO_TEST_CASE(free_all_reset_reuse_test)
+{
+	const ptrdiff_t max_size = 2 * 1024 * 1024;
+	GcState state(max_size);
+	// same order as closing a pooled lua state: gc_free_all, then reset when released to the pool
+	for (int round = 0; round < 3; round++) {
+		auto big = state.gc_malloc(100 * 1024);
+		BOOST_CHECK(big != nullptr);
+		for (int i = 0; i < 4000; i++) {
+			state.gc_new_object<GcString>()->value = "abc";
+		}
+		auto blocks_size = state.malloced_blocks_size();
+		state.gc_free_all();
+		state.reset();
+		// the large buffer block is freed, bump blocks are kept and still counted
+		BOOST_CHECK(state.malloced_blocks_size() == blocks_size - 100 * 1024);
+		BOOST_CHECK(state.usedsize() == 0);
+
+		// fill every retained block with small buffers, past the end of a large block if it was kept
+		std::vector<char*> items;
+		for (int i = 0; i < 2000; i++) {
+			auto p = static_cast<char*>(state.gc_malloc(256));
+			memset(p, 'x', 256);
+			items.push_back(p);
+		}
+		BOOST_CHECK(state.malloced_blocks_size() <= max_size);
+		state.gc_free_all();
+		state.reset();
+	}
+
+	// the kept heap is limited again by max gc size
+	std::vector<void*> items;
+	try {
+		for (;;) {
+			items.push_back(state.gc_malloc(1024));
+		}
+	}
+	catch (const GcException&) {
+	}
+	BOOST_CHECK(state.malloced_blocks_size() <= max_size);
+	BOOST_CHECK(items.size() > 1024 && items.size() <= 2048);
+	state.gc_free_all();
+	state.reset();
+	state.set_max_gc_size(512 * 1024);
+	BOOST_CHECK(state.malloced_blocks_size() <= 512 * 1024);
+}
+
+BOOST_AUTO_TEST_CASE(state_pool_test)
+{
+	GcStatePool pool(1);
+	auto state1 = pool.acquire(1024 * 1024);
+	BOOST_CHECK(state1->pooled());
+	auto p = state1->gc_malloc(64);
+	pool.release(state1);
+	BOOST_CHECK(pool.idle_count() == 1);
+
+	auto state2 = pool.acquire(1024 * 1024);
+	BOOST_CHECK(state2 == state1);
+	BOOST_CHECK(state2->usedsize() == 0);
+	BOOST_CHECK(state2->gc_malloc(64) == p);
+
+	auto state3 = pool.acquire(1024 * 1024);
+	BOOST_CHECK(state3 != state2);
+	pool.release(state2);
+	pool.release(state3); // pool is full, deleted
+	BOOST_CHECK(pool.idle_count() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(object_with_extra_test)
+{
+	GcState state;
+	auto obj = state.gc_new_object_with_extra<PlainObject>(100);
+	BOOST_CHECK(obj->tt == PlainObject::type);
+	BOOST_CHECK(state.buffer_size(obj) >= ptrdiff_t(sizeof(PlainObject) + 100));
+	auto bytes = reinterpret_cast<char*>(obj + 1);
+	memset(bytes, 'x', 100);
+	BOOST_CHECK(obj->value == 0);
+	state.gc_free(obj);
+	BOOST_CHECK(state.usedsize() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(sweep_resurrect_test)
+{
+	GcState state;
+	std::vector<PlainObject*> objects;
+	for (int i = 0; i < 4; i++) {
+		objects.push_back(state.gc_new_object<PlainObject>());
+	}
+	state.gc_begin_mark();
+	BOOST_CHECK(state.gc_end_mark() == 4);
+	// found again before its sweep step, the object is kept
+	state.gc_mark(objects[2]);
+	BOOST_CHECK(state.gc_sweep_step(100, nullptr) == 3);
+	BOOST_CHECK(state.buffer_size(objects[2]) > 0);
+	BOOST_CHECK(state.buffer_size(objects[0]) == 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()